@@ -1,10 +1,141 @@
-// Dummy LPC17xx.h for unit testing
+// Dummy LPC17xx.h for unit testing and host simulation
 #ifndef __LPC17XX_H
 #define __LPC17XX_H
 
-// Add any minimal type definitions or macros that might be
-// dereferenced or used in logic.c if it were to include this directly.
-// For now, keeping it minimal as logic.c's direct hardware interaction
-// is expected to be abstracted by keypad.c, lcd.c etc.
+// On the target the CMSIS device header is used instead of this file.
+// Here, only the peripherals touched by the drivers are declared, and their
+// register blocks are backed by host memory that board_sim.c interprets.
+// Register layouts are abbreviated to the fields the firmware uses.
+
+#include <stdint.h>
+#include "sim_local.h"
+
+#define LPC17XX_HOST_SIM 1 // Lets drivers route register stores through the simulator
+
+typedef struct {
+    volatile uint32_t FIODIR;
+    uint32_t RESERVED0[3];
+    volatile uint32_t FIOMASK;
+    volatile uint32_t FIOPIN;
+    volatile uint32_t FIOSET;
+    volatile uint32_t FIOCLR;
+} LPC_GPIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t FLASHCFG;
+    volatile uint32_t PLL0CON;
+    volatile uint32_t PLL0CFG;
+    volatile uint32_t PLL0STAT;
+    volatile uint32_t PLL0FEED;
+    volatile uint32_t PCONP;
+    volatile uint32_t CCLKCFG;
+    volatile uint32_t CLKSRCSEL;
+    volatile uint32_t SCS;
+    volatile uint32_t PCLKSEL0;
+    volatile uint32_t PCLKSEL1;
+    volatile uint32_t DMAREQSEL;
+} LPC_SC_TypeDef;
+
+typedef struct {
+    volatile uint32_t IR;
+    volatile uint32_t TCR;
+    volatile uint32_t TC;
+    volatile uint32_t PR;
+    volatile uint32_t PC;
+    volatile uint32_t MCR;
+    volatile uint32_t MR0;
+    volatile uint32_t MR1;
+    volatile uint32_t MR2;
+    volatile uint32_t MR3;
+} LPC_TIM_TypeDef;
+
+typedef struct {
+    volatile uint32_t DMACIntStat;
+    volatile uint32_t DMACIntTCStat;
+    volatile uint32_t DMACIntTCClear;
+    volatile uint32_t DMACIntErrStat;
+    volatile uint32_t DMACIntErrClr;
+    volatile uint32_t DMACEnbldChns;
+    volatile uint32_t DMACConfig;
+} LPC_GPDMA_TypeDef;
+
+// Address registers are pointer-sized so host buffers can be referenced
+typedef struct {
+    volatile uintptr_t DMACCSrcAddr;
+    volatile uintptr_t DMACCDestAddr;
+    volatile uintptr_t DMACCLLI;
+    volatile uint32_t DMACCControl;
+    volatile uint32_t DMACCConfig;
+} LPC_GPDMACH_TypeDef;
+
+// Cortex-M3 cycle counter (core_cm3.h). The simulator counts CCLK cycles of
+// virtual busy time; instruction time is not modelled.
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+extern SIM_LOCAL uint32_t SystemCoreClock; // CCLK in Hz, as in CMSIS system_LPC17xx.c
+
+// In-application programming (IAP) routines of the boot ROM, which the target calls
+// through the entry point at 0x1FFF1FF1. sim_iap() implements the prepare, copy RAM
+// to flash and erase commands with their datasheet timing (board_sim.c). Parameters
+// are pointer-sized so that host RAM addresses fit. Only the two 32 kB sectors at
+// the top of flash (28 and 29) are backed, by sim_flash_top; SIM_FLASH() maps a
+// flash address there for reading.
+#define SIM_FLASH_TOP_ADDR 0x00070000UL
+#define SIM_FLASH_TOP_SIZE 0x10000UL
+#define SIM_FLASH(addr) (&sim_flash_top[(addr) - SIM_FLASH_TOP_ADDR])
+extern SIM_LOCAL uint8_t sim_flash_top[SIM_FLASH_TOP_SIZE];
+void sim_iap(uintptr_t command[5], uintptr_t result[5]);
+
+// SRAM left out of the startup code's zeroing (.noinit). It keeps its contents
+// through a reset as long as power holds, see board_sim_restart().
+#define SIM_NOINIT_SIZE 1024
+extern SIM_LOCAL uint32_t sim_noinit[SIM_NOINIT_SIZE / 4];
+
+extern SIM_LOCAL LPC_GPIO_TypeDef sim_gpio[5];
+extern SIM_LOCAL LPC_SC_TypeDef sim_sc;
+extern SIM_LOCAL LPC_TIM_TypeDef sim_tim[4];
+extern SIM_LOCAL LPC_GPDMA_TypeDef sim_gpdma;
+extern SIM_LOCAL LPC_GPDMACH_TypeDef sim_gpdmach[8];
+extern SIM_LOCAL DWT_Type sim_dwt;
+extern SIM_LOCAL CoreDebug_Type sim_coredebug;
+
+#ifdef SIM_THREAD_LOCAL
+// Thread-local ports have no address fixed at compile time, which the pin groups
+// of board_pins.h need. Their addresses point into sim_gpio_layout, which is
+// never accessed; SIM_GPIO() maps such an address to this thread's port.
+extern LPC_GPIO_TypeDef sim_gpio_layout[5];
+#define SIM_GPIO(port) (&sim_gpio[(port) - sim_gpio_layout])
+#define LPC_GPIO0 (&sim_gpio_layout[0])
+#define LPC_GPIO1 (&sim_gpio_layout[1])
+#define LPC_GPIO2 (&sim_gpio_layout[2])
+#define LPC_GPIO3 (&sim_gpio_layout[3])
+#define LPC_GPIO4 (&sim_gpio_layout[4])
+#else
+#define SIM_GPIO(port) (port)
+#define LPC_GPIO0 (&sim_gpio[0])
+#define LPC_GPIO1 (&sim_gpio[1])
+#define LPC_GPIO2 (&sim_gpio[2])
+#define LPC_GPIO3 (&sim_gpio[3])
+#define LPC_GPIO4 (&sim_gpio[4])
+#endif
+#define LPC_SC (&sim_sc)
+#define LPC_TIM0 (&sim_tim[0])
+#define LPC_TIM1 (&sim_tim[1])
+#define LPC_TIM2 (&sim_tim[2])
+#define LPC_TIM3 (&sim_tim[3])
+#define LPC_GPDMA (&sim_gpdma)
+#define LPC_GPDMACH0 (&sim_gpdmach[0])
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_coredebug)
 
 #endif // __LPC17XX_H
@@ -0,0 +1,25 @@
+// ============= BOARD.HPP =============
+// Pin maps of this board, from the templates in pinmap.hpp. board_pins_gen.cpp
+// emits them as C constants (board_pins_gen.h), and board_pins.cpp checks that
+// the emitted header still matches.
+#ifndef BOARD_HPP
+#define BOARD_HPP
+
+#include "pinmap.hpp"
+
+namespace board {
+
+using namespace pinmap;
+
+// Keypad on port 1: rows P1.9, P1.10, P1.14, P1.15; columns P1.0, P1.1, P1.4, P1.8
+using Keypad = KeypadMatrix<1, PinList<9, 10, 14, 15>, PinList<0, 1, 4, 8>>;
+// LCD on port 0: RS P0.9, RW P0.10, EN P0.11, D4-D7 on P0.19-P0.22
+using Lcd = Hd44780Bus<0, 9, 10, 11, PinList<19, 20, 21, 22>>;
+
+static_assert(Keypad::rows == 4 && Keypad::cols == 4, "keypad.c expects a 4x4 matrix");
+static_assert(Keypad::port != Lcd::port, "keypad and LCD each claim FIOMASK of their own port");
+static_assert(Keypad::port <= 4 && Lcd::port <= 4, "the LPC1768 has GPIO ports 0 to 4");
+
+} // namespace board
+
+#endif
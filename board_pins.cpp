@@ -0,0 +1,74 @@
+// ============= BOARD_PINS.CPP =============
+// Compile-time check that board_pins_gen.h, the C constants the drivers use
+// (see board_pins.h), still matches the board in board.hpp. A board change
+// without regenerating the header fails here. Emits no code.
+// ===================================
+
+#include <stdint.h>
+#include "board.hpp"
+#include "board_pins_gen.h"
+
+using namespace board;
+
+namespace {
+
+template <typename A, typename B>
+constexpr bool same(const A &generated, const B *expected, unsigned n)
+{
+    if (sizeof(generated) / sizeof(generated[0]) != n) {
+        return false;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        if (generated[i] != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Pins>
+constexpr bool same_bits(const uint32_t (&generated)[4])
+{
+    for (unsigned i = 0; i < 4; i++) {
+        if (generated[i] != 1u << Pins::pins[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr uint32_t row_patterns[] = BOARD_KEYPAD_ROW_PATTERNS;
+constexpr uint32_t row_bits[] = BOARD_KEYPAD_ROW_BITS;
+constexpr uint32_t col_bits[] = BOARD_KEYPAD_COL_BITS;
+constexpr uint32_t col_pins[] = BOARD_KEYPAD_COL_PINS;
+constexpr uint8_t column_table[] = BOARD_KEYPAD_COLUMN_TABLE;
+constexpr uint32_t lcd_data_bits[] = BOARD_LCD_DATA_BITS;
+constexpr uint32_t nibble_patterns[] = BOARD_LCD_NIBBLE_PATTERNS;
+constexpr uint32_t lcd_data_expected[] = {
+    Lcd::nibble_patterns.v[1], Lcd::nibble_patterns.v[2],
+    Lcd::nibble_patterns.v[4], Lcd::nibble_patterns.v[8]
+};
+
+} // namespace
+
+#define STALE "board_pins_gen.h is stale: rerun board_pins_gen"
+
+// The GPIO port is checked through its name: LPC_GPIO<port>
+#define BOARD_PORT_NAME(gpio) #gpio
+#define BOARD_PORT_DIGIT(gpio) BOARD_PORT_NAME(gpio)[8]
+static_assert(BOARD_PORT_DIGIT(BOARD_KEYPAD_GPIO) == '0' + Keypad::port, STALE);
+static_assert(BOARD_PORT_DIGIT(BOARD_LCD_GPIO) == '0' + Lcd::port, STALE);
+
+static_assert(BOARD_KEYPAD_MASK == Keypad::mask, STALE);
+static_assert(BOARD_KEYPAD_ROW_MASK == Keypad::row_mask, STALE);
+static_assert(same(row_patterns, Keypad::row_patterns.v, Keypad::rows), STALE);
+static_assert(same_bits<Keypad::row_list>(row_bits), STALE);
+static_assert(same_bits<Keypad::col_list>(col_bits), STALE);
+static_assert(same(col_pins, Keypad::col_list::pins, Keypad::cols), STALE);
+static_assert(same(column_table, Keypad::column_table.v, 1u << Keypad::cols), STALE);
+
+static_assert(BOARD_LCD_MASK == Lcd::mask, STALE);
+static_assert(BOARD_LCD_RS_BIT == Lcd::rs, STALE);
+static_assert(BOARD_LCD_EN_BIT == Lcd::en, STALE);
+static_assert(same(lcd_data_bits, lcd_data_expected, 4), STALE);
+static_assert(same(nibble_patterns, Lcd::nibble_patterns.v, 16), STALE);
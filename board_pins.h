@@ -0,0 +1,49 @@
+// ============= BOARD_PINS.H =============
+// C view of the board's pin maps. The values come from board_pins_gen.h, which
+// board_pins_gen.cpp generates from the templates in pinmap.hpp; change the board
+// in board.hpp. Everything here is a constant with internal linkage, so masks and
+// patterns become immediates and constant-indexed table entries fold away.
+#ifndef BOARD_PINS_H
+#define BOARD_PINS_H
+
+#include <stdint.h>
+#include "gpio.h"
+#include "board_pins_gen.h"
+
+// --- Keypad matrix (4 rows, 4 columns) ---
+static const gpio_group keypad_pins = { BOARD_KEYPAD_GPIO, BOARD_KEYPAD_MASK }; // Rows and columns on one port
+static const uint32_t keypad_row_mask = BOARD_KEYPAD_ROW_MASK;                // All row pins
+static const uint32_t keypad_row_patterns[4] = BOARD_KEYPAD_ROW_PATTERNS;     // All rows high except row i
+static const uint32_t keypad_row_bits[4] = BOARD_KEYPAD_ROW_BITS;             // Pin bit of row i
+static const uint32_t keypad_col_bits[4] = BOARD_KEYPAD_COL_BITS;             // Pin bit of column i
+
+static const uint32_t keypad_col_pins[4] = BOARD_KEYPAD_COL_PINS;             // Pin number of column i
+static const uint8_t keypad_column_table[16] = BOARD_KEYPAD_COLUMN_TABLE;     // First low column per keypad_col_compact()
+
+// Bit i set if column i's pin is high in a FIOPIN value (constant shifts and masks)
+static inline unsigned keypad_col_compact(uint32_t port_bits)
+{
+    return ((port_bits >> keypad_col_pins[0]) & 1u) | (((port_bits >> keypad_col_pins[1]) & 1u) << 1) |
+           (((port_bits >> keypad_col_pins[2]) & 1u) << 2) | (((port_bits >> keypad_col_pins[3]) & 1u) << 3);
+}
+
+// Index of the first column reading low in a FIOPIN value, 4 if none (one table load)
+static inline unsigned char keypad_column(uint32_t port_bits)
+{
+    return keypad_column_table[keypad_col_compact(port_bits)];
+}
+
+// Bit i set for each column i reading low
+static inline unsigned char keypad_columns(uint32_t port_bits)
+{
+    return (unsigned char)(~keypad_col_compact(port_bits) & 0xFu);
+}
+
+// --- HD44780 bus ---
+static const gpio_group lcd_pins = { BOARD_LCD_GPIO, BOARD_LCD_MASK };        // RS, RW, EN and D4-D7 on one port
+static const uint32_t lcd_rs_bit = BOARD_LCD_RS_BIT;
+static const uint32_t lcd_en_bit = BOARD_LCD_EN_BIT;
+static const uint32_t lcd_data_bits[4] = BOARD_LCD_DATA_BITS;                 // Pin bit of D4..D7
+static const uint32_t lcd_nibble_patterns[16] = BOARD_LCD_NIBBLE_PATTERNS;    // Data pin pattern for each nibble
+
+#endif
@@ -0,0 +1,79 @@
+// ============= BOARD_PINS_GEN.CPP =============
+// Host program that writes board_pins_gen.h: the pin maps of board.hpp as
+// preprocessor constants, so the C drivers get immediates instead of loads from
+// extern globals. Run it after changing the board:
+//
+//     g++ -std=c++17 -I. -o board_pins_gen board_pins_gen.cpp
+//     ./board_pins_gen > board_pins_gen.h
+// ===================================
+
+#include <stdio.h>
+#include "board.hpp"
+
+using namespace board;
+
+static void define(const char *name, uint32_t value)
+{
+    printf("#define %s 0x%08Xu\n", name, (unsigned)value);
+}
+
+// A brace-enclosed initializer, `per_line` values to a line
+template <typename T>
+static void define_table(const char *name, const T *v, unsigned n, unsigned per_line, int width)
+{
+    printf("#define %s { \\\n", name);
+    for (unsigned i = 0; i < n; i++) {
+        printf("%s0x%0*X%s", i % per_line ? " " : "    ", width, (unsigned)v[i], i + 1 < n ? "," : "");
+        if ((i + 1) % per_line == 0 || i + 1 == n) {
+            printf(" \\\n");
+        }
+    }
+    printf("}\n");
+}
+
+int main()
+{
+    const uint32_t row_bits[4] = {
+        1u << Keypad::row_list::pins[0], 1u << Keypad::row_list::pins[1],
+        1u << Keypad::row_list::pins[2], 1u << Keypad::row_list::pins[3]
+    };
+    const uint32_t col_bits[4] = {
+        1u << Keypad::col_list::pins[0], 1u << Keypad::col_list::pins[1],
+        1u << Keypad::col_list::pins[2], 1u << Keypad::col_list::pins[3]
+    };
+    const uint32_t data_bits[4] = {
+        Lcd::nibble_patterns.v[1], Lcd::nibble_patterns.v[2],
+        Lcd::nibble_patterns.v[4], Lcd::nibble_patterns.v[8]
+    };
+    const uint32_t col_pins[4] = {
+        Keypad::col_list::pins[0], Keypad::col_list::pins[1],
+        Keypad::col_list::pins[2], Keypad::col_list::pins[3]
+    };
+
+    printf("// ============= BOARD_PINS_GEN.H =============\n"
+           "// Generated by board_pins_gen.cpp from board.hpp. Do not edit; regenerate after\n"
+           "// changing the board. board_pins.cpp does not compile while this is stale.\n"
+           "#ifndef BOARD_PINS_GEN_H\n"
+           "#define BOARD_PINS_GEN_H\n\n");
+
+    printf("// --- Keypad matrix ---\n");
+    printf("#define BOARD_KEYPAD_GPIO LPC_GPIO%u\n", Keypad::port);
+    define("BOARD_KEYPAD_MASK", Keypad::mask);
+    define("BOARD_KEYPAD_ROW_MASK", Keypad::row_mask);
+    define_table("BOARD_KEYPAD_ROW_PATTERNS", Keypad::row_patterns.v, Keypad::rows, 4, 8);
+    define_table("BOARD_KEYPAD_ROW_BITS", row_bits, 4, 4, 8);
+    define_table("BOARD_KEYPAD_COL_BITS", col_bits, 4, 4, 8);
+    define_table("BOARD_KEYPAD_COL_PINS", col_pins, 4, 4, 2);
+    define_table("BOARD_KEYPAD_COLUMN_TABLE", Keypad::column_table.v, 1u << Keypad::cols, 16, 1);
+
+    printf("\n// --- HD44780 bus ---\n");
+    printf("#define BOARD_LCD_GPIO LPC_GPIO%u\n", Lcd::port);
+    define("BOARD_LCD_MASK", Lcd::mask);
+    define("BOARD_LCD_RS_BIT", Lcd::rs);
+    define("BOARD_LCD_EN_BIT", Lcd::en);
+    define_table("BOARD_LCD_DATA_BITS", data_bits, 4, 4, 8);
+    define_table("BOARD_LCD_NIBBLE_PATTERNS", Lcd::nibble_patterns.v, 16, 4, 8);
+
+    printf("\n#endif\n");
+    return 0;
+}
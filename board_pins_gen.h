@@ -0,0 +1,42 @@
+// ============= BOARD_PINS_GEN.H =============
+// Generated by board_pins_gen.cpp from board.hpp. Do not edit; regenerate after
+// changing the board. board_pins.cpp does not compile while this is stale.
+#ifndef BOARD_PINS_GEN_H
+#define BOARD_PINS_GEN_H
+
+// --- Keypad matrix ---
+#define BOARD_KEYPAD_GPIO LPC_GPIO1
+#define BOARD_KEYPAD_MASK 0x0000C713u
+#define BOARD_KEYPAD_ROW_MASK 0x0000C600u
+#define BOARD_KEYPAD_ROW_PATTERNS { \
+    0x0000C400, 0x0000C200, 0x00008600, 0x00004600 \
+}
+#define BOARD_KEYPAD_ROW_BITS { \
+    0x00000200, 0x00000400, 0x00004000, 0x00008000 \
+}
+#define BOARD_KEYPAD_COL_BITS { \
+    0x00000001, 0x00000002, 0x00000010, 0x00000100 \
+}
+#define BOARD_KEYPAD_COL_PINS { \
+    0x00, 0x01, 0x04, 0x08 \
+}
+#define BOARD_KEYPAD_COLUMN_TABLE { \
+    0x0, 0x1, 0x0, 0x2, 0x0, 0x1, 0x0, 0x3, 0x0, 0x1, 0x0, 0x2, 0x0, 0x1, 0x0, 0x4 \
+}
+
+// --- HD44780 bus ---
+#define BOARD_LCD_GPIO LPC_GPIO0
+#define BOARD_LCD_MASK 0x00780E00u
+#define BOARD_LCD_RS_BIT 0x00000200u
+#define BOARD_LCD_EN_BIT 0x00000800u
+#define BOARD_LCD_DATA_BITS { \
+    0x00080000, 0x00100000, 0x00200000, 0x00400000 \
+}
+#define BOARD_LCD_NIBBLE_PATTERNS { \
+    0x00000000, 0x00080000, 0x00100000, 0x00180000, \
+    0x00200000, 0x00280000, 0x00300000, 0x00380000, \
+    0x00400000, 0x00480000, 0x00500000, 0x00580000, \
+    0x00600000, 0x00680000, 0x00700000, 0x00780000 \
+}
+
+#endif
@@ -0,0 +1,717 @@
+// ============= BOARD_SIM.C =============
+// Host-side board model, see board_sim.h.
+// ===================================
+
+#include <LPC17xx.h>
+#include "board_sim.h"
+#include "lcd.h"
+#include "board_pins.h"
+#define DELAY_IMPLEMENTATION // Defines delay() and delay_us()
+#include "delay.h"
+
+#include <math.h>   // For log(), in the bounce model
+#include <string.h> // For memset()
+
+// Pin assignments come from the same compile-time pin map as the drivers
+#define LCD_RS lcd_rs_bit
+#define LCD_EN lcd_en_bit
+#define LCD_DATA (lcd_data_bits[0] | lcd_data_bits[1] | lcd_data_bits[2] | lcd_data_bits[3])
+
+// HD44780 bus timing (2-line module at 5 V, ns)
+#define LCD_T_PW_EH 450        // Minimum EN high width
+#define LCD_T_CYC_E 1000       // Minimum EN cycle time
+#define LCD_T_AS 60            // RS setup before EN rises
+#define LCD_T_DSW 195          // Data setup before EN falls
+#define LCD_T_EXEC 37000ULL    // Execution time of most instructions
+#define LCD_T_EXEC_CLEAR 1520000ULL // Clear display / return home
+
+// IAP (LPC1768 datasheet, flash endurance and timing)
+#define IAP_CMD_SUCCESS 0
+#define IAP_INVALID_COMMAND 1
+#define IAP_SRC_ADDR_ERROR 2
+#define IAP_DST_ADDR_ERROR 3
+#define IAP_DST_ADDR_NOT_MAPPED 5
+#define IAP_COUNT_ERROR 6
+#define IAP_INVALID_SECTOR 7
+#define IAP_SECTOR_NOT_PREPARED 9
+#define IAP_FIRST_SECTOR 28      // Sectors backed by sim_flash_top
+#define IAP_SECTOR_SIZE 0x8000UL
+#define IAP_T_ERASE 100000000ULL // Sector erase
+#define IAP_T_PROG 1000000ULL    // Per 256 bytes programmed
+
+SIM_LOCAL uint32_t SystemCoreClock = 100000000UL;
+SIM_LOCAL LPC_GPIO_TypeDef sim_gpio[5];
+#ifdef SIM_THREAD_LOCAL
+LPC_GPIO_TypeDef sim_gpio_layout[5];
+#endif
+SIM_LOCAL LPC_SC_TypeDef sim_sc;
+SIM_LOCAL LPC_TIM_TypeDef sim_tim[4];
+SIM_LOCAL LPC_GPDMA_TypeDef sim_gpdma;
+SIM_LOCAL LPC_GPDMACH_TypeDef sim_gpdmach[8];
+SIM_LOCAL DWT_Type sim_dwt;
+SIM_LOCAL CoreDebug_Type sim_coredebug;
+SIM_LOCAL uint8_t sim_flash_top[SIM_FLASH_TOP_SIZE];
+SIM_LOCAL uint32_t sim_noinit[SIM_NOINIT_SIZE / 4];
+
+SIM_LOCAL unsigned long sim_gpio_stores = 0;
+SIM_LOCAL unsigned long sim_dma_transfers = 0;
+SIM_LOCAL unsigned long sim_lcd_bytes = 0;
+SIM_LOCAL unsigned long sim_keypad_selects = 0;
+SIM_LOCAL unsigned long long sim_time_ns = 0;
+SIM_LOCAL unsigned long sim_lcd_timing_violations = 0;
+SIM_LOCAL const char *sim_lcd_last_violation = "";
+SIM_LOCAL sim_clock_slot sim_clock_residency[SIM_CLOCK_SLOTS];
+SIM_LOCAL unsigned long sim_timer_rate_errors = 0;
+SIM_LOCAL unsigned long sim_flash_wait_errors = 0;
+SIM_LOCAL unsigned long sim_iap_errors = 0;
+SIM_LOCAL unsigned long sim_flash_erases = 0;
+SIM_LOCAL unsigned long sim_flash_programs = 0;
+
+// Output latches (what the port drives on pins configured as outputs)
+static SIM_LOCAL uint32_t out_latch[5];
+
+// Keypad state: bit row * 4 + col is set for each key whose contacts are closed
+static SIM_LOCAL uint16_t pressed_keys = 0;
+
+// Contact bounce (times in ns). With a profile set, held_keys is what the finger
+// does and each key's contact follows it through the chatter of its switch.
+#define SIM_NEVER 0xFFFFFFFFFFFFFFFFULL
+typedef struct {
+    unsigned long long chatter_until; // End of the current burst of chatter or dropout
+    unsigned long long next;          // Next contact event, SIM_NEVER when settled
+    unsigned char dropout;            // The next event opens a held contact
+} sim_contact;
+static SIM_LOCAL const sim_bounce *bounce_profile;
+static SIM_LOCAL uint32_t bounce_rng;
+static SIM_LOCAL uint16_t held_keys;
+static SIM_LOCAL sim_contact contacts[16];
+
+// HD44780 state
+static SIM_LOCAL char lcd_ddram[2][LCD_DDRAM_LINE_LEN];
+static SIM_LOCAL unsigned char lcd_ac;        // Address counter (0x00-0x27, 0x40-0x67)
+static SIM_LOCAL unsigned char lcd_shift;     // Display shift in columns (0-39)
+static SIM_LOCAL int lcd_four_bit;            // 0 until the 4-bit function set has been seen
+static SIM_LOCAL int lcd_have_high_nibble;    // 1 after the first half of a 4-bit transfer
+static SIM_LOCAL unsigned char lcd_high_nibble;
+static SIM_LOCAL uint32_t lcd_prev_pins;      // Port 0 levels before the current store
+
+// HD44780 timing state (times in ns)
+static SIM_LOCAL unsigned long long lcd_t_rs_change;
+static SIM_LOCAL unsigned long long lcd_t_data_change;
+static SIM_LOCAL unsigned long long lcd_t_en_rise;
+static SIM_LOCAL unsigned long long lcd_busy_until;
+static SIM_LOCAL int lcd_seen_rise;
+
+// GPDMA channel 0 state
+static SIM_LOCAL int dma_active;
+static SIM_LOCAL unsigned long dma_index;
+static SIM_LOCAL unsigned long long dma_next_ns;
+
+// IAP state: sectors prepared for the next erase or copy (ROM semantics: each
+// erase or copy needs a prepare of its own)
+static SIM_LOCAL uint32_t iap_prepared_first;
+static SIM_LOCAL uint32_t iap_prepared_last;
+static SIM_LOCAL int iap_prepared;
+
+void board_sim_reset(void)
+{
+    memset(sim_flash_top, 0xFF, sizeof(sim_flash_top)); // Erased, as shipped
+    sim_iap_errors = 0;
+    sim_flash_erases = 0;
+    sim_flash_programs = 0;
+    board_sim_restart(1);
+}
+
+void board_sim_restart(int power_lost)
+{
+    if (power_lost) {
+        // SRAM powers up with a pattern of its own; fill it with one
+        uint32_t x = 0x9E3779B9u;
+        unsigned i;
+        for (i = 0; i < SIM_NOINIT_SIZE / 4; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            sim_noinit[i] = x;
+        }
+    }
+    memset(sim_gpio, 0, sizeof(sim_gpio));
+    memset(&sim_sc, 0, sizeof(sim_sc));
+    memset(sim_tim, 0, sizeof(sim_tim));
+    memset(&sim_gpdma, 0, sizeof(sim_gpdma));
+    memset(sim_gpdmach, 0, sizeof(sim_gpdmach));
+    memset(&sim_dwt, 0, sizeof(sim_dwt));
+    memset(&sim_coredebug, 0, sizeof(sim_coredebug));
+    memset(out_latch, 0, sizeof(out_latch));
+    // Clock state left by CMSIS SystemInit: 12 MHz oscillator, PLL0 at 400 MHz, CCLK 100 MHz
+    sim_sc.SCS = (1 << 5) | (1 << 6);
+    sim_sc.CLKSRCSEL = 0x01;
+    sim_sc.PLL0CFG = 99 | (5 << 16);
+    sim_sc.PLL0CON = 0x03;
+    sim_sc.PLL0STAT = sim_sc.PLL0CFG | (1 << 24) | (1 << 25) | (1 << 26); // Enabled, connected, locked
+    sim_sc.CCLKCFG = 3;
+    sim_sc.FLASHCFG = 0x303A; // Four clocks
+    SystemCoreClock = 100000000UL;
+    memset(sim_clock_residency, 0, sizeof(sim_clock_residency));
+    sim_timer_rate_errors = 0;
+    sim_flash_wait_errors = 0;
+    sim_gpio_stores = 0;
+    sim_dma_transfers = 0;
+    sim_lcd_bytes = 0;
+    sim_keypad_selects = 0;
+    sim_time_ns = 0;
+    sim_lcd_timing_violations = 0;
+    sim_lcd_last_violation = "";
+    pressed_keys = 0;
+    bounce_profile = NULL;
+    held_keys = 0;
+    memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+    lcd_ac = 0;
+    lcd_shift = 0;
+    lcd_four_bit = 0;
+    lcd_have_high_nibble = 0;
+    lcd_prev_pins = 0;
+    lcd_t_rs_change = 0;
+    lcd_t_data_change = 0;
+    lcd_t_en_rise = 0;
+    lcd_busy_until = 0;
+    lcd_seen_rise = 0;
+    dma_active = 0;
+    dma_index = 0;
+    dma_next_ns = 0;
+    iap_prepared = 0;
+}
+
+// Level of every pin on a port: outputs from the latch, inputs from the attached devices
+static uint32_t pin_levels(int port)
+{
+    uint32_t dir = sim_gpio[port].FIODIR;
+    uint32_t inputs = 0xFFFFFFFFu; // Undriven inputs are pulled up
+
+    if (port == 1 && pressed_keys != 0) {
+        // A pressed key connects its row to its column; a low row pulls the column low
+        int key;
+        for (key = 0; key < 16; key++) {
+            uint32_t row_bit = keypad_row_bits[key / 4];
+            if ((pressed_keys & (1u << key)) && (dir & row_bit) && (out_latch[1] & row_bit) == 0) {
+                inputs &= ~keypad_col_bits[key % 4];
+            }
+        }
+    }
+    return (out_latch[port] & dir) | (inputs & ~dir);
+}
+
+static void lcd_violation(const char *what)
+{
+    sim_lcd_timing_violations++;
+    sim_lcd_last_violation = what;
+}
+
+static void lcd_advance_ac(void)
+{
+    lcd_ac++;
+    if (lcd_ac == LCD_DDRAM_LINE_LEN) {
+        lcd_ac = 0x40;
+    } else if (lcd_ac == 0x40 + LCD_DDRAM_LINE_LEN) {
+        lcd_ac = 0x00;
+    }
+}
+
+static void lcd_execute(unsigned char byte, int is_data)
+{
+    sim_lcd_bytes++;
+    lcd_busy_until = sim_time_ns + LCD_T_EXEC;
+    if (is_data) {
+        lcd_ddram[lcd_ac >= 0x40][lcd_ac & 0x3F] = (char)byte;
+        lcd_advance_ac();
+    } else if (byte & 0x80) {            // Set DDRAM address
+        lcd_ac = byte & 0x7F;
+    } else if (byte & 0x40) {            // Set CGRAM address - not modelled
+    } else if (byte & 0x20) {            // Function set
+    } else if (byte & 0x10) {            // Cursor or display shift
+        if (byte & 0x08) {               // Display shift; R/L bit set means right
+            lcd_shift = (byte & 0x04) ? (lcd_shift + LCD_DDRAM_LINE_LEN - 1) % LCD_DDRAM_LINE_LEN
+                                      : (lcd_shift + 1) % LCD_DDRAM_LINE_LEN;
+        }
+    } else if (byte == 0x01) {           // Clear display
+        memset(lcd_ddram, ' ', sizeof(lcd_ddram));
+        lcd_ac = 0;
+        lcd_shift = 0;
+        lcd_busy_until = sim_time_ns + LCD_T_EXEC_CLEAR;
+    } else if ((byte & 0xFE) == 0x02) {  // Return home
+        lcd_ac = 0;
+        lcd_shift = 0;
+        lcd_busy_until = sim_time_ns + LCD_T_EXEC_CLEAR;
+    }
+    // Entry mode and display control keep their power-on meaning (increment, display on)
+}
+
+// Called after every store to port 0: checks the bus timing and latches a nibble
+// on each falling edge of EN
+static void lcd_observe(void)
+{
+    uint32_t pins = pin_levels(0);
+    uint32_t changed = pins ^ lcd_prev_pins;
+
+    if (changed & LCD_RS) {
+        if (pins & LCD_EN) {
+            lcd_violation("RS changed while EN high");
+        }
+        lcd_t_rs_change = sim_time_ns;
+    }
+    if (changed & LCD_DATA) {
+        lcd_t_data_change = sim_time_ns;
+    }
+
+    if ((changed & LCD_EN) && (pins & LCD_EN)) { // Rising edge
+        if (sim_time_ns - lcd_t_rs_change < LCD_T_AS) {
+            lcd_violation("RS setup before EN rise");
+        }
+        if (lcd_seen_rise && sim_time_ns - lcd_t_en_rise < LCD_T_CYC_E) {
+            lcd_violation("EN cycle time");
+        }
+        if (sim_time_ns < lcd_busy_until) {
+            lcd_violation("Write while controller busy");
+        }
+        lcd_t_en_rise = sim_time_ns;
+        lcd_seen_rise = 1;
+    } else if ((changed & LCD_EN) && !(pins & LCD_EN)) { // Falling edge
+        unsigned char nibble = 0;
+        int i;
+        for (i = 0; i < 4; i++) {
+            if (pins & lcd_data_bits[i]) {
+                nibble |= (unsigned char)(1 << i);
+            }
+        }
+        int is_data = (pins & LCD_RS) != 0;
+
+        if (sim_time_ns - lcd_t_en_rise < LCD_T_PW_EH) {
+            lcd_violation("EN pulse width");
+        }
+        if (sim_time_ns - lcd_t_data_change < LCD_T_DSW) {
+            lcd_violation("Data setup before EN fall");
+        }
+        if (!lcd_four_bit) {
+            // 8-bit interface: D3-D0 are not wired, only the function set matters
+            if (nibble == 0x02) {
+                lcd_four_bit = 1;
+            }
+            lcd_busy_until = sim_time_ns + LCD_T_EXEC;
+        } else if (!lcd_have_high_nibble) {
+            lcd_high_nibble = nibble;
+            lcd_have_high_nibble = 1;
+        } else {
+            lcd_have_high_nibble = 0;
+            lcd_execute((unsigned char)((lcd_high_nibble << 4) | nibble), is_data);
+        }
+    }
+    lcd_prev_pins = pins;
+}
+
+void sim_gpio_store(volatile uint32_t *reg, uint32_t value)
+{
+    int port;
+    LPC_GPIO_TypeDef *g;
+    uint32_t writable;
+
+#ifdef SIM_THREAD_LOCAL
+    if ((const volatile void *)reg >= (const volatile void *)sim_gpio_layout &&
+        (const volatile void *)reg < (const volatile void *)&sim_gpio_layout[5]) {
+        // An address taken from LPC_GPIOn, such as the LCD's GPDMA destination
+        reg = (volatile uint32_t *)((uintptr_t)sim_gpio + ((uintptr_t)reg - (uintptr_t)sim_gpio_layout));
+    }
+#endif
+    for (port = 0; port < 5; port++) {
+        if ((const volatile void *)reg >= (const volatile void *)&sim_gpio[port] &&
+            (const volatile void *)reg < (const volatile void *)&sim_gpio[port + 1]) {
+            break;
+        }
+    }
+    if (port == 5) {
+        return; // Not a GPIO register
+    }
+    g = &sim_gpio[port];
+    writable = ~g->FIOMASK;
+    sim_gpio_stores++;
+
+    if (reg == &g->FIODIR) {
+        g->FIODIR = value;
+    } else if (reg == &g->FIOMASK) {
+        g->FIOMASK = value;
+    } else if (reg == &g->FIOPIN) {
+        out_latch[port] = (out_latch[port] & ~writable) | (value & writable);
+    } else if (reg == &g->FIOSET) {
+        out_latch[port] |= value & writable;
+    } else if (reg == &g->FIOCLR) {
+        out_latch[port] &= ~(value & writable);
+    }
+
+    if (port == 1 && reg == &g->FIOPIN) {
+        sim_keypad_selects++;
+    }
+    // Reads of FIOPIN see the pin levels, with masked pins reading as 0
+    g->FIOPIN = pin_levels(port) & ~g->FIOMASK;
+    if (port == 0) {
+        lcd_observe();
+    }
+}
+
+uint32_t board_sim_cclk_hz(void)
+{
+    uint32_t in_hz = (sim_sc.CLKSRCSEL & 0x03) == 0x01 ? 12000000UL : 4000000UL; // Main oscillator or IRC
+    if ((sim_sc.PLL0CON & 0x03) == 0x03) {
+        uint32_t m = (sim_sc.PLL0CFG & 0x7FFF) + 1;
+        uint32_t n = ((sim_sc.PLL0CFG >> 16) & 0xFF) + 1;
+        unsigned long long fcco = 2ULL * m * in_hz / n;
+        return (uint32_t)(fcco / (sim_sc.CCLKCFG + 1));
+    }
+    return in_hz / (sim_sc.CCLKCFG + 1);
+}
+
+// Timer n peripheral clock: PCLKSEL0 bits 2..3 (Timer 0) and 4..5 (Timer 1)
+static uint32_t timer_pclk_hz(int timer)
+{
+    static const unsigned char div[4] = { 4, 1, 2, 8 };
+    return board_sim_cclk_hz() / div[(sim_sc.PCLKSEL0 >> (2 + 2 * timer)) & 3];
+}
+
+// Charges `ns` of virtual time to the current CCLK and checks the clock-dependent settings
+static void clock_account(unsigned long long ns, int sleeping)
+{
+    uint32_t hz = board_sim_cclk_hz();
+    uint32_t flash_clocks = ((sim_sc.FLASHCFG >> 12) & 0x0F) + 1;
+    int i;
+
+    if (ns == 0) {
+        return;
+    }
+    if ((sim_tim[1].TCR & 0x01) && timer_pclk_hz(1) / (sim_tim[1].PR + 1) != 1000000UL) {
+        sim_timer_rate_errors++;
+    }
+    if (flash_clocks * 20000000ULL < hz) {
+        sim_flash_wait_errors++;
+    }
+    // The core clock is stopped during WFI, so CYCCNT only counts busy time
+    if (!sleeping && (sim_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) && (sim_coredebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk)) {
+        sim_dwt.CYCCNT += (uint32_t)(ns * hz / 1000000000ULL);
+    }
+    for (i = 0; i < SIM_CLOCK_SLOTS; i++) {
+        sim_clock_slot *slot = &sim_clock_residency[i];
+        if (slot->hz == hz || slot->hz == 0 || i == SIM_CLOCK_SLOTS - 1) {
+            slot->hz = hz;
+            if (sleeping) {
+                slot->sleep_ns += ns;
+            } else {
+                slot->busy_ns += ns;
+            }
+            return;
+        }
+    }
+}
+
+// --- Contact bounce ---
+
+static uint32_t bounce_random(void)
+{
+    bounce_rng ^= bounce_rng << 13;
+    bounce_rng ^= bounce_rng >> 17;
+    bounce_rng ^= bounce_rng << 5;
+    return bounce_rng;
+}
+
+static unsigned long long bounce_uniform_ns(uint32_t min_us, uint32_t max_us)
+{
+    return 1000ULL * (min_us + (max_us > min_us ? bounce_random() % (max_us - min_us + 1) : 0));
+}
+
+static unsigned long long bounce_exponential_ns(uint32_t mean_us)
+{
+    double u = (bounce_random() + 1.0) / 4294967297.0; // (0, 1)
+    return 1000ULL + (unsigned long long)(-log(u) * mean_us * 1000.0);
+}
+
+// The finger has just pressed or released `key`: its contact chatters, starting
+// with the new state
+static void contact_start(int key, int held)
+{
+    sim_contact *c = &contacts[key];
+    const sim_bounce *b = bounce_profile;
+    unsigned long long length = (bounce_random() % 1000u < b->long_permille)
+                                    ? bounce_uniform_ns(b->bounce_max_us, b->long_max_us)
+                                    : bounce_uniform_ns(b->bounce_min_us, b->bounce_max_us);
+
+    held_keys = (uint16_t)(held ? held_keys | (1u << key) : held_keys & ~(1u << key));
+    pressed_keys = (uint16_t)(held ? pressed_keys | (1u << key) : pressed_keys & ~(1u << key));
+    c->chatter_until = sim_time_ns + length;
+    c->next = sim_time_ns + bounce_exponential_ns(b->pulse_mean_us);
+    if (c->next > c->chatter_until) {
+        c->next = c->chatter_until;
+    }
+    c->dropout = 0;
+}
+
+// Plays every contact event up to the current time, then updates the keypad inputs
+static void contacts_advance(void)
+{
+    int key;
+
+    if (bounce_profile == NULL) {
+        return;
+    }
+    for (key = 0; key < 16; key++) {
+        sim_contact *c = &contacts[key];
+        uint16_t bit = (uint16_t)(1u << key);
+
+        while (c->next <= sim_time_ns) {
+            unsigned long long t = c->next;
+            if (c->dropout) { // A held contact opens for a moment
+                c->dropout = 0;
+                pressed_keys &= (uint16_t)~bit;
+                c->chatter_until = t + bounce_uniform_ns(1, bounce_profile->dropout_max_us);
+                c->next = c->chatter_until;
+            } else if (t < c->chatter_until) {
+                pressed_keys ^= bit;
+                c->next = t + bounce_exponential_ns(bounce_profile->pulse_mean_us);
+                if (c->next > c->chatter_until) {
+                    c->next = c->chatter_until;
+                }
+            } else { // Settled where the finger wants it
+                pressed_keys = (uint16_t)((pressed_keys & ~bit) | (held_keys & bit));
+                c->next = SIM_NEVER;
+                if ((held_keys & bit) && bounce_profile->dropouts_per_s) {
+                    c->dropout = 1;
+                    c->next = t + bounce_exponential_ns(1000000u / bounce_profile->dropouts_per_s);
+                }
+            }
+        }
+    }
+    sim_gpio[1].FIOPIN = pin_levels(1) & ~sim_gpio[1].FIOMASK;
+}
+
+void board_sim_bounce(const sim_bounce *profile, uint32_t seed)
+{
+    int key;
+
+    bounce_profile = profile;
+    bounce_rng = seed ? seed : 1;
+    held_keys = pressed_keys;
+    for (key = 0; key < 16; key++) {
+        contacts[key].next = SIM_NEVER;
+        contacts[key].dropout = 0;
+    }
+}
+
+// Moves the virtual clock to `until`, performing every DMA transfer that the
+// Timer 0 match requests on the way. Only channel 0, memory to peripheral, with
+// single 32-bit transfers and no linked list is modelled (what lcd_dma.c uses).
+static void dma_service(unsigned long long until)
+{
+    LPC_GPDMACH_TypeDef *ch = &sim_gpdmach[0];
+    unsigned long long tick_ns;
+
+    if (!(ch->DMACCConfig & 0x01) || !(sim_gpdma.DMACConfig & 0x01) || !(sim_tim[0].TCR & 0x01)) {
+        dma_active = 0;
+        sim_time_ns = until;
+        contacts_advance();
+        return;
+    }
+    tick_ns = (unsigned long long)(sim_tim[0].MR0 + 1) * (sim_tim[0].PR + 1) * 1000000000ULL /
+              timer_pclk_hz(0);
+    if (!dma_active) { // Channel was enabled since the last service
+        dma_active = 1;
+        dma_index = 0;
+        dma_next_ns = sim_time_ns + tick_ns;
+    }
+    while (dma_active && dma_next_ns <= until) {
+        const uint32_t *src = (const uint32_t *)ch->DMACCSrcAddr;
+        sim_time_ns = dma_next_ns;
+        sim_gpio_store((volatile uint32_t *)ch->DMACCDestAddr, src[dma_index++]);
+        sim_dma_transfers++;
+        dma_next_ns += tick_ns;
+        if (dma_index >= (ch->DMACCControl & 0xFFF)) {
+            ch->DMACCConfig &= ~0x01u;     // Channel disables itself at terminal count
+            sim_gpdma.DMACIntTCStat |= 1;
+            dma_active = 0;
+        }
+    }
+    if (until > sim_time_ns) {
+        sim_time_ns = until;
+    }
+    contacts_advance();
+}
+
+void board_sim_run_dma(void)
+{
+    // Service up to the next transfer each time so the clock stops at the last one
+    while ((sim_gpdmach[0].DMACCConfig & 0x01) && (sim_gpdma.DMACConfig & 0x01) && (sim_tim[0].TCR & 0x01)) {
+        dma_service(dma_active ? dma_next_ns : sim_time_ns);
+    }
+}
+
+// Moves the finger to the keys in `keys`: contacts follow at once, or through
+// their chatter when a bounce profile is set
+static void keys_set(uint16_t keys)
+{
+    int key;
+
+    if (bounce_profile == NULL) {
+        pressed_keys = keys;
+    } else {
+        for (key = 0; key < 16; key++) {
+            if (((held_keys ^ keys) >> key) & 1) {
+                contact_start(key, (keys >> key) & 1);
+            }
+        }
+        contacts_advance();
+    }
+    sim_gpio[1].FIOPIN = pin_levels(1) & ~sim_gpio[1].FIOMASK;
+}
+
+void board_sim_press_key(unsigned char row, unsigned char col)
+{
+    keys_set((uint16_t)(1u << ((row & 3) * 4 + (col & 3))));
+}
+
+void board_sim_press_also(unsigned char row, unsigned char col)
+{
+    keys_set((uint16_t)((bounce_profile ? held_keys : pressed_keys) | (1u << ((row & 3) * 4 + (col & 3)))));
+}
+
+void board_sim_release_keys(void)
+{
+    keys_set(0);
+}
+
+// --- IAP ---
+
+// The CPU waits in the boot ROM while the flash is erased or programmed
+static void iap_busy(unsigned long long ns)
+{
+    clock_account(ns, 0);
+    dma_service(sim_time_ns + ns);
+}
+
+// Checks that sectors first..last are backed and prepared, and uses up the prepare
+static uint32_t iap_sectors(uint32_t first, uint32_t last)
+{
+    int ok = iap_prepared && first >= iap_prepared_first && last <= iap_prepared_last;
+    iap_prepared = 0;
+    if (first > last || first < IAP_FIRST_SECTOR || last >= IAP_FIRST_SECTOR + SIM_FLASH_TOP_SIZE / IAP_SECTOR_SIZE) {
+        return IAP_INVALID_SECTOR;
+    }
+    return ok ? IAP_CMD_SUCCESS : IAP_SECTOR_NOT_PREPARED;
+}
+
+void sim_iap(uintptr_t command[5], uintptr_t result[5])
+{
+    uint32_t status = IAP_CMD_SUCCESS;
+    uint32_t s;
+
+    switch (command[0]) {
+    case 50: // Prepare sectors for write operation: start, end
+        iap_prepared_first = (uint32_t)command[1];
+        iap_prepared_last = (uint32_t)command[2];
+        iap_prepared = 1;
+        if (iap_prepared_first > iap_prepared_last || iap_prepared_first < IAP_FIRST_SECTOR ||
+            iap_prepared_last >= IAP_FIRST_SECTOR + SIM_FLASH_TOP_SIZE / IAP_SECTOR_SIZE) {
+            iap_prepared = 0;
+            status = IAP_INVALID_SECTOR;
+        }
+        break;
+    case 51: { // Copy RAM to flash: destination, source, bytes, CCLK in kHz
+        uintptr_t dst = command[1];
+        const uint8_t *src = (const uint8_t *)command[2];
+        uint32_t bytes = (uint32_t)command[3];
+        if (dst % 256 != 0) {
+            status = IAP_DST_ADDR_ERROR;
+        } else if ((uintptr_t)src % 4 != 0) {
+            status = IAP_SRC_ADDR_ERROR;
+        } else if (bytes != 256 && bytes != 512 && bytes != 1024 && bytes != 4096) {
+            status = IAP_COUNT_ERROR;
+        } else if (dst < SIM_FLASH_TOP_ADDR || dst + bytes > SIM_FLASH_TOP_ADDR + SIM_FLASH_TOP_SIZE) {
+            status = IAP_DST_ADDR_NOT_MAPPED;
+        } else {
+            status = iap_sectors(IAP_FIRST_SECTOR + (uint32_t)((dst - SIM_FLASH_TOP_ADDR) / IAP_SECTOR_SIZE),
+                                 IAP_FIRST_SECTOR + (uint32_t)((dst + bytes - 1 - SIM_FLASH_TOP_ADDR) / IAP_SECTOR_SIZE));
+        }
+        if (status == IAP_CMD_SUCCESS) {
+            for (s = 0; s < bytes; s++) {
+                SIM_FLASH(dst)[s] &= src[s]; // Programming only clears bits
+            }
+            sim_flash_programs++;
+            iap_busy(IAP_T_PROG * (bytes / 256));
+        }
+        break;
+    }
+    case 52: // Erase sectors: start, end, CCLK in kHz
+        status = iap_sectors((uint32_t)command[1], (uint32_t)command[2]);
+        if (status == IAP_CMD_SUCCESS) {
+            for (s = (uint32_t)command[1]; s <= command[2]; s++) {
+                memset(&sim_flash_top[(s - IAP_FIRST_SECTOR) * IAP_SECTOR_SIZE], 0xFF, IAP_SECTOR_SIZE);
+                sim_flash_erases++;
+                iap_busy(IAP_T_ERASE);
+            }
+        }
+        break;
+    default:
+        status = IAP_INVALID_COMMAND;
+        break;
+    }
+    // The ROM times erasing and programming from the CCLK it is given
+    if ((command[0] == 51 && command[4] != board_sim_cclk_hz() / 1000) ||
+        (command[0] == 52 && command[3] != board_sim_cclk_hz() / 1000)) {
+        sim_iap_errors++;
+    }
+    if (status != IAP_CMD_SUCCESS) {
+        sim_iap_errors++;
+    }
+    result[0] = status;
+}
+
+void board_sim_lcd_visible(unsigned char line, char out[17])
+{
+    int i;
+    for (i = 0; i < 16; i++) {
+        out[i] = lcd_ddram[line & 1][(lcd_shift + i) % LCD_DDRAM_LINE_LEN];
+    }
+    out[16] = '\0';
+}
+
+void delay(unsigned int ms)
+{
+    clock_account((unsigned long long)ms * 1000000ULL, 0);
+    dma_service(sim_time_ns + (unsigned long long)ms * 1000000ULL);
+}
+
+// Programs Timer 1 like delay.c so that the rate checks above see the real settings;
+// the virtual clock itself starts at board_sim_reset()
+void delay_init(void)
+{
+    sim_tim[1].PR = SystemCoreClock / 1000000UL - 1;
+    sim_tim[1].TCR = 0x01;
+}
+
+void delay_clock_changed(void)
+{
+    sim_tim[1].PR = SystemCoreClock / 1000000UL - 1;
+}
+
+void delay_us(unsigned int us)
+{
+    clock_account((unsigned long long)us * 1000ULL, 0);
+    dma_service(sim_time_ns + (unsigned long long)us * 1000ULL);
+}
+
+uint32_t uptime_us(void)
+{
+    return (uint32_t)(sim_time_ns / 1000ULL);
+}
+
+void sleep_until_us(uint32_t at_us)
+{
+    uint32_t now = uptime_us();
+    if ((int32_t)(at_us - now) > 0) {
+        clock_account((unsigned long long)(at_us - now) * 1000ULL, 1);
+        dma_service(sim_time_ns + (unsigned long long)(at_us - now) * 1000ULL);
+    }
+}
@@ -0,0 +1,94 @@
+// ============= BOARD_SIM.H =============
+// Host-side model of the calculator board, used by the driver tests and host tools.
+// It backs the register blocks declared in the dummy LPC17xx.h, applies the
+// LPC1768 FIODIR/FIOMASK/FIOPIN/FIOSET/FIOCLR semantics to every store, and wires
+// the pins to a 4x4 keypad matrix (port 1) and an HD44780 controller (port 0).
+// The GPDMA channel 0 + Timer 0 path used by lcd_dma.c is emulated as well.
+// delay(), delay_us(), uptime_us() and sleep_until_us() are provided here too and
+// run on a virtual clock instead of spinning.
+#ifndef BOARD_SIM_H
+#define BOARD_SIM_H
+
+#include <stdint.h>
+#include "sim_local.h"
+
+// Resets all registers, the keypad, the LCD model, the counters and the clock, as
+// at the first power-up: the flash sectors of sim_flash_top are erased and the
+// .noinit SRAM holds garbage
+void board_sim_reset(void);
+
+// The same, but as after a reset of a board already in use: the flash keeps its
+// contents, and so does the .noinit SRAM unless `power_lost` (a watchdog reset or
+// a dip the SRAM rode out, or a power cut)
+void board_sim_restart(int power_lost);
+
+// --- Counters ---
+extern SIM_LOCAL unsigned long sim_gpio_stores;    // GPIO register stores since reset (CPU and DMA)
+extern SIM_LOCAL unsigned long sim_dma_transfers;  // Of those, stores made by the GPDMA
+extern SIM_LOCAL unsigned long sim_lcd_bytes;      // Bytes (commands + data) latched by the LCD
+extern SIM_LOCAL unsigned long sim_keypad_selects; // Row patterns driven onto the keypad
+
+// --- Virtual clock ---
+extern SIM_LOCAL unsigned long long sim_time_ns;   // Virtual time since reset
+
+// --- CPU clock ---
+// CCLK as configured by the PLL0 and CCLKCFG registers (100 MHz after reset, like
+// CMSIS SystemInit). Timer tick rates follow it through PCLKSEL0.
+uint32_t board_sim_cclk_hz(void);
+
+// Virtual time per CCLK frequency, split into busy waiting (delay, delay_us) and
+// sleeping (sleep_until_us). Time is charged when the clock advances.
+#define SIM_CLOCK_SLOTS 4
+typedef struct {
+    uint32_t hz;                  // 0 for an unused slot
+    unsigned long long busy_ns;
+    unsigned long long sleep_ns;
+} sim_clock_slot;
+extern SIM_LOCAL sim_clock_slot sim_clock_residency[SIM_CLOCK_SLOTS];
+
+// Checked whenever the clock advances: Timer 1 must count at 1 MHz for the current
+// CCLK (delay.c), and the flash wait states must suit it (20 MHz per clock).
+extern SIM_LOCAL unsigned long sim_timer_rate_errors;
+extern SIM_LOCAL unsigned long sim_flash_wait_errors;
+
+// --- Keypad matrix ---
+void board_sim_press_key(unsigned char row, unsigned char col);  // Releases any other key
+void board_sim_press_also(unsigned char row, unsigned char col); // Adds a key, for chords
+void board_sim_release_keys(void);
+
+// Contact bounce. By default contacts follow the finger at once; with a profile
+// every make and break chatters first, alternating open and closed intervals
+// until it settles, and held contacts may drop out for a moment.
+typedef struct {
+    uint32_t bounce_min_us;  // Length of the chatter after each make and break:
+    uint32_t bounce_max_us;  //   uniform in [min, max] ...
+    uint32_t long_permille;  // ... except for this share of them, uniform in
+    uint32_t long_max_us;    //   [bounce_max_us, long_max_us] (worn switches)
+    uint32_t pulse_mean_us;  // Mean open or closed interval within it (exponential)
+    uint32_t dropouts_per_s; // Held contacts open this often on average, 0 for never
+    uint32_t dropout_max_us; // For a uniform time up to this
+} sim_bounce;
+void board_sim_bounce(const sim_bounce *profile, uint32_t seed); // NULL for clean contacts
+
+// --- HD44780 model ---
+// Copies the 16 columns currently visible on a line (after display shift) into out
+void board_sim_lcd_visible(unsigned char line, char out[17]);
+
+// Bus timing checks against the HD44780 datasheet (EN pulse width and cycle,
+// RS and data setup, instruction execution time)
+extern SIM_LOCAL unsigned long sim_lcd_timing_violations;
+extern SIM_LOCAL const char *sim_lcd_last_violation;
+
+// --- IAP ---
+// Commands that failed or were given a CCLK other than the current one, and the
+// flash operations performed. Erasing a sector takes 100 ms and programming 1 ms
+// per 256 bytes, during which the CPU waits in the boot ROM.
+extern SIM_LOCAL unsigned long sim_iap_errors;
+extern SIM_LOCAL unsigned long sim_flash_erases;
+extern SIM_LOCAL unsigned long sim_flash_programs;
+
+// --- GPDMA ---
+// Runs an enabled DMA channel 0 transfer to completion, advancing the clock
+void board_sim_run_dma(void);
+
+#endif
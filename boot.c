@@ -0,0 +1,31 @@
+// ============= BOOT.C =============
+// Power-up sequence. The keypad is scanned from the first millisecond, and keys
+// pressed while the LCD is still in its power-on wait are buffered, so the
+// calculator accepts input as soon as the display can show it.
+// ===================================
+
+#include "boot.h"
+#include "clock.h"
+#include "delay.h"
+#include "diag.h"
+#include "keypad.h"
+#include "lcd.h"
+#include "ramfunc.h"
+#include "stack_monitor.h"
+
+void boot_fast(void)
+{
+    stack_paint(); // For stack_high_water()
+    ramfunc_init(); // Evaluator and soft-float code to SRAM, in -DCALC_RAMFUNC_SRAM builds
+    clock_init(); // Idle clock; tasks boost it for evaluation and LCD updates
+    delay_init();
+    diag_init(); // Cycle counter for the diagnostics screen
+    KeyPadInitialize();
+    lcd_init_begin();
+
+    // The LCD needs about 45 ms in total, nearly all of it waiting; scan the keypad
+    // meanwhile (one scan takes about 4 ms, so no extra delay is added)
+    while (!lcd_init_poll()) {
+        KeypadPoll();
+    }
+}
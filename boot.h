@@ -0,0 +1,7 @@
+// ============= BOOT.H =============
+#ifndef BOOT_H
+#define BOOT_H
+
+void boot_fast(void);
+
+#endif
@@ -0,0 +1,755 @@
+// ============= CALC_EVAL.HPP =============
+// constexpr port of the calculator's tokenizer and evaluator (logic.c).
+// A key string such as "2+3*4=" goes through the same steps as on the device:
+// tokenize() follows calc_ui_key() (unary minus, number length, decimal point,
+// clear, backspace, ANS, the first error wins) and evaluate() follows evaluate_begin()/evaluate_step()
+// (two stacks, left to right for equal precedence). Every float operation is
+// done in the same order as in logic.c, so results match bit for bit. Input and
+// Keypad take the keys one at a time, as the calculator does.
+//
+// Everything is constexpr: results can be checked with static_assert and tables
+// of them built by the compiler (calc_goldens.cpp), and the same functions run
+// at runtime (eval_cpp_bench.cpp, libcalc.cpp). Header-only, no global state.
+#ifndef CALC_EVAL_HPP
+#define CALC_EVAL_HPP
+
+namespace calc {
+
+// Same limits as logic.h (checked in calc_goldens.cpp)
+constexpr int max_tokens = 50; // MAX_TOKENS
+constexpr int line_len = 16;   // LCD_LINE_LEN, longest number typed
+
+enum class Error : unsigned char { none, syntax, div_zero, stack, expr_long, num_len };
+
+// The message set_error() stores for `error`, or nullptr for none
+constexpr const char* message(Error error)
+{
+    switch (error) {
+    case Error::syntax: return "Err: Syntax";
+    case Error::div_zero: return "Err: Div Zero";
+    case Error::stack: return "Err: Stack";
+    case Error::expr_long: return "Err: Expr Long";
+    case Error::num_len: return "Err: Num Len";
+    default: return nullptr;
+    }
+}
+
+struct Result {
+    float value; // 0 on error, as in logic.c
+    Error error;
+
+    constexpr bool ok() const { return error == Error::none; }
+};
+
+// Tokens as logic.c keeps them in expr_type/expr_data: 'N' with the number or
+// 'O' with the operator's character code
+struct Expr {
+    char type[max_tokens];
+    float data[max_tokens];
+    int len;
+    Error error; // Input error raised while tokenizing
+};
+
+// Keeps the first error, like set_error()
+constexpr void fail(Error& error, Error raised)
+{
+    if (error == Error::none) {
+        error = raised;
+    }
+}
+
+constexpr int precedence(char op)
+{
+    if (op == '+' || op == '-') {
+        return 1;
+    }
+    if (op == '*' || op == '/') {
+        return 2;
+    }
+    return 0;
+}
+
+constexpr float apply(char op, float a, float b, Error& error)
+{
+    switch (op) {
+    case '+': return a + b;
+    case '-': return a - b;
+    case '*': return a * b;
+    case '/':
+        if ((b < 0.0f ? -b : b) < 1e-7f) { // FLOAT_EPSILON
+            fail(error, Error::div_zero);
+            return 0.0f;
+        }
+        return a / b;
+    default:
+        fail(error, Error::syntax);
+        return 0.0f;
+    }
+}
+
+// parse_current_input_number() on the `n` characters of `num`
+constexpr float parse_number(const char* num, int n, Error& error)
+{
+    if (n == 0) {
+        return 0.0f;
+    }
+    if (n == 1 && (num[0] == '-' || num[0] == '.')) {
+        fail(error, Error::syntax);
+        return 0.0f;
+    }
+    float result = 0.0f;
+    float decimal_multiplier = 0.1f;
+    bool in_decimal_part = false;
+    int i = (num[0] == '-') ? 1 : 0;
+
+    for (; i < n; i++) {
+        if (num[i] == '.') {
+            if (in_decimal_part) {
+                fail(error, Error::syntax);
+                return 0.0f;
+            }
+            in_decimal_part = true;
+        } else if (num[i] >= '0' && num[i] <= '9') {
+            int digit = num[i] - '0';
+            if (!in_decimal_part) {
+                result = result * 10.0f + digit;
+            } else {
+                result += digit * decimal_multiplier;
+                decimal_multiplier *= 0.1f;
+            }
+        } else {
+            fail(error, Error::syntax);
+            return 0.0f;
+        }
+    }
+    return (num[0] == '-') ? -result : result;
+}
+
+constexpr void push(Expr& x, char type, float data)
+{
+    if (x.error != Error::none) {
+        return;
+    }
+    if (x.len >= max_tokens) {
+        fail(x.error, Error::expr_long);
+        return;
+    }
+    x.type[x.len] = type;
+    x.data[x.len] = data;
+    x.len++;
+}
+
+// --- Number text ---
+// format_number() and format_typed_number() of logic.c with the same integer
+// arithmetic, so that ANS and backspace over an operator type the same text as
+// on the device
+
+static_assert(sizeof(unsigned) == sizeof(float), "float_parts() reads a float as 32 bits");
+
+constexpr unsigned float_bits(float value)
+{
+    return __builtin_bit_cast(unsigned, value);
+}
+
+constexpr bool is_nan(float value)
+{
+    return value != value;
+}
+
+constexpr bool is_inf(float value)
+{
+    return (float_bits(value) & 0x7FFFFFFFu) == 0x7F800000u;
+}
+
+constexpr bool sign_bit(float value)
+{
+    return (float_bits(value) >> 31) != 0;
+}
+
+constexpr float abs(float value)
+{
+    return __builtin_bit_cast(float, float_bits(value) & 0x7FFFFFFFu);
+}
+
+// roundf() (half away from zero) up to the sign of a zero result
+constexpr float round(float value)
+{
+    if (abs(value) >= 8388608.0f) { // 2^23 and up are integers
+        return value;
+    }
+    long long t = (long long)value;
+    float frac = value - (float)t;
+    if (frac >= 0.5f) {
+        t++;
+    } else if (frac <= -0.5f) {
+        t--;
+    }
+    return (float)t;
+}
+
+// float_parts(): a finite float as mant * 2^exp with an integer mantissa
+constexpr unsigned float_parts(float value, int& exp)
+{
+    unsigned bits = float_bits(value);
+    int biased = (int)((bits >> 23) & 0xFF);
+    unsigned mant = bits & 0x7FFFFF;
+
+    if (biased == 0) {
+        exp = -149;
+        return mant;
+    }
+    exp = biased - 150;
+    return mant | 0x800000;
+}
+
+// fmt_u64()
+constexpr int put_u64(char* buf, unsigned long long value)
+{
+    char tmp[20]{};
+    int n = 0, len = 0;
+    do {
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    for (; len < n; len++) {
+        buf[len] = tmp[n - 1 - len];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+constexpr int put_str(char* buf, int len, const char* str)
+{
+    while (*str) {
+        buf[len++] = *str++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+// Writes the lower limbs of a base-10^9 number after its top limb, with their
+// leading zeros; returns the new length
+constexpr int put_limbs(char* digits, int len, const unsigned* limbs, int used)
+{
+    for (int i = used - 2; i >= 0; i--) {
+        unsigned limb = limbs[i];
+        for (int d = 8; d >= 0; d--) {
+            digits[len + d] = (char)('0' + limb % 10);
+            limb /= 10;
+        }
+        len += 9;
+    }
+    return len;
+}
+
+// float_integer_digits(): the digits of a non-negative integral float
+constexpr int float_integer_digits(float value, char* digits)
+{
+    int exp = 0;
+    unsigned mant = float_parts(value, exp);
+    unsigned limbs[5]{};
+    int used = 1;
+
+    if (exp <= 0) {
+        return put_u64(digits, (exp > -32) ? (unsigned long long)(mant >> -exp) : 0);
+    }
+    if (exp <= 39) {
+        return put_u64(digits, (unsigned long long)mant << exp);
+    }
+    limbs[0] = mant;
+    while (exp-- > 0) {
+        unsigned carry = 0;
+        for (int i = 0; i < used; i++) {
+            unsigned doubled = limbs[i] * 2 + carry;
+            carry = doubled >= 1000000000u;
+            limbs[i] = carry ? doubled - 1000000000u : doubled;
+        }
+        if (carry) {
+            limbs[used++] = 1;
+        }
+    }
+    return put_limbs(digits, put_u64(digits, limbs[used - 1]), limbs, used);
+}
+
+// format_scientific(): "%.3e" of the `n` integer digits
+constexpr int format_scientific(const char* digits, int n, bool negative, char* out)
+{
+    char m[4] = { digits[0], digits[1], digits[2], digits[3] };
+    int exp10 = n - 1, len = 0, i = 0;
+    bool sticky = false;
+
+    for (i = 5; i < n; i++) {
+        sticky |= digits[i] != '0';
+    }
+    if (n > 4 && (digits[4] > '5' || (digits[4] == '5' && (sticky || ((m[3] - '0') & 1))))) {
+        for (i = 3; i >= 0 && m[i] == '9'; i--) {
+            m[i] = '0';
+        }
+        if (i >= 0) {
+            m[i]++;
+        } else {
+            m[0] = '1';
+            exp10++;
+        }
+    }
+    if (negative) {
+        out[len++] = '-';
+    }
+    out[len++] = m[0];
+    out[len++] = '.';
+    out[len++] = m[1];
+    out[len++] = m[2];
+    out[len++] = m[3];
+    out[len++] = 'e';
+    out[len++] = '+';
+    if (exp10 < 10) {
+        out[len++] = '0';
+    }
+    return len + put_u64(out + len, (unsigned long long)exp10);
+}
+
+// format_number() into `out` of line_len + 1 characters: the length, or -1 if
+// the text is longer than line_len
+constexpr int format_number(float value, char* out)
+{
+    char text[48]{};
+    bool negative = sign_bit(value);
+    int len = 0;
+
+    if (is_nan(value)) {
+        len = put_str(text, 0, "nan");
+    } else if (is_inf(value)) {
+        len = put_str(text, 0, negative ? "-inf" : "inf");
+    } else if (abs(value - round(value)) < 1e-7f) { // FLOAT_EPSILON
+        if (negative) {
+            text[len++] = '-';
+        }
+        len += float_integer_digits(abs(round(value)), text + len);
+        if (len > line_len) {
+            len = format_scientific(text + negative, len - negative, negative, text);
+        }
+    } else { // "%f", trailing zeros trimmed
+        int exp = 0, frac_digits = 6;
+        unsigned long long scaled = (unsigned long long)float_parts(value, exp) * 1000000ULL;
+
+        if (exp < 0) {
+            int shift = -exp;
+            unsigned long long q = (shift < 64) ? scaled >> shift : 0;
+            if (shift < 64) {
+                unsigned long long rem = scaled & ((1ULL << shift) - 1);
+                unsigned long long half = 1ULL << (shift - 1);
+                if (rem > half || (rem == half && (q & 1))) {
+                    q++;
+                }
+            }
+            scaled = q;
+        } else {
+            scaled <<= exp;
+        }
+        if (negative) {
+            text[len++] = '-';
+        }
+        len += put_u64(text + len, scaled / 1000000ULL);
+        unsigned frac = (unsigned)(scaled % 1000000ULL);
+        while (frac_digits > 0 && frac % 10 == 0) {
+            frac /= 10;
+            frac_digits--;
+        }
+        if (frac_digits > 0) {
+            text[len++] = '.';
+            for (int d = frac_digits - 1; d >= 0; d--) {
+                text[len + d] = (char)('0' + frac % 10);
+                frac /= 10;
+            }
+            len += frac_digits;
+        }
+    }
+
+    int n = (len < line_len) ? len : line_len;
+    for (int i = 0; i < n; i++) {
+        out[i] = text[i];
+    }
+    out[n] = '\0';
+    return (len > line_len) ? -1 : len;
+}
+
+// float_exact_digits(): all decimal digits of a finite, non-negative float
+constexpr int float_exact_digits(float value, char* digits, int& frac_digits)
+{
+    int exp = 0;
+    unsigned mant = float_parts(value, exp);
+    unsigned limbs[14]{};
+    int used = 1;
+
+    if (exp >= 0) {
+        frac_digits = 0;
+        return float_integer_digits(value, digits);
+    }
+    limbs[0] = mant % 1000000000u;
+    if (mant >= 1000000000u) {
+        limbs[used++] = mant / 1000000000u;
+    }
+    for (int k = -exp; k > 0; k -= 12) {
+        unsigned factor = 244140625u, carry = 0; // 5^12
+        if (k < 12) {
+            factor = 1;
+            for (int i = 0; i < k; i++) {
+                factor *= 5;
+            }
+        }
+        for (int i = 0; i < used; i++) {
+            unsigned long long product = (unsigned long long)limbs[i] * factor + carry;
+            limbs[i] = (unsigned)(product % 1000000000u);
+            carry = (unsigned)(product / 1000000000u);
+        }
+        if (carry) {
+            limbs[used++] = carry;
+        }
+    }
+    frac_digits = -exp;
+    return put_limbs(digits, put_u64(digits, limbs[used - 1]), limbs, used);
+}
+
+// layout_digits(): the length, or -1 if longer than line_len
+constexpr int layout_digits(const char* digits, int n, int point, bool negative, char* text)
+{
+    int first = 0, last = n, len = 0;
+
+    while (last > point && last > 0 && digits[last - 1] == '0') {
+        last--;
+    }
+    while (first < point - 1 && digits[first] == '0') {
+        first++;
+    }
+    if ((point > 0 ? point - first : 1) + (last > point ? last - point + 1 : 0) + negative > line_len) {
+        return -1;
+    }
+    if (negative) {
+        text[len++] = '-';
+    }
+    if (point <= 0) {
+        text[len++] = '0';
+    }
+    for (int i = first; i < point; i++) {
+        text[len++] = digits[i];
+    }
+    if (last > point) {
+        text[len++] = '.';
+        for (int i = point; i < last; i++) {
+            text[len++] = (i < 0) ? '0' : digits[i];
+        }
+    }
+    text[len] = '\0';
+    return len;
+}
+
+// step_digit()
+constexpr bool step_digit(char* digits, int at, int delta)
+{
+    int i = at;
+    while (i >= 0 && digits[i] == (delta > 0 ? '9' : '0')) {
+        digits[i--] = (delta > 0) ? '0' : '9';
+    }
+    if (i < 0) {
+        return false;
+    }
+    digits[i] = (char)(digits[i] + delta);
+    return true;
+}
+
+// format_typed_number(): the shortest text that parse_number() turns back into
+// `value`, as the history shows a number token
+constexpr int format_typed_number(float value, char* buf)
+{
+    constexpr int deltas[3] = { 0, -1, 1 };
+    char exact[120]{}, rounded[120]{}, candidate[120]{};
+    bool negative = sign_bit(value);
+    int frac_digits = 0, n = 0, first = 0, len = -1;
+
+    if (is_nan(value) || is_inf(value)) {
+        return format_number(value, buf);
+    }
+    exact[0] = '0';
+    n = 1 + float_exact_digits(abs(value), exact + 1, frac_digits);
+    int point = n - frac_digits;
+    while (first < n && exact[first] == '0') {
+        first++;
+    }
+    if (first == n) {
+        return put_str(buf, 0, negative ? "-0" : "0");
+    }
+    for (int p = 1; p <= 9; p++) {
+        int keep = first + p;
+        bool sticky = false;
+
+        for (int i = 0; i < n; i++) {
+            rounded[i] = exact[i];
+        }
+        if (keep < n) {
+            for (int i = keep + 1; i < n; i++) {
+                sticky |= exact[i] != '0';
+            }
+            if (exact[keep] > '5' || (exact[keep] == '5' && (sticky || ((exact[keep - 1] - '0') & 1)))) {
+                step_digit(rounded, keep - 1, 1);
+            }
+            for (int i = keep; i < n; i++) {
+                rounded[i] = '0';
+            }
+        } else {
+            keep = n;
+        }
+        for (int d = 0; d < 3; d++) {
+            for (int i = 0; i < n; i++) {
+                candidate[i] = rounded[i];
+            }
+            if (deltas[d] != 0 && !step_digit(candidate, keep - 1, deltas[d])) {
+                continue;
+            }
+            len = layout_digits(candidate, n, point, negative, buf);
+            Error error = Error::none;
+            if (len > 0 && parse_number(buf, len, error) == value && error == Error::none) {
+                return len;
+            }
+        }
+    }
+    len = layout_digits(rounded, n, point, negative, buf);
+    return (len > 0) ? len : format_number(value, buf);
+}
+
+// The input rules of calc_ui_key(), one key at a time
+struct Input {
+    Expr x{};
+    char num[line_len + 1]{};
+    int n = 0;
+    bool decimal_point_entered = false;
+    bool last_key_was_operator = false;
+
+    // load_typed_number(): `value` becomes the number being typed, as format_number()
+    // shows it (ANS) or as the history shows a token (backspace over an operator).
+    // False, with no number being typed, if that text could not have been typed.
+    constexpr bool load(float value, bool as_token)
+    {
+        char text[line_len + 1]{};
+        int len = as_token ? format_typed_number(value, text) : format_number(value, text);
+        int i = 0;
+        while (i < len && ((text[i] >= '0' && text[i] <= '9') || text[i] == '.' || text[i] == '-')) {
+            i++;
+        }
+        if (len <= 0 || i != len) {
+            n = 0;
+            return false;
+        }
+        decimal_point_entered = false;
+        for (n = 0; n < len; n++) {
+            num[n] = text[n];
+            decimal_point_entered |= text[n] == '.';
+        }
+        last_key_was_operator = false;
+        return true;
+    }
+
+    // Takes one key: "0123456789+-*/=.", 'C' (clear), '<' (backspace) or 'A'
+    // (ANS, which types `ans`); any other character is a syntax error.
+    // Returns true once the input is complete: at '=' or at the first error.
+    constexpr bool key(char key, float ans = 0.0f)
+    {
+        if (key >= '0' && key <= '9') {
+            if (n < line_len) {
+                num[n++] = key;
+                last_key_was_operator = false;
+            } else {
+                fail(x.error, Error::num_len);
+            }
+        } else if (key == '.') {
+            if (!decimal_point_entered && n < line_len - 1) {
+                if (n == 0) {
+                    num[n++] = '0';
+                }
+                num[n++] = '.';
+                decimal_point_entered = true;
+                last_key_was_operator = false;
+            } else {
+                fail(x.error, decimal_point_entered ? Error::syntax : Error::num_len);
+            }
+        } else if (key == '+' || key == '-' || key == '*' || key == '/') {
+            if (key == '-' && (x.len == 0 || last_key_was_operator) && n == 0) {
+                num[n++] = '-'; // Unary minus starts a number
+                last_key_was_operator = false;
+            } else {
+                if (n > 0) {
+                    float value = parse_number(num, n, x.error);
+                    push(x, 'N', value);
+                    n = 0;
+                    decimal_point_entered = false;
+                } else if (x.len == 0 || (x.type[x.len - 1] == 'O' && !last_key_was_operator)) {
+                    if (key != '+') { // A leading '+' is let through
+                        fail(x.error, Error::syntax);
+                    }
+                }
+                push(x, 'O', (float)key);
+                last_key_was_operator = true;
+            }
+        } else if (key == 'C') {
+            x = Expr{};
+            n = 0;
+            decimal_point_entered = false;
+            last_key_was_operator = false;
+        } else if (key == '<') {
+            if (n > 0) {
+                if (num[--n] == '.') {
+                    decimal_point_entered = false;
+                }
+                if (n == 0) { // Back to just after the operator, if any
+                    last_key_was_operator = x.len > 0 && x.type[x.len - 1] == 'O';
+                }
+            } else if (x.len > 0 && x.type[x.len - 1] == 'O') {
+                // The number before the operator is typed again; a leading '+' or the
+                // second of two operators just goes
+                if (x.len < 2 || x.type[x.len - 2] != 'N') {
+                    x.len--;
+                    last_key_was_operator = x.len > 0;
+                } else if (load(x.data[x.len - 2], true)) {
+                    x.len -= 2;
+                }
+            }
+        } else if (key == 'A') {
+            if (!load(ans, false)) { // Scientific notation, inf or nan cannot be typed
+                fail(x.error, Error::num_len);
+            }
+        } else if (key == '=') {
+            if (n > 0) {
+                float value = parse_number(num, n, x.error);
+                push(x, 'N', value);
+            } else if (x.len > 0 && x.type[x.len - 1] == 'O') {
+                fail(x.error, Error::syntax); // Trailing operator
+            }
+            return true;
+        } else {
+            fail(x.error, Error::syntax); // Not a key of the keypad
+        }
+        return x.error != Error::none;
+    }
+};
+
+// Feeds the characters of `keys` to Input. Input ends at the first '=', the end
+// of the string or the first error; a missing '=' is implied. 'A' types 0, the
+// last result before any.
+constexpr Expr tokenize(const char* keys)
+{
+    Input in{};
+    while (!in.key(*keys != '\0' ? *keys++ : '=')) {
+    }
+    return in.x;
+}
+
+// evaluate_begin() and evaluate_step() run to completion
+constexpr Result evaluate(const Expr& x)
+{
+    float val_stack[max_tokens]{};
+    char op_stack[max_tokens]{};
+    int val_top = -1, op_top = -1;
+    Error error = x.error;
+
+    if (error != Error::none || x.len == 0) {
+        return Result{0.0f, error};
+    }
+    if (x.type[x.len - 1] == 'O') {
+        return Result{0.0f, Error::syntax};
+    }
+    if (x.len == 1) {
+        return Result{x.data[0], Error::none};
+    }
+
+    for (int i = 0; i < x.len || op_top >= 0;) {
+        if (i < x.len && x.type[i] == 'N') {
+            if (val_top >= max_tokens - 1) {
+                return Result{0.0f, Error::stack};
+            }
+            val_stack[++val_top] = x.data[i++];
+            continue;
+        }
+        if (i < x.len) { // Operator: apply the stack's top while it binds at least as tightly
+            char op = (char)x.data[i];
+            if (op_top < 0 || precedence(op_stack[op_top]) < precedence(op)) {
+                if (op_top >= max_tokens - 1) {
+                    return Result{0.0f, Error::stack};
+                }
+                op_stack[++op_top] = op;
+                i++;
+                continue;
+            }
+        }
+        if (val_top < 1) {
+            return Result{0.0f, Error::syntax};
+        }
+        char op = op_stack[op_top--];
+        float b = val_stack[val_top--];
+        float a = val_stack[val_top--];
+        val_stack[++val_top] = apply(op, a, b, error);
+        if (error != Error::none) {
+            return Result{0.0f, error};
+        }
+    }
+    if (val_top != 0) {
+        return Result{0.0f, Error::syntax};
+    }
+    return Result{val_stack[0], Error::none};
+}
+
+// A key string straight to its result
+constexpr Result run(const char* keys)
+{
+    return evaluate(tokenize(keys));
+}
+
+// The calculator across calculations, as calc_ui_key() runs it: once a result or
+// an error is shown, the next key starts a new calculation and is taken as input,
+// except '=' after an error, which only clears. 'A' types the last result shown.
+struct Keypad {
+    Input in{};
+    bool ended = false;
+    bool error_shown = false;
+    float ans = 0.0f; // calc_ctx.ans
+
+    // Returns true if the key brings up a result or an error, stored in `out`
+    constexpr bool press(char key, Result& out)
+    {
+        if (ended) {
+            in = Input{};
+            ended = false;
+            if (key == '=' && error_shown) {
+                return false;
+            }
+        }
+        if (!in.key(key, ans)) {
+            return false;
+        }
+        out = evaluate(in.x);
+        ended = true;
+        error_shown = !out.ok();
+        if (!error_shown) {
+            ans = out.value;
+        }
+        return true;
+    }
+};
+
+// Results of a list of key strings, computed by the compiler
+template <typename T, unsigned N>
+struct Table {
+    T v[N];
+};
+
+template <unsigned N>
+constexpr Table<Result, N> results(const char* const (&keys)[N])
+{
+    Table<Result, N> t{};
+    for (unsigned i = 0; i < N; i++) {
+        t.v[i] = run(keys[i]);
+    }
+    return t;
+}
+
+} // namespace calc
+
+#endif
@@ -0,0 +1,129 @@
+// ============= CALC_GOLDENS.CPP =============
+// Golden results of the evaluator, computed by the compiler from calc_eval.hpp
+// and exported to the C tests (see calc_goldens.h). The expected values are
+// asserted here, so a change to the port that alters a result fails the build.
+// ===================================
+
+#include "calc_goldens.h"
+#include "calc_eval.hpp"
+#include "logic.h"
+
+static_assert(calc::max_tokens == MAX_TOKENS, "calc_eval.hpp out of step with logic.h");
+static_assert(calc::line_len == LCD_LINE_LEN, "calc_eval.hpp out of step with logic.h");
+
+// --- Results ---
+static_assert(calc::run("2+3=").value == 5.0f, "addition");
+static_assert(calc::run("5-2=").value == 3.0f, "subtraction");
+static_assert(calc::run("3*4=").value == 12.0f, "multiplication");
+static_assert(calc::run("10/2=").value == 5.0f, "division");
+static_assert(calc::run("2+3*4=").value == 14.0f, "* binds tighter than +");
+static_assert(calc::run("2*3+4=").value == 10.0f, "* binds tighter than +");
+static_assert(calc::run("10-2+3=").value == 11.0f, "equal precedence goes left to right");
+static_assert(calc::run("8/2/2=").value == 2.0f, "equal precedence goes left to right");
+static_assert(calc::run("1+2*3-4/2=").value == 5.0f, "mixed precedence");
+static_assert(calc::run("1/2=").value == 0.5f, "fractional result");
+static_assert(calc::run(".5=").value == 0.5f, "leading decimal point");
+static_assert(calc::run("1.25*4=").value == 5.0f, "decimal operand");
+static_assert(calc::run("-2+5=").value == 3.0f, "unary minus at the start");
+static_assert(calc::run("5*-2=").value == -10.0f, "unary minus after an operator");
+static_assert(calc::run("3--2=").value == 5.0f, "binary then unary minus");
+static_assert(calc::run("7=").value == 7.0f && calc::run("7=").ok(), "single number");
+static_assert(calc::run("=").value == 0.0f && calc::run("=").ok(), "empty expression");
+static_assert(calc::run("2+3").value == 5.0f, "'=' implied at the end");
+
+// --- Errors ---
+static_assert(calc::run("1/0=").error == calc::Error::div_zero, "division by zero");
+static_assert(calc::run("5*+=").error == calc::Error::syntax, "operator after operator");
+static_assert(calc::run("5+=").error == calc::Error::syntax, "trailing operator");
+static_assert(calc::run("*5=").error == calc::Error::syntax, "leading operator");
+static_assert(calc::run("+5=").error == calc::Error::syntax, "a leading '+' is taken, then has no operand");
+static_assert(calc::run("-=").error == calc::Error::syntax, "minus alone");
+static_assert(calc::run("1.5.").error == calc::Error::syntax, "second decimal point");
+static_assert(calc::run("12345678901234567").error == calc::Error::num_len, "number longer than the LCD");
+static_assert(calc::run("1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1=").value == 25.0f,
+              "longest expression (49 tokens)");
+static_assert(calc::run("1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1=").error == calc::Error::expr_long,
+              "51 tokens");
+static_assert(calc::run("1/0+2*").value == 0.0f && calc::run("1/0+2*").error == calc::Error::syntax,
+              "input errors win over evaluation errors");
+
+// --- One key at a time ---
+// The last result or error that pressing `keys` brings up, -1 if none does
+constexpr calc::Result last_shown(const char* keys)
+{
+    calc::Keypad keypad{};
+    calc::Result shown{-1.0f, calc::Error::none};
+    for (; *keys; keys++) {
+        keypad.press(*keys, shown);
+    }
+    return shown;
+}
+
+static_assert(last_shown("12+3").value == -1.0f, "no result before '='");
+static_assert(last_shown("2+3=4=").value == 4.0f, "a digit after a result starts over");
+static_assert(last_shown("2+3=*").error == calc::Error::syntax, "an operator after a result starts over too");
+static_assert(last_shown("1/0==5=").value == 5.0f, "'=' after an error only clears");
+static_assert(last_shown("1.5.").error == calc::Error::syntax, "input errors show at once");
+static_assert(last_shown("1.5.7=").value == 7.0f, "a key after an input error starts over");
+
+// --- Clear, backspace and ANS ---
+static_assert(last_shown("12+34C5=").value == 5.0f, "clear drops the expression");
+static_assert(last_shown("1/0=C7=").value == 7.0f, "clear after an error");
+static_assert(last_shown("12<3=").value == 13.0f, "backspace deletes a digit");
+static_assert(last_shown("1.<5=").value == 15.0f, "backspace deletes the decimal point");
+static_assert(last_shown("12+<3=").value == 123.0f, "backspace over an operator reopens the number");
+static_assert(last_shown("9999.99*<<1=").value == calc::run("9999.91=").value, "reopened as typed, not 9999.990234");
+static_assert(last_shown("+<5=").value == 5.0f, "backspace over a leading '+'");
+static_assert(last_shown("5*-<<2=").value == 52.0f, "backspace over a unary minus, then the operator");
+static_assert(last_shown("-0+<1=").value == -1.0f, "a reopened -0 keeps its sign");
+static_assert(last_shown("2+3=A*2=").value == 10.0f, "ANS types the last result");
+static_assert(last_shown("A=").value == 0.0f && last_shown("A=").ok(), "ANS is 0 before any result");
+static_assert(last_shown("5=1/0=A=").value == 5.0f, "an error leaves ANS alone");
+static_assert(last_shown("1/3=A*3=").value == calc::run("0.333333*3=").value, "ANS types the result as shown");
+static_assert(last_shown("99999999*99999999=A").error == calc::Error::num_len, "ANS in scientific notation");
+
+// --- Tables for the C tests ---
+static constexpr const char* golden_keys[] = {
+    "2+3=", "5-2=", "3*4=", "10/2=", "2+3*4=", "2*3+4=", "10-2+3=", "8/2/2=",
+    "1+2*3-4/2=", "1/2=", ".5=", "1.25*4=", "-2+5=", "5*-2=", "3--2=", "7=", "=",
+    "0.1+0.2=", "1/3=", "2/3*3=", "0.7*0.7-0.49=", "123456.7+0.05=", "99999999*99999999=",
+    "-.5*-.5=", "1.5-2.25/0.5*3=",
+    "1/0=", "5*+=", "5+=", "*5=", "+5=", "-=", "1.5.", "12345678901234567",
+    "1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1=",
+    "1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1+1=",
+};
+constexpr unsigned golden_count = sizeof(golden_keys) / sizeof(golden_keys[0]);
+
+static constexpr auto golden_table = [] {
+    constexpr auto results = calc::results(golden_keys);
+    calc::Table<calc_golden, golden_count> t{};
+    for (unsigned i = 0; i < golden_count; i++) {
+        t.v[i] = calc_golden{golden_keys[i], results.v[i].value, calc::message(results.v[i].error)};
+    }
+    return t;
+}();
+
+extern "C" const calc_golden *const calc_goldens = golden_table.v;
+extern "C" const int calc_golden_count = golden_count;
+
+// Key sequences across calculations, with the last result or error shown
+static constexpr const char* key_golden_keys[] = {
+    "12+34C5=", "1/0=C7=", "12<3=", "1.<5=", "12+<3=", "9999.99*<<1=", "+<5=", "5*-<<2=",
+    "-0+<1=", "0.1+<<<5=", "123456.7+<8=", "16777217+<=", "3.14159*2-<<<7=", "9<<=", "2+3=<4=",
+    "2+3=A*2=", "A=", "5=1/0=A=", "1/3=A*3=", "2/3=A=", "7=A+A*A=", "123456789=A+1=",
+    "0.000001*0.000001=A=", "1234567*1000000000=A-1=", "3=AAA=", "12A=", "1.5=2+A<<=",
+    "99999999*99999999=A", "1/0=A=",
+};
+constexpr unsigned key_golden_count = sizeof(key_golden_keys) / sizeof(key_golden_keys[0]);
+
+static constexpr auto key_golden_table = [] {
+    calc::Table<calc_golden, key_golden_count> t{};
+    for (unsigned i = 0; i < key_golden_count; i++) {
+        calc::Result r = last_shown(key_golden_keys[i]);
+        t.v[i] = calc_golden{key_golden_keys[i], r.value, calc::message(r.error)};
+    }
+    return t;
+}();
+
+extern "C" const calc_golden *const calc_key_goldens = key_golden_table.v;
+extern "C" const int calc_key_golden_count = key_golden_count;
@@ -0,0 +1,31 @@
+// ============= CALC_GOLDENS.H =============
+// C view of the evaluator's golden results. calc_goldens.cpp computes them at
+// compile time with the constexpr port in calc_eval.hpp (and static_asserts the
+// expected ones); test_logic.c checks that logic.c produces the same.
+#ifndef CALC_GOLDENS_H
+#define CALC_GOLDENS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *keys;  // Keys as typed, "0123456789+-*/=." and 'C' (clear), '<' (backspace), 'A' (ANS)
+    float value;       // Result, 0 on error
+    const char *error; // Error message, NULL if none
+} calc_golden;
+
+// One expression each
+extern const calc_golden *const calc_goldens;
+extern const int calc_golden_count;
+
+// Key sequences across calculations, from power-up (ANS 0): the last result or
+// error they bring up
+extern const calc_golden *const calc_key_goldens;
+extern const int calc_key_golden_count;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
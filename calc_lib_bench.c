@@ -0,0 +1,115 @@
+// calc_lib_bench.c - libcalc.so: one call per expression against calc_eval_batch()
+//
+// Fills a batch with the golden expressions of calc_goldens.cpp and checks the
+// library's results against them: through calc_eval_batch(), through calc_eval()
+// and typed key by key through the keystroke API, which also types the key
+// sequences with clear, backspace and ANS. It then times the batch both
+// ways, through the shared library's PLT as any client would call it.
+//
+// Build and run commands are in README.md ("Host Library").
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime() under -std=c99
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "calc_goldens.h"
+#include "libcalc.h"
+
+#define BATCH 1024
+#define RUNS 2000
+
+static const char *exprs[BATCH];
+static calc_result results[BATCH];
+
+static double now_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int same(const calc_result *r, const calc_golden *g)
+{
+    const char *message = calc_error_message(r->error);
+    if (g->error) {
+        return message && strcmp(message, g->error) == 0;
+    }
+    return r->error == CALC_OK && memcmp(&r->value, &g->value, sizeof(r->value)) == 0;
+}
+
+int main(void)
+{
+    calc_keypad keypad;
+    double start, one_by_one, batched;
+    int i, r, failures = 0;
+    size_t ok = 0;
+
+    if (calc_abi_version() != CALC_ABI_VERSION) {
+        printf("libcalc ABI %d, built against %d\n", calc_abi_version(), CALC_ABI_VERSION);
+        return 1;
+    }
+    for (i = 0; i < BATCH; i++) {
+        exprs[i] = calc_goldens[i % calc_golden_count].keys;
+    }
+
+    // Results: batch, single calls and key by key
+    calc_eval_batch(exprs, BATCH, results);
+    calc_keypad_init(&keypad);
+    for (i = 0; i < calc_golden_count; i++) {
+        const calc_golden *g = &calc_goldens[i];
+        const char *k;
+        calc_result single, typed = { -1.0f, CALC_OK };
+
+        calc_eval(g->keys, &single);
+        for (k = g->keys; *k && !calc_keypad_press(&keypad, *k, &typed); k++) {
+        }
+        if (!*k) {
+            calc_keypad_press(&keypad, '=', &typed); // '=' implied at the end
+        }
+        if (!same(&results[i], g) || !same(&single, g) || !same(&typed, g)) {
+            printf("%s: batch %d %.9g, single %d %.9g, keys %d %.9g, expected %s %.9g\n", g->keys,
+                   results[i].error, results[i].value, single.error, single.value, typed.error, typed.value,
+                   g->error ? g->error : "", g->value);
+            failures++;
+        }
+        calc_keypad_press(&keypad, '=', &typed); // Clears an error; otherwise starts over
+        calc_keypad_init(&keypad);
+    }
+    // Clear, backspace and ANS across calculations: the last result or error shown
+    for (i = 0; i < calc_key_golden_count; i++) {
+        const calc_golden *g = &calc_key_goldens[i];
+        const char *k;
+        calc_result shown = { -1.0f, CALC_OK };
+
+        calc_keypad_init(&keypad);
+        for (k = g->keys; *k; k++) {
+            calc_keypad_press(&keypad, *k, &shown);
+        }
+        if (!same(&shown, g)) {
+            printf("%s: keys %d %.9g, expected %s %.9g\n", g->keys, shown.error, shown.value,
+                   g->error ? g->error : "", g->value);
+            failures++;
+        }
+    }
+
+    start = now_s();
+    for (r = 0; r < RUNS; r++) {
+        for (i = 0; i < BATCH; i++) {
+            calc_eval(exprs[i], &results[i]);
+        }
+    }
+    one_by_one = (now_s() - start) / ((double)RUNS * BATCH) * 1e9;
+
+    start = now_s();
+    for (r = 0; r < RUNS; r++) {
+        ok += calc_eval_batch(exprs, BATCH, results);
+    }
+    batched = (now_s() - start) / ((double)RUNS * BATCH) * 1e9;
+
+    printf("%d expressions (%d goldens), %zu of each batch without error\n", BATCH, calc_golden_count, ok / RUNS);
+    printf("calc_eval() each   %7.1f ns/expression\n", one_by_one);
+    printf("calc_eval_batch()  %7.1f ns/expression (%.2fx)\n", batched, one_by_one / batched);
+    printf("mismatches         %d\n", failures);
+    return failures ? 1 : 0;
+}
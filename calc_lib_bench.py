@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# calc_lib_bench.py - libcalc.so from Python ctypes: one call per expression
+# against calc_eval_batch()
+#
+# The C side (calc_lib_bench.c) checks the results against the goldens; this
+# checks that both paths agree and times them across the ctypes boundary, where
+# each call costs far more than the evaluation itself.
+#
+# Build commands are in README.md ("Host Library"); run from the build directory:
+#     python3 calc_lib_bench.py [path/to/libcalc.so]
+
+import ctypes
+import sys
+import time
+
+BATCH = 1024
+RUNS = 200
+
+# Mix of lengths, precedence, decimals and errors, as in the goldens
+EXPRS = [
+    b"2+3*4=", b"1+2*3-4/2+5*6=", b"9999.99*3.14159=", b"10/4=", b"5/0=",
+    b"1.5+2.25-0.125=", b"123456789*9=", b"7-8-9=", b"*5=", b"2*3/4+5-6*7/8=",
+    b"0.1+0.2=", b"100/3*3=", b"-5+3=", b"1..2=", b"42=", b"3.5*2-1/4+8*8-9=",
+]
+
+
+class calc_result(ctypes.Structure):
+    _fields_ = [("value", ctypes.c_float), ("error", ctypes.c_int32)]
+
+
+def main():
+    lib = ctypes.CDLL(sys.argv[1] if len(sys.argv) > 1 else "./libcalc.so")
+    lib.calc_eval.argtypes = [ctypes.c_char_p, ctypes.POINTER(calc_result)]
+    lib.calc_eval.restype = ctypes.c_int32
+    lib.calc_eval_batch.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_size_t,
+                                    ctypes.POINTER(calc_result)]
+    lib.calc_eval_batch.restype = ctypes.c_size_t
+
+    keys = [EXPRS[i % len(EXPRS)] for i in range(BATCH)]
+    exprs = (ctypes.c_char_p * BATCH)(*keys)
+    batch = (calc_result * BATCH)()
+    single = (calc_result * BATCH)()
+
+    # Both paths give the same results
+    lib.calc_eval_batch(exprs, BATCH, batch)
+    for i in range(BATCH):
+        lib.calc_eval(exprs[i], single[i])
+    mismatches = sum(1 for a, b in zip(batch, single)
+                     if a.error != b.error or (a.error == 0 and a.value != b.value))
+
+    calc_eval = lib.calc_eval
+    start = time.perf_counter()
+    for _ in range(RUNS):
+        for i in range(BATCH):
+            calc_eval(keys[i], single[i])
+    one_by_one = (time.perf_counter() - start) / (RUNS * BATCH) * 1e9
+
+    start = time.perf_counter()
+    ok = 0
+    for _ in range(RUNS):
+        ok += lib.calc_eval_batch(exprs, BATCH, batch)
+    batched = (time.perf_counter() - start) / (RUNS * BATCH) * 1e9
+
+    print("%d expressions, %d of each batch without error" % (BATCH, ok // RUNS))
+    print("calc_eval() each   %7.1f ns/expression" % one_by_one)
+    print("calc_eval_batch()  %7.1f ns/expression (%.2fx)" % (batched, one_by_one / batched))
+    print("mismatches         %d" % mismatches)
+    return 1 if mismatches else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
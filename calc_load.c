@@ -0,0 +1,244 @@
+// calc_load.c - Load generator for calc_server
+//
+// Opens -c connections, one thread each, and keeps -d requests of -b expressions
+// in flight on every one for -t seconds. The expressions are the golden table of
+// calc_goldens.cpp, taken in turn, so every result is checked against the
+// compile-time value bit for bit (or the same error message). Prints the
+// requests and expressions per second and the request latency, from the send to
+// the whole response read: p50, p99 and max.
+//
+// Build and run commands are in README.md ("Evaluation Server").
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime() under -std=c99
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "calc_goldens.h"
+#include "calc_proto.h"
+
+#define MAX_CONNS 256
+#define MAX_DEPTH 256
+#define LATENCY_BUCKETS 100000 // 1 us each, up to 100 ms; the last takes everything above
+
+typedef struct {
+    pthread_t thread;
+    unsigned long requests, exprs, mismatches;
+    unsigned long *latency; // LATENCY_BUCKETS
+    uint64_t latency_max_ns;
+    bool failed;
+} client;
+
+static const char *socket_path = CALC_PROTO_SOCKET;
+static int depth = 8, batch = 64;
+static double seconds = 3.0;
+static uint64_t end_ns;
+
+static uint64_t now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+static bool write_all(int fd, const unsigned char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool read_all(int fd, unsigned char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Request of `batch` goldens from `first` on; returns the frame length
+static size_t build_request(unsigned char *frame, int first)
+{
+    unsigned char *p = frame + 8;
+    int i;
+
+    for (i = 0; i < batch; i++) {
+        const char *keys = calc_goldens[(first + i) % calc_golden_count].keys;
+        size_t n = strlen(keys);
+        *p++ = (unsigned char)n;
+        memcpy(p, keys, n);
+        p += n;
+    }
+    calc_proto_put32(frame, (uint32_t)(p - frame - 4));
+    calc_proto_put32(frame + 4, (uint32_t)batch);
+    return (size_t)(p - frame);
+}
+
+// Checks a response payload against the goldens from `first` on; returns the
+// number of results that differ
+static unsigned long check_response(const unsigned char *p, uint32_t len, int first)
+{
+    const unsigned char *end = p + len;
+    unsigned long bad = 0;
+    int i;
+
+    if (len < 4 || calc_proto_get32(p) != (uint32_t)batch) return (unsigned long)batch;
+    p += 4;
+    for (i = 0; i < batch; i++) {
+        const calc_golden *g = &calc_goldens[(first + i) % calc_golden_count];
+        if (end - p < 5 || end - p < 5 + p[4]) return bad + (unsigned long)(batch - i);
+        if (g->error ? (p[4] != strlen(g->error) || memcmp(p + 5, g->error, p[4]) != 0)
+                     : (p[4] != 0 || memcmp(p, &g->value, sizeof(g->value)) != 0)) {
+            bad++;
+        }
+        p += 5 + p[4];
+    }
+    return bad;
+}
+
+static void *run_client(void *arg)
+{
+    client *cl = arg;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t frame_max = 8 + (size_t)batch * 256;
+    unsigned char *frame = malloc(frame_max), *response = malloc(CALC_PROTO_MAX_FRAME);
+    uint64_t sent_at[MAX_DEPTH];
+    int first[MAX_DEPTH];
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0), in_flight = 0, head = 0, next = 0;
+    bool sending = true;
+
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (!frame || !response || fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(socket_path);
+        cl->failed = true;
+        goto done;
+    }
+    for (;;) {
+        uint32_t len;
+        uint64_t ns;
+
+        // Fill the pipeline, then wait for the oldest request's response
+        while (sending && in_flight < depth) {
+            int slot = (head + in_flight) % depth;
+            size_t n = build_request(frame, next);
+            first[slot] = next;
+            next = (next + batch) % calc_golden_count;
+            sent_at[slot] = now_ns();
+            if (!write_all(fd, frame, n)) {
+                cl->failed = true;
+                goto done;
+            }
+            in_flight++;
+        }
+        if (in_flight == 0) break;
+        if (!read_all(fd, response, 4) || (len = calc_proto_get32(response)) > CALC_PROTO_MAX_FRAME ||
+            !read_all(fd, response, len)) {
+            fprintf(stderr, "connection lost\n");
+            cl->failed = true;
+            goto done;
+        }
+        ns = now_ns();
+        cl->mismatches += check_response(response, len, first[head]);
+        cl->latency[(ns - sent_at[head]) / 1000 < LATENCY_BUCKETS ? (ns - sent_at[head]) / 1000 : LATENCY_BUCKETS - 1]++;
+        if (ns - sent_at[head] > cl->latency_max_ns) cl->latency_max_ns = ns - sent_at[head];
+        cl->requests++;
+        cl->exprs += (unsigned long)batch;
+        head = (head + 1) % depth;
+        in_flight--;
+        sending = ns < end_ns;
+    }
+done:
+    if (fd >= 0) close(fd);
+    free(frame);
+    free(response);
+    return NULL;
+}
+
+static unsigned long percentile_us(const unsigned long *latency, unsigned long samples, double p)
+{
+    unsigned long want = (unsigned long)(samples * p), seen = 0;
+    int b;
+
+    for (b = 0; b < LATENCY_BUCKETS - 1; b++) {
+        seen += latency[b];
+        if (seen > want) break;
+    }
+    return (unsigned long)b + 1; // Upper edge of the bucket
+}
+
+int main(int argc, char **argv)
+{
+    static client clients[MAX_CONNS];
+    unsigned long *latency = calloc(LATENCY_BUCKETS, sizeof(*latency));
+    unsigned long requests = 0, exprs = 0, mismatches = 0;
+    uint64_t started, max_ns = 0;
+    int conns = 4, i, b;
+    bool failed = false;
+    double took;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            conns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-c connections] [-d depth] [-b batch] [-t seconds] [socket]\n", argv[0]);
+            return 1;
+        } else {
+            socket_path = argv[i];
+        }
+    }
+    if (conns < 1 || conns > MAX_CONNS || depth < 1 || depth > MAX_DEPTH ||
+        batch < 1 || batch > CALC_PROTO_MAX_BATCH || !latency) {
+        fprintf(stderr, "at most %d connections, depth %d and batch %d\n", MAX_CONNS, MAX_DEPTH, CALC_PROTO_MAX_BATCH);
+        return 1;
+    }
+
+    started = now_ns();
+    end_ns = started + (uint64_t)(seconds * 1e9);
+    for (i = 0; i < conns; i++) {
+        clients[i].latency = calloc(LATENCY_BUCKETS, sizeof(unsigned long));
+        if (!clients[i].latency || pthread_create(&clients[i].thread, NULL, run_client, &clients[i]) != 0) {
+            fprintf(stderr, "cannot start client %d\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < conns; i++) {
+        client *cl = &clients[i];
+        pthread_join(cl->thread, NULL);
+        requests += cl->requests;
+        exprs += cl->exprs;
+        mismatches += cl->mismatches;
+        failed = failed || cl->failed;
+        for (b = 0; b < LATENCY_BUCKETS; b++) latency[b] += cl->latency[b];
+        if (cl->latency_max_ns > max_ns) max_ns = cl->latency_max_ns;
+    }
+    took = (now_ns() - started) / 1e9;
+
+    printf("%d connections x %d in flight, %d expressions per request, %.1f s\n", conns, depth, batch, took);
+    printf("requests     %lu (%.0f/s)\n", requests, requests / took);
+    printf("expressions  %lu (%.0f/s)\n", exprs, exprs / took);
+    if (requests) {
+        printf("latency      p50 <%lu us, p99 <%lu us, max %lu us\n", percentile_us(latency, requests, 0.50),
+               percentile_us(latency, requests, 0.99), (unsigned long)(max_ns / 1000));
+    }
+    printf("mismatches   %lu\n", mismatches);
+    return (failed || mismatches) ? 1 : 0;
+}
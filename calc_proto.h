@@ -0,0 +1,41 @@
+// ============= CALC_PROTO.H =============
+// Wire format of calc_server, the host evaluation daemon, and its load generator
+// calc_load. Everything is in frames, in host byte order (both ends share the
+// machine through a Unix domain socket):
+//
+//     frame    = u32 payload length, payload
+//     request  = u32 count, count x (u8 length, keys)
+//     response = u32 count, count x (u32 result float bits, u8 length, error message)
+//
+// keys are typed as on the keypad, "0123456789+-*/=.", with '=' implied at the end;
+// anything after the first '=' is ignored. A result is what the firmware shows:
+// the float, bit for bit, or the error message ("Err: Syntax", ...) with a result
+// of 0. An empty message means no error.
+//
+// A client may send any number of requests without waiting (pipelining); the
+// responses on a connection come back in the order of the requests. The server
+// closes a connection that sends a malformed request.
+#ifndef CALC_PROTO_H
+#define CALC_PROTO_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define CALC_PROTO_SOCKET "/tmp/calc.sock" // Default path
+#define CALC_PROTO_MAX_FRAME (1u << 20)    // Longest payload accepted
+#define CALC_PROTO_MAX_BATCH 16384         // Most expressions in one request
+#define CALC_PROTO_MAX_MESSAGE 16          // LCD_LINE_LEN
+
+static inline uint32_t calc_proto_get32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void calc_proto_put32(unsigned char *p, uint32_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+#endif
@@ -0,0 +1,489 @@
+// calc_server.c - Host evaluation daemon: logic.c behind a Unix domain socket
+//
+// Other programs (line-test tools, scripts) send key strings and get back exactly
+// what the firmware would show, from the firmware's own calc_ui_key() and
+// evaluator. The wire format is in calc_proto.h: length-prefixed frames, many
+// expressions per request, any number of requests in flight per connection.
+//
+// The main thread runs an epoll loop. It accepts connections, reads frames, checks
+// them and queues each request as a job. The worker threads take jobs from the
+// queue and type every expression on a calculator of their own, then hand the
+// response back to the loop through an eventfd. The loop puts the responses of a
+// connection back into request order and writes them without blocking. The build
+// uses -DSIM_THREAD_LOCAL, which makes logic.c's state thread-local (sim_local.h).
+//
+// Build and run commands are in README.md ("Evaluation Server").
+
+// Not _GNU_SOURCE: with it, <pthread.h> needs cpu_set_t from <sched.h>, and -I.
+// finds the scheduler's sched.h there
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "calc_proto.h"
+#include "logic.h"
+
+#define MAX_WORKERS 64
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+
+typedef struct job job;
+
+typedef struct conn conn;
+
+struct conn {
+    int fd;
+    bool closed;
+    bool want_write;       // EPOLLOUT armed
+    unsigned char *in;     // Received, not yet a complete frame
+    size_t in_len, in_cap;
+    unsigned char *out;    // Responses not yet written
+    size_t out_len, out_sent, out_cap;
+    uint64_t next_seq;     // Given to the next request read
+    uint64_t send_seq;     // Request whose response is written next
+    job *done;             // Responses finished early, sorted by seq
+    unsigned outstanding;  // Jobs queued or running; the conn is freed at 0 once closed
+    conn *next_released;   // In the released list
+};
+
+struct job {
+    job *next;
+    conn *c;
+    uint64_t seq;
+    unsigned char *request;  // Payload
+    unsigned char *response; // Whole frame, NULL if it could not be built
+    size_t response_len;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    job *head, *tail;
+    bool stop;
+} work = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, false };
+
+static struct {
+    pthread_mutex_t lock;
+    job *head;
+} finished = { PTHREAD_MUTEX_INITIALIZER, NULL };
+
+static int epoll_fd, listen_fd, wake_fd;
+static volatile sig_atomic_t stopping;
+static unsigned long served_requests, served_exprs, served_conns;
+// Closed connections with nothing outstanding. Later events of the same epoll_wait
+// batch may still point at them, so they are freed only after the batch.
+static conn *released;
+
+static const char keypad_chars[] = "0123456789+-*/=."; // Indexed by KEY_* code
+
+// Types `keys` on this thread's calculator, as test_logic.c does with the goldens.
+// Returns the result, or 0 with *error set to the message shown.
+static float evaluate_keys(const unsigned char *keys, int n, const char **error)
+{
+    int i;
+
+    calc_ui_begin();
+    for (i = 0; i < n && !calc_ctx.calculation_has_ended && !calc_eval_pending(); i++) {
+        const char *k = keys[i] ? strchr(keypad_chars, keys[i]) : NULL;
+        if (!k) {
+            *error = "Err: Syntax"; // Not a key of the keypad, as in calc_eval.hpp
+            return 0.0f;
+        }
+        calc_ui_key((unsigned char)(k - keypad_chars));
+    }
+    if (!calc_ctx.calculation_has_ended && !calc_eval_pending()) {
+        calc_ui_key(KEY_EQUALS); // '=' implied at the end
+    }
+    if (calc_eval_pending()) {
+        calc_eval_run();
+    }
+    *error = calculator_error ? error_message : NULL;
+    return calculator_error ? 0.0f : calc_ctx.eval.result;
+}
+
+// Worker side: builds the response frame of a checked request
+static void serve_request(job *j)
+{
+    uint32_t count = calc_proto_get32(j->request), i;
+    const unsigned char *p = j->request + 4;
+    unsigned char *q;
+
+    j->response = malloc(8 + (size_t)count * (5 + CALC_PROTO_MAX_MESSAGE));
+    if (!j->response) return;
+    q = j->response + 8;
+    for (i = 0; i < count; i++) {
+        const char *error;
+        float value = evaluate_keys(p + 1, p[0], &error);
+        size_t len = error ? strlen(error) : 0;
+
+        p += 1 + p[0];
+        memcpy(q, &value, sizeof(value));
+        q[4] = (unsigned char)len;
+        memcpy(q + 5, error, len);
+        q += 5 + len;
+    }
+    j->response_len = (size_t)(q - j->response);
+    calc_proto_put32(j->response, (uint32_t)(j->response_len - 4));
+    calc_proto_put32(j->response + 4, count);
+}
+
+static void *worker(void *arg)
+{
+    uint64_t one = 1;
+
+    (void)arg;
+    for (;;) {
+        job *j;
+
+        pthread_mutex_lock(&work.lock);
+        while (!work.head && !work.stop) pthread_cond_wait(&work.ready, &work.lock);
+        j = work.head;
+        if (j) {
+            work.head = j->next;
+            if (!work.head) work.tail = NULL;
+        }
+        pthread_mutex_unlock(&work.lock);
+        if (!j) return NULL; // Stopping and nothing left
+
+        serve_request(j);
+        pthread_mutex_lock(&finished.lock);
+        j->next = finished.head;
+        finished.head = j;
+        pthread_mutex_unlock(&finished.lock);
+        if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) perror("eventfd");
+    }
+}
+
+static void job_free(job *j)
+{
+    free(j->request);
+    free(j->response);
+    free(j);
+}
+
+// True if the `len` bytes at `p` are one complete request
+static bool request_valid(const unsigned char *p, uint32_t len)
+{
+    uint32_t count, i, at = 4;
+
+    if (len < 4) return false;
+    count = calc_proto_get32(p);
+    if (count > CALC_PROTO_MAX_BATCH) return false;
+    for (i = 0; i < count; i++) {
+        if (at >= len) return false;
+        at += 1 + p[at];
+    }
+    return at == len;
+}
+
+static bool reserve(unsigned char **buf, size_t *cap, size_t need)
+{
+    unsigned char *grown;
+    size_t to = *cap ? *cap : READ_CHUNK;
+
+    if (need <= *cap) return true;
+    while (to < need) to *= 2;
+    grown = realloc(*buf, to);
+    if (!grown) return false;
+    *buf = grown;
+    *cap = to;
+    return true;
+}
+
+static void conn_close(conn *c)
+{
+    if (!c->closed) {
+        job *j;
+
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        close(c->fd);
+        c->closed = true;
+        while ((j = c->done) != NULL) {
+            c->done = j->next;
+            job_free(j);
+        }
+        free(c->in);
+        free(c->out);
+        c->in = c->out = NULL;
+    }
+    if (c->outstanding == 0) { // Once: a closed conn gets no more jobs or events
+        c->next_released = released;
+        released = c;
+    }
+}
+
+static void free_released(void)
+{
+    while (released) {
+        conn *c = released;
+        released = c->next_released;
+        free(c);
+    }
+}
+
+static void conn_watch(conn *c, bool want_write)
+{
+    struct epoll_event ev = { .events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.ptr = c };
+
+    if (want_write != c->want_write) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want_write;
+    }
+}
+
+// Writes what the socket takes; returns false if the connection was closed
+static bool conn_flush(conn *c)
+{
+    while (c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) break;
+        if (n < 0) {
+            conn_close(c);
+            return false;
+        }
+        c->out_sent += (size_t)n;
+    }
+    if (c->out_sent == c->out_len) c->out_sent = c->out_len = 0;
+    conn_watch(c, c->out_len != 0);
+    return true;
+}
+
+// Queues every complete frame of the input buffer; returns false if the
+// connection was closed
+static bool conn_dispatch(conn *c)
+{
+    size_t at = 0;
+
+    while (c->in_len - at >= 4) {
+        uint32_t len = calc_proto_get32(c->in + at);
+        job *j = NULL;
+
+        if (len > CALC_PROTO_MAX_FRAME) break; // Rejected below
+        if (c->in_len - at - 4 < len) break;
+        if (!request_valid(c->in + at + 4, len) || !(j = calloc(1, sizeof(*j))) ||
+            !(j->request = malloc(len))) {
+            if (j) free(j);
+            conn_close(c);
+            return false;
+        }
+        memcpy(j->request, c->in + at + 4, len);
+        j->c = c;
+        j->seq = c->next_seq++;
+        c->outstanding++;
+        served_requests++;
+        served_exprs += calc_proto_get32(j->request);
+
+        pthread_mutex_lock(&work.lock);
+        if (work.tail) work.tail->next = j;
+        else work.head = j;
+        work.tail = j;
+        pthread_cond_signal(&work.ready);
+        pthread_mutex_unlock(&work.lock);
+        at += 4 + len;
+    }
+    if (c->in_len - at >= 4 && calc_proto_get32(c->in + at) > CALC_PROTO_MAX_FRAME) {
+        conn_close(c);
+        return false;
+    }
+    memmove(c->in, c->in + at, c->in_len - at);
+    c->in_len -= at;
+    return true;
+}
+
+static void conn_read(conn *c)
+{
+    for (;;) {
+        ssize_t n;
+
+        if (!reserve(&c->in, &c->in_cap, c->in_len + READ_CHUNK)) {
+            conn_close(c);
+            return;
+        }
+        n = read(c->fd, c->in + c->in_len, READ_CHUNK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        if (n <= 0) { // Closed by the client; responses still owed are dropped
+            conn_close(c);
+            return;
+        }
+        c->in_len += (size_t)n;
+        if (!conn_dispatch(c)) return;
+    }
+}
+
+static void accept_all(void)
+{
+    for (;;) {
+        struct epoll_event ev = { .events = EPOLLIN };
+        conn *c;
+        int fd = accept(listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR) perror("accept");
+            return;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        served_conns++;
+    }
+}
+
+// Takes the workers' finished jobs and writes out every response that is next
+// in its connection's order
+static void collect_finished(void)
+{
+    uint64_t count;
+    job *list;
+
+    if (read(wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) perror("eventfd");
+    pthread_mutex_lock(&finished.lock);
+    list = finished.head;
+    finished.head = NULL;
+    pthread_mutex_unlock(&finished.lock);
+
+    while (list) {
+        job *j = list, **slot;
+        conn *c = j->c;
+
+        list = j->next;
+        c->outstanding--;
+        if (c->closed || !j->response) {
+            job_free(j);
+            conn_close(c); // Releases a closed conn once nothing is outstanding
+            continue;
+        }
+        for (slot = &c->done; *slot && (*slot)->seq < j->seq; slot = &(*slot)->next) {
+        }
+        j->next = *slot;
+        *slot = j;
+        while (c->done && c->done->seq == c->send_seq) {
+            j = c->done;
+            if (!reserve(&c->out, &c->out_cap, c->out_len + j->response_len)) break;
+            memcpy(c->out + c->out_len, j->response, j->response_len);
+            c->out_len += j->response_len;
+            c->done = j->next;
+            c->send_seq++;
+            job_free(j);
+        }
+        conn_flush(c);
+    }
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = CALC_PROTO_SOCKET;
+    pthread_t threads[MAX_WORKERS];
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    struct epoll_event ev = { .events = EPOLLIN };
+    struct sigaction sa = { .sa_handler = on_signal };
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            workers = atol(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [-j workers] [socket]\n", argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (workers < 1 || workers > MAX_WORKERS) workers = workers < 1 ? 1 : MAX_WORKERS;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        perror(path);
+        return 1;
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        perror("epoll");
+        return 1;
+    }
+    ev.data.ptr = &listen_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.ptr = &wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    for (i = 0; i < workers; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+            fprintf(stderr, "cannot start worker %d\n", i);
+            return 1;
+        }
+    }
+    printf("calc_server: %s, %ld workers\n", path, workers);
+    fflush(stdout);
+
+    while (!stopping) {
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1), e;
+
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (e = 0; e < n; e++) {
+            void *ptr = events[e].data.ptr;
+
+            if (ptr == &listen_fd) {
+                accept_all();
+            } else if (ptr == &wake_fd) {
+                collect_finished();
+            } else {
+                conn *c = ptr;
+                if (c->closed) continue; // Closed earlier in this batch
+                if ((events[e].events & EPOLLOUT) && !conn_flush(c)) continue;
+                if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    conn_read(c); // Reads 0 and closes on hang-up
+                }
+            }
+        }
+        free_released();
+    }
+
+    pthread_mutex_lock(&work.lock);
+    work.stop = true;
+    pthread_cond_broadcast(&work.ready);
+    pthread_mutex_unlock(&work.lock);
+    for (i = 0; i < workers; i++) pthread_join(threads[i], NULL);
+    unlink(path);
+    printf("calc_server: %lu connections, %lu requests, %lu expressions\n",
+           served_conns, served_requests, served_exprs);
+    return 0;
+}
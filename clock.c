@@ -0,0 +1,132 @@
+// ============= CLOCK.C =============
+// CPU clock manager. Runs slowly while waiting for keys and at full speed while
+// tasks hold a boost (evaluation, LCD updates).
+//
+// Everything that measures time is kept correct across a change:
+// - SystemCoreClock is updated, and delay.c reloads the Timer 1 prescaler from it,
+//   so uptime_us(), delay_us() and every scheduler deadline stay in microseconds.
+// - lcd_dma.c derives the Timer 0 tick from SystemCoreClock when a frame starts;
+//   the LCD task keeps its boost until the frame has finished.
+// - Flash wait states are raised before speeding up and lowered after slowing down.
+// ===================================
+
+#include <LPC17xx.h>
+#include "clock.h"
+#include "delay.h"
+
+#define PLL0_M 25             // Multiplier
+#define PLL0_N 2              // Pre-divider
+#define CLOCK_FULL_DIV 3      // CCLKCFG + 1 for CLOCK_FULL_HZ
+#define CLOCK_IDLE_DIV 75     // CCLKCFG + 1 for CLOCK_IDLE_HZ
+
+SIM_LOCAL uint32_t clock_level_us[CLOCK_LEVELS];
+SIM_LOCAL uint32_t clock_switches = 0;
+
+static SIM_LOCAL clock_level_t current_level = CLOCK_IDLE;
+static SIM_LOCAL unsigned char boosts = 0; // Outstanding clock_boost() requests
+static SIM_LOCAL uint32_t level_since = 0; // Uptime of the last switch
+
+static const uint32_t level_hz[CLOCK_LEVELS] = { CLOCK_IDLE_HZ, CLOCK_FULL_HZ };
+static const uint32_t level_div[CLOCK_LEVELS] = { CLOCK_IDLE_DIV, CLOCK_FULL_DIV };
+
+static void pll0_feed(void)
+{
+    LPC_SC->PLL0FEED = 0xAA;
+    LPC_SC->PLL0FEED = 0x55;
+}
+
+// Flash access time: one CPU clock per started 20 MHz (FLASHTIM = clocks - 1)
+static void flash_wait_states(uint32_t cclk_hz)
+{
+    uint32_t clocks = (cclk_hz + 19999999UL) / 20000000UL;
+    LPC_SC->FLASHCFG = (LPC_SC->FLASHCFG & 0x0FFF) | ((clocks - 1) << 12);
+}
+
+void clock_init(void)
+{
+    int i;
+
+    // 12 MHz main oscillator
+    LPC_SC->SCS |= (1 << 5);              // OSCEN, 1-20 MHz range
+    while (!(LPC_SC->SCS & (1 << 6)))     // OSCSTAT
+        ;
+
+    // PLL0 reprogramming sequence from the user manual
+    LPC_SC->FLASHCFG = (LPC_SC->FLASHCFG & 0x0FFF) | (5 << 12); // Six clocks: safe at any speed during the switch
+    LPC_SC->PLL0CON = 0x01; pll0_feed();  // Disconnect
+    LPC_SC->PLL0CON = 0x00; pll0_feed();  // Disable
+    // Peripheral clocks must be selected while PLL0 is disconnected (errata PCLKSELx.1)
+    LPC_SC->PCLKSEL0 = (LPC_SC->PCLKSEL0 & ~(3UL << 4)) | (1UL << 4); // PCLK_TIMER1 = CCLK, for delay.c
+    LPC_SC->CLKSRCSEL = 0x01;             // PLL0 input: main oscillator
+    LPC_SC->PLL0CFG = (PLL0_M - 1) | ((PLL0_N - 1) << 16);
+    pll0_feed();
+    LPC_SC->PLL0CON = 0x01; pll0_feed();  // Enable
+    LPC_SC->CCLKCFG = CLOCK_IDLE_DIV - 1;
+    while (!(LPC_SC->PLL0STAT & (1 << 26))) // PLOCK0
+        ;
+    LPC_SC->PLL0CON = 0x03; pll0_feed();  // Connect
+    while (!(LPC_SC->PLL0STAT & (1 << 25))) // PLLC0_STAT
+        ;
+    flash_wait_states(CLOCK_IDLE_HZ);
+
+    SystemCoreClock = CLOCK_IDLE_HZ;
+    current_level = CLOCK_IDLE;
+    boosts = 0;
+    level_since = 0; // delay_init() starts the uptime at 0
+    clock_switches = 0;
+    for (i = 0; i < CLOCK_LEVELS; i++) {
+        clock_level_us[i] = 0;
+    }
+}
+
+static void clock_set(clock_level_t level)
+{
+    uint32_t now;
+
+    if (level == current_level) {
+        return;
+    }
+    now = uptime_us();
+    clock_level_us[current_level] += now - level_since;
+    level_since = now;
+    clock_switches++;
+
+    if (level_hz[level] > level_hz[current_level]) {
+        flash_wait_states(level_hz[level]);
+        LPC_SC->CCLKCFG = level_div[level] - 1;
+    } else {
+        LPC_SC->CCLKCFG = level_div[level] - 1;
+        flash_wait_states(level_hz[level]);
+    }
+    SystemCoreClock = level_hz[level];
+    current_level = level;
+    delay_clock_changed();
+}
+
+void clock_boost(void)
+{
+    if (boosts++ == 0) {
+        clock_set(CLOCK_FULL);
+    }
+}
+
+void clock_release(void)
+{
+    if (boosts > 0 && --boosts == 0) {
+        clock_set(CLOCK_IDLE);
+    }
+}
+
+clock_level_t clock_level(void)
+{
+    return current_level;
+}
+
+uint32_t clock_residency_us(clock_level_t level)
+{
+    uint32_t us = clock_level_us[level];
+    if (level == current_level) {
+        us += uptime_us() - level_since;
+    }
+    return us;
+}
@@ -0,0 +1,30 @@
+// ============= CLOCK.H =============
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include "sim_local.h"
+
+// CPU clock levels. PLL0 stays locked at CLOCK_FCCO_HZ and only the CCLK divider
+// changes, so a switch takes effect at once without waiting for the PLL.
+typedef enum {
+    CLOCK_IDLE,  // Waiting for keys: 4 MHz
+    CLOCK_FULL,  // Evaluation and LCD bursts: 100 MHz
+    CLOCK_LEVELS
+} clock_level_t;
+
+#define CLOCK_FCCO_HZ 300000000UL  // PLL0 output: 2 * 25 * 12 MHz / 2
+#define CLOCK_FULL_HZ 100000000UL  // FCCO / 3
+#define CLOCK_IDLE_HZ 4000000UL    // FCCO / 75
+
+void clock_init(void);            // Main oscillator + PLL0, then the idle level; call before delay_init()
+void clock_boost(void);           // Request full speed (nestable)
+void clock_release(void);         // Drop one request; back to idle when none are left
+clock_level_t clock_level(void);
+
+// --- Accounting ---
+extern SIM_LOCAL uint32_t clock_level_us[CLOCK_LEVELS]; // Time spent at each level before the current one
+extern SIM_LOCAL uint32_t clock_switches;               // Number of level changes
+uint32_t clock_residency_us(clock_level_t level); // Including the time at the current level
+
+#endif
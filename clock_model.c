@@ -0,0 +1,90 @@
+// clock_model.c - Host model of the dynamic clock scaling (see clock.c)
+//
+// Boots the firmware on the board simulator, replays a recorded key trace through
+// the task scheduler and reports how long the CPU spent at each clock, busy and
+// asleep, and what that costs in energy compared with running flat out.
+//
+// Build and run commands are in README.md ("Clock Scaling").
+
+#include <stdio.h>
+#include "board_sim.h"
+#include "boot.h"
+#include "clock.h"
+#include "delay.h"
+#include "key_trace.h"
+#include "sched.h"
+#include "tasks.h"
+
+#define SETTLE_MS 2000 // Runs on after the last key so the final result is drawn
+
+// Supply current model at 3.3 V (mA). The active line is fitted to the LPC1768
+// datasheet figures for code running from flash with peripherals off (about 7 mA
+// at 12 MHz, 42 mA at 100 MHz). Sleep keeps the clock tree and PLL running, so it
+// also grows with CCLK; those numbers are an estimate, not a datasheet value.
+#define RUN_MA_BASE     2.2
+#define RUN_MA_PER_MHZ  0.40
+#define SLEEP_MA_BASE   1.5
+#define SLEEP_MA_PER_MHZ 0.09
+
+static double run_ma(uint32_t hz)   { return RUN_MA_BASE + RUN_MA_PER_MHZ * (hz / 1e6); }
+static double sleep_ma(uint32_t hz) { return SLEEP_MA_BASE + SLEEP_MA_PER_MHZ * (hz / 1e6); }
+
+static key_trace trace;
+
+int main(int argc, char **argv) {
+    const char *path = (argc > 1) ? argv[1] : "traces/basic.trace";
+    double busy_s = 0, sleep_s = 0, charge_scaled = 0;
+    double charge_fixed, charge_spin, total_s;
+    char line[17];
+    int i;
+
+    if (key_trace_load(path, &trace) < 0) return 1;
+
+    board_sim_reset();
+    board_sim_release_keys();
+    boot_fast();
+    tasks_start();
+    key_trace_replay(&trace);
+    sched_run_until(uptime_us() + SETTLE_MS * 1000UL);
+
+    printf("%s: %d keys, %.3f s simulated, %lu clock switches\n\n", path, trace.count,
+           sim_time_ns / 1e9, (unsigned long)clock_switches);
+    printf("  CCLK      busy ms    sleep ms   charge mC\n");
+    for (i = 0; i < SIM_CLOCK_SLOTS; i++) {
+        const sim_clock_slot *slot = &sim_clock_residency[i];
+        double b, s, q;
+        if (slot->hz == 0) continue;
+        b = slot->busy_ns / 1e9;
+        s = slot->sleep_ns / 1e9;
+        q = b * run_ma(slot->hz) + s * sleep_ma(slot->hz);
+        printf("  %3lu MHz  %9.1f  %10.1f  %10.3f\n", (unsigned long)(slot->hz / 1000000UL),
+               b * 1e3, s * 1e3, q);
+        busy_s += b;
+        sleep_s += s;
+        charge_scaled += q;
+    }
+
+    // Same timeline at a fixed 100 MHz: with WFI between tasks, and the old
+    // superloop that never sleeps
+    total_s = busy_s + sleep_s;
+    charge_fixed = busy_s * run_ma(CLOCK_FULL_HZ) + sleep_s * sleep_ma(CLOCK_FULL_HZ);
+    charge_spin = total_s * run_ma(CLOCK_FULL_HZ);
+
+    printf("\nEnergy-weighted duty cycle (100%% = always running at %lu MHz):\n",
+           (unsigned long)(CLOCK_FULL_HZ / 1000000UL));
+    printf("  clock scaling + sleep   %6.2f%%  (%.3f mC, %.2f mA average)\n",
+           100.0 * charge_scaled / charge_spin, charge_scaled, charge_scaled / total_s);
+    printf("  %3lu MHz + sleep         %6.2f%%  (%.3f mC, %.2f mA average)\n",
+           (unsigned long)(CLOCK_FULL_HZ / 1000000UL),
+           100.0 * charge_fixed / charge_spin, charge_fixed, charge_fixed / total_s);
+    printf("  %3lu MHz busy-wait       %6.2f%%  (%.3f mC, %.2f mA average)\n",
+           (unsigned long)(CLOCK_FULL_HZ / 1000000UL), 100.0, charge_spin, charge_spin / total_s);
+    printf("  time busy               %6.2f%%\n", 100.0 * busy_s / total_s);
+
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    printf("\nLCD: \"%s\"\n", line);
+    printf("LCD timing violations %lu, timer rate errors %lu, flash wait errors %lu\n",
+           sim_lcd_timing_violations, sim_timer_rate_errors, sim_flash_wait_errors);
+    return (sim_lcd_timing_violations || sim_timer_rate_errors || sim_flash_wait_errors) ? 2 : 0;
+}
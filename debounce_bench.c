@@ -0,0 +1,152 @@
+// debounce_bench.c - Key latency and false triggers of the debouncer on bouncing switches
+//
+// Runs the firmware's keypad task (tasks.c) on the board simulator with the
+// contact bounce model of board_sim.h, and presses random keys with human timing
+// on switches of each chatter profile below. The keys are those whose action is
+// sent on acceptance (see keymap.h). Every press is scored on the keys the
+// firmware accepted between it and the next press:
+// - latency: from the first contact to the acceptance of the key
+// - missed:  the key was never accepted
+// - false:   further or other keys were accepted (double keys from chatter or
+//            dropouts, and keys that do not match)
+//
+// The benchmark itself takes the accepted keys from the buffer before the UI task
+// runs. Built as is it measures the adaptive debouncer; built with
+// -DKEYPAD_DEBOUNCE_FIXED, the previous one (5 identical scans).
+//
+// Build and run commands are in README.md ("Adaptive Debounce").
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "board_sim.h"
+#include "boot.h"
+#include "delay.h"
+#include "keypad.h"
+#include "keymap.h"
+#include "sched.h"
+#include "tasks.h"
+
+#define PRESSES 2000
+#define GAP_MIN_MS 80   // Between a release and the next press
+#define GAP_MAX_MS 250
+#define HOLD_MIN_MS 60  // Fast typing
+#define HOLD_MAX_MS 200
+
+typedef struct {
+    const char *name;
+    sim_bounce bounce;
+} profile;
+
+static const profile profiles[] = {
+    { "clean",   { 0, 0, 0, 0, 0, 0, 0 } },
+    { "light",   { 100, 1000, 0, 0, 100, 0, 0 } },
+    { "typical", { 500, 4000, 0, 0, 250, 0, 0 } },
+    { "worn",    { 2000, 10000, 50, 20000, 600, 2, 1500 } },
+    { "failing", { 5000, 15000, 100, 30000, 1000, 10, 3000 } },
+};
+
+typedef struct {
+    unsigned char key;   // Key code of the press
+    uint32_t at;         // Uptime of the press
+    uint32_t latency;    // First acceptance of the key after it, 0 if none yet
+    unsigned extra;      // Keys accepted besides that one
+} press;
+
+static press presses[PRESSES];
+static uint32_t latencies[PRESSES];
+static uint32_t rng = 1;
+
+static uint32_t random_between(uint32_t min, uint32_t max)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return min + rng % (max - min + 1);
+}
+
+static int by_value(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Runs the tasks until `until`, scoring every key the keypad task accepts against
+// the latest press
+static void run_until(uint32_t until, press *p)
+{
+    unsigned char key;
+
+    while ((int32_t)(uptime_us() - until) < 0) {
+        sched_run_once();
+        while ((key = KeypadNextKey()) != 0xFF) {
+            if (p != NULL && key == p->key && p->latency == 0) {
+                p->latency = uptime_us() - p->at;
+            } else if (p != NULL) {
+                p->extra++;
+            }
+        }
+    }
+}
+
+static void run_profile(const profile *pr)
+{
+    unsigned long missed = 0, extra = 0, scored = 0;
+    uint64_t total = 0;
+    int i;
+
+    board_sim_reset();
+    boot_fast();
+    tasks_start();
+    run_until(uptime_us() + 100000, NULL);
+    board_sim_bounce(&pr->bounce, 12345);
+
+    for (i = 0; i < PRESSES; i++) {
+        press *p = &presses[i];
+        unsigned char row, col;
+
+        do {
+            row = (unsigned char)random_between(0, 3);
+            col = (unsigned char)random_between(0, 3);
+        } while (keymap.v[KEYMAP_BASE][row * 16 + (1u << col)] & (KEYMAP_HOLD | KEYMAP_CHORD));
+
+        run_until(uptime_us() + random_between(GAP_MIN_MS, GAP_MAX_MS) * 1000UL, i ? &presses[i - 1] : NULL);
+        p->key = keyCodes[row][col];
+        p->at = uptime_us();
+        p->latency = 0;
+        p->extra = 0;
+        board_sim_press_key(row, col);
+        run_until(p->at + random_between(HOLD_MIN_MS, HOLD_MAX_MS) * 1000UL, p);
+        board_sim_release_keys();
+    }
+    run_until(uptime_us() + GAP_MAX_MS * 1000UL, &presses[PRESSES - 1]);
+
+    for (i = 0; i < PRESSES; i++) {
+        extra += presses[i].extra;
+        if (presses[i].latency == 0) {
+            missed++;
+        } else {
+            latencies[scored++] = presses[i].latency;
+            total += presses[i].latency;
+        }
+    }
+    qsort(latencies, scored, sizeof(latencies[0]), by_value);
+    printf("%-8s %8.2f %8.2f %8.2f %7lu %7lu %9.2f\n", pr->name, scored ? total / 1000.0 / scored : 0.0,
+           scored ? latencies[scored / 2] / 1000.0 : 0.0, scored ? latencies[scored * 99 / 100] / 1000.0 : 0.0,
+           missed, extra, 1000.0 * extra / PRESSES);
+}
+
+int main(void)
+{
+    unsigned i;
+
+#ifdef KEYPAD_DEBOUNCE_FIXED
+    printf("fixed debouncer (5 identical scans), %d presses per profile\n", PRESSES);
+#else
+    printf("adaptive debouncer (%d us + chatter), %d presses per profile\n", KEY_WINDOW_MIN_US, PRESSES);
+#endif
+    printf("%-8s %8s %8s %8s %7s %7s %9s\n", "profile", "mean ms", "p50 ms", "p99 ms", "missed", "false", "false/1k");
+    for (i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        run_profile(&profiles[i]);
+    }
+    return 0;
+}
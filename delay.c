@@ -1,8 +1,71 @@
+// ============= DELAY.C =============
+// Delays and the microsecond uptime counter, based on Timer 1 running free at 1 MHz.
+// Unlike a counted busy loop this does not depend on the code the compiler emits,
+// only on the timer's peripheral clock, which is CCLK (SystemCoreClock). clock.c
+// selects that clock in clock_init() and calls delay_clock_changed() whenever it
+// changes CCLK.
+#include <LPC17xx.h>
+#define DELAY_IMPLEMENTATION // delay() and delay_us() are defined here, not profiled
+#include "delay.h"
+
+void delay_init(void)
+{
+    LPC_SC->PCONP |= (1 << 2);                 // Power Timer 1
+    LPC_TIM1->TCR = 0x02;                      // Reset and hold
+    LPC_TIM1->PR = SystemCoreClock / 1000000UL - 1; // One count per microsecond
+    LPC_TIM1->MCR = 0;                         // Free running, wraps at 2^32
+    LPC_TIM1->TCR = 0x01;                      // Start
+}
+
+// Keeps the count at 1 MHz after a CCLK change. The prescale counter is restarted
+// so it cannot be left above the new limit; each change loses less than 1 us.
+void delay_clock_changed(void)
+{
+    LPC_TIM1->PR = SystemCoreClock / 1000000UL - 1;
+    LPC_TIM1->PC = 0;
+}
+
+uint32_t uptime_us(void)
+{
+    return LPC_TIM1->TC;
+}
+
+// Waits at least `us` microseconds: the first tick may come right after the start
+void delay_us(unsigned int us)
+{
+    uint32_t start = LPC_TIM1->TC;
+    while ((uint32_t)(LPC_TIM1->TC - start) <= us)
+        ;
+}
+
 void delay(unsigned int ms)
 {
-    unsigned int i, j;
-    // Adjusted loop count for more accurate timing
-    // This assumes ~96MHz system clock, adjust if different
-    for (i = 0; i < ms; i++)
-        for (j = 0; j < 2000; j++); // Increased from 1275 to 2000
+    while (ms--) {
+        delay_us(1000);
+    }
+}
+
+// Sleeps (WFI) until the uptime reaches at_us, woken by a Timer 1 MR0 match interrupt.
+// Interrupts are masked around the check so a match between the check and the WFI
+// still ends the sleep: a pending interrupt wakes WFI even while masked.
+void sleep_until_us(uint32_t at_us)
+{
+    LPC_TIM1->MR0 = at_us;
+    LPC_TIM1->IR = 0x01;  // Clear any old MR0 match
+    LPC_TIM1->MCR = 0x01; // Interrupt on MR0, keep running
+    NVIC_EnableIRQ(TIMER1_IRQn);
+
+    __disable_irq();
+    while ((int32_t)(LPC_TIM1->TC - at_us) < 0) {
+        __WFI();
+        __enable_irq();  // Let the pending handler (ours or another) run
+        __disable_irq();
+    }
+    __enable_irq();
+    LPC_TIM1->MCR = 0;
+}
+
+void TIMER1_IRQHandler(void)
+{
+    LPC_TIM1->IR = 0x01; // The wake-up is all that is needed
 }
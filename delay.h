@@ -2,6 +2,22 @@
 #ifndef DELAY_H
 #define DELAY_H
 
+#include <stdint.h>
+
+void delay_init(void);
+void delay_clock_changed(void); // Called by clock.c after SystemCoreClock changed
 void delay(unsigned int ms);
+void delay_us(unsigned int us);
+uint32_t uptime_us(void); // Microseconds since delay_init(), wraps after about 71 minutes
+void sleep_until_us(uint32_t at_us); // Low-power wait until uptime_us() reaches at_us
+
+#if defined(DELAY_PROFILE) && !defined(DELAY_IMPLEMENTATION)
+// Profiling build: every delay()/delay_us() call is timed and charged to its call
+// site (see delay_profile.h). Files that define the delays set DELAY_IMPLEMENTATION.
+void delay_profiled(unsigned int ms, const char *file, int line);
+void delay_us_profiled(unsigned int us, const char *file, int line);
+#define delay(ms) delay_profiled((ms), __FILE__, __LINE__)
+#define delay_us(us) delay_us_profiled((us), __FILE__, __LINE__)
+#endif
 
 #endif
@@ -0,0 +1,184 @@
+// ============= DELAY_PROFILE.C =============
+// Delay call-site profiler, see delay_profile.h
+// ===================================
+
+#define DELAY_IMPLEMENTATION // The wrappers below call the real delays
+#include "delay.h"
+#include "delay_profile.h"
+#include "fmt.h"
+#include "lcd.h"
+#include "logic.h" // For LCD_LINE_LEN and the LCD commands
+
+#include <string.h> // For memset(), strrchr()
+
+delay_profile_site delay_profile_sites[DELAY_PROFILE_SITES];
+uint32_t delay_profile_dropped = 0;
+
+void delay_profile_reset(void)
+{
+    memset(delay_profile_sites, 0, sizeof(delay_profile_sites));
+    delay_profile_dropped = 0;
+}
+
+// Open addressing on (file, line). __FILE__ strings are not merged across files
+// reliably, but within one file they are, so the pointer identifies the file.
+static delay_profile_site *site_for(const char *file, int line)
+{
+    uint32_t h = ((uint32_t)(uintptr_t)file >> 2) ^ ((uint32_t)line * 2654435761UL);
+    int probe;
+
+    for (probe = 0; probe < DELAY_PROFILE_SITES; probe++) {
+        delay_profile_site *s = &delay_profile_sites[(h + probe) & (DELAY_PROFILE_SITES - 1)];
+        if (s->file == file && s->line == (uint16_t)line) {
+            return s;
+        }
+        if (s->file == NULL) {
+            s->file = file;
+            s->line = (uint16_t)line;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void charge(const char *file, int line, uint32_t us)
+{
+    delay_profile_site *s = site_for(file, line);
+    if (s == NULL) {
+        delay_profile_dropped++;
+        return;
+    }
+    s->calls++;
+    s->total_us += us;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+}
+
+void delay_profiled(unsigned int ms, const char *file, int line)
+{
+    uint32_t start = uptime_us();
+    delay(ms);
+    charge(file, line, uptime_us() - start);
+}
+
+void delay_us_profiled(unsigned int us, const char *file, int line)
+{
+    uint32_t start = uptime_us();
+    delay_us(us);
+    charge(file, line, uptime_us() - start);
+}
+
+// Right-aligns the number in `width` columns
+static int put_u32(char *buf, int len, uint32_t value, int width)
+{
+    char digits[12];
+    int n = fmt_u64(digits, value);
+    while (n < width--) {
+        buf[len++] = ' ';
+    }
+    return fmt_str(buf, len, digits);
+}
+
+// Ranks the occupied slots by total time, largest first; returns how many there are
+static int rank_sites(const delay_profile_site **order, uint32_t *total)
+{
+    int used = 0, i, j;
+
+    *total = 0;
+    for (i = 0; i < DELAY_PROFILE_SITES; i++) {
+        const delay_profile_site *s = &delay_profile_sites[i];
+        if (s->file == NULL) {
+            continue;
+        }
+        *total += s->total_us;
+        for (j = used++; j > 0 && order[j - 1]->total_us < s->total_us; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = s;
+    }
+    return used;
+}
+
+static const char *base_name(const char *file)
+{
+    const char *name = strrchr(file, '/');
+    return name ? name + 1 : file;
+}
+
+uint32_t delay_profile_report(delay_profile_sink emit, uint32_t keys)
+{
+    const delay_profile_site *order[DELAY_PROFILE_SITES];
+    uint32_t total;
+    int used = rank_sites(order, &total), i;
+    char line[96];
+
+    emit(keys ? "rank  call site          calls    total us   max us  share  us/key"
+              : "rank  call site          calls    total us   max us  share");
+    for (i = 0; i < used; i++) {
+        const delay_profile_site *s = order[i];
+        uint32_t tenths = total ? (uint32_t)((uint64_t)s->total_us * 1000 / total) : 0;
+        int len, start;
+
+        len = put_u32(line, 0, (uint32_t)(i + 1), 4);
+        len = fmt_str(line, len, "  ");
+        start = len;
+        len = fmt_str(line, len, base_name(s->file));
+        len = fmt_str(line, len, ":");
+        len = put_u32(line, len, s->line, 0);
+        while (len < start + 16) {
+            line[len++] = ' ';
+        }
+        len = put_u32(line, len, s->calls, 8);
+        len = put_u32(line, len, s->total_us, 12);
+        len = put_u32(line, len, s->max_us, 9);
+        len = put_u32(line, len, tenths / 10, 5);
+        len = fmt_str(line, len, ".");
+        len = put_u32(line, len, tenths % 10, 0);
+        len = fmt_str(line, len, "%");
+        if (keys) {
+            len = put_u32(line, len, s->total_us / keys, 8);
+        }
+        emit(line);
+    }
+    if (delay_profile_dropped) {
+        int len = fmt_str(line, 0, "calls from sites not in the table: ");
+        put_u32(line, len, delay_profile_dropped, 0);
+        emit(line);
+    }
+    return total;
+}
+
+void delay_profile_show(int sites)
+{
+    const delay_profile_site *order[DELAY_PROFILE_SITES];
+    delay_profile_site shown[DELAY_PROFILE_SITES];
+    uint32_t total;
+    int used = rank_sites(order, &total), i;
+    char line[32]; // Room for any counts; cut to the LCD width below
+    int len;
+
+    // Copy the ranking before drawing: the LCD waits are profiled too
+    for (i = 0; i < used && i < sites; i++) {
+        shown[i] = *order[i];
+    }
+    for (i = 0; i < used && i < sites; i++) {
+        len = put_u32(line, 0, (uint32_t)(i + 1), 0);
+        len = fmt_str(line, len, " ");
+        len = fmt_str(line, len, base_name(shown[i].file));
+        len = fmt_str(line, len, ":");
+        put_u32(line, len, shown[i].line, 0);
+        line[LCD_LINE_LEN] = '\0';
+        lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C');
+        lcdstring(line);
+
+        len = put_u32(line, 0, shown[i].total_us, 0);
+        len = fmt_str(line, len, "us ");
+        len = put_u32(line, len, total ? (uint32_t)((uint64_t)shown[i].total_us * 100 / total) : 0, 0);
+        fmt_str(line, len, "%");
+        line[LCD_LINE_LEN] = '\0';
+        lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+        lcdstring(line);
+        delay(2000);
+    }
+}
@@ -0,0 +1,41 @@
+// ============= DELAY_PROFILE.H =============
+// Delay call-site profiler. Building everything with DELAY_PROFILE defined (and
+// adding delay_profile.c) turns each delay()/delay_us() call into a timed call
+// that is charged to its source location. The table is compact (a few hundred
+// bytes), fixed in size and updated in O(1) per call; sites that do not fit are
+// counted in delay_profile_dropped.
+#ifndef DELAY_PROFILE_H
+#define DELAY_PROFILE_H
+
+#include <stdint.h>
+
+#define DELAY_PROFILE_SITES 32 // Power of two
+
+typedef struct {
+    const char *file;   // __FILE__ of the call, NULL for a free slot
+    uint16_t line;
+    uint32_t calls;
+    uint32_t total_us;  // Measured with uptime_us(), so overshoot is included
+    uint32_t max_us;
+} delay_profile_site;
+
+extern delay_profile_site delay_profile_sites[DELAY_PROFILE_SITES];
+extern uint32_t delay_profile_dropped; // Calls from sites that found the table full
+
+void delay_profile_reset(void);
+
+// Timed delays charged to (file, line); the DELAY_PROFILE macros in delay.h call these
+void delay_profiled(unsigned int ms, const char *file, int line);
+void delay_us_profiled(unsigned int us, const char *file, int line);
+
+// Writes the sites ranked by total time, one line per call to `emit`, without
+// printf. With `keys` > 0 each line also shows the wait per keystroke.
+// Returns the total time of all sites in microseconds.
+typedef void (*delay_profile_sink)(const char *line);
+uint32_t delay_profile_report(delay_profile_sink emit, uint32_t keys);
+
+// Target report: shows the top `sites` call sites on the LCD, two seconds each
+// ("1 keypad.c:38" over "48000us 96%")
+void delay_profile_show(int sites);
+
+#endif
@@ -0,0 +1,61 @@
+// delay_report.c - Host report of where the firmware waits (see delay_profile.h)
+//
+// Boots the firmware on the board simulator with every delay()/delay_us() call
+// profiled, replays a recorded key trace through the task scheduler and ranks
+// the call sites by total time spent waiting, overall and per keystroke. Boot
+// waits are reported separately so they do not hide the per-key costs.
+//
+// Build and run commands are in README.md ("Delay Profiler").
+
+#include <stdio.h>
+#include "board_sim.h"
+#include "boot.h"
+#include "delay.h"
+#include "delay_profile.h"
+#include "key_trace.h"
+#include "logic.h"
+#include "sched.h"
+#include "tasks.h"
+
+#define SETTLE_MS 2000 // Runs on after the last key so the final result is drawn
+
+static key_trace trace;
+
+static void print_line(const char *line) {
+    printf("  %s\n", line);
+}
+
+int main(int argc, char **argv) {
+    const char *path = (argc > 1) ? argv[1] : "traces/basic.trace";
+    uint32_t start, total;
+    char line[17];
+
+    if (key_trace_load(path, &trace) < 0) return 1;
+
+    board_sim_reset();
+    board_sim_release_keys();
+    delay_profile_reset();
+    start = uptime_us();
+    boot_fast();
+    printf("Boot: %lu us to a ready LCD and keypad\n", (unsigned long)(uptime_us() - start));
+    delay_profile_report(print_line, 0);
+
+    delay_profile_reset();
+    start = uptime_us();
+    tasks_start();
+    key_trace_replay(&trace);
+    sched_run_until(uptime_us() + SETTLE_MS * 1000UL);
+
+    printf("\n%s: %d keys, %lu us simulated, %lu us idle in the scheduler\n", path, trace.count,
+           (unsigned long)(uptime_us() - start), (unsigned long)sched_idle_us);
+    total = delay_profile_report(print_line, (uint32_t)trace.count);
+    printf("  waiting in delays: %lu us, %lu us per key\n", (unsigned long)total,
+           (unsigned long)(total / (trace.count ? trace.count : 1)));
+    printf("  frames drawn %lu, skipped %lu\n", (unsigned long)calc_ctx.frames,
+           (unsigned long)calc_ctx.frames_skipped);
+
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    printf("\nLCD: \"%s\", timing violations %lu\n", line, sim_lcd_timing_violations);
+    return sim_lcd_timing_violations ? 2 : 0;
+}
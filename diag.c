@@ -0,0 +1,74 @@
+// ============= DIAG.C =============
+// Diagnostics counters and the pages of the hidden screen, see diag.h
+// ===================================
+
+#include "diag.h"
+
+#ifndef CALC_NO_DIAG
+
+#include "delay.h"
+#include "fmt.h"
+#include "logic.h"
+#include "stack_monitor.h"
+
+#include <string.h> // For memset()
+
+SIM_LOCAL diag_counters diag;
+
+void diag_init(void)
+{
+    memset(&diag, 0, sizeof(diag));
+#ifdef DIAG_HAVE_CYCLES
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    diag.uptime_last = uptime_us();
+}
+
+// Appends "<label><value><unit>" at text[len]; returns the new length
+static int diag_field(char *text, int len, const char *label, uint64_t value, const char *unit)
+{
+    len = fmt_str(text, len, label);
+    len += fmt_u64(text + len, value);
+    return fmt_str(text, len, unit);
+}
+
+// Copies `text` to `line`, cut to the LCD width
+static void diag_line(char *line, const char *text)
+{
+    int i;
+    for (i = 0; i < LCD_LINE_LEN && text[i]; i++) {
+        line[i] = text[i];
+    }
+    line[i] = '\0';
+}
+
+void diag_page_text(int page, char *line1, char *line2)
+{
+    char a[48], b[48]; // Room for any values; cut to the LCD width below
+    uint32_t now = uptime_us();
+    uint32_t wraps = diag.uptime_wraps + (now < diag.uptime_last ? 1 : 0);
+
+    switch (page) {
+    case 0:
+        diag_field(a, 0, "Keys ", calc_ctx.keys, "");
+        diag_field(b, 0, "Bounce rej ", diag.debounce_rejects, "");
+        break;
+    case 1:
+        diag_field(a, 0, "Evals ", diag.evals, "");
+        diag_field(b, 0, "Worst ", diag.eval_cycles_max, " cyc");
+        break;
+    case 2:
+        diag_field(a, 0, "LCD bytes ", diag.lcd_bytes, "");
+        diag_field(b, 0, "Key>LCD ", diag.latency_keys ? diag.latency_us / diag.latency_keys : 0, " us");
+        break;
+    default:
+        diag_field(a, diag_field(a, 0, "Stack ", stack_high_water(), "/"), "", stack_size(), "");
+        diag_field(b, 0, "Up ", (((uint64_t)wraps << 32) + now) / 1000000u, " s");
+        break;
+    }
+    diag_line(line1, a);
+    diag_line(line2, b);
+}
+
+#endif
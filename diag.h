@@ -0,0 +1,110 @@
+// ============= DIAG.H =============
+// Field diagnostics: counters kept by the drivers and the calculator core, shown on
+// a hidden, paged LCD screen. Holding '=' and '.' together (KEY_DIAG, see keypad.h)
+// opens it, every further key shows the next page, and the key after the last page
+// returns to the calculator.
+//
+// Every update is a few loads and stores on the path it measures. Building with
+// CALC_NO_DIAG defined removes the counters, the chord and the screen.
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdint.h>
+#include "sim_local.h"
+
+#define DIAG_PAGES 4
+
+#ifndef CALC_NO_DIAG
+
+typedef struct {
+    uint32_t debounce_rejects; // Presses the scan saw but released or changed before acceptance
+    uint32_t evals;            // Evaluations finished (results and errors)
+    uint32_t eval_cycles;      // CPU cycles of the evaluation in progress
+    uint32_t eval_cycles_max;  // Most cycles one evaluation took (DWT, target only)
+    uint32_t lcd_bytes;        // Commands and characters sent to the controller
+    uint32_t keys_taken;       // Keys taken from the buffer that no frame has shown yet
+    uint32_t keys_taken_at;    // Sum of their acceptance times (mod 2^32, only differences count)
+    uint32_t latency_keys;     // Keys whose effect has reached the LCD
+    uint64_t latency_us;       // Total key-accepted-to-frame-drawn time of those keys
+    uint32_t uptime_last;      // Last uptime_us() seen by diag_uptime_poll()
+    uint32_t uptime_wraps;     // Times uptime_us() wrapped around (every 71.6 minutes)
+} diag_counters;
+
+extern SIM_LOCAL diag_counters diag;
+
+#define DIAG_COUNT(field) (diag.field++)
+#define DIAG_ADD(field, n) (diag.field += (n))
+
+// Cycle counter for the evaluation figures. It reads 0 with the dummy LPC17xx.h:
+// the host simulator does not model instruction time, and the QEMU build has no DWT.
+#if defined(__arm__)
+#include <LPC17xx.h>
+#endif
+#if defined(__arm__) && !defined(LPC17XX_HOST_SIM)
+#define DIAG_HAVE_CYCLES 1
+#define DIAG_CYCLES() (DWT->CYCCNT)
+#else
+#define DIAG_CYCLES() 0u
+#endif
+
+// A key accepted at `accepted_at` was taken from the buffer
+static inline void diag_key_taken(uint32_t accepted_at)
+{
+    diag.keys_taken++;
+    diag.keys_taken_at += accepted_at;
+}
+
+// A frame finished at `now`: it shows every key taken since the previous frame
+static inline void diag_frame_drawn(uint32_t now)
+{
+    diag.latency_us += diag.keys_taken * now - diag.keys_taken_at;
+    diag.latency_keys += diag.keys_taken;
+    diag.keys_taken = 0;
+    diag.keys_taken_at = 0;
+}
+
+// An evaluation finished: fold its cycles into the worst case
+static inline void diag_eval_done(void)
+{
+    diag.evals++;
+    if (diag.eval_cycles > diag.eval_cycles_max) {
+        diag.eval_cycles_max = diag.eval_cycles;
+    }
+    diag.eval_cycles = 0;
+}
+
+// Extends uptime_us() past its wrap; needs a call at least every 71 minutes
+static inline void diag_uptime_poll(uint32_t now)
+{
+    if (now < diag.uptime_last) {
+        diag.uptime_wraps++;
+    }
+    diag.uptime_last = now;
+}
+
+#define DIAG_EVAL_BEGIN() (diag.eval_cycles = 0)
+#define DIAG_EVAL_DONE() diag_eval_done()
+#define DIAG_KEY_TAKEN(accepted_at) diag_key_taken(accepted_at)
+#define DIAG_FRAME_DRAWN(now) diag_frame_drawn(now)
+#define DIAG_UPTIME_POLL(now) diag_uptime_poll(now)
+
+void diag_init(void); // Clears the counters and starts the cycle counter; call at boot
+
+// Text of page `page` (0 .. DIAG_PAGES - 1), LCD_LINE_LEN characters at most per line
+void diag_page_text(int page, char *line1, char *line2);
+
+#else
+
+#define DIAG_COUNT(field) ((void)0)
+#define DIAG_ADD(field, n) ((void)0)
+#define DIAG_CYCLES() 0u
+#define DIAG_EVAL_BEGIN() ((void)0)
+#define DIAG_EVAL_DONE() ((void)0)
+#define DIAG_KEY_TAKEN(accepted_at) ((void)0)
+#define DIAG_FRAME_DRAWN(now) ((void)0)
+#define DIAG_UPTIME_POLL(now) ((void)0)
+#define diag_init() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,90 @@
+// ============= EVAL_BENCH.C =============
+// Measures evaluate_full_expression() in CPU cycles with the DWT cycle counter, to
+// compare code placement: build once normally (everything in flash) and once with
+// -DCALC_RAMFUNC_SRAM (evaluator and soft-float in SRAM, see ramfunc.h), and compare.
+// main() runs it at boot when built with -DEVAL_BENCH.
+// ===================================
+
+#include <LPC17xx.h>
+#include "eval_bench.h"
+#include "clock.h"
+#include "delay.h"
+#include "lcd.h"
+#include "logic.h"
+#include "ramfunc.h"
+#include "fmt.h"
+
+uint32_t eval_bench_cycles = 0;
+uint32_t eval_bench_cycles_max = 0;
+
+// Token counts of the benchmark expressions: a short sum, a typical entry and the
+// longest expression the calculator accepts
+static const int bench_tokens[] = { 3, 11, MAX_TOKENS - 1 };
+#define BENCH_EXPRS (int)(sizeof(bench_tokens) / sizeof(bench_tokens[0]))
+
+// Numbers with fractions, operators cycling through all four precedence cases
+static void bench_build(int tokens)
+{
+    static const char ops[] = "+*-/";
+    int i;
+
+    clear_all_state();
+    for (i = 0; i < tokens; i++) {
+        if (i & 1) {
+            push_operator_to_expr(ops[(i >> 1) & 3]);
+        } else {
+            push_operand_to_expr(1.25f + (float)i * 0.5f);
+        }
+    }
+}
+
+void eval_bench_run(void)
+{
+    uint32_t total = 0;
+    int e, r;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    clock_boost();
+
+    for (e = 0; e < BENCH_EXPRS; e++) {
+        uint32_t start, cycles;
+
+        bench_build(bench_tokens[e]);
+        evaluate_full_expression(); // Warm the flash accelerator's buffers
+        start = DWT->CYCCNT;
+        for (r = 0; r < EVAL_BENCH_RUNS; r++) {
+            evaluate_full_expression();
+        }
+        cycles = (DWT->CYCCNT - start) / EVAL_BENCH_RUNS;
+        total += cycles;
+        if (e == BENCH_EXPRS - 1) {
+            eval_bench_cycles_max = cycles;
+        }
+    }
+
+    clock_release();
+    eval_bench_cycles = total / BENCH_EXPRS;
+    clear_all_state();
+}
+
+void eval_bench_report(void)
+{
+    char line[32]; // Room for any count; cut to the LCD width below
+    int len;
+
+    eval_bench_run();
+    len = fmt_str(line, 0, CALC_RAMFUNC_WHERE " ");
+    len += fmt_u64(line + len, eval_bench_cycles);
+    fmt_str(line, len, " cyc");
+    line[LCD_LINE_LEN] = '\0';
+    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C');
+    lcdstring(line);
+    len = fmt_str(line, 0, "Max ");
+    len += fmt_u64(line + len, eval_bench_cycles_max);
+    fmt_str(line, len, " cyc");
+    line[LCD_LINE_LEN] = '\0';
+    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+    lcdstring(line);
+    delay(2000); // The start-up message replaces it
+}
@@ -0,0 +1,17 @@
+// ============= EVAL_BENCH.H =============
+#ifndef EVAL_BENCH_H
+#define EVAL_BENCH_H
+
+#include <stdint.h>
+
+#define EVAL_BENCH_RUNS 100 // Evaluations per expression
+
+// Cycles per evaluation at full clock, averaged over the benchmark expressions.
+// Results of the last run, for reading from a debugger.
+extern uint32_t eval_bench_cycles;    // All expressions
+extern uint32_t eval_bench_cycles_max; // Longest expression (MAX_TOKENS tokens)
+
+void eval_bench_run(void);    // Needs clock_init(), delay_init() and ramfunc_init() first
+void eval_bench_report(void); // Runs it and shows the figures on the LCD for 2 s
+
+#endif
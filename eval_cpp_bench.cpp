@@ -0,0 +1,133 @@
+// eval_cpp_bench.cpp - Host benchmark of the constexpr evaluator against logic.c
+//
+// Types the eval_bench.c expressions (3, 11 and 49 tokens) into both versions,
+// checks that they build the same tokens and give the same result bit for bit,
+// then times them: evaluation alone on the same tokens (evaluate_full_expression()
+// against calc::evaluate()), and keys to result (calc_ui_key() and the evaluator
+// against calc::run()). Results checked with static_assert in calc_goldens.cpp
+// cost nothing at runtime; this measures the cases that stay at runtime.
+//
+// Build and run commands are in README.md ("Constexpr Evaluator").
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <time.h> // Not <chrono>: its headers include <sched.h>, which -I. finds here
+#include "calc_eval.hpp"
+
+extern "C" {
+#include "logic.h"
+}
+
+static const int bench_tokens[] = { 3, 11, MAX_TOKENS - 1 };
+static const int runs = 200000;
+
+// Makes the compiler assume `p` was read and changed, so a call with the same
+// arguments cannot be hoisted out of the timing loop
+static void clobber(const void* p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+// Same expressions as eval_bench.c: 1.25, 2.25, ... with the operators cycling
+// through "+*-/"
+static std::string bench_keys(int tokens)
+{
+    static const char ops[] = "+*-/";
+    std::string keys;
+    char number[16];
+
+    for (int i = 0; i < tokens; i++) {
+        if (i & 1) {
+            keys += ops[(i >> 1) & 3];
+        } else {
+            std::snprintf(number, sizeof(number), "%g", 1.25 + i * 0.5);
+            keys += number;
+        }
+    }
+    return keys + "=";
+}
+
+// calc_ui_key() up to '=', leaving the evaluation begun
+static void c_type(const std::string& keys)
+{
+    calc_ui_begin();
+    for (char c : keys) {
+        unsigned char key = (c >= '0' && c <= '9') ? (unsigned char)(c - '0') :
+                            c == '+' ? KEY_PLUS : c == '-' ? KEY_MINUS :
+                            c == '*' ? KEY_MULTIPLY : c == '/' ? KEY_DIVIDE :
+                            c == '.' ? KEY_DECIMAL : KEY_EQUALS;
+        calc_ui_key(key);
+    }
+}
+
+static float c_finish()
+{
+    while (!evaluate_step(2 * MAX_TOKENS)) {
+    }
+    calc_ctx.eval_pending = false;
+    return calc_ctx.eval.result;
+}
+
+template <typename F>
+static double ns_per_run(F f)
+{
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < runs; r++) {
+        f();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / runs;
+}
+
+int main()
+{
+    int failures = 0;
+
+    std::printf("%-6s %12s %12s %7s %12s %12s %7s\n", "tokens",
+                "C eval ns", "C++ eval ns", "ratio", "C keys ns", "C++ keys ns", "ratio");
+    for (int tokens : bench_tokens) {
+        std::string keys = bench_keys(tokens);
+        calc::Expr x = calc::tokenize(keys.c_str());
+        calc::Result cpp = calc::evaluate(x);
+
+        c_type(keys);
+        float c = c_finish();
+        bool same_tokens = expr_len == x.len &&
+                           std::memcmp(expr_type, x.type, x.len) == 0 &&
+                           std::memcmp(expr_data, x.data, x.len * sizeof(float)) == 0;
+        if (!same_tokens || calculator_error || !cpp.ok() || std::memcmp(&c, &cpp.value, sizeof(c)) != 0) {
+            std::printf("%d tokens: C %.9g, C++ %.9g, tokens %s\n", tokens, c, cpp.value,
+                        same_tokens ? "same" : "differ");
+            failures++;
+            continue;
+        }
+
+        // expr_type/expr_data still hold the tokens typed above
+        double c_eval = ns_per_run([] {
+            float v = evaluate_full_expression();
+            clobber(&v);
+        });
+        double cpp_eval = ns_per_run([&x] {
+            clobber(&x);
+            calc::Result r = calc::evaluate(x);
+            clobber(&r);
+        });
+        double c_keys = ns_per_run([&keys] {
+            c_type(keys);
+            float v = c_finish();
+            clobber(&v);
+        });
+        const char* text = keys.c_str();
+        double cpp_keys = ns_per_run([text] {
+            clobber(text);
+            calc::Result r = calc::run(text);
+            clobber(&r);
+        });
+        std::printf("%-6d %12.1f %12.1f %6.2fx %12.1f %12.1f %6.2fx\n", tokens,
+                    c_eval, cpp_eval, c_eval / cpp_eval, c_keys, cpp_keys, c_keys / cpp_keys);
+    }
+    return failures ? 1 : 0;
+}
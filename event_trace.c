@@ -0,0 +1,103 @@
+// ============= EVENT_TRACE.C =============
+// Event trace backends, see event_trace.h: ITM stimulus port on the target, a
+// file on the host
+// ===================================
+
+#include "event_trace.h"
+#include "delay.h"
+
+#if defined(__arm__)
+#include <LPC17xx.h>
+#endif
+
+uint32_t event_trace_error_arg(const char *message)
+{
+    uint32_t arg = 0;
+    int i;
+
+    if (message[0] == 'E' && message[1] == 'r' && message[2] == 'r' && message[3] == ':' && message[4] == ' ') {
+        message += 5;
+    }
+    for (i = 0; i < 3 && message[i]; i++) {
+        arg |= (uint32_t)(unsigned char)message[i] << (8 * i);
+    }
+    return arg;
+}
+
+#if defined(__arm__) && !defined(LPC17XX_HOST_SIM)
+
+// Nothing to open: the debugger enables the port and the SWO output
+int event_trace_open(const char *path)
+{
+    (void)path;
+    event_trace_emit(EVT_START, EVENT_TRACE_VERSION);
+    return 0;
+}
+
+void event_trace_close(void)
+{
+}
+
+static void itm_word(uint32_t word)
+{
+    while (ITM->PORT[EVENT_TRACE_ITM_PORT].u32 == 0) {
+        // Stimulus FIFO full; SWO drains it within a few microseconds
+    }
+    ITM->PORT[EVENT_TRACE_ITM_PORT].u32 = word;
+}
+
+void event_trace_emit(event_trace_type type, uint32_t arg)
+{
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & (1UL << EVENT_TRACE_ITM_PORT)) == 0) {
+        return; // No debugger listening
+    }
+    itm_word(uptime_us());
+    itm_word(EVENT_TRACE_WORD1(type, arg));
+}
+
+#else
+
+#include <stdio.h>
+
+static FILE *trace_file = NULL;
+
+int event_trace_open(const char *path)
+{
+    event_trace_close();
+    trace_file = fopen(path, "wb");
+    if (trace_file == NULL) {
+        return -1;
+    }
+    event_trace_emit(EVT_START, EVENT_TRACE_VERSION);
+    return 0;
+}
+
+void event_trace_close(void)
+{
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+}
+
+static void put_word(unsigned char *out, uint32_t word)
+{
+    out[0] = (unsigned char)word;
+    out[1] = (unsigned char)(word >> 8);
+    out[2] = (unsigned char)(word >> 16);
+    out[3] = (unsigned char)(word >> 24);
+}
+
+void event_trace_emit(event_trace_type type, uint32_t arg)
+{
+    unsigned char record[8];
+
+    if (trace_file == NULL) {
+        return;
+    }
+    put_word(record, uptime_us());
+    put_word(record + 4, EVENT_TRACE_WORD1(type, arg));
+    fwrite(record, sizeof(record), 1, trace_file);
+}
+
+#endif
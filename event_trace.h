@@ -0,0 +1,52 @@
+// ============= EVENT_TRACE.H =============
+// Binary event trace. A build with EVENT_TRACE defined (and event_trace.c added)
+// records key, evaluation, LCD and error events as 8-byte records:
+//
+//     word 0: uptime_us() when the event happened
+//     word 1: type in bits 0-7, argument in bits 8-31
+//
+// both little-endian. On the target the words go to ITM stimulus port
+// EVENT_TRACE_ITM_PORT and leave over SWO; when no debugger has enabled the port,
+// an event costs two register reads. Host builds write the same records to the
+// file given to event_trace_open(). trace_decode.c turns either into Chrome
+// trace-event JSON (chrome://tracing, ui.perfetto.dev).
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stdint.h>
+
+#define EVENT_TRACE_ITM_PORT 1 // Port 0 is left for text output
+#define EVENT_TRACE_VERSION 1  // Argument of EVT_START
+
+typedef enum {
+    EVT_START = 0x5A,  // First record of a trace; argument is EVENT_TRACE_VERSION
+    EVT_KEY = 1,       // Key accepted by the keypad driver; argument is the key code
+    EVT_EVAL_BEGIN,    // Evaluation started; argument is the number of tokens
+    EVT_EVAL_END,      // Evaluation finished or cancelled; argument is the operations run
+    EVT_LCD_BEGIN,     // calc_render() started a frame; argument is the view
+    EVT_LCD_END,       // Frame handed to the LCD
+    EVT_ERROR          // Error raised; argument is the first three letters after "Err: "
+} event_trace_type;
+
+// Record layout shared by the target, the host backend and the decoder
+#define EVENT_TRACE_WORD1(type, arg) ((uint32_t)(type) | ((uint32_t)(arg) << 8))
+
+// Call sites use TRACE_EVENT(), which compiles to nothing (arguments included)
+// unless EVENT_TRACE is defined
+void event_trace_emit(event_trace_type type, uint32_t arg);
+#ifdef EVENT_TRACE
+#define TRACE_EVENT(type, arg) event_trace_emit((type), (arg))
+#else
+#define TRACE_EVENT(type, arg) ((void)0)
+#endif
+
+// Packs the first three characters of an error message after "Err: " into an argument
+uint32_t event_trace_error_arg(const char *message);
+
+// Starts a trace with an EVT_START record. On the host, records go to `path`
+// (closed by event_trace_close()); the target ignores it and writes to the ITM.
+// Returns 0, or -1 if the file cannot be created.
+int event_trace_open(const char *path);
+void event_trace_close(void);
+
+#endif
@@ -0,0 +1,334 @@
+// fleet_sim.c - Soak test of the whole firmware on thousands of simulated calculators
+//
+// Every instance is a complete calculator on the board simulator: boot_fast(), the
+// task scheduler, the keypad and LCD drivers, the HD44780 and keypad models and a
+// virtual clock of its own. Instance i replays trace i % (number of traces) of the
+// corpus with its timing varied from a per-instance seed: the gaps between
+// presses and the hold times move by up to a quarter, within human limits. The
+// firmware is built with -DSIM_THREAD_LOCAL (sim_local.h), so each worker thread of
+// the pool runs its instances one after the other on its own copy of the state.
+//
+// Before each press (from the second on) and at the end, both LCD lines are
+// compared with an undisturbed replay of the same trace. An instance whose display
+// differs is a divergence; the first few are printed with their seed so they can
+// be replayed with -n/-s. The report also gives the results shown as errors, the
+// simulator's fault counters (HD44780 bus timing, timer rate, flash wait states),
+// keys the firmware did not take, the key-to-frame latency distribution
+// (diag.h) and the throughput in simulated keys per second of wall time.
+//
+// Build and run commands are in README.md ("Fleet Simulation").
+
+#define _POSIX_C_SOURCE 200809L // pthreads and clock_gettime() under -std=c99
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "board_sim.h"
+#include "boot.h"
+#include "diag.h"
+#include "key_trace.h"
+#include "logic.h"
+#include "sched.h"
+#include "tasks.h"
+
+#define SETTLE_MS 2000       // Runs on after the last key so the final result is drawn
+#define MAX_TRACES 64
+#define MAX_THREADS 64
+#define MIN_HOLD_MS 45       // Keeps every press longer than the debounce (5 scans when fixed)
+#define MIN_RELEASE_MS 80    // Shortest time between a release and the next press
+#define LATENCY_BUCKET_US 10
+#define LATENCY_BUCKETS 10000 // Up to 100 ms; the last bucket takes everything above
+#define DIVERGENCES_SHOWN 5
+
+typedef char lcd_lines[2][17];
+
+// One trace of the corpus and what the undisturbed replay showed
+typedef struct {
+    const char *path;
+    key_trace trace;
+    lcd_lines *expected; // Before events 1 .. count - 1, then at the end
+} corpus_entry;
+
+static corpus_entry corpus[MAX_TRACES];
+static int corpus_size;
+static unsigned long instances = 1000;
+static uint64_t base_seed = 1;
+
+static unsigned long next_instance; // Taken by the workers with __atomic_fetch_add()
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static int divergences_shown;
+
+typedef struct {
+    unsigned long instances;
+    unsigned long divergent;
+    unsigned long keys;          // Keys pressed
+    unsigned long keys_lost;     // Pressed but never taken by the firmware
+    unsigned long results;       // '=' pressed
+    unsigned long errors;        // Error messages shown
+    unsigned long timing_violations, timer_rate_errors, flash_wait_errors;
+    unsigned long long sim_us;   // Virtual time simulated
+    unsigned long latency[LATENCY_BUCKETS];
+    unsigned long latency_samples;
+    uint32_t latency_max_us;
+} fleet_stats;
+
+// State of one instance's replay, passed to the observer
+typedef struct {
+    const corpus_entry *entry;
+    const key_trace *trace;      // The varied trace being replayed
+    lcd_lines *record;           // Reference run: where to store the display
+    fleet_stats *stats;
+    int first_diff;              // First snapshot that differed, -1 if none
+    lcd_lines now, got;
+    uint32_t latency_keys, latency_us_low; // diag figures at the previous snapshot
+    uint64_t latency_us;
+} replay_state;
+
+static uint64_t xorshift(uint64_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 7;
+    *s ^= *s << 17;
+    return *s;
+}
+
+// Uniform in [-range, range]
+static int32_t jitter(uint64_t *s, uint32_t range)
+{
+    return range ? (int32_t)(xorshift(s) % (2 * range + 1)) - (int32_t)range : 0;
+}
+
+// Copy of `in` with gaps and holds moved by up to 25%, keys kept distinct
+static void vary_trace(const key_trace *in, key_trace *out, uint64_t seed)
+{
+    uint64_t s = seed * 0x9E3779B97F4A7C15ULL + 1;
+    int i;
+
+    out->count = in->count;
+    for (i = 0; i < in->count; i++) {
+        const key_trace_event *ev = &in->events[i];
+        int32_t hold = ev->hold_ms + jitter(&s, ev->hold_ms / 4);
+        out->events[i] = *ev;
+        out->events[i].hold_ms = (uint16_t)(hold < MIN_HOLD_MS ? MIN_HOLD_MS : hold);
+        if (i == 0) {
+            out->events[i].at_ms = ev->at_ms + jitter(&s, ev->at_ms / 4);
+        } else {
+            uint32_t gap = ev->at_ms - in->events[i - 1].at_ms;
+            int32_t varied = (int32_t)gap + jitter(&s, gap / 4);
+            int32_t shortest = out->events[i - 1].hold_ms + MIN_RELEASE_MS;
+            out->events[i].at_ms = out->events[i - 1].at_ms + (uint32_t)(varied < shortest ? shortest : varied);
+        }
+    }
+}
+
+static void record_latency(replay_state *st)
+{
+    uint32_t keys = diag.latency_keys - st->latency_keys;
+    uint64_t us = diag.latency_us - st->latency_us;
+    fleet_stats *stats = st->stats;
+
+    st->latency_keys = diag.latency_keys;
+    st->latency_us = diag.latency_us;
+    if (keys == 0 || !stats) return;
+    us /= keys;
+    stats->latency[us / LATENCY_BUCKET_US < LATENCY_BUCKETS ? us / LATENCY_BUCKET_US : LATENCY_BUCKETS - 1] += keys;
+    stats->latency_samples += keys;
+    if (us > stats->latency_max_us) stats->latency_max_us = (uint32_t)us;
+}
+
+// Snapshot `snap` of the display: stored for the reference, compared otherwise
+static void snapshot(replay_state *st, int snap)
+{
+    bool was_error = strncmp(st->now[0], "Err", 3) == 0;
+
+    board_sim_lcd_visible(0, st->now[0]);
+    board_sim_lcd_visible(1, st->now[1]);
+    record_latency(st);
+    if (st->stats && !was_error && strncmp(st->now[0], "Err", 3) == 0) st->stats->errors++;
+    if (st->record) {
+        memcpy(st->record[snap], st->now, sizeof(st->now));
+    } else if (st->first_diff < 0 && memcmp(st->entry->expected[snap], st->now, sizeof(st->now)) != 0) {
+        st->first_diff = snap;
+        memcpy(st->got, st->now, sizeof(st->now));
+    }
+}
+
+static void observe(int i, void *arg)
+{
+    replay_state *st = arg;
+
+    if (i == 0) return; // The splash may or may not have timed out
+    snapshot(st, i - 1);
+    if (st->stats && st->trace->events[i - 1].key == KEY_EQUALS) st->stats->results++;
+}
+
+// Boots a fresh calculator on this thread and replays `trace` on it
+static void run_instance(replay_state *st)
+{
+    uint32_t end;
+
+    // A power-on reset also reloads .data; the drivers' state is reset by boot_fast()
+    // or left idle by the previous replay, which ends with every key released
+    calc_ctx = (calc_context){ .view = VIEW_SPLASH };
+    board_sim_reset();
+    boot_fast();
+    tasks_start();
+    st->first_diff = -1;
+    st->now[0][0] = '\0';
+    st->latency_keys = diag.latency_keys;
+    st->latency_us = diag.latency_us;
+    end = key_trace_replay_observed(st->trace, observe, st);
+    sched_run_until(end + SETTLE_MS * 1000UL);
+    snapshot(st, st->trace->count - 1);
+}
+
+static void report_divergence(unsigned long n, const replay_state *st)
+{
+    const lcd_lines *want = &st->entry->expected[st->first_diff];
+
+    pthread_mutex_lock(&report_lock);
+    if (divergences_shown++ < DIVERGENCES_SHOWN) {
+        printf("divergence: instance %lu, %s key %d (replay with -n 1 -s %llu %s)\n"
+               "  expected \"%s\" / \"%s\"\n  got      \"%s\" / \"%s\"\n",
+               n, st->first_diff + 1 < st->trace->count ? "before" : "after the last",
+               st->first_diff + 2, (unsigned long long)(base_seed + n), st->entry->path, (*want)[0], (*want)[1], st->got[0], st->got[1]);
+    }
+    pthread_mutex_unlock(&report_lock);
+}
+
+static void *worker(void *arg)
+{
+    fleet_stats *stats = arg;
+    static _Thread_local key_trace varied; // 4 KB, kept off the worker's stack
+
+    for (;;) {
+        unsigned long n = __atomic_fetch_add(&next_instance, 1, __ATOMIC_RELAXED);
+        replay_state st = { 0 };
+
+        if (n >= instances) break;
+        st.entry = &corpus[n % corpus_size];
+        vary_trace(&st.entry->trace, &varied, base_seed + n);
+        st.trace = &varied;
+        st.stats = stats;
+        run_instance(&st);
+
+        stats->instances++;
+        stats->keys += varied.count;
+        stats->keys_lost += (unsigned long)varied.count - calc_ctx.keys;
+        stats->timing_violations += sim_lcd_timing_violations;
+        stats->timer_rate_errors += sim_timer_rate_errors;
+        stats->flash_wait_errors += sim_flash_wait_errors;
+        stats->sim_us += sim_time_ns / 1000;
+        if (st.first_diff >= 0) {
+            stats->divergent++;
+            report_divergence(n, &st);
+        }
+    }
+    return NULL;
+}
+
+static uint32_t percentile(const fleet_stats *s, double p)
+{
+    unsigned long want = (unsigned long)(s->latency_samples * p), seen = 0;
+    int b;
+
+    if (s->latency_samples == 0) return 0;
+    for (b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += s->latency[b];
+        if (seen > want) break;
+    }
+    return (uint32_t)(b + 1) * LATENCY_BUCKET_US; // Upper edge of the bucket
+}
+
+static double wall_s(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    static fleet_stats per_thread[MAX_THREADS]; // 80 KB each
+    pthread_t threads[MAX_THREADS];
+    fleet_stats total = { 0 };
+    int threads_n = 4, i, b;
+    double started, took;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            instances = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads_n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            base_seed = strtoull(argv[++i], NULL, 0);
+        } else if (argv[i][0] == '-' || corpus_size == MAX_TRACES) {
+            fprintf(stderr, "usage: %s [-n instances] [-j threads] [-s seed] trace...\n", argv[0]);
+            return 1;
+        } else {
+            corpus[corpus_size++].path = argv[i];
+        }
+    }
+    if (corpus_size == 0) corpus[corpus_size++].path = "traces/basic.trace";
+    if (threads_n < 1 || threads_n > MAX_THREADS) threads_n = 4;
+
+    // Reference runs, undisturbed, on the main thread's own calculator
+    for (i = 0; i < corpus_size; i++) {
+        corpus_entry *e = &corpus[i];
+        replay_state st = { 0 };
+
+        if (key_trace_load(e->path, &e->trace) <= 0) return 1;
+        e->expected = calloc((size_t)e->trace.count, sizeof(lcd_lines));
+        if (!e->expected) return 1;
+        st.entry = e;
+        st.trace = &e->trace;
+        st.record = e->expected;
+        run_instance(&st);
+    }
+
+    printf("%lu instances of %d trace%s on %d threads\n", instances, corpus_size,
+           corpus_size == 1 ? "" : "s", threads_n);
+    started = wall_s();
+    for (i = 0; i < threads_n; i++) {
+        if (pthread_create(&threads[i], NULL, worker, &per_thread[i]) != 0) {
+            fprintf(stderr, "cannot start thread %d\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < threads_n; i++) {
+        fleet_stats *s = &per_thread[i];
+        pthread_join(threads[i], NULL);
+        total.instances += s->instances;
+        total.divergent += s->divergent;
+        total.keys += s->keys;
+        total.keys_lost += s->keys_lost;
+        total.results += s->results;
+        total.errors += s->errors;
+        total.timing_violations += s->timing_violations;
+        total.timer_rate_errors += s->timer_rate_errors;
+        total.flash_wait_errors += s->flash_wait_errors;
+        total.sim_us += s->sim_us;
+        for (b = 0; b < LATENCY_BUCKETS; b++) total.latency[b] += s->latency[b];
+        total.latency_samples += s->latency_samples;
+        if (s->latency_max_us > total.latency_max_us) total.latency_max_us = s->latency_max_us;
+    }
+    took = wall_s() - started;
+
+    printf("divergent instances     %lu of %lu\n", total.divergent, total.instances);
+    printf("results                 %lu, %lu error messages shown\n", total.results, total.errors);
+    printf("keys pressed            %lu, %lu not taken\n", total.keys, total.keys_lost);
+    printf("simulator faults        %lu LCD timing, %lu timer rate, %lu flash wait\n",
+           total.timing_violations, total.timer_rate_errors, total.flash_wait_errors);
+    printf("key to frame latency    p50 <%lu us, p90 <%lu us, p99 <%lu us, max %lu us (%lu keys)\n",
+           (unsigned long)percentile(&total, 0.50), (unsigned long)percentile(&total, 0.90),
+           (unsigned long)percentile(&total, 0.99), (unsigned long)total.latency_max_us,
+           total.latency_samples);
+    printf("throughput              %.0f keys/s, %.0f instances/s, %.0fx real time (%.2f s)\n",
+           total.keys / took, total.instances / took, total.sim_us / 1e6 / took, took);
+
+    return (total.divergent || total.keys_lost || total.timing_violations ||
+            total.timer_rate_errors || total.flash_wait_errors) ? 1 : 0;
+}
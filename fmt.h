@@ -0,0 +1,41 @@
+// ============= FMT.H =============
+// Integer to text without the C library's printf family, which links newlib's
+// float formatting and can allocate from the heap (see heap_guard.h).
+#ifndef FMT_H
+#define FMT_H
+
+#include <stdint.h>
+
+// Writes the decimal digits of `value` and a terminator; returns the digit count
+static inline int fmt_u64(char *buf, uint64_t value)
+{
+    char tmp[20];
+    int n = 0, len;
+
+    while (value > UINT32_MAX) { // 64-bit division is a library call on the Cortex-M3
+        tmp[n++] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    uint32_t v32 = (uint32_t)value;
+    do {
+        tmp[n++] = (char)('0' + v32 % 10);
+        v32 /= 10;
+    } while (v32 != 0);
+    for (len = 0; len < n; len++) {
+        buf[len] = tmp[n - 1 - len];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+// Appends `str` at buf[len] and returns the new length
+static inline int fmt_str(char *buf, int len, const char *str)
+{
+    while (*str) {
+        buf[len++] = *str++;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+#endif
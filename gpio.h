@@ -0,0 +1,52 @@
+// ============= GPIO.H =============
+// Port-group abstraction for the LPC1768 fast GPIO block.
+// A group is a set of pins on one port that a driver owns exclusively. The port's
+// FIOMASK is programmed once so that a plain FIOPIN store only affects the group's
+// pins, which lets a driver put a whole pattern (data nibble + control lines, or a
+// keypad row pattern) on the pins with a single store instead of a SET/CLR pair.
+// Because FIOMASK is per port, at most one group may be claimed per port.
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <LPC17xx.h>
+#include <stdint.h>
+
+#ifdef LPC17XX_HOST_SIM
+// Host build: every register store goes through the board simulator, which applies
+// the LPC1768 semantics and counts the stores.
+void sim_gpio_store(volatile uint32_t *reg, uint32_t value);
+#define GPIO_STORE(reg, value) sim_gpio_store(&(reg), (value))
+#define GPIO_PORT(g) SIM_GPIO((g)->port) // The calling thread's port (LPC17xx.h)
+#else
+#define GPIO_STORE(reg, value) ((reg) = (value))
+#define GPIO_PORT(g) ((g)->port)
+#endif
+
+typedef struct {
+    LPC_GPIO_TypeDef *port; // Fast GPIO port the pins belong to
+    uint32_t mask;          // Pins owned by this group
+} gpio_group;
+
+// Claims the group's port: sets the direction of the group's pins (1 = output)
+// and masks off every pin outside the group for FIOPIN accesses
+static inline void gpio_group_init(const gpio_group *g, uint32_t outputs)
+{
+    LPC_GPIO_TypeDef *port = GPIO_PORT(g);
+
+    GPIO_STORE(port->FIODIR, (port->FIODIR & ~g->mask) | (outputs & g->mask));
+    GPIO_STORE(port->FIOMASK, ~g->mask);
+}
+
+// Drives all output pins of the group to the given pattern in one store
+static inline void gpio_group_write(const gpio_group *g, uint32_t pattern)
+{
+    GPIO_STORE(GPIO_PORT(g)->FIOPIN, pattern);
+}
+
+// Reads the current level of the group's pins (pins outside the group read as 0)
+static inline uint32_t gpio_group_read(const gpio_group *g)
+{
+    return GPIO_PORT(g)->FIOPIN & g->mask;
+}
+
+#endif
@@ -0,0 +1,136 @@
+// ============= HEAP_GUARD.C =============
+// Allocation tracer, see heap_guard.h. Linked only into tracing builds, together
+// with HEAP_TRACE_LDFLAGS; the linker then routes every reference to an allocator
+// symbol to the __wrap_ functions below, which record it and call the original
+// (__real_) definition.
+// ===================================
+
+#include <string.h>
+#include "heap_guard.h"
+
+struct _reent;
+
+heap_trace_site heap_trace[HEAP_TRACE_SITES];
+uint32_t heap_trace_sites = 0;
+uint32_t heap_trace_calls = 0;
+uint32_t heap_trace_sbrk = 0;
+
+void heap_trace_reset(void)
+{
+    memset(heap_trace, 0, sizeof(heap_trace));
+    heap_trace_sites = 0;
+    heap_trace_calls = 0;
+    heap_trace_sbrk = 0;
+}
+
+static void heap_record(uintptr_t site, size_t bytes)
+{
+    uint32_t i;
+
+    heap_trace_calls++;
+    for (i = 0; i < heap_trace_sites; i++) {
+        if (heap_trace[i].site == site) {
+            break;
+        }
+    }
+    if (i == heap_trace_sites) {
+        if (heap_trace_sites == HEAP_TRACE_SITES) {
+            return;
+        }
+        heap_trace[heap_trace_sites++].site = site;
+    }
+    heap_trace[i].calls++;
+    heap_trace[i].bytes += (uint32_t)bytes;
+    if (bytes > heap_trace[i].largest) {
+        heap_trace[i].largest = (uint32_t)bytes;
+    }
+}
+
+#define CALLER ((uintptr_t)__builtin_return_address(0))
+
+// The public functions call the _r variants, which are wrapped too; only the
+// outermost call is recorded, so each allocation is counted once at its real site
+static int heap_depth = 0;
+
+#define TRACED(bytes, call) do {                  \
+        if (heap_depth++ == 0) {                  \
+            heap_record(CALLER, (bytes));         \
+        }                                         \
+        call;                                     \
+        heap_depth--;                             \
+    } while (0)
+
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real__malloc_r(struct _reent *r, size_t size);
+void __real__free_r(struct _reent *r, void *ptr);
+void *__real__calloc_r(struct _reent *r, size_t count, size_t size);
+void *__real__realloc_r(struct _reent *r, void *ptr, size_t size);
+void *__real__sbrk(ptrdiff_t increment);
+
+void *__wrap_malloc(size_t size)
+{
+    void *p;
+    TRACED(size, p = __real_malloc(size));
+    return p;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *p;
+    TRACED(count * size, p = __real_calloc(count, size));
+    return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    void *p;
+    TRACED(size, p = __real_realloc(ptr, size));
+    return p;
+}
+
+void *__wrap__malloc_r(struct _reent *r, size_t size)
+{
+    void *p;
+    TRACED(size, p = __real__malloc_r(r, size));
+    return p;
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t count, size_t size)
+{
+    void *p;
+    TRACED(count * size, p = __real__calloc_r(r, count, size));
+    return p;
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size)
+{
+    void *p;
+    TRACED(size, p = __real__realloc_r(r, ptr, size));
+    return p;
+}
+
+// Frees are not recorded, but still pass through so the depth stays right
+void __wrap_free(void *ptr)
+{
+    heap_depth++;
+    __real_free(ptr);
+    heap_depth--;
+}
+
+void __wrap__free_r(struct _reent *r, void *ptr)
+{
+    heap_depth++;
+    __real__free_r(r, ptr);
+    heap_depth--;
+}
+
+void *__wrap__sbrk(ptrdiff_t increment)
+{
+    if (increment > 0) {
+        heap_trace_sbrk += (uint32_t)increment;
+    }
+    return __real__sbrk(increment);
+}
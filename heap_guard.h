@@ -0,0 +1,37 @@
+// ============= HEAP_GUARD.H =============
+// Heap use on the target (newlib). The firmware is meant to run without a heap;
+// two link modes check that, both with the flags
+//
+//     -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc,--wrap=_malloc_r,
+//         --wrap=_free_r,--wrap=_calloc_r,--wrap=_realloc_r,--wrap=_sbrk
+//
+// - Tracing: link heap_guard.c as well. Every allocation made through malloc and
+//   friends, or the _r variants the C library uses internally, is recorded with
+//   its call site, and so is every _sbrk().
+// - Forbidding: link without heap_guard.c. The allocator symbols are redirected to
+//   wrappers that do not exist, so the link fails, naming each object that still
+//   refers to one. qemu/run_qemu.sh links the calculator code this way (not run
+//   yet, see there).
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HEAP_TRACE_SITES 16
+
+typedef struct {
+    uintptr_t site;    // Return address in the caller of the allocator
+    uint32_t calls;
+    uint32_t bytes;    // Total requested
+    uint32_t largest;  // Largest single request
+} heap_trace_site;
+
+extern heap_trace_site heap_trace[HEAP_TRACE_SITES]; // First HEAP_TRACE_SITES distinct sites
+extern uint32_t heap_trace_sites;   // Entries used in heap_trace
+extern uint32_t heap_trace_calls;   // All allocations, including sites that did not fit
+extern uint32_t heap_trace_sbrk;    // Bytes obtained from _sbrk()
+
+void heap_trace_reset(void);        // Clears the counters (not the heap)
+
+#endif
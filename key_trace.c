@@ -0,0 +1,92 @@
+// ============= KEY_TRACE.C =============
+// Loads and replays recorded key traces on the board simulator (host only)
+#include <stdio.h>
+#include <string.h>
+#include "key_trace.h"
+#include "board_sim.h"
+#include "keymap.h"
+#include "logic.h"
+#include "sched.h"
+#include "delay.h"
+
+
+static const char trace_keys[] = "0123456789+-*/=."; // Indexed by KEY_* code
+
+static int key_from_char(char c) {
+    const char *p = (c != '\0') ? strchr(trace_keys, c) : NULL;
+    return p ? (int)(p - trace_keys) : -1;
+}
+
+int key_trace_load(const char *path, key_trace *trace) {
+    FILE *f = fopen(path, "r");
+    char line[128];
+    int line_no = 0;
+
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+    trace->count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long at_ms, hold_ms = KEY_TRACE_HOLD_MS;
+        char key_char;
+        char *hash = strchr(line, '#');
+        int fields, key;
+
+        line_no++;
+        if (hash) *hash = '\0';
+        fields = sscanf(line, "%lu %c %lu", &at_ms, &key_char, &hold_ms);
+        if (fields <= 0) continue; // Blank or comment-only line
+        key = (fields >= 2) ? key_from_char(key_char) : -1;
+        if (key < 0 || hold_ms == 0 || hold_ms > 0xFFFF) {
+            fprintf(stderr, "%s:%d: expected '<at_ms> <key> [hold_ms]'\n", path, line_no);
+            fclose(f);
+            return -1;
+        }
+        if (trace->count == KEY_TRACE_MAX) {
+            fprintf(stderr, "%s:%d: more than %d keys\n", path, line_no, KEY_TRACE_MAX);
+            fclose(f);
+            return -1;
+        }
+        trace->events[trace->count].at_ms = (uint32_t)at_ms;
+        trace->events[trace->count].key = (unsigned char)key;
+        trace->events[trace->count].hold_ms = (uint16_t)hold_ms;
+        trace->count++;
+    }
+    fclose(f);
+    return trace->count;
+}
+
+static void press_key_code(unsigned char key) {
+    unsigned char row, col;
+    for (row = 0; row < 4; row++) {
+        for (col = 0; col < 4; col++) {
+            if ((unsigned char)keyCodes[row][col] == key) {
+                board_sim_press_key(row, col);
+                return;
+            }
+        }
+    }
+}
+
+uint32_t key_trace_replay(const key_trace *trace) {
+    return key_trace_replay_observed(trace, NULL, NULL);
+}
+
+uint32_t key_trace_replay_observed(const key_trace *trace, key_trace_observer observe, void *arg) {
+    uint32_t start = uptime_us();
+    int i;
+
+    for (i = 0; i < trace->count; i++) {
+        const key_trace_event *ev = &trace->events[i];
+        uint32_t press_at = start + ev->at_ms * 1000UL;
+
+        // Keys closer together than the previous hold are pressed as soon as it ends
+        if ((int32_t)(press_at - uptime_us()) > 0) sched_run_until(press_at);
+        if (observe) observe(i, arg);
+        press_key_code(ev->key);
+        sched_run_until(uptime_us() + ev->hold_ms * 1000UL);
+        board_sim_release_keys();
+    }
+    return uptime_us();
+}
@@ -0,0 +1,40 @@
+// ============= KEY_TRACE.H =============
+// Recorded keypad sessions for the host tools. A trace is a text file with one key
+// per line:
+//
+//     <at_ms> <key> [hold_ms]   # comment
+//
+// at_ms is the press time from the start of the replay, key is one of 0-9 + - * / = .
+// and hold_ms defaults to KEY_TRACE_HOLD_MS. Blank lines and '#' comments are skipped.
+#ifndef KEY_TRACE_H
+#define KEY_TRACE_H
+
+#include <stdint.h>
+
+#define KEY_TRACE_MAX 512
+#define KEY_TRACE_HOLD_MS 60
+
+typedef struct {
+    uint32_t at_ms;
+    unsigned char key;     // KEY_* code from logic.h
+    uint16_t hold_ms;
+} key_trace_event;
+
+typedef struct {
+    key_trace_event events[KEY_TRACE_MAX];
+    int count;
+} key_trace;
+
+// Returns the number of events, or -1 (with a message on stderr) if the file cannot
+// be read or a line does not parse
+int key_trace_load(const char *path, key_trace *trace);
+
+// Presses every key on the simulated keypad at its time and runs the scheduler in
+// between. Call after boot_fast() and tasks_start(). Returns the uptime at the end.
+uint32_t key_trace_replay(const key_trace *trace);
+
+// Same, calling observe(i, arg) just before event i is pressed
+typedef void (*key_trace_observer)(int i, void *arg);
+uint32_t key_trace_replay_observed(const key_trace *trace, key_trace_observer observe, void *arg);
+
+#endif
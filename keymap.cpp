@@ -0,0 +1,132 @@
+// ============= KEYMAP.CPP =============
+// The keypad's layers, compiled into the flat tables of keymap.h. Declare keys
+// here: every grid is indexed [row][column] like the matrix.
+// ===================================
+
+#include "keymap.h"
+#include "logic.h"
+
+namespace {
+
+constexpr unsigned char same = 0xFE; // Shift layer: as in the base layer
+constexpr unsigned char none = KEY_NONE;
+
+// Legends
+constexpr unsigned char base[4][4] = {
+    { KEY_1, KEY_2, KEY_3, KEY_4 },
+    { KEY_5, KEY_6, KEY_7, KEY_8 },
+    { KEY_9, KEY_0, KEY_PLUS, KEY_MINUS },
+    { KEY_MULTIPLY, KEY_DIVIDE, KEY_EQUALS, KEY_DECIMAL },
+};
+
+// The key after KEY_SHIFT
+constexpr unsigned char shift[4][4] = {
+    { same, same, same, same },
+    { same, same, same, same },
+    { same, same, same, same },
+    { same, KEY_CLEAR, KEY_ANS, KEY_BACKSPACE },
+};
+
+// Held for KEY_LONG_MS. These keys send their press action on release.
+constexpr unsigned char long_press[4][4] = {
+    { none, none, none, none },
+    { none, none, none, none },
+    { none, none, none, none },
+    { none, KEY_CLEAR, none, KEY_BACKSPACE },
+};
+
+// Keys held together in one row (a row is read at a time), in every press layer.
+// Their keys send their own actions KEY_CHORD_MS late, or on release.
+struct Chord {
+    unsigned row;
+    unsigned cols; // Bit per column
+    unsigned char action;
+};
+
+constexpr Chord chords[] = {
+#ifndef CALC_NO_DIAG
+    { KEY_DIAG_ROW, (1u << KEY_DIAG_COL_A) | (1u << KEY_DIAG_COL_B), KEY_DIAG }, // '=' and '.'
+#endif
+    { 2, (1u << 2) | (1u << 3), KEY_SHIFT }, // '+' and '-'
+};
+
+constexpr unsigned lowest(unsigned cols)
+{
+    unsigned c = 0;
+    while (!((cols >> c) & 1)) {
+        c++;
+    }
+    return c;
+}
+
+// True if the key at row, column `c` is one of a chord's
+constexpr bool starts_chord(unsigned row, unsigned c)
+{
+    for (const Chord& chord : chords) {
+        if (chord.row == row && ((chord.cols >> c) & 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr keymap_tables compile()
+{
+    keymap_tables t{};
+    for (unsigned row = 0; row < 4; row++) {
+        for (unsigned cols = 0; cols < 16; cols++) {
+            unsigned code = row * 16 + cols;
+            unsigned char press = none, shifted = none, held = none, wait = 0;
+            if (cols != 0) {
+                // Keys without a chord of their own read as the first of them, as
+                // the one-key scan did (keypad_column())
+                unsigned c = lowest(cols);
+                press = base[row][c];
+                shifted = shift[row][c] == same ? press : shift[row][c];
+                held = long_press[row][c];
+                wait = held != none ? KEYMAP_HOLD : cols == (1u << c) && starts_chord(row, c) ? KEYMAP_CHORD : 0;
+                for (const Chord& chord : chords) {
+                    if (chord.row == row && chord.cols == cols) {
+                        press = shifted = chord.action;
+                        held = none;
+                        wait = 0;
+                    }
+                }
+            }
+            t.v[KEYMAP_BASE][code] = (unsigned char)(press | wait);
+            t.v[KEYMAP_SHIFT][code] = (unsigned char)(shifted | wait);
+            t.v[KEYMAP_LONG][code] = held;
+        }
+    }
+    return t;
+}
+
+constexpr keymap_tables tables = compile();
+
+constexpr unsigned char at(unsigned layer, unsigned row, unsigned cols)
+{
+    return tables.v[layer][row * 16 + cols];
+}
+
+static_assert(at(KEYMAP_BASE, 0, 0) == KEY_NONE && at(KEYMAP_BASE, 2, 1 << 1) == KEY_0, "legends out of place");
+static_assert(at(KEYMAP_BASE, 2, 1 << 2) == (KEY_PLUS | KEYMAP_CHORD), "'+' waits for the shift chord");
+static_assert(at(KEYMAP_BASE, 3, 1 << 3) == (KEY_DECIMAL | KEYMAP_HOLD) &&
+              at(KEYMAP_LONG, 3, 1 << 3) == KEY_BACKSPACE, "long press of '.' deletes");
+#ifndef CALC_NO_DIAG
+static_assert(at(KEYMAP_BASE, 3, 1 << 2) == (KEY_CANCEL | KEYMAP_CHORD), "'=' waits for the diagnostics chord");
+#else
+static_assert(at(KEYMAP_BASE, 3, 1 << 2) == KEY_CANCEL, "KEY_CANCEL acts on acceptance");
+#endif
+static_assert(at(KEYMAP_BASE, 2, 0xC) == KEY_SHIFT && at(KEYMAP_SHIFT, 2, 0xC) == KEY_SHIFT &&
+              at(KEYMAP_BASE, 2, 0x6) == KEY_0, "chords, and keys held together without one");
+
+} // namespace
+
+extern "C" const keymap_tables keymap = tables;
+
+extern "C" const char keyCodes[4][4] = {
+    { base[0][0], base[0][1], base[0][2], base[0][3] },
+    { base[1][0], base[1][1], base[1][2], base[1][3] },
+    { base[2][0], base[2][1], base[2][2], base[2][3] },
+    { base[3][0], base[3][1], base[3][2], base[3][3] },
+};
@@ -0,0 +1,45 @@
+// ============= KEYMAP.H =============
+// C view of the keymap. The layers are declared in keymap.cpp and compiled into
+// flat tables indexed by scan code: what KeypadReadRow() reads from one row,
+//     row * 16 + the bits of the columns reading low
+// so a chord of keys in one row has a code of its own. The debouncer (keypad.c)
+// turns an accepted scan code into an action with one load, keymap.v[layer][code]:
+// - KEYMAP_BASE:  the legends, and the chords
+// - KEYMAP_SHIFT: the next key after KEY_SHIFT
+// - KEYMAP_LONG:  a key held for KEY_LONG_MS; KEY_NONE if it has no long-press action
+// Actions are the KEY_* codes of logic.h. Two flags on base and shift entries make
+// a key's action wait, to be sent on release unless something else happens first:
+// - KEYMAP_HOLD:  the key has a long-press action, sent instead after KEY_LONG_MS
+// - KEYMAP_CHORD: the key starts a chord. The action is sent after KEY_CHORD_MS
+//   held, or dropped if the other keys of the chord join it in that time.
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define KEYMAP_SCAN_CODES 64 // 4 rows x 16 column patterns
+#define KEYMAP_BASE 0
+#define KEYMAP_SHIFT 1
+#define KEYMAP_LONG 2
+#define KEYMAP_LAYERS 3
+#define KEYMAP_HOLD 0x80
+#define KEYMAP_CHORD 0x40
+#define KEY_LONG_MS 500
+#define KEY_CHORD_MS 60 // Longest gap between the keys of a chord
+
+typedef struct {
+    unsigned char v[KEYMAP_LAYERS][KEYMAP_SCAN_CODES];
+} keymap_tables;
+
+extern const keymap_tables keymap;
+
+// Base legend of each key, by row and column (key traces and host tools)
+extern const char keyCodes[4][4];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
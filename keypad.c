@@ -1,98 +1,409 @@
-// ============= KEYPAD.C =============
-#include <LPC17xx.h>
-#include "keypad.h"
-#include "delay.h"
-
-char keyCodes[4][4] = {
-    {0x1, 0x2, 0x3, 0x4},
-    {0x5, 0x6, 0x7, 0x8}, 
-    {0x9, 0x0, 0xA, 0xB},
-    {0xC, 0xD, 0xE, 0xF}
-};
-
-void KeyPadInitialize(void)
-{
-    // Make rows output
-    LPC_GPIO1->FIODIR |= (1 << 9) | (1 << 10) | (1 << 14) | (1 << 15);
-    // Make columns input  
-    LPC_GPIO1->FIODIR &= ~((1 << 0) | (1 << 1) | (1 << 4) | (1 << 8));
-    
-    // Set all rows high initially
-    LPC_GPIO1->FIOSET = (1 << 9) | (1 << 10) | (1 << 14) | (1 << 15);
-}
-
-void SetRowToZero(unsigned char rowNumber)
-{
-    // Set all rows high first
-    LPC_GPIO1->FIOSET = (1 << 9) | (1 << 10) | (1 << 14) | (1 << 15);
-    
-    // Pull selected row low
-    switch (rowNumber) {
-        case 0: LPC_GPIO1->FIOCLR = (1 << 9); break;
-        case 1: LPC_GPIO1->FIOCLR = (1 << 10); break;  
-        case 2: LPC_GPIO1->FIOCLR = (1 << 14); break;
-        case 3: LPC_GPIO1->FIOCLR = (1 << 15); break;
-    }
-    delay(1); // Signal stabilization delay
-}
-
-unsigned char ReadColumnNumber(void)
-{
-    unsigned long int temp = LPC_GPIO1->FIOPIN;
-    
-    if ((temp & (1 << 0)) == 0) return 0;
-    if ((temp & (1 << 1)) == 0) return 1; 
-    if ((temp & (1 << 4)) == 0) return 2;
-    if ((temp & (1 << 8)) == 0) return 3;
-    return 4; // No key pressed
-}
-
-// FIXED: Non-blocking key detection with improved debouncing
-unsigned char GetKeyPressed(void)
-{
-    static unsigned char lastKey = 0xFF;
-    static int debounceCount = 0;
-    static int stableCount = 0;
-    unsigned char row, col;
-    unsigned char currentKey = 0xFF;
-    
-    // Scan all rows to find pressed key
-    for (row = 0; row < 4; row++) {
-        SetRowToZero(row);
-        col = ReadColumnNumber();
-        if (col < 4) {
-            currentKey = keyCodes[row][col];
-            break; // Found a key, stop scanning
-        }
-    }
-    
-    // Debouncing logic
-    if (currentKey != 0xFF) { // Key is pressed
-        if (currentKey == lastKey) {
-            stableCount++;
-            if (stableCount >= 5) { // Key stable for 5 consecutive reads
-                if (debounceCount == 0) { // First time registering this key
-                    debounceCount = 1;
-                    return currentKey; // Return the key
-                }
-                // Key is being held - don't return it again
-                return 0xFF;
-            }
-        } else {
-            // Different key or first detection
-            lastKey = currentKey;
-            stableCount = 1;
-            debounceCount = 0;
-        }
-    } else {
-        // No key pressed - reset everything
-        if (lastKey != 0xFF) {
-            // Key was just released
-            lastKey = 0xFF;
-            stableCount = 0;
-            debounceCount = 0;
-        }
-    }
-    
-    return 0xFF; // No valid key or still debouncing
-}
+// ============= KEYPAD.C =============
+#include <LPC17xx.h>
+#include "keypad.h"
+#include "delay.h"
+#include "gpio.h"
+#include "board_pins.h"
+#include "diag.h"
+#include "event_trace.h"
+#include "keymap.h"
+#include "logic.h" // For KEY_SHIFT
+
+// Pin assignment, row patterns and the column lookup tables come from the
+// compile-time pin map in board.hpp (board_pins.h), key actions from the keymap in keymap.cpp. Rows and columns share port 1, so they
+// are claimed as one group: a row pattern is written with a single store and the
+// columns can still be read through FIOPIN.
+
+static void KeypadDebounceReset(void);
+
+void KeyPadInitialize(void)
+{
+    KeypadDebounceReset();
+
+    // Make rows output, columns input
+    gpio_group_init(&keypad_pins, keypad_row_mask);
+    
+    // Set all rows high initially
+    gpio_group_write(&keypad_pins, keypad_row_mask);
+}
+
+void KeypadSelectRow(unsigned char rowNumber)
+{
+    // Pull selected row low and all others high in one store
+    gpio_group_write(&keypad_pins, keypad_row_patterns[rowNumber & 3]);
+}
+
+void SetRowToZero(unsigned char rowNumber)
+{
+    KeypadSelectRow(rowNumber);
+    delay_us(KEY_SETTLE_US); // Signal stabilization delay
+}
+
+unsigned char ReadColumnNumber(void)
+{
+    // First column reading low, or 4 if no key is pressed, in one table load
+    return keypad_column(gpio_group_read(&keypad_pins));
+}
+
+unsigned char KeypadReadRow(unsigned char rowNumber)
+{
+    unsigned char cols = keypad_columns(gpio_group_read(&keypad_pins));
+
+    if (cols == 0) {
+        return 0xFF;
+    }
+    return (unsigned char)((rowNumber & 3) * 16 + cols); // Scan code, see keymap.h
+}
+
+// --- Keymap layers ---
+// The debouncer reports presses by scan code; these turn them into actions. A key
+// whose action waits (KEYMAP_HOLD or KEYMAP_CHORD) is sent on release, or at its
+// deadline while held, or dropped if more keys join it in a chord. Keys of a chord
+// that stay down after it are ignored until every key is up.
+#define KEYMAP_WAIT (KEYMAP_HOLD | KEYMAP_CHORD)
+#define SCAN_ROW(scan) ((scan) & 0x30)
+#define SCAN_COLS(scan) ((scan) & 0x0F)
+
+static SIM_LOCAL unsigned char keymapLayer;        // KEYMAP_BASE, or KEYMAP_SHIFT for the next key
+static SIM_LOCAL unsigned char keymapHeld = 0xFF;  // Accepted scan code whose action waits
+static SIM_LOCAL uint32_t keymapHeldSince;
+static SIM_LOCAL unsigned char keymapChord = 0xFF; // Chord sent last, until every key is up
+
+// True if the keys of scan code `part` are all in `whole`
+static int ScanWithin(unsigned char part, unsigned char whole)
+{
+    return SCAN_ROW(part) == SCAN_ROW(whole) && (SCAN_COLS(part) & ~SCAN_COLS(whole)) == 0;
+}
+
+static unsigned char KeymapSend(unsigned char scan, unsigned char action)
+{
+    if (SCAN_COLS(scan) & (SCAN_COLS(scan) - 1)) {
+        keymapChord = scan; // Two or more keys
+    }
+    if (action == KEY_SHIFT) {
+        keymapLayer ^= KEYMAP_SHIFT; // A second shift cancels the first
+        return 0xFF;
+    }
+    keymapLayer = KEYMAP_BASE;
+    return action;
+}
+
+// A press of `scan` was accepted at `now`
+static unsigned char KeymapPress(unsigned char scan, uint32_t now)
+{
+    unsigned char action = keymap.v[keymapLayer][scan];
+
+    if (keymapChord != 0xFF && ScanWithin(scan, keymapChord)) {
+        return 0xFF; // What is left of the chord after some of its keys were let go
+    }
+    keymapChord = 0xFF;
+    if (action & KEYMAP_WAIT) {
+        keymapHeld = scan;
+        keymapHeldSince = now;
+        return 0xFF;
+    }
+    return KeymapSend(scan, action);
+}
+
+// The accepted press is still held at `now`
+static unsigned char KeymapHold(uint32_t now)
+{
+    unsigned char scan = keymapHeld;
+    unsigned char action;
+
+    if (scan == 0xFF) {
+        return 0xFF;
+    }
+    action = keymap.v[keymapLayer][scan];
+    if (action & KEYMAP_HOLD) {
+        if (now - keymapHeldSince < KEY_LONG_MS * 1000UL) {
+            return 0xFF;
+        }
+        action = keymap.v[KEYMAP_LONG][scan];
+    } else if (now - keymapHeldSince < KEY_CHORD_MS * 1000UL) {
+        return 0xFF; // No second key yet
+    }
+    keymapHeld = 0xFF;
+    return KeymapSend(scan, (unsigned char)(action & ~KEYMAP_WAIT));
+}
+
+// The accepted press ended: the scan now reads `next`, 0xFF once every key is up
+static unsigned char KeymapRelease(unsigned char next)
+{
+    unsigned char scan = keymapHeld;
+
+    if (next == 0xFF) {
+        keymapChord = 0xFF;
+    }
+    if (scan == 0xFF) {
+        return 0xFF;
+    }
+    keymapHeld = 0xFF;
+    if (next != 0xFF && ScanWithin(scan, next)) {
+        return 0xFF; // Grew into a chord, which acts instead
+    }
+    return KeymapSend(scan, (unsigned char)(keymap.v[keymapLayer][scan] & ~KEYMAP_WAIT));
+}
+
+// FIXED: Non-blocking key detection with improved debouncing
+unsigned char GetKeyPressed(void)
+{
+    unsigned char row;
+    unsigned char currentKey = 0xFF;
+    
+    // Scan all rows to find pressed key
+    for (row = 0; row < 4; row++) {
+        SetRowToZero(row);
+        currentKey = KeypadReadRow(row);
+        if (currentKey != 0xFF) {
+            break; // Found a key, stop scanning
+        }
+    }
+    return KeypadDebounce(currentKey);
+}
+
+#ifdef KEYPAD_DEBOUNCE_FIXED
+// Debouncing logic: a key is accepted once, after 5 consecutive scans that saw it
+unsigned char KeypadDebounce(unsigned char currentKey)
+{
+    static SIM_LOCAL unsigned char lastKey = 0xFF;
+    static SIM_LOCAL int debounceCount = 0;
+    static SIM_LOCAL int stableCount = 0;
+    unsigned char action = 0xFF;
+    
+    DIAG_UPTIME_POLL(uptime_us()); // Runs on every scan, so no wrap is missed
+    if (currentKey != 0xFF) { // Key is pressed
+        if (currentKey == lastKey) {
+            stableCount++;
+            if (stableCount >= 5) { // Key stable for 5 consecutive reads
+                if (debounceCount == 0) { // First time registering this key
+                    debounceCount = 1;
+                    return KeymapPress(currentKey, uptime_us()); // Return the key
+                }
+                // Key is being held - only a waiting action can come now
+                return KeymapHold(uptime_us());
+            }
+        } else {
+            // Different key or first detection
+            if (lastKey != 0xFF && debounceCount == 0) {
+                DIAG_COUNT(debounce_rejects); // The previous key never became stable
+            } else if (lastKey != 0xFF) {
+                action = KeymapRelease(currentKey);
+            }
+            lastKey = currentKey;
+            stableCount = 1;
+            debounceCount = 0;
+        }
+    } else {
+        // No key pressed - reset everything
+        if (lastKey != 0xFF) {
+            // Key was just released
+            if (debounceCount == 0) {
+                DIAG_COUNT(debounce_rejects); // Released before it was accepted
+            } else {
+                action = KeymapRelease(0xFF);
+            }
+            lastKey = 0xFF;
+            stableCount = 0;
+            debounceCount = 0;
+        }
+    }
+    
+    return action; // A key sent on release, or 0xFF while debouncing
+}
+
+static void KeypadDebounceReset(void)
+{
+    keymapLayer = KEYMAP_BASE;
+    keymapHeld = 0xFF;
+    keymapChord = 0xFF;
+}
+
+int KeypadDebouncing(void)
+{
+    return 0; // Keeps the scan rate; stability is counted in scans
+}
+#else
+// Adaptive debouncing. A key is accepted once its reads have stayed the same for
+// its window, and a press ends once the key has read open for that long. The
+// window follows the longest chatter measured on that key, so a clean switch is
+// accepted a millisecond after it is first seen while a worn one is still waited
+// out. While a key settles the caller reads its row every KEY_SAMPLE_US
+// (KeypadDebouncing()), which is what makes the measurement fine-grained.
+// Keys and chords are told apart by scan code.
+static SIM_LOCAL uint16_t keyBounceUs[KEYMAP_SCAN_CODES]; // Chatter estimate of each scan code
+static SIM_LOCAL uint64_t keyBounceKnown;                 // Scan codes measured since the reset
+
+static SIM_LOCAL unsigned char readKey;           // Last scan result
+static SIM_LOCAL uint32_t readSince;              // Uptime when it changed to that
+static SIM_LOCAL unsigned char pressKey;          // Key being pressed, held or released, 0xFF when idle
+static SIM_LOCAL unsigned char pressAccepted;     // pressKey has been passed to the keymap
+static SIM_LOCAL uint32_t pressStart;             // Uptime of its first read
+static SIM_LOCAL unsigned char releasing;         // Accepted, and read open since releaseStart
+static SIM_LOCAL uint32_t releaseStart;
+
+static void KeypadDebounceReset(void)
+{
+    keymapLayer = KEYMAP_BASE;
+    keymapHeld = 0xFF;
+    keymapChord = 0xFF;
+    keyBounceKnown = 0;
+    readKey = 0xFF;
+    pressKey = 0xFF;
+    pressAccepted = 0;
+    releasing = 0;
+}
+
+static uint32_t KeypadBounce(unsigned char key)
+{
+    return ((keyBounceKnown >> key) & 1) ? keyBounceUs[key] : KEY_BOUNCE_START_US;
+}
+
+uint32_t KeypadDebounceWindow(unsigned char key)
+{
+    uint32_t window = KEY_WINDOW_MIN_US + KeypadBounce(key);
+    return window < KEY_WINDOW_MAX_US ? window : KEY_WINDOW_MAX_US;
+}
+
+// Folds one chatter measurement into the key's estimate: a longer one widens the
+// window at once, shorter ones narrow it a quarter of the way each time
+static void KeypadLearnBounce(unsigned char key, uint32_t chatter_us)
+{
+    uint32_t estimate = KeypadBounce(key);
+
+    if (chatter_us >= estimate) {
+        estimate = chatter_us < KEY_BOUNCE_MAX_US ? chatter_us : KEY_BOUNCE_MAX_US;
+    } else {
+        estimate -= (estimate - chatter_us + 3) / 4;
+    }
+    keyBounceUs[key] = (uint16_t)estimate;
+    keyBounceKnown |= 1ULL << key;
+}
+
+unsigned char KeypadDebounce(unsigned char currentKey)
+{
+    uint32_t now = uptime_us();
+    unsigned char action = 0xFF;
+
+    DIAG_UPTIME_POLL(now); // Runs on every scan, so no wrap is missed
+    if (currentKey != readKey) {
+        readKey = currentKey;
+        readSince = now;
+        if (currentKey == 0xFF) {
+            if (pressAccepted && !releasing) {
+                releasing = 1;
+                releaseStart = now;
+            }
+        } else if (currentKey != pressKey) {
+            if (pressKey != 0xFF && !pressAccepted) {
+                DIAG_COUNT(debounce_rejects); // The previous key never became stable
+            } else if (pressKey != 0xFF) {
+                action = KeymapRelease(currentKey); // Rolled over to another key or chord
+            }
+            pressKey = currentKey;
+            pressStart = now;
+            pressAccepted = 0;
+            releasing = 0;
+        }
+        return action;
+    }
+    if (pressKey == 0xFF || now - readSince < KeypadDebounceWindow(pressKey)) {
+        return 0xFF; // Idle, or not stable for long enough yet
+    }
+    if (currentKey != 0xFF) {
+        if (!pressAccepted) {
+            pressAccepted = 1;
+            KeypadLearnBounce(pressKey, readSince - pressStart);
+            return KeymapPress(pressKey, now);
+        }
+        if (releasing) { // The contact opened for a moment while held
+            releasing = 0;
+            KeypadLearnBounce(pressKey, readSince - releaseStart);
+        }
+        return KeymapHold(now); // Held: only a waiting action can come now
+    }
+    // Open for a whole window: the press is over
+    if (!pressAccepted) {
+        DIAG_COUNT(debounce_rejects); // Released before it was accepted
+    } else {
+        KeypadLearnBounce(pressKey, readSince - releaseStart);
+        action = KeymapRelease(0xFF);
+    }
+    pressKey = 0xFF;
+    pressAccepted = 0;
+    releasing = 0;
+    return action;
+}
+
+int KeypadDebouncing(void)
+{
+    return pressKey != 0xFF && (!pressAccepted || releasing);
+}
+#endif
+
+// --- Key buffer ---
+static SIM_LOCAL unsigned char keyBuffer[KEY_BUFFER_SIZE];
+static SIM_LOCAL unsigned char keyHead = 0; // Next slot to write
+static SIM_LOCAL unsigned char keyTail = 0; // Next slot to read
+#ifndef CALC_NO_DIAG
+static SIM_LOCAL uint32_t keyAcceptedAt[KEY_BUFFER_SIZE]; // Uptime of each buffered key, for the latency figure
+#endif
+SIM_LOCAL uint32_t keypad_first_key_us = 0;
+
+void KeypadPoll(void)
+{
+    KeypadQueueKey(GetKeyPressed());
+}
+
+void KeypadQueueKey(unsigned char key)
+{
+    unsigned char next = (unsigned char)((keyHead + 1) % KEY_BUFFER_SIZE);
+    
+    if (key == 0xFF) {
+        return;
+    }
+    if (keypad_first_key_us == 0) {
+        keypad_first_key_us = uptime_us();
+    }
+    if (next != keyTail) { // Drop the key if the buffer is full
+#ifndef CALC_NO_DIAG
+        keyAcceptedAt[keyHead] = uptime_us();
+#endif
+        keyBuffer[keyHead] = key;
+        keyHead = next;
+        TRACE_EVENT(EVT_KEY, key);
+    }
+}
+
+unsigned char KeypadNextKey(void)
+{
+    unsigned char key;
+    
+    if (keyTail == keyHead) {
+        return 0xFF;
+    }
+    key = keyBuffer[keyTail];
+    DIAG_KEY_TAKEN(keyAcceptedAt[keyTail]);
+    keyTail = (unsigned char)((keyTail + 1) % KEY_BUFFER_SIZE);
+    return key;
+}
+
+unsigned char KeypadPeekKey(void)
+{
+    return (keyTail == keyHead) ? 0xFF : keyBuffer[keyTail];
+}
+
+int KeypadFlushThrough(unsigned char key)
+{
+    unsigned char i = keyTail;
+    
+    while (i != keyHead && keyBuffer[i] != key) {
+        i = (unsigned char)((i + 1) % KEY_BUFFER_SIZE);
+    }
+    if (i == keyHead) {
+        return 0;
+    }
+    DIAG_KEY_TAKEN(keyAcceptedAt[i]);
+    keyTail = (unsigned char)((i + 1) % KEY_BUFFER_SIZE);
+    return 1;
+}
@@ -1,12 +1,48 @@
-// ============= KEYPAD.H =============
-#ifndef KEYPAD_H
-#define KEYPAD_H
-
-void KeyPadInitialize(void);
-void SetRowToZero(unsigned char rowNumber);
-unsigned char ReadColumnNumber(void);
-unsigned char GetKeyPressed(void);
-
-#define MAX_TOKENS 50
-
-#endif
+// ============= KEYPAD.H =============
+#ifndef KEYPAD_H
+#define KEYPAD_H
+
+#include <stdint.h>
+#include "sim_local.h"
+
+void KeyPadInitialize(void);
+void SetRowToZero(unsigned char rowNumber);
+unsigned char ReadColumnNumber(void);
+unsigned char GetKeyPressed(void);
+
+// Pieces of GetKeyPressed() for callers that scan one row at a time (see tasks.c):
+// select a row, wait KEY_SETTLE_US, read it, and feed the scan result to the debouncer.
+#define KEY_SETTLE_US 1000 // Row select to column read
+void KeypadSelectRow(unsigned char rowNumber);
+unsigned char KeypadReadRow(unsigned char rowNumber); // Scan code of the selected row (keymap.h), or 0xFF
+unsigned char KeypadDebounce(unsigned char scannedKey); // Action of the keymap for a press, or 0xFF
+int KeypadDebouncing(void); // A key is settling: read its row again after KEY_SAMPLE_US
+
+// Adaptive debouncing (keypad.c): a key's window is KEY_WINDOW_MIN_US plus the
+// longest chatter recently measured on it. Keys start at KEY_BOUNCE_START_US until
+// their first press. Building with KEYPAD_DEBOUNCE_FIXED restores the previous
+// debouncer, which accepts a key after 5 identical scans.
+#define KEY_SAMPLE_US 250
+#define KEY_WINDOW_MIN_US 1000
+#define KEY_WINDOW_MAX_US 30000
+#define KEY_BOUNCE_START_US 4000
+#define KEY_BOUNCE_MAX_US 20000
+#ifndef KEYPAD_DEBOUNCE_FIXED
+uint32_t KeypadDebounceWindow(unsigned char scan); // Current window of a scan code, in us
+#endif
+void KeypadQueueKey(unsigned char key); // Adds an accepted key to the buffer
+
+// Buffered input: KeypadPoll() scans once and queues a key's action, KeypadNextKey()
+// returns the oldest queued key or 0xFF. Lets keys be collected while the firmware
+// is busy with something else, e.g. the LCD power-on wait at boot.
+#define KEY_BUFFER_SIZE 8
+#define KEY_POLL_MS 5 // Interval between keypad polls while idle
+void KeypadPoll(void);
+unsigned char KeypadNextKey(void);
+unsigned char KeypadPeekKey(void); // Oldest queued key without removing it, or 0xFF
+int KeypadFlushThrough(unsigned char key); // Drops queued keys through the oldest `key`: 1, or 0 (none dropped) if absent
+extern SIM_LOCAL uint32_t keypad_first_key_us; // Uptime when the first key was accepted, 0 if none yet
+
+#define MAX_TOKENS 50
+
+#endif
@@ -2,109 +2,217 @@
 #include <LPC17xx.h>
 #include "lcd.h"
 #include "delay.h"
+#include "gpio.h"
+#include "board_pins.h"
+#include "diag.h"
+#include "sim_local.h"
 
-#define RS 9
-#define RW 10
-#define EN 11
+// RS, RW, EN and D4-D7 are owned as one group (lcd_pins, from the compile-time pin
+// map in board.hpp, see board_pins.h), so each store sets all of them at once. Nibbles are put
+// on the data pins through lcd_nibble_patterns, whatever pins they are wired to.
 
+#ifdef LCD_DMA_BACKEND
+#include "lcd_dma.h"
+
+static SIM_LOCAL lcd_dma_frame lcd_frame LCD_DMA_FRAME_SECTION; // Waveform being built between lcd_frame_begin/end, in AHB SRAM
+static SIM_LOCAL int lcd_frame_open = 0;  // True while lcdchar() appends to lcd_frame
+#endif
+
+// HD44780 timings in microseconds. The datasheet minimums are all well below 1 us
+// for the bus itself; execution times are the datasheet values at 270 kHz with
+// about 10% margin for oscillator tolerance.
+#define LCD_BUS_US 1             // RS setup, EN pulse width and EN low time
+#define LCD_EXEC_US 40           // Most instructions and data writes (37 us)
+#define LCD_EXEC_CLEAR_US 1640   // Clear display and return home (1.52 ms)
+#define LCD_POWER_ON_US 40000    // From VCC reaching 2.7 V to the first instruction
+
+// Latches one nibble: the caller has already presented RS and the data (EN low),
+// EN is raised and dropped again with the same pattern on the other pins
+static void lcd_pulse(uint32_t pins)
+{
+    gpio_group_write(&lcd_pins, pins | lcd_en_bit);  // Enable high
+    delay_us(LCD_BUS_US);                          // Enable pulse width
+    gpio_group_write(&lcd_pins, pins);             // Enable low - nibble latched
+    delay_us(LCD_BUS_US);                          // Enable low time before the next pulse
+}
+
+// Sends one 4-bit-mode initialisation nibble with RS low
+static void lcd_init_nibble(unsigned char nibble)
+{
+    uint32_t pins = lcd_nibble_patterns[nibble & 0x0F];
+    gpio_group_write(&lcd_pins, pins);             // Data settles before enable rises
+    lcd_pulse(pins);
+}
+
+// Initialisation by instruction (HD44780U datasheet, figure 24), 4-bit interface.
+// Each step is sent once the previous step's wait has passed.
+typedef struct {
+    unsigned char value;      // Nibble (8-bit phase) or command byte
+    unsigned char is_nibble;  // Sent as a single nibble while still in 8-bit mode
+    unsigned short wait_us;   // Wait after this step (lcdchar waits out commands itself)
+} lcd_init_step_t;
+
+static const lcd_init_step_t lcd_init_steps[] = {
+    {0x03, 1, 4100},          // Function set (8-bit), then wait more than 4.1 ms
+    {0x03, 1, 100},           // Function set (8-bit), then wait more than 100 us
+    {0x03, 1, LCD_EXEC_US},   // Function set (8-bit)
+    {0x02, 1, LCD_EXEC_US},   // Function set: switch to 4-bit
+    {0x28, 0, 0},             // 4-bit, 2 lines, 5x7 font
+    {0x0C, 0, 0},             // Display ON, Cursor OFF, Blink OFF
+    {0x06, 0, 0},             // Increment cursor, no shift
+    {0x01, 0, 0}              // Clear display
+};
+#define LCD_INIT_YIELD_US 1000 // Shorter waits are spun inside lcd_init_poll()
+#define LCD_INIT_STEPS (sizeof(lcd_init_steps) / sizeof(lcd_init_steps[0]))
+
+static SIM_LOCAL unsigned char lcd_init_next = LCD_INIT_STEPS; // Next step to send
+static SIM_LOCAL uint32_t lcd_init_ready_at = 0;               // Uptime at which it may be sent
+
+// Starts the non-blocking initialisation: claims the pins and begins the power-on wait
+void lcd_init_begin(void)
+{
+    // Claim RS, RW, EN and the data pins as outputs and drive them all low
+    gpio_group_init(&lcd_pins, lcd_pins.mask);
+    gpio_group_write(&lcd_pins, 0);
+
+    lcd_init_next = 0;
+    lcd_init_ready_at = uptime_us() + LCD_POWER_ON_US;
+}
+
+// Sends the next initialisation step if its wait has passed.
+// Returns 1 once the display is ready for use, 0 while initialisation is in progress.
+int lcd_init_poll(void)
+{
+    const lcd_init_step_t *step;
+
+    if (lcd_init_next >= LCD_INIT_STEPS) {
+        return 1;
+    }
+    if ((int32_t)(uptime_us() - lcd_init_ready_at) < 0) {
+        return 0;
+    }
+
+    // Send steps until one is followed by a wait long enough to be worth returning for
+    do {
+        step = &lcd_init_steps[lcd_init_next++];
+        if (step->is_nibble) {
+            lcd_init_nibble(step->value);
+        } else {
+            lcdchar(step->value, 'C');
+        }
+        if (step->wait_us >= LCD_INIT_YIELD_US) {
+            lcd_init_ready_at = uptime_us() + step->wait_us;
+            return 0;
+        }
+        delay_us(step->wait_us);
+    } while (lcd_init_next < LCD_INIT_STEPS);
+
+#ifdef LCD_DMA_BACKEND
+    lcd_dma_init();
+#endif
+    return 1;
+}
+
+// Blocking initialisation, for callers that have nothing else to do meanwhile
 void lcdinit(void) 
 {
-    // Set data pins and control pins as output
-    LPC_GPIO0->FIODIR |= (1 << 22) | (1 << 21) | (1 << 20) | (1 << 19);
-    LPC_GPIO0->FIODIR |= (1 << EN) | (1 << RW) | (1 << RS);
-    
-    // Initialize all pins to low
-    LPC_GPIO0->FIOCLR = (1 << RS) | (1 << RW) | (1 << EN);
-    LPC_GPIO0->FIOCLR = (0x0F << 19); // Clear data pins
-    
-    delay(100); // Power-on delay - increased from 50ms
-    
-    // LCD initialization sequence for 4-bit mode
-    // Send 0x30 three times with proper delays
-    LPC_GPIO0->FIOCLR = (0x0F << 19);   // Clear data pins
-    LPC_GPIO0->FIOSET = (0x03 << 19);   // Set 0x3 on upper nibble
-    LPC_GPIO0->FIOSET = (1 << EN);      // Enable high
-    delay(5);                           // Longer enable pulse
-    LPC_GPIO0->FIOCLR = (1 << EN);      // Enable low
-    delay(10);                          // Wait 10ms
-    
-    // Second 0x30
-    LPC_GPIO0->FIOSET = (1 << EN);
-    delay(5);
-    LPC_GPIO0->FIOCLR = (1 << EN);
-    delay(5);
-    
-    // Third 0x30  
-    LPC_GPIO0->FIOSET = (1 << EN);
-    delay(5);
-    LPC_GPIO0->FIOCLR = (1 << EN);
-    delay(5);
-    
-    // Now send 0x20 to set 4-bit mode
-    LPC_GPIO0->FIOCLR = (0x0F << 19);
-    LPC_GPIO0->FIOSET = (0x02 << 19);   // 0x2 for 4-bit mode
-    LPC_GPIO0->FIOSET = (1 << EN);
-    delay(5);
-    LPC_GPIO0->FIOCLR = (1 << EN);
-    delay(10);
-    
-    // Now use 4-bit commands
-    lcdchar(0x28, 'C'); delay(10);  // 4-bit, 2 lines, 5x7 font
-    lcdchar(0x0C, 'C'); delay(10);  // Display ON, Cursor OFF, Blink OFF
-    lcdchar(0x06, 'C'); delay(10);  // Increment cursor, no shift
-    lcdchar(0x01, 'C'); delay(20);  // Clear display - needs longer delay
+    lcd_init_begin();
+    while (!lcd_init_poll()) {
+        delay_us(LCD_BUS_US);
+    }
+}
+
+void lcd_frame_begin(void)
+{
+#ifdef LCD_DMA_BACKEND
+    lcd_dma_wait(); // The previous frame's buffer is reused
+    lcd_dma_frame_reset(&lcd_frame);
+    lcd_frame_open = 1;
+#endif
+}
+
+void lcd_frame_end(void)
+{
+#ifdef LCD_DMA_BACKEND
+    lcd_frame_open = 0;
+    lcd_dma_start(&lcd_frame);
+#endif
 }
 
 void lcdstring(char *str) 
 {
     unsigned char i = 0;
     while (str[i] != '\0') {
-        lcdchar(str[i], 'D');
-        delay(2); // Small delay between characters
+        lcdchar(str[i], 'D'); // lcdchar waits until the controller is ready again
         i++;
     }
 }
 
+// Moves the DDRAM address counter to a column (0-39) of line 0 or 1
+void lcd_goto(unsigned char line, unsigned char col)
+{
+    unsigned char addr = (line ? LCD_DDRAM_LINE_2 : 0x00) + (col % LCD_DDRAM_LINE_LEN);
+    lcdchar(LCD_CMD_SET_DDRAM_ADDR | addr, 'C');
+}
+
+// Writes len characters starting at a DDRAM column, wrapping from column 39
+// back to column 0 of the same line (the controller would run on to the other line)
+void lcd_write_at(unsigned char line, unsigned char col, const char *str, int len)
+{
+    int i;
+    col %= LCD_DDRAM_LINE_LEN;
+    lcd_goto(line, col);
+    for (i = 0; i < len; i++) {
+        if (col == LCD_DDRAM_LINE_LEN) {
+            col = 0;
+            lcd_goto(line, col);
+        }
+        lcdchar(str[i], 'D');
+        col++;
+    }
+}
+
+// Scrolls both lines left by the given number of columns using the controller's
+// display shift; DDRAM contents are untouched and the window wraps after column 39
+void lcd_shift_display_left(unsigned char steps)
+{
+    while (steps--) {
+        lcdchar(LCD_CMD_DISPLAY_SHIFT_LEFT, 'C');
+    }
+}
+
 void lcdchar(unsigned char data, unsigned char type) 
 {
-    unsigned char lower = data & 0x0F;
-    unsigned char upper = (data & 0xF0) >> 4;
-    
-    // Set command/data mode
-    if (type == 'C') 
-        LPC_GPIO0->FIOCLR = (1 << RS);  // Command mode
-    else 
-        LPC_GPIO0->FIOSET = (1 << RS);  // Data mode
-    
-    // Ensure RW is low (write mode)
-    LPC_GPIO0->FIOCLR = (1 << RW);
-    
-    delay(1); // Setup time
+    DIAG_COUNT(lcd_bytes);
+#ifdef LCD_DMA_BACKEND
+    if (lcd_frame_open) {
+        // The waveform carries its own timing, so none of the delays below apply
+        if (!lcd_dma_frame_byte(&lcd_frame, data, type)) {
+            lcd_dma_start(&lcd_frame); // Frame buffer full: send what we have
+            lcd_dma_wait();
+            lcd_dma_frame_reset(&lcd_frame);
+            lcd_dma_frame_byte(&lcd_frame, data, type);
+        }
+        return;
+    }
+    lcd_dma_wait(); // Direct writes must not interleave with a running frame
+#endif
+    uint32_t rs = (type == 'C') ? 0 : lcd_rs_bit; // Command or data mode
+    uint32_t upper = lcd_nibble_patterns[data >> 4];
+    uint32_t lower = lcd_nibble_patterns[data & 0x0F];
     
-    // Send upper nibble
-    LPC_GPIO0->FIOCLR = (0x0F << 19);   // Clear data pins
-    LPC_GPIO0->FIOSET = (upper << 19);  // Set upper nibble
-    LPC_GPIO0->FIOSET = (1 << EN);      // Enable high
-    delay(5);                           // Enable pulse width - increased
-    LPC_GPIO0->FIOCLR = (1 << EN);      // Enable low
-    delay(5);                           // Hold time - increased
+    // RS, RW (always low: write mode) and the upper nibble in one store,
+    // so RS is stable before enable rises
+    gpio_group_write(&lcd_pins, rs | upper);
+    delay_us(LCD_BUS_US); // Setup time
     
-    // Send lower nibble  
-    LPC_GPIO0->FIOCLR = (0x0F << 19);   // Clear data pins
-    LPC_GPIO0->FIOSET = (lower << 19);  // Set lower nibble
-    LPC_GPIO0->FIOSET = (1 << EN);      // Enable high
-    delay(5);                           // Enable pulse width - increased
-    LPC_GPIO0->FIOCLR = (1 << EN);      // Enable low
-    delay(5);                           // Hold time - increased
+    lcd_pulse(rs | upper); // Send upper nibble
+    lcd_pulse(rs | lower); // Send lower nibble (data may change while enable rises)
     
-    // Extra delay for commands
-    if (type == 'C') {
-        if (data == 0x01 || data == 0x02) {
-            delay(20); // Clear/Home commands need more time
-        } else {
-            delay(5);  // Other commands
-        }
+    // Wait out the execution time before the next transfer
+    if (type == 'C' && (data == 0x01 || data == 0x02)) {
+        delay_us(LCD_EXEC_CLEAR_US); // Clear/Home commands need more time
     } else {
-        delay(2); // Data write delay
+        delay_us(LCD_EXEC_US);
     }
 }
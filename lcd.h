@@ -2,8 +2,24 @@
 #ifndef LCD_H
 #define LCD_H
 
+#define LCD_DDRAM_LINE_LEN 40        // DDRAM characters per line; only 16 are visible at once
+#define LCD_CMD_SET_DDRAM_ADDR 0x80    // OR with the DDRAM address
+#define LCD_CMD_DISPLAY_SHIFT_LEFT 0x18 // Scroll the visible window one column to the right
+#define LCD_DDRAM_LINE_2 0x40          // DDRAM address of the first column of line 2
+
 void lcdinit(void);
+void lcd_init_begin(void);
+int lcd_init_poll(void);
 void lcdstring(char *str);
 void lcdchar(unsigned char data, unsigned char type);
+void lcd_goto(unsigned char line, unsigned char col);
+void lcd_write_at(unsigned char line, unsigned char col, const char *str, int len);
+void lcd_shift_display_left(unsigned char steps);
+
+// Groups the writes between begin and end into one frame. With LCD_DMA_BACKEND
+// defined the frame is streamed to the pins by the GPDMA (see lcd_dma.c) and
+// end returns immediately; otherwise both calls do nothing.
+void lcd_frame_begin(void);
+void lcd_frame_end(void);
 
 #endif
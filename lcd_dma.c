@@ -0,0 +1,128 @@
+// ============= LCD_DMA.C =============
+// GPDMA + timer clocked LCD waveform engine, see lcd_dma.h.
+//
+// Waveform for one byte, one word per tick (T = LCD_DMA_TICK_NS):
+//   0: RS + upper nibble, EN low    (RS settles one tick before EN rises)
+//   1: RS + upper nibble, EN high
+//   2: RS + upper nibble, EN low    (upper nibble latched)
+//   3: RS + lower nibble, EN high   (data only has to be valid before EN falls)
+//   4: RS + lower nibble, EN low    (byte latched, controller starts executing)
+//   5..: idle words until the execution time has passed
+// The next byte's EN rises two ticks after its first word, so the byte needs
+// ceil(exec / T) - 2 idle words. With T = 10 us that is 2 for most bytes and 150
+// for clear/home, and EN is high for 10 us with a 20 us cycle, well above the
+// controller's 450 ns / 1000 ns minimums.
+// ===================================
+
+#include <LPC17xx.h>
+#include "lcd_dma.h"
+#include "lcd.h"
+#include "delay.h"
+#include "board_pins.h"
+#include "sim_local.h"
+
+// Timer 0 runs from CCLK / 4 (the reset PCLKSEL0 setting). The match value is taken
+// from SystemCoreClock each time a frame starts, so the tick stays LCD_DMA_TICK_NS
+// whatever clock level clock.c has selected. The clock must not change while a
+// frame is streaming: the LCD task holds its clock boost until lcd_dma_busy() is 0.
+#define LCD_DMA_TIMER_TICKS ((SystemCoreClock / 4 / 1000000UL) * LCD_DMA_TICK_NS / 1000UL)
+
+#define GPDMA_CH 0             // Channel 0 (highest priority)
+#define GPDMA_REQ_MAT0_0 8     // Request line 8 carries MAT0.0 when DMAREQSEL bit 0 is set
+
+// The idle words after a frame's last byte assume that another byte follows, whose
+// EN rises two ticks after its first word. Set while that remainder of the last
+// execution time still has to be waited out by lcd_dma_wait().
+static SIM_LOCAL int lcd_dma_settle = 0;
+
+void lcd_dma_init(void)
+{
+    LPC_SC->PCONP |= (1 << 29) | (1 << 1); // Power the GPDMA and Timer 0
+    LPC_SC->DMAREQSEL |= (1 << 0);         // Request line 8 is MAT0.0 rather than UART0 TX
+    LPC_GPDMA->DMACConfig = 0x01;          // Enable the controller, little-endian
+
+    LPC_TIM0->TCR = 0x02;                  // Hold the timer in reset
+    LPC_TIM0->PR = 0;
+    LPC_TIM0->MCR = (1 << 1);              // Reset on MR0: one DMA request per tick
+}
+
+void lcd_dma_frame_reset(lcd_dma_frame *frame)
+{
+    frame->count = 0;
+}
+
+// Appends the waveform for one byte ('C' for command, 'D' for data, as lcdchar()).
+// Returns 0, leaving the frame unchanged, if the byte does not fit.
+int lcd_dma_frame_byte(lcd_dma_frame *frame, unsigned char data, unsigned char type)
+{
+    uint32_t rs = (type == 'C') ? 0 : lcd_rs_bit;
+    uint32_t upper = rs | lcd_nibble_patterns[data >> 4];
+    uint32_t lower = rs | lcd_nibble_patterns[data & 0x0F];
+    unsigned long exec_ns = (type == 'C' && (data == 0x01 || data == 0x02)) ? LCD_EXEC_CLEAR_NS
+                                                                            : LCD_EXEC_NS;
+    int idle = (int)((exec_ns + LCD_DMA_TICK_NS - 1) / LCD_DMA_TICK_NS) - 2;
+    uint32_t *w;
+
+    if (idle < 0) {
+        idle = 0;
+    }
+    if (frame->count + 5 + idle > LCD_DMA_FRAME_WORDS) {
+        return 0;
+    }
+
+    w = &frame->words[frame->count];
+    *w++ = upper;
+    *w++ = upper | lcd_en_bit;
+    *w++ = upper;
+    *w++ = lower | lcd_en_bit;
+    *w++ = lower;
+    while (idle--) {
+        *w++ = lower;
+    }
+    frame->count = (int)(w - frame->words);
+    return 1;
+}
+
+// Starts streaming a frame. The frame must stay untouched until lcd_dma_busy() is 0,
+// and must be in AHB SRAM (LCD_DMA_FRAME_SECTION), where the GPDMA can read it.
+void lcd_dma_start(const lcd_dma_frame *frame)
+{
+    if (frame->count == 0) {
+        return;
+    }
+    LPC_GPDMA->DMACIntTCClear = 1 << GPDMA_CH;
+    LPC_GPDMA->DMACIntErrClr = 1 << GPDMA_CH;
+
+    LPC_GPDMACH0->DMACCSrcAddr = (uintptr_t)frame->words;
+    LPC_GPDMACH0->DMACCDestAddr = (uintptr_t)&LPC_GPIO0->FIOPIN; // FIOMASK limits it to the LCD pins
+    LPC_GPDMACH0->DMACCLLI = 0;
+    LPC_GPDMACH0->DMACCControl = (uint32_t)frame->count  // Transfer size
+                               | (2 << 18)               // Source width: 32 bits
+                               | (2 << 21)               // Destination width: 32 bits
+                               | (1 << 26);              // Increment source; single transfers
+    LPC_GPDMACH0->DMACCConfig = 0x01                      // Enable
+                              | (GPDMA_REQ_MAT0_0 << 6)   // Destination request: MAT0.0
+                              | (1 << 11);                // Memory to peripheral
+
+    LPC_TIM0->TCR = 0x02; // Restart the timer so the first word gets a full tick
+    LPC_TIM0->MR0 = LCD_DMA_TIMER_TICKS - 1;
+    LPC_TIM0->TCR = 0x01;
+    lcd_dma_settle = 1;
+}
+
+// The channel enable bit clears itself when the last word has been transferred
+int lcd_dma_busy(void)
+{
+    return (LPC_GPDMACH0->DMACCConfig & 0x01) != 0;
+}
+
+void lcd_dma_wait(void)
+{
+    while (lcd_dma_busy()) {
+        delay_us(LCD_DMA_TICK_NS / 1000);
+    }
+    if (lcd_dma_settle) {
+        delay_us(2 * LCD_DMA_TICK_NS / 1000);
+        lcd_dma_settle = 0;
+    }
+}
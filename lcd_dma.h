@@ -0,0 +1,42 @@
+// ============= LCD_DMA.H =============
+// Optional LCD backend: a whole frame of LCD commands and data is turned into the
+// sequence of port 0 patterns the CPU would otherwise write (RS + data nibble with
+// EN high, then EN low), and the GPDMA streams it to FIO0PIN, one word per Timer 0
+// match. The CPU is free while the frame is being sent.
+// Enable it by building lcd.c with LCD_DMA_BACKEND defined.
+#ifndef LCD_DMA_H
+#define LCD_DMA_H
+
+#include <stdint.h>
+
+#define LCD_DMA_TICK_NS 10000UL    // Time between two DMA stores (Timer 0 match period)
+#define LCD_DMA_FRAME_WORDS 512    // Port patterns per frame; a full redraw needs about 400
+
+// HD44780 execution times the waveform waits out before the next transfer
+#define LCD_EXEC_NS 37000UL        // Most instructions and data writes
+#define LCD_EXEC_CLEAR_NS 1520000UL // Clear display and return home
+
+typedef struct {
+    uint32_t words[LCD_DMA_FRAME_WORDS]; // FIO0PIN patterns, one per tick
+    int count;                           // Number of valid words
+} lcd_dma_frame;
+
+// The GPDMA reaches only the AHB SRAM banks (0x2007C000-0x20083FFF) and the
+// peripherals, not the local SRAM at 0x10000000 where .bss goes. A frame handed to
+// lcd_dma_start() must therefore be declared with LCD_DMA_FRAME_SECTION, which
+// lcd_dma.ld links into AHB SRAM bank 0 and checks at link time. The section is
+// NOLOAD: its contents are undefined until lcd_dma_frame_reset().
+#ifdef LPC17XX_HOST_SIM
+#define LCD_DMA_FRAME_SECTION
+#else
+#define LCD_DMA_FRAME_SECTION __attribute__((section(".ahbram")))
+#endif
+
+void lcd_dma_init(void);
+void lcd_dma_frame_reset(lcd_dma_frame *frame);
+int lcd_dma_frame_byte(lcd_dma_frame *frame, unsigned char data, unsigned char type);
+void lcd_dma_start(const lcd_dma_frame *frame);
+int lcd_dma_busy(void);
+void lcd_dma_wait(void);
+
+#endif
@@ -0,0 +1,73 @@
+// ============= LIBCALC.CPP =============
+// libcalc.so: the C ABI of libcalc.h over the constexpr port in calc_eval.hpp.
+// Built with -fvisibility=hidden, so only the CALC_API functions are exported.
+// ===================================
+
+#include <new>
+#include "libcalc.h"
+#include "calc_eval.hpp"
+
+static_assert(sizeof(calc::Keypad) <= sizeof(calc_keypad), "calc_keypad too small for calc::Keypad");
+static_assert(alignof(calc::Keypad) <= alignof(calc_keypad), "calc_keypad not aligned for calc::Keypad");
+static_assert(int(calc::Error::syntax) == CALC_ERR_SYNTAX && int(calc::Error::div_zero) == CALC_ERR_DIV_ZERO &&
+              int(calc::Error::stack) == CALC_ERR_STACK && int(calc::Error::expr_long) == CALC_ERR_EXPR_LONG &&
+              int(calc::Error::num_len) == CALC_ERR_NUM_LEN, "error codes out of step with calc_eval.hpp");
+static_assert(calc::run("2+3*4=").value == 14.0f, "library built from a broken evaluator");
+
+static calc_result to_c(calc::Result r)
+{
+    return calc_result{r.value, int32_t(r.error)};
+}
+
+static calc::Keypad* state(calc_keypad* keypad)
+{
+    return std::launder(reinterpret_cast<calc::Keypad*>(keypad->opaque));
+}
+
+extern "C" {
+
+int calc_abi_version(void)
+{
+    return CALC_ABI_VERSION;
+}
+
+const char* calc_error_message(int32_t error)
+{
+    if (error <= CALC_OK || error > CALC_ERR_NUM_LEN) {
+        return nullptr;
+    }
+    return calc::message(calc::Error(error));
+}
+
+int32_t calc_eval(const char* keys, calc_result* out)
+{
+    *out = to_c(calc::run(keys));
+    return out->error;
+}
+
+size_t calc_eval_batch(const char* const* exprs, size_t n, calc_result* out)
+{
+    size_t ok = 0;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = to_c(calc::run(exprs[i]));
+        ok += out[i].error == CALC_OK;
+    }
+    return ok;
+}
+
+void calc_keypad_init(calc_keypad* keypad)
+{
+    new (keypad->opaque) calc::Keypad{};
+}
+
+int calc_keypad_press(calc_keypad* keypad, char key, calc_result* out)
+{
+    calc::Result shown{};
+    if (!state(keypad)->press(key, shown)) {
+        return 0;
+    }
+    *out = to_c(shown);
+    return 1;
+}
+
+} // extern "C"
@@ -0,0 +1,83 @@
+// ============= LIBCALC.H =============
+// C ABI of libcalc.so, the calculator's input rules and evaluator for host tools
+// (Python ctypes, Go cgo, ...). Results match the firmware bit for bit: the
+// library is the constexpr port in calc_eval.hpp, which test_logic checks
+// against logic.c.
+//
+// The library holds no global state and allocates nothing: every call works on
+// the caller's buffers, so any number of threads may call it at once.
+//
+// Keys are typed as on the keypad, "0123456789+-*/=.", plus the keys of the
+// shift layer: 'C' clears, '<' is backspace and 'A' types the last result (ANS).
+// A key string ends at the first '=', the end of the string or the first error;
+// a missing '=' is implied. Only the keystroke API keeps a last result; in a key
+// string 'A' types 0.
+//
+// ABI rules: functions and error codes are only ever added, and the structs
+// below keep their size and layout. CALC_ABI_VERSION changes with the soname
+// (libcalc.so.1) only if that ever has to be broken.
+#ifndef LIBCALC_H
+#define LIBCALC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CALC_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define CALC_API __attribute__((visibility("default")))
+#else
+#define CALC_API
+#endif
+
+enum {
+    CALC_OK = 0,
+    CALC_ERR_SYNTAX = 1,    // "Err: Syntax"
+    CALC_ERR_DIV_ZERO = 2,  // "Err: Div Zero"
+    CALC_ERR_STACK = 3,     // "Err: Stack"
+    CALC_ERR_EXPR_LONG = 4, // "Err: Expr Long"
+    CALC_ERR_NUM_LEN = 5    // "Err: Num Len"
+};
+
+typedef struct {
+    float value;   // Result, 0 on error
+    int32_t error; // CALC_OK or CALC_ERR_*
+} calc_result;
+
+// State of the keystroke API. Owned by the caller, opaque, 8-byte aligned.
+typedef struct {
+    uint64_t opaque[64];
+} calc_keypad;
+
+// CALC_ABI_VERSION of the library loaded
+CALC_API int calc_abi_version(void);
+
+// The message the calculator shows for `error`, or NULL for CALC_OK and unknown codes
+CALC_API const char *calc_error_message(int32_t error);
+
+// Evaluates one key string; returns its error code
+CALC_API int32_t calc_eval(const char *keys, calc_result *out);
+
+// Evaluates exprs[0 .. n-1] into out[0 .. n-1]; returns how many had no error
+CALC_API size_t calc_eval_batch(const char *const *exprs, size_t n, calc_result *out);
+
+// Keystroke API: the calculator across calculations. After a result or an error,
+// the next key starts a new calculation and is taken as input, except '=' after
+// an error, which only clears. Input errors show at the key that causes them.
+// 'A' types the last result shown (0 after calc_keypad_init()), as the LCD shows
+// it; one in scientific notation cannot be typed and is CALC_ERR_NUM_LEN.
+CALC_API void calc_keypad_init(calc_keypad *keypad);
+
+// Presses one key; returns 1 if it brings up a result or an error (stored in
+// *out), 0 while input goes on. Any other character is a syntax error.
+CALC_API int calc_keypad_press(calc_keypad *keypad, char key, calc_result *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
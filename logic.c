@@ -4,34 +4,47 @@
 // ===================================
 
 #include "logic.h"
-#include "keypad.h" // For GetKeyPressed()
-#include "delay.h"  // For delay()
+#include "keypad.h" // For KeypadPoll()/KeypadNextKey()
+#include "delay.h"  // For delay()/uptime_us()
 #include "lcd.h"    // For lcdchar(), lcdstring()
+#include "ramfunc.h" // For CALC_RAMFUNC
+#include "fmt.h"     // For fmt_u64(), fmt_str()
+#include "diag.h"    // For the diagnostics counters and screen
+#include "event_trace.h" // For TRACE_EVENT()
 
-#include <stdio.h>   // For snprintf()
 #include <stdbool.h> // For bool type
-#include <math.h>    // For fabsf(), roundf()
-#include <string.h>  // For strlen(), strncpy(), strcat(), memset()
+#include <math.h>    // For fabsf(), roundf(), isnan(), isinf(), signbit()
+#include <string.h>  // For strlen(), strncpy(), memmove(), memset(), memcpy()
 
 // --- Defines ---
-#define MAX_DISPLAY_STR 32  // Max length for the full expression string history (not directly displayed fully)
 #define FLOAT_EPSILON 1e-7f // Epsilon for comparing float to integer and for division by zero check
 
 // --- Global Variables ---
 // Error State
-bool calculator_error = false;           // Flag: true if an error is currently active
-char error_message[ERROR_MSG_LEN] = {0}; // Buffer to store the current error message string
+SIM_LOCAL bool calculator_error = false;           // Flag: true if an error is currently active
+SIM_LOCAL char error_message[ERROR_MSG_LEN] = {0}; // Buffer to store the current error message string
 
 // Expression Storage (Shunting-Yard Intermediate Representation)
-char expr_type[MAX_TOKENS];  // Array to store the type of each token ('N' for number, 'O' for operator)
-float expr_data[MAX_TOKENS]; // Array to store the value of numbers or the char code of operators
-int expr_len = 0;            // Current number of tokens in the expression
+SIM_LOCAL char expr_type[MAX_TOKENS];  // Array to store the type of each token ('N' for number, 'O' for operator)
+SIM_LOCAL float expr_data[MAX_TOKENS]; // Array to store the value of numbers or the char code of operators
+SIM_LOCAL int expr_len = 0;            // Current number of tokens in the expression
 
-// Display Strings
-char expression_str[MAX_DISPLAY_STR];     // Stores the full infix expression string as entered by the user (for history/scrolling)
-int expression_index = 0;                 // Current length of the expression_str
-char current_num_str[LCD_LINE_LEN + 1]; // Stores the string for the number currently being typed by the user
-int current_num_index = 0;                // Current length of current_num_str
+// Current Input
+SIM_LOCAL char current_num_str[LCD_LINE_LEN + 1]; // Stores the string for the number currently being typed by the user
+SIM_LOCAL int current_num_index = 0;                // Current length of current_num_str
+
+// Calculator Context
+// Key handling, display and evaluation state, kept between calls so that keys can be
+// fed in one at a time and an evaluation can be spread over several slices.
+SIM_LOCAL calc_context calc_ctx = { .view = VIEW_SPLASH };
+
+// LCD DDRAM Mirror
+// Line 1 history is written once into the controller's 40-column DDRAM and scrolled into
+// view with the hardware display shift, so each key only transfers the new characters.
+static SIM_LOCAL bool lcd_history_valid = false; // False forces a full redraw (after clear, result or error)
+static SIM_LOCAL int lcd_history_tokens = 0;     // Number of tokens whose text is already in DDRAM line 1
+static SIM_LOCAL int lcd_history_chars = 0;      // Characters written to line 1 since the last full redraw
+static SIM_LOCAL int lcd_view_shift = 0;         // Current hardware display shift (columns, modulo 40)
 
 /**
  * @brief Sets the global error flag and stores the error message.
@@ -46,6 +59,7 @@ void set_error(const char* message) {
         return; // Preserve the first error encountered
     }
     calculator_error = true;
+    TRACE_EVENT(EVT_ERROR, event_trace_error_arg(message));
     strncpy(error_message, message, ERROR_MSG_LEN - 1);
     error_message[ERROR_MSG_LEN - 1] = '\0'; // Ensure null termination
 }
@@ -58,64 +72,541 @@ void set_error(const char* message) {
  */
 void clear_all_state() { 
     expr_len = 0;
-    expression_index = 0;
     current_num_index = 0;
 
-    memset(expression_str, 0, sizeof(expression_str));
     memset(current_num_str, 0, sizeof(current_num_str));
     // expr_type and expr_data do not need explicit clearing as their usage is governed by expr_len.
     
     calculator_error = false;
     error_message[0] = '\0';
+    lcd_history_valid = false; // History shrank; the DDRAM copy is stale
+}
+
+/**
+ * @brief Splits a finite float into `mant * 2^exp` with an integer mantissa.
+ */
+static uint32_t float_parts(float value, int* exp) {
+    union { float f; uint32_t u; } bits = { .f = value };
+    int biased = (int)((bits.u >> 23) & 0xFF);
+    uint32_t mant = bits.u & 0x7FFFFF;
+
+    if (biased == 0) { // Zero or subnormal
+        *exp = -149;
+        return mant;
+    }
+    *exp = biased - 150;
+    return mant | 0x800000;
 }
 
 /**
- * @brief Updates the LCD display with the current expression string and current number input.
+ * @brief Writes the exact decimal digits of a non-negative, integer-valued float.
  * 
- * Line 1 of the LCD shows the a portion of the historical expression string.
- * Line 2 of the LCD shows the number currently being typed.
- * This function is typically called after each key press that modifies the input.
- * It does not handle error message display; that's done in RunCalculatorLogic.
+ * Values below 2^63 use 64-bit arithmetic; larger ones (up to FLT_MAX, 39 digits) are
+ * built up by doubling a number held in base-10^9 limbs.
+ * @return Number of digits written (the buffer is not terminated).
  */
-void update_lcd_display_content() { 
-    char display_buffer_line1[LCD_LINE_LEN + 1] = {0};
-    char display_buffer_line2[LCD_LINE_LEN + 1] = {0};
-    int start_pos;
+static int float_integer_digits(float value, char* digits) {
+    int exp;
+    uint32_t mant = float_parts(value, &exp);
+    uint32_t limbs[5]; // Least significant first, 9 digits each
+    int used = 1, len, i;
 
-    // Prepare Line 1: Historical expression string (last LCD_LINE_LEN characters)
-    if (expression_index > 0) {
-        start_pos = (expression_index > LCD_LINE_LEN) ? (expression_index - LCD_LINE_LEN) : 0;
-        strncpy(display_buffer_line1, &expression_str[start_pos], LCD_LINE_LEN);
+    if (exp <= 0) {
+        return fmt_u64(digits, (exp > -32) ? (uint64_t)(mant >> -exp) : 0);
+    }
+    if (exp <= 39) {
+        return fmt_u64(digits, (uint64_t)mant << exp);
+    }
+    limbs[0] = mant; // Below 2^24, so one limb
+    while (exp-- > 0) {
+        uint32_t carry = 0;
+        for (i = 0; i < used; i++) {
+            uint32_t doubled = limbs[i] * 2 + carry;
+            carry = doubled >= 1000000000UL;
+            limbs[i] = carry ? doubled - 1000000000UL : doubled;
+        }
+        if (carry) {
+            limbs[used++] = 1;
+        }
     }
+    len = fmt_u64(digits, limbs[used - 1]);
+    for (i = used - 2; i >= 0; i--) { // Lower limbs with their leading zeros
+        uint32_t limb = limbs[i];
+        int d;
+        for (d = 8; d >= 0; d--) {
+            digits[len + d] = (char)('0' + limb % 10);
+            limb /= 10;
+        }
+        len += 9;
+    }
+    return len;
+}
 
-    // Prepare Line 2: Current number being typed
-    if (current_num_index > 0) {
-        strncpy(display_buffer_line2, current_num_str, LCD_LINE_LEN);
+/**
+ * @brief Formats `digits` (a decimal integer of `n` >= 4 digits) as d.ddde+XX.
+ * 
+ * Rounds to four significant digits, ties to even, as printf's "%.3e" does.
+ * @return Length written to `out` (not terminated).
+ */
+static int format_scientific(const char* digits, int n, bool negative, char* out) {
+    char m[4] = { digits[0], digits[1], digits[2], digits[3] };
+    int exp10 = n - 1, len = 0, i;
+    bool sticky = false;
+
+    for (i = 5; i < n; i++) {
+        sticky |= digits[i] != '0';
     }
-    // If no current number and no expression history, Line 2 remains blank.
-    
-    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); // 'C' for command
-    delay(20); // Delay for LCD command processing
-    lcdstring(display_buffer_line1);
-    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); 
-    delay(5); // Delay for LCD command processing
-    lcdstring(display_buffer_line2);
+    if (n > 4 && (digits[4] > '5' || (digits[4] == '5' && (sticky || ((m[3] - '0') & 1))))) {
+        for (i = 3; i >= 0 && m[i] == '9'; i--) {
+            m[i] = '0';
+        }
+        if (i >= 0) {
+            m[i]++;
+        } else { // 9999 rounded up to 10000
+            m[0] = '1';
+            exp10++;
+        }
+    }
+    if (negative) {
+        out[len++] = '-';
+    }
+    out[len++] = m[0];
+    out[len++] = '.';
+    out[len++] = m[1];
+    out[len++] = m[2];
+    out[len++] = m[3];
+    out[len++] = 'e';
+    out[len++] = '+';
+    if (exp10 < 10) {
+        out[len++] = '0';
+    }
+    len += fmt_u64(out + len, (uint64_t)exp10);
+    return len;
 }
 
 /**
- * @brief Appends a string (typically a number or operator) to the historical expression string.
+ * @brief Formats a number the way the calculator shows it on the LCD.
  * 
- * This string (`expression_str`) is used by `update_lcd_display_content` to show
- * the expression history on the first line of the LCD.
- * @param str_to_add The string to append.
+ * Integers are shown without a decimal point, other values have trailing zeros
+ * removed, and values that do not fit in LCD_LINE_LEN characters fall back to
+ * scientific notation.
+ * The digits are produced with integer arithmetic and match printf's "%.0f", "%f"
+ * (trimmed) and "%.3e" exactly, without the C library's formatter, which can
+ * allocate from the heap.
+ * @param value The number to format.
+ * @param buf Output buffer; must hold at least LCD_LINE_LEN + 1 characters.
+ * @param buf_size Size of `buf` in bytes.
+ * @return Length of the formatted string, or -1 if the value cannot be shown in
+ *         LCD_LINE_LEN characters (the contents of `buf` are then unspecified).
  */
-void add_to_expression_string(const char* str_to_add) {
-    int len_to_add = strlen(str_to_add);
-    if (expression_index + len_to_add < MAX_DISPLAY_STR - 1) { // Check against buffer size
-        strcat(expression_str, str_to_add);
-        expression_index += len_to_add;
+int format_number(float value, char* buf, int buf_size) {
+    char text[48]; // Sign, the 39 digits of FLT_MAX and a terminator
+    bool negative = signbit(value) != 0;
+    int len = 0;
+
+    if (isnan(value)) {
+        len = fmt_str(text, 0, "nan");
+    } else if (isinf(value)) {
+        len = fmt_str(text, 0, negative ? "-inf" : "inf");
+    } else if (fabsf(value - roundf(value)) < FLOAT_EPSILON) {
+        // Effectively an integer: the digits of the nearest one
+        if (negative) {
+            text[len++] = '-';
+        }
+        len += float_integer_digits(fabsf(roundf(value)), text + len);
+        text[len] = '\0';
+        // Too long for the display: try scientific notation instead
+        if (len > LCD_LINE_LEN) {
+            len = format_scientific(text + negative, len - negative, negative, text);
+            text[len] = '\0';
+        }
+    } else {
+        // Six decimals as "%f", then trailing zeros and the decimal point trimmed.
+        // Only values below 2^23 get here (larger floats are integers), so the
+        // scaled value fits in 64 bits: mant * 10^6 < 2^44.
+        int exp, frac_digits = 6;
+        uint64_t scaled = (uint64_t)float_parts(value, &exp) * 1000000ULL;
+        uint32_t frac;
+
+        if (exp < 0) {
+            int shift = -exp;
+            uint64_t q = (shift < 64) ? scaled >> shift : 0;
+            if (shift < 64) {
+                uint64_t rem = scaled & ((1ULL << shift) - 1);
+                uint64_t half = 1ULL << (shift - 1);
+                if (rem > half || (rem == half && (q & 1))) {
+                    q++;
+                }
+            }
+            scaled = q;
+        } else {
+            scaled <<= exp;
+        }
+        if (negative) {
+            text[len++] = '-';
+        }
+        len += fmt_u64(text + len, scaled / 1000000ULL);
+        frac = (uint32_t)(scaled % 1000000ULL);
+        while (frac_digits > 0 && frac % 10 == 0) {
+            frac /= 10;
+            frac_digits--;
+        }
+        if (frac_digits > 0) {
+            int d;
+            text[len++] = '.';
+            for (d = frac_digits - 1; d >= 0; d--) {
+                text[len + d] = (char)('0' + frac % 10);
+                frac /= 10;
+            }
+            len += frac_digits;
+        }
+        text[len] = '\0';
+    }
+
+    // Copy with snprintf's truncation rules; the full length is still reported
+    if (buf_size > 0) {
+        int n = (len < buf_size - 1) ? len : buf_size - 1;
+        memcpy(buf, text, n);
+        buf[n] = '\0';
     }
-    // If buffer is full, further additions are ignored to prevent overflow.
+    return (len > LCD_LINE_LEN) ? -1 : len;
+}
+
+/**
+ * @brief Converts typed number text to a float, digit by digit as it was typed.
+ * 
+ * This is the calculator's own conversion, which is not always the nearest float
+ * to the decimal text. The history is rendered so that this conversion gives the
+ * token back (see `format_typed_number`).
+ * @param text Digits with an optional leading '-' and at most one '.'.
+ * @param len Number of characters of `text`.
+ * @param ok Set to false for a second decimal point or any other character.
+ * @return The number, or 0.0f if `*ok` is false.
+ */
+static float parse_number_text(const char* text, int len, bool* ok) {
+    float result = 0.0f;
+    float decimal_multiplier = 0.1f; // For digits after decimal point
+    bool in_decimal_part = false;    // Flag to track if we are parsing the fractional part
+    bool is_negative_num = false;
+    int start_idx = 0;               // Starting index for parsing (0, or 1 if negative)
+
+    *ok = true;
+    if (len > 0 && text[0] == '-') {
+        is_negative_num = true;
+        start_idx = 1;
+    }
+
+    for (int i = start_idx; i < len; i++) {
+        if (text[i] == '.') {
+            if (in_decimal_part) { // Already encountered a decimal point
+                *ok = false;
+                return 0.0f;
+            }
+            in_decimal_part = true;
+        } else if (text[i] >= '0' && text[i] <= '9') {
+            int digit = text[i] - '0';
+            if (!in_decimal_part) {
+                result = result * 10.0f + digit; // Accumulate integer part
+            } else {
+                result += digit * decimal_multiplier; // Accumulate fractional part
+                decimal_multiplier *= 0.1f;
+            }
+        } else {
+            *ok = false;
+            return 0.0f;
+        }
+    }
+    return is_negative_num ? -result : result;
+}
+
+/**
+ * @brief Writes the exact decimal digits of a finite, non-negative float.
+ * 
+ * A float is mant * 2^exp; with exp < 0 that is mant * 5^-exp / 10^-exp, so the
+ * digits are those of mant * 5^-exp, built in base-10^9 limbs, with -exp of them
+ * after the decimal point. Up to 113 digits (the smallest subnormal).
+ * @param frac_digits Set to the number of digits after the decimal point.
+ * @return Number of digits written (the buffer is not terminated).
+ */
+static int float_exact_digits(float value, char* digits, int* frac_digits) {
+    int exp;
+    uint32_t mant = float_parts(value, &exp);
+    uint32_t limbs[14]; // Least significant first, 9 digits each
+    int used = 1, k, len, i;
+
+    if (exp >= 0) {
+        *frac_digits = 0;
+        return float_integer_digits(value, digits);
+    }
+    limbs[0] = mant % 1000000000UL;
+    if (mant >= 1000000000UL) {
+        limbs[used++] = mant / 1000000000UL;
+    }
+    for (k = -exp; k > 0; k -= 12) { // 5^12 per pass keeps each product below 2^64
+        uint32_t factor = 244140625UL, carry = 0; // 5^12
+        if (k < 12) {
+            for (factor = 1, i = 0; i < k; i++) {
+                factor *= 5;
+            }
+        }
+        for (i = 0; i < used; i++) {
+            uint64_t product = (uint64_t)limbs[i] * factor + carry;
+            limbs[i] = (uint32_t)(product % 1000000000UL);
+            carry = (uint32_t)(product / 1000000000UL);
+        }
+        if (carry) {
+            limbs[used++] = carry;
+        }
+    }
+    len = fmt_u64(digits, limbs[used - 1]);
+    for (i = used - 2; i >= 0; i--) { // Lower limbs with their leading zeros
+        uint32_t limb = limbs[i];
+        int d;
+        for (d = 8; d >= 0; d--) {
+            digits[len + d] = (char)('0' + limb % 10);
+            limb /= 10;
+        }
+        len += 9;
+    }
+    *frac_digits = -exp;
+    return len;
+}
+
+/**
+ * @brief Lays out decimal digits as the calculator types a number.
+ * 
+ * @param digits `n` digits, of which the last `n - point` are after the decimal
+ *        point (`point` may be negative or zero for values below 1).
+ * @param text Output; must hold LCD_LINE_LEN + 1 characters.
+ * @return Length of the text (leading and trailing zeros trimmed), or -1 if it
+ *         would be longer than LCD_LINE_LEN characters.
+ */
+static int layout_digits(const char* digits, int n, int point, bool negative, char* text) {
+    int first, last, i, len = 0;
+
+    for (last = n; last > point && last > 0 && digits[last - 1] == '0'; last--) {
+    }
+    for (first = 0; first < point - 1 && digits[first] == '0'; first++) {
+    }
+    if ((point > 0 ? point - first : 1) + (last > point ? last - point + 1 : 0) + negative > LCD_LINE_LEN) {
+        return -1;
+    }
+    if (negative) {
+        text[len++] = '-';
+    }
+    if (point <= 0) {
+        text[len++] = '0';
+    }
+    for (i = first; i < point; i++) {
+        text[len++] = digits[i];
+    }
+    if (last > point) {
+        text[len++] = '.';
+        for (i = point; i < last; i++) { // Positions before the digits are zeros
+            text[len++] = (i < 0) ? '0' : digits[i];
+        }
+    }
+    text[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Adds `delta` (+1 or -1) to the decimal digit string at position `at`.
+ * 
+ * `digits[0]` must be a '0' above the significant digits, to absorb a carry.
+ * @return false if the result would be negative.
+ */
+static bool step_digit(char* digits, int at, int delta) {
+    int i;
+
+    for (i = at; i >= 0 && digits[i] == (delta > 0 ? '9' : '0'); i--) {
+        digits[i] = (delta > 0) ? '0' : '9';
+    }
+    if (i < 0) {
+        return false;
+    }
+    digits[i] = (char)(digits[i] + delta);
+    return true;
+}
+
+/**
+ * @brief Formats a number token of the history as the shortest text that types it.
+ * 
+ * `parse_number_text` is not always the nearest conversion, so the text a number
+ * was typed as is not always the nearest decimal of its float. For 1 to 9
+ * significant digits, the value rounded half to even and the decimals one unit
+ * below and above it are tried, and the first that `parse_number_text` turns back
+ * into `value` is taken. A number therefore shows as it was typed (9999.99, not
+ * 9999.990234) up to the precision of a float. If none does, the nearest 9-digit
+ * decimal is shown. Values whose text would not fit in LCD_LINE_LEN characters
+ * are shown as `format_number` shows them.
+ * @param buf Output buffer; must hold at least LCD_LINE_LEN + 1 characters.
+ * @return Length of the text, or -1 as from `format_number`.
+ */
+static int format_typed_number(float value, char* buf) {
+    static const signed char deltas[3] = { 0, -1, 1 };
+    char exact[120]; // A '0' for the carry, then up to 113 digits
+    char rounded[120], candidate[120];
+    bool negative = signbit(value) != 0;
+    int frac_digits, n, point, first, p, d, i, len = -1;
+
+    if (isnan(value) || isinf(value)) {
+        return format_number(value, buf, LCD_LINE_LEN + 1);
+    }
+    exact[0] = '0';
+    n = 1 + float_exact_digits(fabsf(value), exact + 1, &frac_digits);
+    point = n - frac_digits;
+    for (first = 0; first < n && exact[first] == '0'; first++) {
+    }
+    if (first == n) { // Zero
+        return fmt_str(buf, 0, negative ? "-0" : "0");
+    }
+    for (p = 1; p <= 9; p++) {
+        int keep = first + p;
+        bool sticky = false, ok;
+
+        memcpy(rounded, exact, (size_t)n);
+        if (keep < n) { // Round to p significant digits, ties to even
+            for (i = keep + 1; i < n; i++) {
+                sticky |= exact[i] != '0';
+            }
+            if (exact[keep] > '5' || (exact[keep] == '5' && (sticky || ((exact[keep - 1] - '0') & 1)))) {
+                step_digit(rounded, keep - 1, 1); // exact[0] is '0', so the carry stops there
+            }
+            memset(rounded + keep, '0', (size_t)(n - keep));
+        } else {
+            keep = n;
+        }
+        for (d = 0; d < 3; d++) {
+            memcpy(candidate, rounded, (size_t)n);
+            if (deltas[d] != 0 && !step_digit(candidate, keep - 1, deltas[d])) {
+                continue;
+            }
+            len = layout_digits(candidate, n, point, negative, buf);
+            if (len > 0 && parse_number_text(buf, len, &ok) == value && ok) {
+                return len;
+            }
+        }
+    }
+    len = layout_digits(rounded, n, point, negative, buf); // The nearest 9 digits
+    return (len > 0) ? len : format_number(value, buf, LCD_LINE_LEN + 1);
+}
+
+/**
+ * @brief Formats a single expression token as it appears in the history.
+ * 
+ * @param index Token index (0 to expr_len - 1).
+ * @param buf Output buffer; must hold at least LCD_LINE_LEN + 1 characters.
+ * @return Length of the token text.
+ */
+static int format_expression_token(int index, char* buf) {
+    if (expr_type[index] == 'O') {
+        buf[0] = (char)expr_data[index];
+        buf[1] = '\0';
+        return 1;
+    }
+    int len = format_typed_number(expr_data[index], buf);
+    if (len < 0) { // Cannot happen for typed input, but never show garbage
+        buf[0] = '?';
+        buf[1] = '\0';
+        len = 1;
+    }
+    return len;
+}
+
+/**
+ * @brief Renders the tail of the expression history from the token arrays.
+ * 
+ * The history is not stored as text; instead the tokens are walked backwards and
+ * formatted one at a time until `width` characters have been produced, so the cost
+ * depends on the visible width rather than on the length of the expression.
+ * @param out Output buffer; must hold at least `width` + 1 characters.
+ * @param width Maximum number of characters to produce (e.g. LCD_LINE_LEN).
+ * @return Number of characters written to `out` (excluding the null terminator).
+ */
+int render_expression_tail(char* out, int width) {
+    char token_buf[LCD_LINE_LEN + 1];
+    int filled = 0; // Characters placed so far, growing leftwards from out[width - 1]
+
+    for (int i = expr_len - 1; i >= 0 && filled < width; i--) {
+        int len = format_expression_token(i, token_buf);
+        while (len > 0 && filled < width) {
+            out[width - 1 - filled++] = token_buf[--len];
+        }
+    }
+
+    memmove(out, out + width - filled, filled);
+    out[filled] = '\0';
+    return filled;
+}
+
+/**
+ * @brief Marks the LCD contents as unknown so the next update redraws everything.
+ * 
+ * Must be called whenever the display is cleared or overwritten outside of
+ * `update_lcd_display_content` (results, errors, the start-up message).
+ */
+static void invalidate_lcd_history(void) {
+    lcd_history_valid = false;
+}
+
+/**
+ * @brief Updates the LCD display with the current expression history and current number input.
+ * 
+ * Line 1 of the LCD shows the last LCD_LINE_LEN characters of the expression history.
+ * After a full redraw, newly pushed tokens are appended to the off-screen part of DDRAM
+ * line 1 and the display window is moved with the controller's display-shift command,
+ * instead of clearing and rewriting the whole line. DDRAM is used as a ring of 40
+ * columns, matching the wrap-around of the hardware shift.
+ * Line 2 of the LCD shows the number currently being typed, written at the columns that
+ * are currently visible.
+ * This function is typically called after each key press that modifies the input.
+ * It does not handle error message display; that is done in calc_render.
+ */
+void update_lcd_display_content() { 
+    char text[LCD_LINE_LEN + 1];
+    int len;
+
+    lcd_frame_begin(); // With the DMA backend, everything below is sent as one frame
+
+    if (!lcd_history_valid || lcd_history_tokens > expr_len) {
+        // Full redraw: clear (which also cancels the display shift) and write the visible tail
+        lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); // 'C' for command; lcdchar waits out the clear
+        len = render_expression_tail(text, LCD_LINE_LEN);
+        lcdstring(text);
+        lcd_history_chars = len;
+        lcd_history_tokens = expr_len;
+        lcd_view_shift = 0;
+        lcd_history_valid = true;
+    } else {
+        // Incremental update: append only the tokens pushed since the last update
+        for (; lcd_history_tokens < expr_len; lcd_history_tokens++) {
+            len = format_expression_token(lcd_history_tokens, text);
+            lcd_write_at(0, lcd_history_chars % LCD_DDRAM_LINE_LEN, text, len);
+            lcd_history_chars += len;
+        }
+        // Keep lcd_history_chars bounded; only its value modulo the DDRAM width matters now
+        if (lcd_history_chars > LCD_LINE_LEN + LCD_DDRAM_LINE_LEN) {
+            lcd_history_chars -= LCD_DDRAM_LINE_LEN;
+        }
+    }
+
+    // Scroll so that the last LCD_LINE_LEN history characters are visible
+    if (lcd_history_chars > LCD_LINE_LEN) {
+        int target_shift = (lcd_history_chars - LCD_LINE_LEN) % LCD_DDRAM_LINE_LEN;
+        int steps = (target_shift - lcd_view_shift + LCD_DDRAM_LINE_LEN) % LCD_DDRAM_LINE_LEN;
+        lcd_shift_display_left((unsigned char)steps);
+        lcd_view_shift = target_shift;
+    }
+
+    // Line 2: current number, padded with spaces to overwrite whatever was visible before
+    memset(text, ' ', LCD_LINE_LEN);
+    if (current_num_index > 0) {
+        memcpy(text, current_num_str, current_num_index);
+    }
+    lcd_write_at(1, lcd_view_shift, text, LCD_LINE_LEN);
+
+    lcd_frame_end();
 }
 
 /**
@@ -138,7 +629,7 @@ void push_operand_to_expr(float num) {
 }
 
 /**
- * @brief Pushes an operator onto the internal expression stack and its string to display history.
+ * @brief Pushes an operator onto the internal expression stack.
  * 
  * Sets an error if an error is already active or if the expression token limit is reached.
  * @param op_char The character representing the operator (e.g., '+', '-').
@@ -154,9 +645,6 @@ void push_operator_to_expr(char op_char) {
     expr_type[expr_len] = 'O'; // 'O' for Operator
     expr_data[expr_len] = (float)op_char; // Store operator char as a float for type consistency in expr_data
     expr_len++;
-    
-    char op_str[2] = {op_char, '\0'};
-    add_to_expression_string(op_str); // Add operator to the display string
 }
 
 /**
@@ -164,9 +652,9 @@ void push_operator_to_expr(char op_char) {
  * 
  * Higher return value means higher precedence. Used by `evaluate_full_expression`.
  * @param op The operator character.
- * @return Precedence level (1 for +/-, 2 for */, 0 otherwise).
+ * @return Precedence level (1 for + and -, 2 for * and /, 0 otherwise).
  */
-int get_precedence(char op) {
+CALC_RAMFUNC int get_precedence(char op) {
     if (op == '+' || op == '-') {
         return 1;
     }
@@ -186,7 +674,7 @@ int get_precedence(char op) {
  * @param b The second (right) operand.
  * @return The result of the operation, or 0.0f if an error occurs.
  */
-float execute_apply_operator(char op, float a, float b) {
+CALC_RAMFUNC float execute_apply_operator(char op, float a, float b) {
     if (calculator_error) { // Should ideally be checked before calling
         return 0.0f; 
     }
@@ -210,104 +698,175 @@ float execute_apply_operator(char op, float a, float b) {
 }
 
 /**
- * @brief Evaluates the current expression stored in `expr_type` and `expr_data`.
- * 
- * This function implements a simplified version of the shunting-yard algorithm
- * (or rather, direct evaluation using two stacks for numbers and operators)
- * to handle operator precedence.
- * - It iterates through the tokenized expression (`expr_type`, `expr_data`).
- * - Numbers are pushed onto a value stack.
- * - Operators are pushed onto an operator stack, maintaining precedence rules:
- *   If the current operator has lower or equal precedence than the operator
- *   at the top of the operator stack, the stack's top operator is applied to
- *   values from the value stack, and the result is pushed back to the value stack.
- * - After processing all tokens, any remaining operators on the stack are applied.
- * - The final result should be the single remaining value on the value stack.
+ * @brief Finishes the evaluation in progress with `result`.
+ */
+static void evaluate_finish(float result) {
+    calc_ctx.eval.result = result;
+    calc_ctx.eval.phase = EVAL_DONE;
+}
+
+/**
+ * @brief Applies the operator on top of the operator stack to the top two values.
+ * @return false if an error was set (missing operand, division by zero).
+ */
+CALC_RAMFUNC static bool evaluate_apply_top(calc_eval_state* ev) {
+    if (ev->val_top < 1) { // Not enough operands on value stack
+        set_error("Err: Syntax"); 
+        return false; 
+    }
+    char op_to_apply = ev->op_stack[ev->op_top--];
+    float b_val = ev->val_stack[ev->val_top--];
+    float a_val = ev->val_stack[ev->val_top--];
+    ev->val_stack[++ev->val_top] = execute_apply_operator(op_to_apply, a_val, b_val);
+    return !calculator_error; // execute_apply_operator may set an error (e.g., Div Zero)
+}
+
+/**
+ * @brief Starts a resumable evaluation of the expression in `expr_type` and `expr_data`.
  * 
- * Sets various errors ("Err: Syntax", "Err: Stack") if issues are found during evaluation.
- * @return The calculated result of the expression, or 0.0f if an error occurs.
+ * The evaluation state lives in `calc_ctx.eval`; `evaluate_step` advances it. Trivial
+ * cases (an error already set, an empty expression, a trailing operator, a single
+ * number) are finished here.
  */
-float evaluate_full_expression() {
+void evaluate_begin(void) {
+    calc_eval_state* ev = &calc_ctx.eval;
+
+    ev->phase = EVAL_TOKENS;
+    ev->next_token = 0;
+    ev->val_top = -1;
+    ev->op_top = -1;
+    ev->result = 0.0f;
+    ev->ops = 0;
+    ev->slices = 0;
+    ev->slice_max_us = 0;
+    ev->compute_us = 0;
+    ev->started_at = uptime_us();
+    ev->elapsed_us = 0;
+    DIAG_EVAL_BEGIN();
+
     if (calculator_error) { // If error already set (e.g. during input parsing)
-        return 0.0f; 
+        evaluate_finish(0.0f);
+        return; 
     }
     if (expr_len == 0) { // Empty expression
-        return 0.0f; 
+        evaluate_finish(0.0f);
+        return; 
     }
 
     // Check for trailing operator: e.g. "5 + ="
     // An expression like "5 =" (expr_len=1, type='N') is valid.
-    if (expr_len > 0 && expr_type[expr_len - 1] == 'O') {
+    if (expr_type[expr_len - 1] == 'O') {
         // This check ensures that an operator is not the last thing in a multi-token expression.
         // A single number is fine (expr_len=1, expr_type[0]=='N').
         // A single operator (expr_len=1, expr_type[0]=='O') would also be caught here if not desired.
         // However, current input logic aims to prevent pushing just an operator if expr_len is 0.
         set_error("Err: Syntax"); 
-        return 0.0f;
+        evaluate_finish(0.0f);
+        return;
     }
     
     // If only a single number was pushed (e.g., "5="), return that number.
     if (expr_len == 1 && expr_type[0] == 'N') {
-        return expr_data[0];
+        evaluate_finish(expr_data[0]);
     }
+}
 
-    float val_stack[MAX_TOKENS]; // Stack for numbers/operands
-    char op_stack[MAX_TOKENS];   // Stack for operator characters
-    int val_top = -1, op_top = -1;
+/**
+ * @brief Advances the evaluation started by `evaluate_begin` by at most `max_ops` operations.
+ * 
+ * This is a simplified version of the shunting-yard algorithm (direct evaluation using
+ * two stacks for numbers and operators) to handle operator precedence:
+ * - Numbers are pushed onto a value stack.
+ * - Operators are pushed onto an operator stack, maintaining precedence rules:
+ *   If the current operator has lower or equal precedence than the operator
+ *   at the top of the operator stack, the stack's top operator is applied to
+ *   values from the value stack, and the result is pushed back to the value stack.
+ * - After processing all tokens, any remaining operators on the stack are applied.
+ * - The final result should be the single remaining value on the value stack.
+ * 
+ * One operation is pushing one token or applying one operator, so an expression of
+ * n tokens takes fewer than 2n operations. Between calls the position and both stacks
+ * are kept in `calc_ctx.eval`, which lets the caller return to other work (key scans,
+ * LCD updates) between slices.
+ * 
+ * Sets various errors ("Err: Syntax", "Err: Stack", "Err: Div Zero") if issues are
+ * found during evaluation; the result is then 0.0f.
+ * @param max_ops Operation budget for this call.
+ * @return true once the evaluation has finished (result in `calc_ctx.eval.result`).
+ */
+CALC_RAMFUNC bool evaluate_step(int max_ops) {
+    calc_eval_state* ev = &calc_ctx.eval;
+    int ops = 0;
 
-    for (int i = 0; i < expr_len; i++) {
-        if (expr_type[i] == 'N') { // Token is a number
-            if (val_top >= MAX_TOKENS - 1) { // Value stack overflow
-                set_error("Err: Stack"); 
-                return 0.0f;
+    while (ev->phase != EVAL_DONE && ev->phase != EVAL_IDLE && ops < max_ops) {
+        if (ev->phase == EVAL_TOKENS) {
+            int i = ev->next_token;
+            if (i >= expr_len) {
+                ev->phase = EVAL_DRAIN; // All tokens read; apply the remaining operators
+                continue;
             }
-            val_stack[++val_top] = expr_data[i];
-        } else { // Token is an operator
-            char current_op_char = (char)expr_data[i];
-            // While operator stack is not empty, and top operator has higher or equal precedence
-            while (op_top >= 0 && get_precedence(op_stack[op_top]) >= get_precedence(current_op_char)) {
-                if (val_top < 1) { // Not enough operands on value stack
-                    set_error("Err: Syntax"); 
-                    return 0.0f; 
+            if (expr_type[i] == 'N') { // Token is a number
+                if (ev->val_top >= MAX_TOKENS - 1) { // Value stack overflow
+                    set_error("Err: Stack"); 
+                    evaluate_finish(0.0f);
+                    break;
                 }
-                char op_to_apply = op_stack[op_top--];
-                float b_val = val_stack[val_top--];
-                float a_val = val_stack[val_top--];
-                val_stack[++val_top] = execute_apply_operator(op_to_apply, a_val, b_val);
-                if (calculator_error) { // Check if execute_apply_operator set an error (e.g., Div Zero)
-                    return 0.0f; 
+                ev->val_stack[++ev->val_top] = expr_data[i];
+                ev->next_token++;
+            } else { // Token is an operator
+                char current_op_char = (char)expr_data[i];
+                // While operator stack is not empty, and top operator has higher or equal precedence,
+                // apply it (one per operation; the token is read again afterwards)
+                if (ev->op_top >= 0 && get_precedence(ev->op_stack[ev->op_top]) >= get_precedence(current_op_char)) {
+                    if (!evaluate_apply_top(ev)) {
+                        evaluate_finish(0.0f);
+                        break;
+                    }
+                } else {
+                    // Push current operator onto operator stack
+                    if (ev->op_top >= MAX_TOKENS - 1) { // Operator stack overflow
+                        set_error("Err: Stack"); 
+                        evaluate_finish(0.0f);
+                        break;
+                    }
+                    ev->op_stack[++ev->op_top] = current_op_char;
+                    ev->next_token++;
                 }
             }
-            // Push current operator onto operator stack
-            if (op_top >= MAX_TOKENS - 1) { // Operator stack overflow
-                set_error("Err: Stack"); 
-                return 0.0f;
+        } else { // EVAL_DRAIN
+            if (ev->op_top < 0) {
+                // The final result should be the only item left on the value stack
+                if (ev->val_top != 0) { 
+                    set_error("Err: Syntax"); // Should indicate an issue with expression structure or evaluation logic
+                    evaluate_finish(0.0f);
+                } else {
+                    evaluate_finish(ev->val_stack[0]);
+                }
+                break;
+            }
+            if (!evaluate_apply_top(ev)) {
+                evaluate_finish(0.0f);
+                break;
             }
-            op_stack[++op_top] = current_op_char;
-        }
-    }
-
-    // After all tokens are processed, apply any remaining operators on the stack
-    while (op_top >= 0) {
-        if (val_top < 1) { // Not enough operands
-            set_error("Err: Syntax"); 
-            return 0.0f; 
-        }
-        char op_to_apply = op_stack[op_top--];
-        float b_val = val_stack[val_top--];
-        float a_val = val_stack[val_top--];
-        val_stack[++val_top] = execute_apply_operator(op_to_apply, a_val, b_val);
-        if (calculator_error) {
-            return 0.0f;
         }
+        ops++;
     }
+    ev->ops += ops;
+    return ev->phase == EVAL_DONE;
+}
 
-    // The final result should be the only item left on the value stack
-    if (val_top != 0) { 
-        set_error("Err: Syntax"); // Should indicate an issue with expression structure or evaluation logic
-        return 0.0f;
+/**
+ * @brief Evaluates the current expression stored in `expr_type` and `expr_data` in one go.
+ * 
+ * Runs `evaluate_begin` and `evaluate_step` to completion.
+ * Sets various errors ("Err: Syntax", "Err: Stack") if issues are found during evaluation.
+ * @return The calculated result of the expression, or 0.0f if an error occurs.
+ */
+CALC_RAMFUNC float evaluate_full_expression() {
+    evaluate_begin();
+    while (!evaluate_step(2 * MAX_TOKENS)) {
     }
-    return val_stack[val_top];
+    return calc_ctx.eval.result;
 }
 
 /**
@@ -318,7 +877,7 @@ float evaluate_full_expression() {
  * - Standalone "-" or "." (sets "Err: Syntax").
  * - Positive and negative integers and floating-point numbers.
  * - Multiple decimal points (sets "Err: Syntax").
- * - Invalid characters (though input filtering in `RunCalculatorLogic` should prevent this).
+ * - Invalid characters (though input filtering in `calc_ui_key` should prevent this).
  * 
  * @return The parsed floating-point number. If parsing fails, an error is set via `set_error()`,
  *         and this function returns 0.0f.
@@ -333,297 +892,520 @@ float parse_current_input_number() {
         return 0.0f;
     }
     if (current_num_index == 1 && current_num_str[0] == '.') {
-        // Input logic in RunCalculatorLogic should turn "." into "0."
+        // Input logic in calc_ui_key should turn "." into "0."
         // If somehow "." reaches here alone, it's a syntax error.
         set_error("Err: Syntax");
         return 0.0f;
     }
     // Note: "123." is a valid input during typing; it's parsed as 123.0.
 
-    float result = 0.0f;
-    float decimal_multiplier = 0.1f; // For digits after decimal point
-    bool in_decimal_part = false;    // Flag to track if we are parsing the fractional part
-    bool is_negative_num = false;
-    int start_idx = 0;               // Starting index for parsing (0, or 1 if negative)
+    bool ok;
+    float result = parse_number_text(current_num_str, current_num_index, &ok);
+    if (!ok) { // Multiple decimal points, or a character calc_ui_key should have filtered
+        set_error("Err: Syntax");
+        return 0.0f;
+    }
+    return result;
+}
 
-    if (current_num_str[0] == '-') {
-        is_negative_num = true;
-        start_idx = 1;
+/**
+ * @brief Marks the view as changed so `calc_render` draws it.
+ * 
+ * A key (or the result after it) that changes the view while an earlier change is
+ * still waiting for its frame is merged into that frame; the earlier state is never
+ * drawn and is counted in `frames_skipped`. Several requests for one key count once.
+ */
+static void request_frame(void) {
+    if (calc_ctx.view_dirty && calc_ctx.frame_key != calc_ctx.keys) {
+        calc_ctx.frames_skipped++;
     }
+    calc_ctx.frame_key = calc_ctx.keys;
+    calc_ctx.view_dirty = true;
+}
 
-    for (int i = start_idx; i < current_num_index; i++) {
-        if (current_num_str[i] == '.') {
-            if (in_decimal_part) { // Already encountered a decimal point
-                set_error("Err: Syntax"); 
-                return 0.0f; 
-            }
-            in_decimal_part = true;
-        } else if (current_num_str[i] >= '0' && current_num_str[i] <= '9') {
-            int digit = current_num_str[i] - '0';
-            if (!in_decimal_part) {
-                result = result * 10.0f + digit; // Accumulate integer part
-            } else {
-                result += digit * decimal_multiplier; // Accumulate fractional part
-                decimal_multiplier *= 0.1f;
-            }
-        } else { 
-            // Should not be reached if RunCalculatorLogic filters input correctly
-            set_error("Err: Syntax"); 
-            return 0.0f; 
-        }
+/**
+ * @brief Switches to the result/error view showing `message` on line 1.
+ */
+static void show_message(const char* message) {
+    strncpy(calc_ctx.view_message, message, LCD_LINE_LEN);
+    calc_ctx.view_message[LCD_LINE_LEN] = '\0';
+    calc_ctx.view = VIEW_MESSAGE;
+    request_frame();
+    calc_ctx.calculation_has_ended = true; // Wait for a key to start over
+}
+
+/**
+ * @brief Switches to the expression input view.
+ */
+static void show_input(void) {
+    calc_ctx.view = VIEW_INPUT;
+    request_frame();
+}
+
+/**
+ * @brief Makes `value` the number being typed: as `format_number` shows it for ANS,
+ *        or as the history shows a number token for backspace over an operator.
+ * 
+ * @return false, with no number being typed, if the text is not something the keys
+ *         could have typed (scientific notation, inf or nan).
+ */
+static bool load_typed_number(float value, bool as_token) {
+    int len = as_token ? format_typed_number(value, current_num_str)
+                       : format_number(value, current_num_str, sizeof(current_num_str));
+    int i;
+    for (i = 0; i < len && ((current_num_str[i] >= '0' && current_num_str[i] <= '9') ||
+                            current_num_str[i] == '.' || current_num_str[i] == '-'); i++) {
     }
-    return is_negative_num ? -result : result;
+    if (len <= 0 || i != len) {
+        current_num_index = 0;
+        memset(current_num_str, 0, sizeof(current_num_str));
+        return false;
+    }
+    current_num_index = len;
+    calc_ctx.decimal_point_entered = strchr(current_num_str, '.') != NULL;
+    calc_ctx.last_key_was_operator = false;
+    return true;
 }
 
+#ifndef CALC_NO_DIAG
 /**
- * @brief Main operational loop for the calculator.
- * 
- * Initializes the calculator, displays a ready message, and then enters an infinite loop
- * to handle key presses and manage calculator states:
- * 
- * 1.  **Initial State / Ready**: Displays "Calculator Ready".
- * 2.  **Input Processing**:
- *     - Reads key presses from `GetKeyPressed()`.
- *     - Handles digit input (0-9), decimal point, and operators (+, -, *, /).
- *     - Updates `current_num_str` for numbers being typed.
- *     - Appends to `expression_str` for display history.
- *     - Pushes operands and operators to `expr_type`/`expr_data` stacks.
- *     - Sets errors like "Err: Num Len", "Err: Syntax" if input rules are violated.
- * 3.  **Calculation (on KEY_EQUALS)**:
- *     - Parses the final `current_num_str`.
- *     - Calls `evaluate_full_expression()` to compute the result.
- *     - Manages display of the result or any error message from evaluation.
- *     - Sets `calculation_has_ended` to true.
- * 4.  **Error State Management**:
- *     - If `calculator_error` is set at any point (input or calculation):
- *       - Displays the `error_message`.
- *       - Sets `calculation_has_ended` to true.
- *       - The calculator effectively waits in this state.
- * 5.  **Post-Calculation/Error State (`calculation_has_ended == true`)**:
- *     - The result or error message remains on the display.
- *     - Any key press (except KEY_NONE or KEY_EQUALS if an error was shown) will:
- *       - Call `clear_all_state()` to reset everything (including errors).
- *       - Transition back to normal input processing, using the pressed key as the
- *         start of a new calculation if it's a valid input key.
- * 
- * The loop includes small delays for keypad polling and LCD command processing.
+ * @brief Handles a key while the diagnostics screen is up, or the chord that opens it.
+ * 
+ * The chord shows the first page and every further key the next one; the key after
+ * the last page returns to the view that was up before, redrawn in full. The keys
+ * do not reach the calculator.
  */
-void RunCalculatorLogic(void) {
-    bool calculation_has_ended = false;    // True if result or error is currently displayed
-    bool decimal_point_entered = false;  // Tracks if decimal point is already in current_num_str
-    bool last_key_was_operator = false;  // Helps manage operator chaining and unary minus logic
-    unsigned char current_key;             // Stores the currently pressed key
+static void diag_screen_key(unsigned char key) {
+    if (calc_ctx.view != VIEW_DIAG) {
+        calc_ctx.diag_return_view = calc_ctx.view;
+        calc_ctx.diag_page = 0;
+        calc_ctx.view = VIEW_DIAG;
+    } else if (key == KEY_DIAG || ++calc_ctx.diag_page >= DIAG_PAGES) {
+        calc_ctx.view = calc_ctx.diag_return_view;
+    }
+    request_frame();
+}
+#endif
 
+/**
+ * @brief Resets the calculator and requests the start-up message.
+ * 
+ * The message stays up until the first key or for SPLASH_MS (see `calc_ui_poll`).
+ */
+void calc_ui_begin(void) {
     clear_all_state(); // Initialize all states and clear any residual errors
+    calc_ctx.calculation_has_ended = false;
+    calc_ctx.decimal_point_entered = false;
+    calc_ctx.last_key_was_operator = false;
+    calc_ctx.eval_pending = false;
+    calc_ctx.view = VIEW_SPLASH;
+    calc_ctx.view_dirty = true;
+    calc_ctx.splash_start = uptime_us();
+}
+
+/**
+ * @brief Shows state restored after a reset (retain.c) in place of the start-up message.
+ * 
+ * The expression, the number being typed and the flags must be back already. The
+ * input view is redrawn in full, as after calc_ui_begin().
+ * @param message Line 1 text of a result or error that was shown, or NULL for the input view.
+ */
+void calc_ui_resume(const char* message) {
+    if (message != NULL) {
+        show_message(message);
+    } else {
+        show_input();
+    }
+}
+
+/**
+ * @brief Time-based housekeeping: replaces the start-up message after SPLASH_MS.
+ */
+void calc_ui_poll(void) {
+    if (calc_ctx.view == VIEW_SPLASH && (uint32_t)(uptime_us() - calc_ctx.splash_start) >= SPLASH_MS * 1000UL) {
+        show_input();
+    }
+}
+
+/**
+ * @brief Processes one key press.
+ * 
+ * - Digit input (0-9) and the decimal point update `current_num_str`.
+ * - Operators (+, -, *, /) push operands and operators to the `expr_type`/`expr_data` stacks;
+ *   '-' at the start of a number is a unary minus.
+ * - KEY_EQUALS parses the last number, checks for a trailing operator and, if there is no
+ *   error, leaves the evaluation pending for `calc_eval_run`.
+ * - KEY_CLEAR clears the expression, KEY_BACKSPACE deletes the last character of the
+ *   number being typed (or a trailing operator), and KEY_ANS replaces the number being
+ *   typed with the last result.
+ * - Input errors ("Err: Num Len", "Err: Syntax") are shown at once.
+ * - While a result or error is shown, any key starts a new calculation and is then
+ *   processed as input, except KEY_EQUALS after an error, which only clears.
+ * 
+ * Only the calculator state is changed; `calc_render` brings the LCD up to date.
+ * Must not be called while `calc_eval_pending()` is true.
+ * @param current_key Key code (KEY_0 ... KEY_DECIMAL, or an action of keymap.cpp); KEY_NONE is ignored.
+ */
+void calc_ui_key(unsigned char current_key) {
+    if (current_key == KEY_NONE) {
+        return;
+    }
+    calc_ctx.keys++;
+#ifndef CALC_NO_DIAG
+    if (current_key == KEY_DIAG || calc_ctx.view == VIEW_DIAG) {
+        diag_screen_key(current_key);
+        return;
+    }
+#endif
+    if (calc_ctx.view == VIEW_SPLASH) {
+        show_input(); // The first key dismisses the start-up message and is processed
+    }
+
+    // Calculation has ended (result or error is shown)
+    if (calc_ctx.calculation_has_ended) {
+        bool error_was_being_displayed = calculator_error; 
+        clear_all_state(); // Reset everything for a new calculation
+        calc_ctx.calculation_has_ended = false;
+        calc_ctx.decimal_point_entered = false;
+        calc_ctx.last_key_was_operator = false;
+        show_input();
+        
+        // If KEY_EQUALS was pressed while an error was shown, it's treated as a clear signal.
+        // We don't want to re-process KEY_EQUALS as a command to calculate an empty expression.
+        if (current_key == KEY_EQUALS && error_was_being_displayed) { 
+            return;
+        }
+        // If any other key was pressed, it will fall through to be processed as new input.
+    }
     
-    // Initial startup message
-    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); 
-    delay(20);
-    lcdstring("Calculator Ready");
-    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); 
-    delay(5);
-    lcdstring("Enter Expression");
-    delay(1000); // Display ready message for a second
-    update_lcd_display_content(); // Update to initial empty/input state
+    // Error occurred during input processing but is not displayed yet
+    if (calculator_error) {
+        show_message(error_message);
+        return; // Wait for next key press to clear the error
+    }
 
-    // Main calculator loop
-    while (true) {
-        current_key = GetKeyPressed(); // Poll for a key press
-
-        // State 1: Calculation has ended (result or error is shown)
-        if (calculation_has_ended) {
-            if (current_key != KEY_NONE) { 
-                bool error_was_being_displayed = calculator_error; 
-                clear_all_state(); // Reset everything for a new calculation
-                calculation_has_ended = false;
-                decimal_point_entered = false;
-                last_key_was_operator = false;
-                
-                // If KEY_EQUALS was pressed while an error was shown, it's treated as a clear signal.
-                // We don't want to re-process KEY_EQUALS as a command to calculate an empty expression.
-                if (current_key == KEY_EQUALS && error_was_being_displayed) { 
-                    update_lcd_display_content(); // Show the now-cleared display
-                    continue; // Go back to waiting for new input
-                }
-                // If any other key was pressed, it will fall through to be processed as new input.
-            } else {
-                delay(50); // No key pressed, continue showing result/error
-                continue;
-            }
+    // --- Process Valid Key Presses ---
+    if (current_key >= KEY_0 && current_key <= KEY_9) { // Digit keys
+        if (current_num_index < LCD_LINE_LEN) { // Prevent overflow of current_num_str
+            current_num_str[current_num_index++] = '0' + current_key;
+            current_num_str[current_num_index] = '\0';
+            calc_ctx.last_key_was_operator = false;
+        } else {
+            set_error("Err: Num Len"); // Number input is too long
         }
-        
-        // State 2: Error occurred during input processing (before KEY_EQUALS)
-        // This ensures errors like "Num Len" are displayed immediately if another action is attempted.
-        if (calculator_error && !calculation_has_ended) {
-            if (current_key == KEY_NONE) { 
-                delay(50); 
-                continue;
-            }
-            // If an error is set and a key is pressed, transition to error display state
-            lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); 
-            delay(20);
-            lcdstring(error_message);
-            lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); 
-            delay(5);
-            lcdstring(""); // Clear second line
-            calculation_has_ended = true; // Enter the "error displayed" state
-            continue; // Wait for next key press to clear the error
-        }
-
-        // State 3: Normal input processing (no key pressed yet, or processing current key)
-        if (current_key == KEY_NONE) {
-            delay(50); 
-            continue;
-        }
-
-        // --- Process Valid Key Presses ---
-        if (current_key >= KEY_0 && current_key <= KEY_9) { // Digit keys
-            if (current_num_index < LCD_LINE_LEN) { // Prevent overflow of current_num_str
-                current_num_str[current_num_index++] = '0' + current_key;
-                current_num_str[current_num_index] = '\0';
-                last_key_was_operator = false;
-            } else {
-                set_error("Err: Num Len"); // Number input is too long
+    } else if (current_key == KEY_DECIMAL) {
+        if (!calc_ctx.decimal_point_entered && current_num_index < LCD_LINE_LEN - 1) { // Ensure space for '.' and at least one digit
+            if (current_num_index == 0) { // If "." is the first char, prepend "0"
+                current_num_str[current_num_index++] = '0';
             }
-        } else if (current_key == KEY_DECIMAL) {
-            if (!decimal_point_entered && current_num_index < LCD_LINE_LEN - 1) { // Ensure space for '.' and at least one digit
-                if (current_num_index == 0) { // If "." is the first char, prepend "0"
-                    current_num_str[current_num_index++] = '0';
-                }
-                current_num_str[current_num_index++] = '.';
+            current_num_str[current_num_index++] = '.';
+            current_num_str[current_num_index] = '\0';
+            calc_ctx.decimal_point_entered = true;
+            calc_ctx.last_key_was_operator = false;
+        } else if (calc_ctx.decimal_point_entered) {
+            set_error("Err: Syntax"); // Multiple decimal points
+        } else {
+            set_error("Err: Num Len"); // Not enough space for decimal point
+        }
+    } else if (current_key >= KEY_PLUS && current_key <= KEY_DIVIDE) { // Operator keys
+        char op_char_map[] = {'+', '-', '*', '/'}; // Map key codes to operator characters
+        char selected_op_char = op_char_map[current_key - KEY_PLUS];
+
+        // Handle unary minus: if '-' is pressed at start of expression,
+        // or after another operator, and no number is currently being typed.
+        if (selected_op_char == '-' && (expr_len == 0 || calc_ctx.last_key_was_operator) && current_num_index == 0) {
+            if (current_num_index < LCD_LINE_LEN) { // Check space for the '-' sign
+                current_num_str[current_num_index++] = '-';
                 current_num_str[current_num_index] = '\0';
-                decimal_point_entered = true;
-                last_key_was_operator = false;
-            } else if (decimal_point_entered) {
-                set_error("Err: Syntax"); // Multiple decimal points
+                calc_ctx.last_key_was_operator = false; // Now considered part of number input
             } else {
-                set_error("Err: Num Len"); // Not enough space for decimal point
+                set_error("Err: Num Len"); // Not enough space for '-'
             }
-        } else if (current_key >= KEY_PLUS && current_key <= KEY_DIVIDE) { // Operator keys
-            char op_char_map[] = {'+', '-', '*', '/'}; // Map key codes to operator characters
-            char selected_op_char = op_char_map[current_key - KEY_PLUS];
-
-            // Handle unary minus: if '-' is pressed at start of expression,
-            // or after another operator, and no number is currently being typed.
-            if (selected_op_char == '-' && (expr_len == 0 || last_key_was_operator) && current_num_index == 0) {
-                if (current_num_index < LCD_LINE_LEN) { // Check space for the '-' sign
-                    current_num_str[current_num_index++] = '-';
-                    current_num_str[current_num_index] = '\0';
-                    last_key_was_operator = false; // Now considered part of number input
-                } else {
-                    set_error("Err: Num Len"); // Not enough space for '-'
-                }
-            } else { // Binary operator or non-unary context
-                if (current_num_index > 0) { // If a number was being typed, process it
-                    float num = parse_current_input_number();
-                    if (!calculator_error) {
-                        push_operand_to_expr(num);
-                        add_to_expression_string(current_num_str); // Add parsed number to history
-                    }
-                    // Reset current number input state
-                    current_num_index = 0;
-                    memset(current_num_str, 0, sizeof(current_num_str));
-                    decimal_point_entered = false;
-                } else if (expr_len == 0 || (expr_type[expr_len - 1] == 'O' && !last_key_was_operator)) {
-                    // Operator pressed without a preceding operand (e.g. "*5" or "5++")
-                    // Allow leading '+' (often ignored) but error for other operators like '*' or '/'.
-                    if (selected_op_char != '+') { 
-                        set_error("Err: Syntax");
-                    }
-                }
-                // If no error so far, push the operator
-                if (!calculator_error) {
-                    push_operator_to_expr(selected_op_char);
-                    last_key_was_operator = true;
-                }
-            }
-        } else if (current_key == KEY_EQUALS) { // Equals key
-            // If a number is currently being typed, parse and push it
-            if (current_num_index > 0 && !calculator_error) {
+        } else { // Binary operator or non-unary context
+            if (current_num_index > 0) { // If a number was being typed, process it
                 float num = parse_current_input_number();
                 if (!calculator_error) {
                     push_operand_to_expr(num);
-                    add_to_expression_string(current_num_str); // Add final number to history
+                }
+                // Reset current number input state
+                current_num_index = 0;
+                memset(current_num_str, 0, sizeof(current_num_str));
+                calc_ctx.decimal_point_entered = false;
+            } else if (expr_len == 0 || (expr_type[expr_len - 1] == 'O' && !calc_ctx.last_key_was_operator)) {
+                // Operator pressed without a preceding operand (e.g. "*5" or "5++")
+                // Allow leading '+' (often ignored) but error for other operators like '*' or '/'.
+                if (selected_op_char != '+') { 
+                    set_error("Err: Syntax");
                 }
             }
-            
-            // Check for syntax error: trailing operator (e.g., "5 + =")
-            if (current_num_index == 0 && expr_len > 0 && expr_type[expr_len - 1] == 'O' && !calculator_error) {
-                 set_error("Err: Syntax");
+            // If no error so far, push the operator
+            if (!calculator_error) {
+                push_operator_to_expr(selected_op_char);
+                calc_ctx.last_key_was_operator = true;
             }
-
-            float final_result = 0.0f;
-            if (!calculator_error) { // Only evaluate if no errors occurred during input phase
-                final_result = evaluate_full_expression();
+        }
+    } else if (current_key == KEY_CLEAR) {
+        clear_all_state();
+        calc_ctx.decimal_point_entered = false;
+        calc_ctx.last_key_was_operator = false;
+    } else if (current_key == KEY_BACKSPACE) {
+        if (current_num_index > 0) {
+            if (current_num_str[--current_num_index] == '.') {
+                calc_ctx.decimal_point_entered = false;
             }
-            
-            // Display result or error
-            lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); 
-            delay(20); 
-
-            if (calculator_error) { // If any error (input or evaluation)
-                lcdstring(error_message);
-            } else { // Display formatted result
-                char result_str_buf[LCD_LINE_LEN + 1];
-                
-                // Check if the result is effectively an integer for display
-                if (fabsf(final_result - roundf(final_result)) < FLOAT_EPSILON) {
-                    snprintf(result_str_buf, sizeof(result_str_buf), "%.0f", final_result);
-                } else {
-                    // Format as float, then trim trailing zeros and unnecessary decimal point
-                    snprintf(result_str_buf, sizeof(result_str_buf), "%f", final_result);
-                    char *p = strchr(result_str_buf, '.');
-                    if (p != NULL) {
-                        int len = strlen(result_str_buf);
-                        char *end_ptr = result_str_buf + len - 1;
-                        while (end_ptr > p && *end_ptr == '0') {
-                            *end_ptr-- = '\0'; // Remove trailing zero
-                        }
-                        if (*end_ptr == '.') { // If decimal point is now last char, remove it
-                            *end_ptr = '\0'; 
-                        }
-                    }
-                }
+            current_num_str[current_num_index] = '\0';
+            if (current_num_index == 0) { // Back to just after the operator, if any
+                calc_ctx.last_key_was_operator = expr_len > 0 && expr_type[expr_len - 1] == 'O';
+            }
+        } else if (expr_len > 0 && expr_type[expr_len - 1] == 'O') {
+            // The number before the operator becomes the number being typed again, so
+            // that further digits extend it. One shown in scientific notation cannot be
+            // typed, and then the operator stays.
+            bool after_number = expr_len >= 2 && expr_type[expr_len - 2] == 'N';
+            if (!after_number) { // A leading '+', or the second of two operators
+                expr_len--;
+                calc_ctx.last_key_was_operator = expr_len > 0;
+                invalidate_lcd_history(); // Another operator may bring expr_len back before the next frame
+            } else if (load_typed_number(expr_data[expr_len - 2], true)) {
+                expr_len -= 2;
+                invalidate_lcd_history();
+            }
+        }
+    } else if (current_key == KEY_ANS) {
+        if (!load_typed_number(calc_ctx.ans, false)) { // Scientific notation, inf or nan cannot be typed
+            set_error("Err: Num Len");
+        }
+    } else if (current_key == KEY_EQUALS) { // Equals key
+        // If a number is currently being typed, parse and push it
+        if (current_num_index > 0 && !calculator_error) {
+            float num = parse_current_input_number();
+            if (!calculator_error) {
+                push_operand_to_expr(num);
+            }
+        }
+        
+        // Check for syntax error: trailing operator (e.g., "5 + =")
+        if (current_num_index == 0 && expr_len > 0 && expr_type[expr_len - 1] == 'O' && !calculator_error) {
+             set_error("Err: Syntax");
+        }
 
-                // If formatted string is too long, try scientific notation
-                if (strlen(result_str_buf) > LCD_LINE_LEN) {
-                    snprintf(result_str_buf, sizeof(result_str_buf), "%.3e", final_result); // E.g., 3 decimal places for exponent
-                }
+        // Reset current number input state for the next potential calculation (after clear)
+        current_num_index = 0; 
+        memset(current_num_str, 0, sizeof(current_num_str));
+        calc_ctx.decimal_point_entered = false; 
+        // expr_len will be cleared by clear_all_state() when a new calculation starts.
 
-                // If still too long, set display error
-                if (strlen(result_str_buf) > LCD_LINE_LEN) { 
-                    set_error("Err: Display"); 
-                    lcdstring(error_message); // Display the new "Err: Display"
-                } else {
-                    lcdstring(result_str_buf);
-                }
+        if (calculator_error) { // Input error: nothing to evaluate
+            show_message(error_message);
+        } else {
+            TRACE_EVENT(EVT_EVAL_BEGIN, (uint32_t)expr_len);
+            evaluate_begin(); // Only evaluate if no errors occurred during input phase
+            calc_ctx.eval_pending = true; // Run in slices by calc_eval_slice()
+        }
+        return;
+    }
+    
+    // After processing a key, show the error it caused or the updated input
+    if (calculator_error) { // e.g. Num Len
+        show_message(error_message);
+    } else {
+        request_frame();
+    }
+}
+
+/**
+ * @brief True while a KEY_EQUALS evaluation is in progress (see `calc_eval_slice`).
+ */
+bool calc_eval_pending(void) {
+    return calc_ctx.eval_pending;
+}
+
+/**
+ * @brief Shows the result or error of the finished evaluation.
+ */
+static void show_evaluation_result(void) {
+    char result_str_buf[LCD_LINE_LEN + 1];
+
+    if (calculator_error) { // Evaluation error (e.g. division by zero)
+        show_message(error_message);
+    } else if (format_number(calc_ctx.eval.result, result_str_buf, sizeof(result_str_buf)) < 0) {
+        // The result cannot be shown even in scientific notation
+        set_error("Err: Display"); 
+        show_message(error_message);
+    } else {
+        calc_ctx.ans = calc_ctx.eval.result;
+        show_message(result_str_buf);
+    }
+}
+
+/**
+ * @brief Runs one slice of the pending evaluation: at most EVAL_SLICE_OPS operations.
+ * 
+ * Measures the slice and adds it to the evaluation's compute time. When the
+ * evaluation finishes, its result or error is shown and the pending flag cleared.
+ * @return true if the evaluation is still pending afterwards.
+ */
+bool calc_eval_slice(void) {
+    calc_eval_state* ev = &calc_ctx.eval;
+    uint32_t start, took;
+    bool done;
+
+    if (!calc_ctx.eval_pending) {
+        return false;
+    }
+    start = uptime_us();
+    DIAG_ADD(eval_cycles, 0u - DIAG_CYCLES()); // Adds the cycle count's change over the slice
+    done = evaluate_step(EVAL_SLICE_OPS);
+    DIAG_ADD(eval_cycles, DIAG_CYCLES());
+    took = uptime_us() - start;
+
+    ev->slices++;
+    ev->compute_us += took;
+    if (took > ev->slice_max_us) {
+        ev->slice_max_us = took;
+    }
+    if (!done) {
+        return true;
+    }
+    ev->elapsed_us = uptime_us() - ev->started_at;
+    DIAG_EVAL_DONE();
+    TRACE_EVENT(EVT_EVAL_END, ev->ops);
+    calc_ctx.eval_pending = false;
+    show_evaluation_result();
+    return false;
+}
+
+/**
+ * @brief Runs the pending evaluation to completion and shows its result or error.
+ */
+void calc_eval_run(void) {
+    while (calc_eval_slice()) {
+    }
+}
+
+/**
+ * @brief Aborts the pending evaluation and shows "Err: Cancelled".
+ * 
+ * Takes effect between two slices; the next key clears the message like any error.
+ */
+void calc_eval_cancel(void) {
+    if (!calc_ctx.eval_pending) {
+        return;
+    }
+    calc_ctx.eval.phase = EVAL_IDLE;
+    calc_ctx.eval.elapsed_us = uptime_us() - calc_ctx.eval.started_at;
+    TRACE_EVENT(EVT_EVAL_END, calc_ctx.eval.ops);
+    calc_ctx.eval_pending = false;
+    set_error("Err: Cancelled");
+    show_message(error_message);
+}
+
+/**
+ * @brief True if the LCD does not show the current view yet.
+ */
+bool calc_render_pending(void) {
+    return calc_ctx.view_dirty;
+}
+
+/**
+ * @brief Time left before RENDER_MAX_FPS allows the next frame, 0 if it may be drawn now.
+ * 
+ * Callers that rate-limit the display process all queued keys first and call
+ * `calc_render` once this reaches 0, so a burst of keys costs one frame.
+ */
+uint32_t calc_render_wait_us(void) {
+    uint32_t since = uptime_us() - calc_ctx.frame_at;
+    if (calc_ctx.frames == 0 || since >= RENDER_FRAME_US) {
+        return 0;
+    }
+    return RENDER_FRAME_US - since;
+}
+
+/**
+ * @brief Brings the LCD up to date with the current view, if it changed.
+ * 
+ * Always draws the latest state, so any number of changes since the last frame
+ * end up on the LCD together. The input view is updated incrementally by
+ * `update_lcd_display_content`; the start-up message and results/errors clear
+ * the display and write both lines. This does not wait for RENDER_MAX_FPS,
+ * see `calc_render_wait_us`.
+ */
+void calc_render(void) {
+    if (!calc_ctx.view_dirty) {
+        return;
+    }
+    calc_ctx.view_dirty = false;
+    calc_ctx.frames++;
+    calc_ctx.frame_at = uptime_us();
+    TRACE_EVENT(EVT_LCD_BEGIN, calc_ctx.view);
+
+    if (calc_ctx.view == VIEW_INPUT) {
+        update_lcd_display_content();
+        DIAG_FRAME_DRAWN(uptime_us());
+        TRACE_EVENT(EVT_LCD_END, 0);
+        return;
+    }
+
+    invalidate_lcd_history();
+    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); 
+    if (calc_ctx.view == VIEW_SPLASH) {
+        lcdstring("Calculator Ready");
+        lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); 
+        lcdstring("Enter Expression");
+#ifndef CALC_NO_DIAG
+    } else if (calc_ctx.view == VIEW_DIAG) {
+        char line1[LCD_LINE_LEN + 1], line2[LCD_LINE_LEN + 1];
+        diag_page_text(calc_ctx.diag_page, line1, line2);
+        lcdstring(line1);
+        lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+        lcdstring(line2);
+#endif
+    } else {
+        lcdstring(calc_ctx.view_message);
+        lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); // Move to second line
+        lcdstring(""); // Clear the second line
+    }
+    DIAG_FRAME_DRAWN(uptime_us());
+    TRACE_EVENT(EVT_LCD_END, 0);
+}
+
+/**
+ * @brief Main operational loop for the calculator, for builds without the task scheduler.
+ * 
+ * Shows the start-up message, then polls the keypad every KEY_POLL_MS and feeds all
+ * buffered keys (including ones pressed during boot) to `calc_ui_key` before drawing
+ * one frame with `calc_render`, at most RENDER_MAX_FPS times per second. A pending
+ * evaluation runs one slice per pass, and a KEY_CANCEL anywhere in the buffer aborts
+ * it, dropping the keys typed ahead of it; other keys wait in the buffer until the
+ * result is shown.
+ * LCD commands wait for their own execution time inside the driver.
+ * See tasks.c for the same work split into cooperative tasks.
+ */
+void RunCalculatorLogic(void) {
+    calc_ui_begin();
+    calc_render();
+
+    // Main calculator loop
+    while (true) {
+        KeypadPoll(); // Scan the keypad, queueing a newly accepted key
+
+        calc_ui_poll();
+        if (calc_eval_pending()) {
+            if (KeypadFlushThrough(KEY_CANCEL)) {
+                calc_eval_cancel();
+            } else {
+                calc_eval_slice(); // Other keys wait for the result
             }
-            lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); // Move to second line
-            delay(5); 
-            lcdstring(""); // Clear the second line
+        }
+        while (!calc_eval_pending() && KeypadPeekKey() != KEY_NONE) {
+            calc_ui_key(KeypadNextKey());
+        }
+        if (calc_render_wait_us() == 0) {
+            calc_render();
+        }
 
-            calculation_has_ended = true; // Set flag to indicate result/error is shown
-            // Reset current number input state for the next potential calculation (after clear)
-            current_num_index = 0; 
-            memset(current_num_str, 0, sizeof(current_num_str));
-            decimal_point_entered = false; 
-            // expression_str and expr_len will be cleared by clear_all_state() when a new calculation starts.
+        if (!calc_eval_pending()) {
+            delay(KEY_POLL_MS); // Polling interval; the keypad driver does the debouncing
         }
-        
-        // After processing a key, if not showing a final result/error, update the input display
-        if (!calculation_has_ended) { 
-             if (calculator_error) { // If an error was set during this key's processing (e.g. Num Len)
-                lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C'); 
-                delay(20); 
-                lcdstring(error_message);
-                lcdchar(LCD_CMD_CURSOR_LINE_2, 'C'); 
-                delay(5); 
-                lcdstring("");
-                calculation_has_ended = true; // Transition to error display state
-             } else {
-                update_lcd_display_content(); // Normal update of input display
-             }
-        }
-        delay(100); // Debounce/polling delay at the end of the loop
     }
 }
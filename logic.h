@@ -3,11 +3,19 @@
 #define LOGIC_H
 
 #include <stdbool.h> // For bool type
+#include <stdint.h>  // For uint32_t
+#include "sim_local.h" // For SIM_LOCAL
 
 // --- Configuration Constants ---
 #define MAX_TOKENS 50      // Maximum number of tokens (numbers/operators) in an expression
 #define ERROR_MSG_LEN 17   // Max 16 displayable chars for LCD error messages + null terminator
 #define LCD_LINE_LEN 16    // Character width of the LCD display line
+#define SPLASH_MS 1000     // Longest time the ready message stays up if no key is pressed
+#define EVAL_SLICE_OPS 8   // Evaluator operations per slice before other work gets a turn
+#ifndef RENDER_MAX_FPS
+#define RENDER_MAX_FPS 50  // Highest LCD refresh rate; changes in between share one frame
+#endif
+#define RENDER_FRAME_US (1000000UL / RENDER_MAX_FPS)
 
 // --- LCD Command Codes (used in logic.c, though ideally part of lcd driver) ---
 #define LCD_CMD_CLEAR_DISPLAY 0x01
@@ -31,11 +39,84 @@
 #define KEY_EQUALS    0xE
 #define KEY_DECIMAL   0xF
 #define KEY_NONE      0xFF // Value indicating no key is pressed
+#define KEY_CANCEL    KEY_EQUALS // '=' pressed again while an evaluation is running aborts it
+#define KEY_DIAG      0x10 // '=' and '.' held together: the diagnostics screen (diag.h)
+#define KEY_DIAG_ROW   3   // Matrix position of the chord; both keys must share a row
+#define KEY_DIAG_COL_A 2   // '=' (read first, see keypad_column())
+#define KEY_DIAG_COL_B 3   // '.'
+// Actions of the other keymap layers (keymap.cpp)
+#define KEY_CLEAR     0x11 // Clears the expression and the number being typed
+#define KEY_BACKSPACE 0x12 // Deletes the last character typed, or a trailing operator
+#define KEY_ANS       0x13 // Types the last result
+#define KEY_SHIFT     0x14 // The next key comes from the shift layer; handled in keypad.c
 
 // --- Global Error State ---
 // These variables are defined in logic.c and used to manage error conditions.
-extern bool calculator_error; // True if an error has occurred
-extern char error_message[ERROR_MSG_LEN]; // Stores the current error message string
+extern SIM_LOCAL bool calculator_error; // True if an error has occurred
+extern SIM_LOCAL char error_message[ERROR_MSG_LEN]; // Stores the current error message string
+
+// --- Expression and Input State ---
+// Defined in logic.c; exposed so the test harness can set up and inspect expressions.
+extern SIM_LOCAL char expr_type[MAX_TOKENS];          // 'N' for number tokens, 'O' for operator tokens
+extern SIM_LOCAL float expr_data[MAX_TOKENS];         // Number value, or operator char code
+extern SIM_LOCAL int expr_len;                        // Number of tokens in the expression
+extern SIM_LOCAL char current_num_str[LCD_LINE_LEN + 1]; // Number currently being typed
+extern SIM_LOCAL int current_num_index;               // Length of current_num_str
+
+// --- Calculator Context ---
+// Defined in logic.c. Holds the key handling and display state between keys and the
+// resumable evaluator's state between slices.
+typedef enum {
+    VIEW_SPLASH,  // "Calculator Ready" start-up message
+    VIEW_INPUT,   // Expression history and the number being typed
+    VIEW_MESSAGE, // A result or an error message on line 1
+    VIEW_DIAG     // A page of the diagnostics screen (diag.h)
+} calc_view_t;
+
+typedef enum {
+    EVAL_IDLE,    // Nothing started (or cancelled)
+    EVAL_TOKENS,  // Reading tokens, next_token is the next one
+    EVAL_DRAIN,   // All tokens read, applying the operators left on the stack
+    EVAL_DONE     // Finished, result is valid unless calculator_error is set
+} calc_eval_phase_t;
+
+typedef struct {
+    calc_eval_phase_t phase;
+    int next_token;               // Next token of expr_type/expr_data to read
+    float val_stack[MAX_TOKENS];  // Stack for numbers/operands
+    char op_stack[MAX_TOKENS];    // Stack for operator characters
+    int val_top, op_top;          // Stack tops, -1 when empty
+    float result;
+    // Measurements of the current (or last) evaluation
+    uint32_t ops;                 // Operations executed
+    uint32_t slices;              // Slices it took
+    uint32_t slice_max_us;        // Longest slice
+    uint32_t compute_us;          // Time spent inside slices
+    uint32_t started_at;          // Uptime at evaluate_begin()
+    uint32_t elapsed_us;          // Begin to finish, including time given to other work
+} calc_eval_state;
+
+typedef struct {
+    bool calculation_has_ended;   // True if result or error is currently displayed
+    bool decimal_point_entered;   // Tracks if decimal point is already in current_num_str
+    bool last_key_was_operator;   // Helps manage operator chaining and unary minus logic
+    bool eval_pending;            // KEY_EQUALS accepted, result not shown yet
+    calc_view_t view;             // What calc_render() shows
+    bool view_dirty;              // The LCD does not show `view` yet
+    char view_message[LCD_LINE_LEN + 1]; // Line 1 text for VIEW_MESSAGE
+    calc_view_t diag_return_view; // View to go back to when the diagnostics screen closes
+    unsigned char diag_page;      // Page shown in VIEW_DIAG
+    uint32_t splash_start;        // Uptime when the start-up message was requested
+    uint32_t keys;                // Keys processed by calc_ui_key()
+    uint32_t frame_key;           // Value of `keys` when the pending frame was last requested
+    uint32_t frame_at;            // Uptime when calc_render() last drew a frame
+    uint32_t frames;              // Frames drawn
+    uint32_t frames_skipped;      // View changes merged into a later frame, never drawn on their own
+    float ans;                    // Last result shown, typed by KEY_ANS
+    calc_eval_state eval;         // Resumable evaluator
+} calc_context;
+
+extern SIM_LOCAL calc_context calc_ctx;
 
 // --- Public Function Prototypes ---
 
@@ -48,6 +129,20 @@ extern char error_message[ERROR_MSG_LEN]; // Stores the current error message st
  */
 void RunCalculatorLogic(void);
 
+// --- Step-wise Interface ---
+// RunCalculatorLogic() is built from these; the scheduler tasks (tasks.c) call them directly.
+void calc_ui_begin(void);                  // Reset and request the start-up message
+void calc_ui_resume(const char* message); // Show restored state instead (retain.c): the message, or input if NULL
+void calc_ui_poll(void);                   // Time-based housekeeping (start-up message timeout)
+void calc_ui_key(unsigned char key);       // Process one key; not while an evaluation is pending
+bool calc_eval_pending(void);              // A KEY_EQUALS evaluation is in progress
+bool calc_eval_slice(void);                // Run EVAL_SLICE_OPS of it; true if still pending
+void calc_eval_run(void);                  // Run it to completion and show the result or error
+void calc_eval_cancel(void);               // Abort it and show "Err: Cancelled"
+bool calc_render_pending(void);            // The LCD does not show the current view yet
+uint32_t calc_render_wait_us(void);        // Time until RENDER_MAX_FPS allows the next frame, 0 if now
+void calc_render(void);                    // Bring the LCD up to date, if the view changed
+
 
 // --- Declarations for functions primarily used within logic.c but exposed for potential testing ---
 // These are not strictly part of the public API for other modules but are declared
@@ -62,6 +157,22 @@ void RunCalculatorLogic(void);
  */
 float parse_current_input_number(void);
 
+/**
+ * @brief Pushes a number token onto the expression.
+ * 
+ * Sets "Err: Expr Long" if the expression already holds MAX_TOKENS tokens.
+ * @param num The number to push.
+ */
+void push_operand_to_expr(float num);
+
+/**
+ * @brief Pushes an operator token onto the expression.
+ * 
+ * Sets "Err: Expr Long" if the expression already holds MAX_TOKENS tokens.
+ * @param op_char The operator character ('+', '-', '*' or '/').
+ */
+void push_operator_to_expr(char op_char);
+
 /**
  * @brief Evaluates the expression stored in `expr_type` and `expr_data`.
  * 
@@ -72,10 +183,46 @@ float parse_current_input_number(void);
  */
 float evaluate_full_expression(void);
 
+/**
+ * @brief Starts a resumable evaluation; the state is kept in `calc_ctx.eval`.
+ */
+void evaluate_begin(void);
+
+/**
+ * @brief Advances the evaluation by at most `max_ops` operations (push a token or apply an operator).
+ * @return true once finished; the result is in `calc_ctx.eval.result`.
+ */
+bool evaluate_step(int max_ops);
+
+/**
+ * @brief Formats a number for display, trimming trailing zeros and falling back to
+ *        scientific notation when needed.
+ * 
+ * @param value The number to format.
+ * @param buf Output buffer of at least LCD_LINE_LEN + 1 characters.
+ * @param buf_size Size of `buf` in bytes.
+ * @return Length of the formatted string, or -1 if it cannot fit in LCD_LINE_LEN characters.
+ */
+int format_number(float value, char* buf, int buf_size);
+
+/**
+ * @brief Renders the last `width` characters of the expression history from the tokens.
+ * 
+ * @param out Output buffer of at least `width` + 1 characters.
+ * @param width Number of trailing characters to produce.
+ * @return Number of characters written (excluding the null terminator).
+ */
+int render_expression_tail(char* out, int width);
+
+/**
+ * @brief Brings the LCD up to date with the expression history and the number being typed.
+ */
+void update_lcd_display_content(void);
+
 /**
  * @brief Clears all calculator state variables and resets any error conditions.
  * 
- * Resets expression arrays, current number input, display strings, and error flags.
+ * Resets expression arrays, current number input, and error flags.
  */
 void clear_all_state(void);
 
@@ -1,17 +1,46 @@
 // ============= MAIN.C =============
 #include <LPC17xx.h>
-#include "lcd.h"
-#include "keypad.h"
-#include "delay.h"
-#include "logic.h"
+#include "boot.h"
+#include "sched.h"
+#include "tasks.h"
+#ifdef EVAL_BENCH
+#include "eval_bench.h"
+#endif
+#ifdef WCET_REPORT
+#include "wcet.h"
+#endif
+#ifdef STACK_REPORT
+#include "stack_monitor.h"
+#endif
+#ifdef DELAY_PROFILE
+#include "delay_profile.h"
+#endif
+#ifdef EVENT_TRACE
+#include <stddef.h>
+#include "event_trace.h"
+#endif
 
 int main(void) 
 {
-    lcdinit();
-    KeyPadInitialize();
+    boot_fast(); // LCD and keypad ready, keys pressed meanwhile are buffered
+#ifdef EVAL_BENCH
+    eval_bench_report(); // Cycles per evaluation on the LCD (see eval_bench.c)
+#endif
+#ifdef WCET_REPORT
+    wcet_report(); // Worst cases against their budgets (see wcet.h)
+#endif
+#ifdef STACK_REPORT
+    stack_report_show(); // Stack peak after the longest expressions (see stack_monitor.c)
+#endif
+#ifdef DELAY_PROFILE
+    delay_profile_show(3); // Where boot waited (see delay_profile.c)
+    delay_profile_reset(); // From here on the table covers keystrokes only
+#endif
+#ifdef EVENT_TRACE
+    event_trace_open(NULL); // Events to ITM port 1 over SWO (see event_trace.h)
+#endif
+    tasks_start(); // Keypad, UI, evaluator and LCD tasks
     
-    while (1) {
-        RunCalculatorLogic();
-        delay(100); // Brief delay between calculator sessions
-    }
+    sched_run(); // Never returns; RunCalculatorLogic() is the single-loop alternative
+    return 0;
 }
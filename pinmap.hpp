@@ -0,0 +1,141 @@
+// ============= PINMAP.HPP =============
+// Compile-time pin maps for the keypad matrix and the HD44780 bus.
+// A board variant is described by its port numbers and pin lists; every mask,
+// row pattern, nibble pattern and the column lookup table is computed by the
+// compiler, so the drivers only do table loads and single stores at runtime.
+// Header-only; instantiated for the board in board.hpp.
+#ifndef PINMAP_HPP
+#define PINMAP_HPP
+
+#include <stdint.h>
+
+namespace pinmap {
+
+// An ordered list of pin numbers on one port
+template <unsigned... Pins>
+struct PinList {
+    static_assert(sizeof...(Pins) > 0, "empty pin list");
+    static_assert(((Pins < 32) && ...), "pin number out of range");
+
+    static constexpr unsigned count = sizeof...(Pins);
+    static constexpr unsigned pins[count] = {Pins...};
+    static constexpr uint32_t mask = (0u | ... | (1u << Pins));
+    static_assert(__builtin_popcount(mask) == count, "pin listed twice");
+
+    static constexpr unsigned lowest() { return __builtin_ctz(mask); }
+    static constexpr unsigned highest() { return 31 - __builtin_clz(mask); }
+
+    // Port pattern with bit i of `value` on the i-th pin of the list
+    static constexpr uint32_t scatter(uint32_t value)
+    {
+        uint32_t pattern = 0;
+        for (unsigned i = 0; i < count; i++) {
+            if (value & (1u << i)) {
+                pattern |= 1u << pins[i];
+            }
+        }
+        return pattern;
+    }
+};
+
+// Lookup table built by the compiler
+template <typename T, unsigned N>
+struct Table {
+    T v[N];
+};
+
+// 4x4 (or any size) keypad: rows are driven low one at a time, columns read low
+// when a key in the selected row is pressed
+template <unsigned Port, class Rows, class Cols>
+struct KeypadMatrix {
+    static_assert((Rows::mask & Cols::mask) == 0, "row and column pins overlap");
+
+    using row_list = Rows;
+    using col_list = Cols;
+
+    static constexpr unsigned port = Port;
+    static constexpr unsigned rows = Rows::count;
+    static constexpr unsigned cols = Cols::count;
+    static constexpr uint32_t row_mask = Rows::mask;
+    static constexpr uint32_t col_mask = Cols::mask;
+    static constexpr uint32_t mask = Rows::mask | Cols::mask;
+
+    // Pattern with only row r low
+    static constexpr Table<uint32_t, rows> row_patterns = [] {
+        Table<uint32_t, rows> t{};
+        for (unsigned r = 0; r < rows; r++) {
+            t.v[r] = Rows::mask & ~(1u << Rows::pins[r]);
+        }
+        return t;
+    }();
+
+    // The column pins are compacted to a bit per column (bit c = pin of column c),
+    // which indexes a table of 2^cols entries giving the first column that reads
+    // low, or `cols` if none does. The compaction is one shift and mask per column
+    // with constant shift counts; a table indexed by the raw port bits would need an
+    // entry for every value of the pins between the column pins as well.
+    static_assert(cols <= 8, "too many columns for a byte of column bits");
+
+    // Bit c set if column c's pin is high in a FIOPIN value
+    static constexpr unsigned compact(uint32_t port_bits)
+    {
+        unsigned bits = 0;
+        for (unsigned c = 0; c < cols; c++) {
+            bits |= ((port_bits >> Cols::pins[c]) & 1u) << c;
+        }
+        return bits;
+    }
+
+    static constexpr Table<uint8_t, (1u << cols)> column_table = [] {
+        Table<uint8_t, (1u << cols)> t{};
+        for (uint32_t bits = 0; bits < (1u << cols); bits++) {
+            t.v[bits] = (uint8_t)cols;
+            for (unsigned c = 0; c < cols; c++) {
+                if (!(bits & (1u << c))) {
+                    t.v[bits] = (uint8_t)c;
+                    break;
+                }
+            }
+        }
+        return t;
+    }();
+
+    // Index of the first column reading low in a FIOPIN value, `cols` if none
+    static inline unsigned column(uint32_t port_bits)
+    {
+        return column_table.v[compact(port_bits)];
+    }
+
+    // Bit per column reading low in a FIOPIN value (several keys in one row)
+    static inline unsigned columns(uint32_t port_bits)
+    {
+        return ~compact(port_bits) & ((1u << cols) - 1);
+    }
+};
+
+// HD44780 in 4-bit mode: RS, RW, EN and four data pins (D4-D7, in that order)
+template <unsigned Port, unsigned RS, unsigned RW, unsigned EN, class Data>
+struct Hd44780Bus {
+    static_assert(Data::count == 4, "4-bit interface needs exactly four data pins");
+    static_assert((Data::mask & ((1u << RS) | (1u << RW) | (1u << EN))) == 0, "control and data pins overlap");
+
+    static constexpr unsigned port = Port;
+    static constexpr uint32_t rs = 1u << RS;
+    static constexpr uint32_t rw = 1u << RW;
+    static constexpr uint32_t en = 1u << EN;
+    static constexpr uint32_t data_mask = Data::mask;
+    static constexpr uint32_t mask = rs | rw | en | Data::mask;
+
+    // Data pin pattern for each nibble value
+    static constexpr Table<uint32_t, 16> nibble_patterns = [] {
+        Table<uint32_t, 16> t{};
+        for (uint32_t n = 0; n < 16; n++) {
+            t.v[n] = Data::scatter(n);
+        }
+        return t;
+    }();
+};
+
+} // namespace pinmap
+
+#endif
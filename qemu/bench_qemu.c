@@ -0,0 +1,100 @@
+// bench_qemu.c - Instruction counts of the evaluator and the number formatter on
+// Cortex-M3, run under QEMU by run_qemu.sh
+//
+// The expressions are the ones eval_bench.c times on the board, so the two sets of
+// figures can be compared. Counts are instructions, not cycles: QEMU does not model
+// the flash wait states or bus timing of the LPC1768. The stack peak of the longest
+// expressions (stack_stress()) is reported as well, and so are the allocations
+// made during the measurements (linked with the tracer, heap_guard.c).
+//
+// Not run yet (see run_qemu.sh): there are no figures to compare with.
+
+#include <stdio.h>
+#include "logic.h"
+#include "insn_count.h"
+#include "stack_monitor.h"
+#include "heap_guard.h"
+
+#define BENCH_RUNS 100
+
+static const int bench_tokens[] = { 3, 11, MAX_TOKENS - 1 }; // As in eval_bench.c
+static const float format_values[] = { 42.0f, -7.0f, 3.14159f, 0.001234f, -12345.678f, 1.5e20f, 2.5e-9f };
+
+#define COUNT(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+static void bench_build(int tokens)
+{
+    static const char ops[] = "+*-/";
+    int i;
+
+    clear_all_state();
+    for (i = 0; i < tokens; i++) {
+        if (i & 1) {
+            push_operator_to_expr(ops[(i >> 1) & 3]);
+        } else {
+            push_operand_to_expr(1.25f + (float)i * 0.5f);
+        }
+    }
+}
+
+int main(void)
+{
+    char buf[LCD_LINE_LEN + 1];
+    uint32_t start, total = 0, allocs = 0;
+    int i, r;
+
+    stack_paint();
+    insn_count_init();
+    printf("Cortex-M3 instruction counts (QEMU mps2-an385, -icount shift=0)\n\n");
+
+    for (i = 0; i < COUNT(bench_tokens); i++) {
+        uint32_t insns;
+        float result;
+
+        bench_build(bench_tokens[i]);
+        result = evaluate_full_expression();
+        allocs -= heap_trace_calls;
+        start = insn_count_now();
+        for (r = 0; r < BENCH_RUNS; r++) {
+            evaluate_full_expression();
+        }
+        insns = insn_count_since(start) / BENCH_RUNS;
+        allocs += heap_trace_calls;
+        printf("evaluate_full_expression %2d tokens  %7lu insns  (%lu per token)  = %g\n",
+               bench_tokens[i], (unsigned long)insns, (unsigned long)(insns / bench_tokens[i]), (double)result);
+    }
+    printf("\n");
+
+    for (i = 0; i < COUNT(format_values); i++) {
+        uint32_t insns;
+
+        allocs -= heap_trace_calls;
+        start = insn_count_now();
+        for (r = 0; r < BENCH_RUNS; r++) {
+            format_number(format_values[i], buf, sizeof(buf));
+        }
+        insns = insn_count_since(start) / BENCH_RUNS;
+        allocs += heap_trace_calls;
+        total += insns;
+        printf("format_number %-14g  %7lu insns  \"%s\"\n", (double)format_values[i], (unsigned long)insns, buf);
+    }
+    printf("format_number average     %7lu insns\n", (unsigned long)(total / COUNT(format_values)));
+
+    allocs -= heap_trace_calls;
+    stack_stress();
+    allocs += heap_trace_calls;
+    printf("\nstack peak %lu of %lu bytes (after stack_stress)\n",
+           (unsigned long)stack_high_water(), (unsigned long)stack_size());
+
+    // The benchmark's own printf() allocates; the measured code must not
+    printf("allocations while measuring: %lu\n", (unsigned long)allocs);
+    printf("allocations in total: %lu, %lu bytes from _sbrk\n",
+           (unsigned long)heap_trace_calls, (unsigned long)heap_trace_sbrk);
+    for (i = 0; i < (int)heap_trace_sites; i++) {
+        printf("  site 0x%08lx: %lu calls, %lu bytes, largest %lu\n", (unsigned long)heap_trace[i].site,
+               (unsigned long)heap_trace[i].calls, (unsigned long)heap_trace[i].bytes,
+               (unsigned long)heap_trace[i].largest);
+    }
+    clear_all_state();
+    return 0;
+}
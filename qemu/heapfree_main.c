@@ -0,0 +1,20 @@
+// heapfree_main.c - Link check for the heap-free guarantee (see heap_guard.h)
+//
+// Linked by run_qemu.sh with the allocator symbols redirected to wrappers that do
+// not exist, so the link fails if the calculator code - key handling, evaluation,
+// result formatting, display rendering - refers to the heap anywhere. Running it
+// just exercises those paths once. The cross link has not been run yet (see
+// run_qemu.sh); README.md gives the host link that has.
+
+#include "logic.h"
+#include "stack_monitor.h"
+
+int main(void)
+{
+    char buf[LCD_LINE_LEN + 1];
+
+    calc_ui_begin();
+    stack_stress(); // Every key, the evaluator, format_number() and calc_render()
+    format_number(-1.25e-3f, buf, sizeof(buf));
+    return calculator_error ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+// ============= INSN_COUNT.C =============
+// See insn_count.h. SysTick is a 24-bit down counter clocked from the CPU clock
+// (25 MHz on mps2-an385, i.e. one tick per 40 instructions at -icount shift=0).
+// Windows are averaged over many calls by the benchmarks, so the tick granularity
+// averages out.
+// ===================================
+
+#include "insn_count.h"
+
+#define SYST_CSR (*(volatile uint32_t *)0xE000E010)
+#define SYST_RVR (*(volatile uint32_t *)0xE000E014)
+#define SYST_CVR (*(volatile uint32_t *)0xE000E018)
+
+#define SYST_MAX 0x00FFFFFFUL
+#define CALIBRATE_LOOPS 1000000UL // Two instructions each
+
+static uint32_t insn_per_tick_x256 = 256; // Fixed point, 8 fraction bits
+static uint32_t call_overhead = 0;
+
+// Exactly two instructions per iteration
+static void __attribute__((noinline)) spin(uint32_t n)
+{
+    __asm volatile ("1: subs %0, %0, #1\n\tbne 1b" : "+r" (n) : : "cc");
+}
+
+static uint32_t ticks_since(uint32_t start)
+{
+    return (start - SYST_CVR) & SYST_MAX; // Counts down
+}
+
+void insn_count_init(void)
+{
+    uint32_t start, ticks;
+
+    SYST_RVR = SYST_MAX;
+    SYST_CVR = 0;
+    SYST_CSR = 0x05; // Enable, CPU clock, no interrupt
+
+    start = SYST_CVR;
+    spin(CALIBRATE_LOOPS);
+    ticks = ticks_since(start);
+    if (ticks != 0) {
+        insn_per_tick_x256 = (uint32_t)((2ULL * CALIBRATE_LOOPS * 256ULL + ticks / 2) / ticks);
+    }
+    call_overhead = 0;
+    start = insn_count_now();
+    call_overhead = insn_count_since(start);
+}
+
+uint32_t insn_count_now(void)
+{
+    return SYST_CVR;
+}
+
+uint32_t insn_count_since(uint32_t start)
+{
+    uint32_t insns = (uint32_t)(((uint64_t)ticks_since(start) * insn_per_tick_x256) >> 8);
+    return (insns > call_overhead) ? insns - call_overhead : 0;
+}
@@ -0,0 +1,15 @@
+// ============= INSN_COUNT.H =============
+// Instruction counting for code running under QEMU with -icount shift=0, where the
+// virtual clock advances exactly 1 ns per instruction. SysTick counts that clock;
+// the ticks-to-instructions ratio is measured at startup with a loop of known length.
+#ifndef INSN_COUNT_H
+#define INSN_COUNT_H
+
+#include <stdint.h>
+
+void insn_count_init(void);                 // Starts SysTick and calibrates
+uint32_t insn_count_now(void);              // Opaque timestamp
+uint32_t insn_count_since(uint32_t start);  // Instructions executed since `start`, minus the
+                                            // cost of the two calls; windows up to ~10^8
+
+#endif
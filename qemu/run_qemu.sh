@@ -0,0 +1,84 @@
+#!/bin/sh
+# Cross-builds the logic unit tests, the instruction-count benchmarks and the WCET
+# harness for the Cortex-M3 and runs them on QEMU's mps2-an385 machine with
+# semihosting output.
+#
+#   qemu/run_qemu.sh            build and run them all, from the repository root
+#   RAMFUNC=sram qemu/run_qemu.sh   the same with the evaluator in SRAM; an unmeasured
+#                                   experiment, see ramfunc.h
+#
+# Needs arm-none-eabi-gcc with newlib (rdimon) and qemu-system-arm; override with
+# CC=... CXX=... QEMU=... . Output goes to qemu/build/, the benchmark figures also to
+# qemu/build/bench.txt so they can be compared between commits. The firmware
+# sources are compiled with -fstack-usage; qemu/build/stack.txt is the folded
+# report (stack_report.c). The calculator code is also linked with every
+# allocator symbol forbidden (heap_guard.h); that link failing is an error.
+#
+# Not run yet: written without arm-none-eabi-gcc or QEMU available, so neither
+# this script nor the programs it builds have been executed. Its checks are not
+# gates until a first run has passed and its bench.txt is committed.
+set -e
+
+CC=${CC:-arm-none-eabi-gcc}
+CXX=${CXX:-arm-none-eabi-g++}
+QEMU=${QEMU:-qemu-system-arm}
+OUT=qemu/build
+
+CFLAGS="-mcpu=cortex-m3 -mthumb -O2 -g -std=c99 -Wall -I. -Iqemu"
+CXXFLAGS="-mcpu=cortex-m3 -mthumb -O2 -g -std=c++17 -Wall -fno-exceptions -fno-rtti -I. -Iqemu"
+LDFLAGS="--specs=rdimon.specs -nostartfiles -T qemu/mps2_an385.ld -L. -L$OUT"
+HEAP_WRAP="-Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc,--wrap=_malloc_r,--wrap=_free_r,--wrap=_calloc_r,--wrap=_realloc_r,--wrap=_sbrk"
+
+run() {
+    # -icount shift=0: one instruction per virtual nanosecond (see insn_count.h)
+    timeout 120 "$QEMU" -M mps2-an385 -nographic -monitor none -serial none \
+        -semihosting-config enable=on,target=native -icount shift=0 -kernel "$1"
+}
+
+mkdir -p "$OUT"
+
+# Code placement: flash by default, ramfunc.ld only with -DCALC_RAMFUNC_SRAM
+if [ "$RAMFUNC" = sram ]; then
+    CFLAGS="$CFLAGS -DCALC_RAMFUNC_SRAM"
+    cp ramfunc.ld "$OUT/placement.ld"
+else
+    : > "$OUT/placement.ld"
+fi
+
+# One object per source so that each gets its .su file next to it
+OBJS=""
+for src in logic.c diag.c stack_monitor.c ramfunc.c test_stubs.c; do
+    obj="$OUT/$(basename "$src" .c).o"
+    $CC $CFLAGS -fstack-usage -c "$src" -o "$obj"
+    OBJS="$OBJS $obj"
+done
+
+# The goldens are computed by the compiler (calc_eval.hpp); the tests compare them
+# with the soft-float results of logic.c on the target
+$CXX $CXXFLAGS -c calc_goldens.cpp -o "$OUT/calc_goldens.o"
+$CC $CFLAGS -o "$OUT/test_logic.elf" test_logic.c qemu/startup_qemu.c $OBJS "$OUT/calc_goldens.o" $LDFLAGS -lm
+# The benchmark traces allocations (heap_guard.c) to show that formatting makes none
+$CC $CFLAGS -o "$OUT/bench_qemu.elf" qemu/bench_qemu.c qemu/insn_count.c heap_guard.c qemu/startup_qemu.c \
+    $OBJS $LDFLAGS $HEAP_WRAP -lm
+# Worst-case instruction counts against the budgets of wcet.h
+$CC $CFLAGS -o "$OUT/wcet_qemu.elf" qemu/wcet_qemu.c wcet.c qemu/insn_count.c qemu/startup_qemu.c $OBJS $LDFLAGS -lm
+# Heap-free link check: no wrapper definitions, so any allocator reference fails to link
+$CC $CFLAGS -DSTARTUP_NO_STDIO -o "$OUT/heapfree.elf" qemu/heapfree_main.c qemu/startup_qemu.c \
+    $OBJS $LDFLAGS $HEAP_WRAP -lm
+arm-none-eabi-size "$OUT/test_logic.elf" "$OUT/bench_qemu.elf" "$OUT/wcet_qemu.elf" 2>/dev/null || true
+
+${HOSTCC:-cc} -o "$OUT/stack_report" stack_report.c -std=c99
+"$OUT/stack_report" -n 15 -c calc_eval_run,calc_eval_slice,show_evaluation_result,format_number \
+    "$OUT/logic.su" "$OUT/stack_monitor.su" | tee "$OUT/stack.txt"
+
+run "$OUT/test_logic.elf" | tee "$OUT/test_logic.log"
+# Semihosting cannot return the exit status on this machine, so read the summary
+grep -q "Failed: 0" "$OUT/test_logic.log"
+
+run "$OUT/heapfree.elf"
+
+run "$OUT/bench_qemu.elf" | tee "$OUT/bench.txt"
+grep -q "allocations while measuring: 0$" "$OUT/bench.txt"
+
+run "$OUT/wcet_qemu.elf" | tee "$OUT/wcet.txt"
+grep -q "wcet: within budget" "$OUT/wcet.txt"
@@ -0,0 +1,71 @@
+// ============= STARTUP_QEMU.C =============
+// Reset and fault handling for the QEMU mps2-an385 builds (see run_qemu.sh). Sets up
+// .data/.bss and the .ramfunc copy, opens the semihosting console and runs main().
+// ===================================
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "ramfunc.h"
+
+extern uint32_t __data_load__[];
+extern uint32_t __data_start__[];
+extern uint32_t __data_end__[];
+extern uint32_t __bss_start__[];
+extern uint32_t __bss_end__[];
+extern uint32_t __StackTop[];
+
+extern int main(void);
+extern void initialise_monitor_handles(void); // librdimon: stdio over semihosting
+extern void __libc_init_array(void);
+extern void _exit(int status);
+
+// newlib's __libc_init_array() and __libc_fini_array() call _init() and _fini(),
+// which normally come from crti.o. The linker script already runs .init_array and
+// .fini_array, and -nostartfiles leaves crti.o out, so they have nothing to do.
+void _init(void)
+{
+}
+
+void _fini(void)
+{
+}
+
+void Reset_Handler(void)
+{
+    const uint32_t *src = __data_load__;
+    uint32_t *dst;
+
+    for (dst = __data_start__; dst < __data_end__; ) {
+        *dst++ = *src++;
+    }
+    for (dst = __bss_start__; dst < __bss_end__; ) {
+        *dst++ = 0;
+    }
+    ramfunc_init();
+#ifdef STARTUP_NO_STDIO
+    // Heap-free link check (run_qemu.sh): exit() and the semihosted stdio would
+    // bring newlib's allocator in by themselves
+    _exit(main());
+#else
+    initialise_monitor_handles();
+    __libc_init_array();
+    exit(main());
+#endif
+}
+
+// Any fault ends the run instead of hanging QEMU
+static void Fault_Handler(void)
+{
+    _exit(3);
+}
+
+__attribute__((section(".vectors"), used))
+static void (*const vectors[16])(void) = {
+    (void (*)(void))__StackTop,
+    Reset_Handler,
+    Fault_Handler, // NMI
+    Fault_Handler, // HardFault
+    Fault_Handler, // MemManage
+    Fault_Handler, // BusFault
+    Fault_Handler, // UsageFault
+};
@@ -0,0 +1,43 @@
+// wcet_qemu.c - The WCET harness (wcet.c) on Cortex-M3 under QEMU, run by run_qemu.sh
+//
+// Costs are instructions (insn_count.h), including the soft-float library calls,
+// with a granularity of about 40 instructions (one SysTick tick). A Cortex-M3
+// takes at least one cycle per instruction, so a count over the cycle budgets of
+// wcet.h is over on the board too; flash wait states and bus timing come on top.
+// Not run yet (see run_qemu.sh).
+
+#include <stdio.h>
+#include "wcet.h"
+#include "insn_count.h"
+
+uint32_t wcet_now(void)
+{
+    return insn_count_now();
+}
+
+uint32_t wcet_since(uint32_t start)
+{
+    return insn_count_since(start);
+}
+
+int main(void)
+{
+    wcet_result results[WCET_FUNCTIONS];
+    bool ok;
+    int f;
+
+    insn_count_init();
+    ok = wcet_run(results, 3);
+    printf("Worst-case instruction counts (QEMU mps2-an385, -icount shift=0)\n\n");
+    printf("%-28s %8s %8s %6s  %s\n", "function", "insns", "budget", "inputs", "worst input");
+    for (f = 0; f < WCET_FUNCTIONS; f++) {
+        const wcet_result *r = &results[f];
+        printf("%-28s %8lu %8lu %6lu  %s%s\n", r->function, (unsigned long)r->worst, (unsigned long)r->budget,
+               (unsigned long)r->inputs, r->input, r->worst > r->budget ? "  OVER BUDGET" : "");
+    }
+    if (!WCET_BUDGETS_MEASURED) {
+        printf("(budgets are estimates until a measurement is recorded in wcet.h)\n");
+    }
+    printf("wcet: %s\n", ok ? "within budget" : "OVER BUDGET");
+    return 0;
+}
@@ -0,0 +1,30 @@
+// ============= RAMFUNC.C =============
+// Startup copy of the .ramfunc section (see ramfunc.h and ramfunc.ld)
+// ===================================
+
+#include <stdint.h>
+#include "ramfunc.h"
+
+#if defined(__arm__) && defined(CALC_RAMFUNC_SRAM)
+// Defined by ramfunc.ld
+extern uint32_t __ramfunc_load__[];
+extern uint32_t __ramfunc_start__[];
+extern uint32_t __ramfunc_end__[];
+
+void ramfunc_init(void)
+{
+    const uint32_t *src = __ramfunc_load__;
+    uint32_t *dst = __ramfunc_start__;
+
+    // The AHB SRAM banks are usable from reset, so the copy can run first thing
+    while (dst < __ramfunc_end__) {
+        *dst++ = *src++;
+    }
+    // Make sure the copied instructions are visible before the first call
+    __asm volatile ("dsb\n\tisb" ::: "memory");
+}
+#else
+void ramfunc_init(void)
+{
+}
+#endif
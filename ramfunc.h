@@ -0,0 +1,26 @@
+// ============= RAMFUNC.H =============
+// Optional code placement in SRAM. Everything runs from flash unless the firmware
+// is built with -DCALC_RAMFUNC_SRAM and linked with ramfunc.ld. Then functions
+// marked CALC_RAMFUNC go to the .ramfunc section, which ramfunc.ld links into the
+// AHB SRAM bank with its load image in flash, together with the soft-float routines
+// from libgcc that the evaluator calls; ramfunc_init() copies it there at startup.
+//
+// Experimental: no figures for either placement have been taken on the board yet,
+// and the SRAM placement stays out of the supported build until eval_bench.c has
+// shown it to be faster. Host builds ignore the attribute.
+#ifndef RAMFUNC_H
+#define RAMFUNC_H
+
+#if defined(__arm__) && defined(CALC_RAMFUNC_SRAM)
+// long_call: SRAM at 0x2007C000 is beyond BL range from flash at 0x00000000. Small
+// helpers may still be inlined into their callers, wherever those are placed.
+#define CALC_RAMFUNC __attribute__((section(".ramfunc"), long_call))
+#define CALC_RAMFUNC_WHERE "SRAM"
+#else
+#define CALC_RAMFUNC
+#define CALC_RAMFUNC_WHERE "Flash"
+#endif
+
+void ramfunc_init(void); // Copies .ramfunc to SRAM; call before any CALC_RAMFUNC function
+
+#endif
@@ -0,0 +1,312 @@
+// ============= RETAIN.C =============
+// Checksummed copies of the calculator state in .noinit SRAM and a flash log, see
+// retain.h.
+// ===================================
+
+#define _POSIX_C_SOURCE 200809L // strnlen() under -std=c99
+#include <LPC17xx.h>
+#include "retain.h"
+#include "delay.h"
+#include "diag.h"
+
+#include <stddef.h> // For offsetof()
+#include <string.h> // For memcpy(), memcmp(), memset(), strnlen()
+
+#define IAP_PREPARE 50
+#define IAP_COPY_RAM_TO_FLASH 51
+#define IAP_ERASE 52
+#define IAP_CMD_SUCCESS 0
+
+// The SRAM copies live in a NOLOAD section that the startup code does not zero
+// (retain.ld); on the host, in the simulator's .noinit SRAM. Flash is read in
+// place, through SIM_FLASH() on the host.
+#ifdef LPC17XX_HOST_SIM
+#define RETAIN_RAM ((retain_record *)sim_noinit)
+#define RETAIN_FLASH(addr) ((const retain_record *)SIM_FLASH(addr))
+#define RETAIN_IAP sim_iap
+#else
+static retain_record retain_ram[2] __attribute__((section(".noinit")));
+#define RETAIN_RAM retain_ram
+#define RETAIN_FLASH(addr) ((const retain_record *)(addr))
+#define RETAIN_IAP ((void (*)(uintptr_t *, uintptr_t *))0x1FFF1FF1UL)
+#endif
+
+// A copy and the rest of its flash slot, word-aligned for IAP
+typedef union {
+    retain_record record;
+    uint32_t words[RETAIN_SLOT_SIZE / 4];
+} retain_slot;
+
+typedef char retain_record_fits_slot[sizeof(retain_record) <= RETAIN_SLOT_SIZE ? 1 : -1];
+#ifdef LPC17XX_HOST_SIM
+typedef char retain_ram_fits_noinit[2 * sizeof(retain_record) <= SIM_NOINIT_SIZE ? 1 : -1];
+#endif
+
+#define RETAIN_PAYLOAD offsetof(retain_record, expr_data) // Start of the compared fields
+#define RETAIN_CRC_LEN offsetof(retain_record, crc)
+
+SIM_LOCAL retain_stats_t retain_stats;
+
+static SIM_LOCAL retain_slot staging;        // Copy being built or programmed
+static SIM_LOCAL uint32_t sequence;          // Of the newest copy anywhere
+static SIM_LOCAL uint32_t flash_sequence;    // Of the newest copy in flash
+static SIM_LOCAL int ram_newest;             // SRAM copy written last, -1 if neither is valid
+static SIM_LOCAL uint32_t changed_at;        // Uptime of the last SRAM copy
+static SIM_LOCAL uint32_t flash_next;        // Next slot to program, 0 .. 2 * RETAIN_SLOTS - 1
+
+// CRC-32 (IEEE 802.3, reflected), four bits per step from a 64-byte table
+static uint32_t retain_crc(const void *data, uint32_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const unsigned char *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    while (len-- > 0) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 15];
+        crc = (crc >> 4) ^ table[crc & 15];
+    }
+    return ~crc;
+}
+
+static bool retain_valid(const retain_record *r)
+{
+    return r->magic == RETAIN_MAGIC && r->expr_len <= MAX_TOKENS && r->current_num_index <= LCD_LINE_LEN &&
+           r->crc == retain_crc(r, RETAIN_CRC_LEN);
+}
+
+// `r` is newer than `than` (NULL for none)
+static bool retain_newer(const retain_record *r, const retain_record *than)
+{
+    return than == NULL || (int32_t)(r->sequence - than->sequence) > 0;
+}
+
+static uintptr_t slot_addr(uint32_t slot)
+{
+    return RETAIN_SECTOR_ADDR + (uintptr_t)slot * RETAIN_SLOT_SIZE;
+}
+
+static uint32_t slot_sector(uint32_t slot)
+{
+    return RETAIN_SECTOR + slot / RETAIN_SLOTS;
+}
+
+// Runs one IAP command. The vectors and handlers are in flash, which cannot be
+// read while it is erased or programmed, so interrupts wait until it is done.
+static uint32_t retain_iap(uintptr_t command[5])
+{
+    uintptr_t result[5];
+
+#ifndef LPC17XX_HOST_SIM
+    __disable_irq();
+#endif
+    RETAIN_IAP(command, result);
+#ifndef LPC17XX_HOST_SIM
+    __enable_irq();
+#endif
+    return (uint32_t)result[0];
+}
+
+static bool retain_erase(uint32_t sector)
+{
+    uintptr_t prepare[5] = { IAP_PREPARE, sector, sector, 0, 0 };
+    uintptr_t erase[5] = { IAP_ERASE, sector, sector, SystemCoreClock / 1000, 0 };
+
+    retain_stats.flash_erases++;
+    return retain_iap(prepare) == IAP_CMD_SUCCESS && retain_iap(erase) == IAP_CMD_SUCCESS;
+}
+
+static bool slot_blank(uint32_t slot)
+{
+    const uint32_t *w = (const uint32_t *)RETAIN_FLASH(slot_addr(slot));
+    unsigned i;
+
+    for (i = 0; i < RETAIN_SLOT_SIZE / 4; i++) {
+        if (w[i] != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Takes the calculator state into staging.record, with canonical padding so that
+// equal states compare equal
+static void retain_capture(void)
+{
+    retain_record *r = &staging.record;
+    calc_view_t view = calc_ctx.view;
+
+#ifndef CALC_NO_DIAG
+    if (view == VIEW_DIAG) {
+        view = calc_ctx.diag_return_view;
+    }
+#endif
+    memset(&staging, 0, sizeof(staging));
+    r->magic = RETAIN_MAGIC;
+    memcpy(r->expr_data, expr_data, expr_len * sizeof(float));
+    memcpy(r->expr_type, expr_type, expr_len);
+    r->ans = calc_ctx.ans;
+    memcpy(r->current_num_str, current_num_str, current_num_index);
+    // The record is zeroed, so copying the characters alone leaves them terminated
+    memcpy(r->view_message, calc_ctx.view_message, strnlen(calc_ctx.view_message, LCD_LINE_LEN));
+    memcpy(r->error_message, error_message, strnlen(error_message, ERROR_MSG_LEN - 1));
+    r->expr_len = (uint8_t)expr_len;
+    r->current_num_index = (uint8_t)current_num_index;
+    r->view = (uint8_t)view;
+    r->flags = (calc_ctx.calculation_has_ended ? RETAIN_F_ENDED : 0) |
+               (calc_ctx.decimal_point_entered ? RETAIN_F_DECIMAL : 0) |
+               (calc_ctx.last_key_was_operator ? RETAIN_F_OPERATOR : 0) |
+               (calculator_error ? RETAIN_F_ERROR : 0);
+}
+
+// Writes `r` over the older SRAM copy, so a reset meanwhile leaves the other one
+static void retain_ram_write(const retain_record *r)
+{
+    ram_newest = ram_newest == 0 ? 1 : 0;
+    RETAIN_RAM[ram_newest] = *r;
+    retain_stats.ram_saves++;
+}
+
+// Puts a valid copy back into the calculator state (after calc_ui_begin())
+static void retain_apply(const retain_record *r)
+{
+    memcpy(expr_data, r->expr_data, r->expr_len * sizeof(float));
+    memcpy(expr_type, r->expr_type, r->expr_len);
+    expr_len = r->expr_len;
+    memcpy(current_num_str, r->current_num_str, sizeof(current_num_str));
+    current_num_str[LCD_LINE_LEN] = '\0';
+    current_num_index = r->current_num_index;
+    memcpy(error_message, r->error_message, sizeof(error_message));
+    error_message[ERROR_MSG_LEN - 1] = '\0';
+    calculator_error = (r->flags & RETAIN_F_ERROR) != 0;
+    calc_ctx.ans = r->ans;
+    calc_ctx.calculation_has_ended = (r->flags & RETAIN_F_ENDED) != 0;
+    calc_ctx.decimal_point_entered = (r->flags & RETAIN_F_DECIMAL) != 0;
+    calc_ctx.last_key_was_operator = (r->flags & RETAIN_F_OPERATOR) != 0;
+}
+
+bool retain_restore(void)
+{
+    uint32_t start = uptime_us();
+    uint32_t cycles = DIAG_CYCLES();
+    const retain_record *best = NULL;
+    const retain_record *best_flash = NULL;
+    const retain_record *rejected = NULL;
+    uint32_t slot, best_slot = 0;
+    bool resumed = false;
+    int i;
+
+    memset(&retain_stats, 0, sizeof(retain_stats));
+    ram_newest = -1;
+    for (i = 0; i < 2; i++) {
+        if (retain_valid(&RETAIN_RAM[i]) && retain_newer(&RETAIN_RAM[i], best)) {
+            best = &RETAIN_RAM[i];
+            ram_newest = i;
+        }
+    }
+    // The newest flash copy by its header, then its CRC; only if that fails, the
+    // newest one older than it, and so on
+    for (;;) {
+        const retain_record *newest = NULL;
+        for (slot = 0; slot < 2 * RETAIN_SLOTS; slot++) {
+            const retain_record *r = RETAIN_FLASH(slot_addr(slot));
+            if (r->magic == RETAIN_MAGIC && retain_newer(r, newest) &&
+                (rejected == NULL || retain_newer(rejected, r))) {
+                newest = r;
+                best_slot = slot;
+            }
+        }
+        if (newest == NULL || retain_valid(newest)) {
+            best_flash = newest;
+            break;
+        }
+        rejected = newest;
+    }
+    flash_sequence = best_flash ? best_flash->sequence : 0;
+    flash_next = best_flash ? (best_slot + 1) % (2 * RETAIN_SLOTS) : 0;
+
+    if (best_flash != NULL && retain_newer(best_flash, best)) {
+        best = best_flash;
+        retain_stats.source = RETAIN_FROM_FLASH;
+        retain_ram_write(best); // Later saves compare against it
+    } else if (best != NULL) {
+        retain_stats.source = RETAIN_FROM_RAM;
+    }
+    sequence = best ? best->sequence : 0;
+    changed_at = start;
+
+    if (best != NULL) {
+        retain_apply(best);
+        if (best->view == VIEW_INPUT || best->view == VIEW_MESSAGE) {
+            memcpy(calc_ctx.view_message, best->view_message, sizeof(calc_ctx.view_message));
+            calc_ctx.view_message[LCD_LINE_LEN] = '\0';
+            calc_ui_resume(best->view == VIEW_MESSAGE ? calc_ctx.view_message : NULL);
+            resumed = true;
+        }
+    }
+    retain_stats.restore_cycles = DIAG_CYCLES() - cycles;
+    retain_stats.restore_us = uptime_us() - start;
+    return resumed;
+}
+
+void retain_save(void)
+{
+    retain_capture();
+    if (ram_newest >= 0 && memcmp((const char *)&staging.record + RETAIN_PAYLOAD,
+                                  (const char *)&RETAIN_RAM[ram_newest] + RETAIN_PAYLOAD,
+                                  RETAIN_CRC_LEN - RETAIN_PAYLOAD) == 0) {
+        return;
+    }
+    staging.record.sequence = ++sequence;
+    staging.record.crc = retain_crc(&staging.record, RETAIN_CRC_LEN);
+    retain_ram_write(&staging.record);
+    changed_at = uptime_us();
+}
+
+bool retain_flash_pending(void)
+{
+    return ram_newest >= 0 && RETAIN_RAM[ram_newest].sequence != flash_sequence;
+}
+
+uint32_t retain_flash_wait_us(void)
+{
+    uint32_t idle = uptime_us() - changed_at;
+    return idle >= RETAIN_IDLE_MS * 1000UL ? 0 : RETAIN_IDLE_MS * 1000UL - idle;
+}
+
+void retain_flash_write(void)
+{
+    uintptr_t prepare[5] = { IAP_PREPARE, 0, 0, 0, 0 };
+    uintptr_t copy[5] = { IAP_COPY_RAM_TO_FLASH, 0, (uintptr_t)staging.words, RETAIN_SLOT_SIZE, 0 };
+    uint32_t tries;
+
+    if (!retain_flash_pending()) {
+        return;
+    }
+    staging.record = RETAIN_RAM[ram_newest];
+    memset((char *)&staging + sizeof(staging.record), 0xFF, sizeof(staging) - sizeof(staging.record));
+
+    // A sector is erased when the log moves into it, which drops the oldest copies.
+    // A slot left dirty by a write that a reset interrupted is skipped.
+    for (tries = 0; tries < 2 * RETAIN_SLOTS; tries++, flash_next = (flash_next + 1) % (2 * RETAIN_SLOTS)) {
+        if (flash_next % RETAIN_SLOTS == 0 && !slot_blank(flash_next) && !retain_erase(slot_sector(flash_next))) {
+            return;
+        }
+        if (slot_blank(flash_next)) {
+            break;
+        }
+    }
+    prepare[1] = prepare[2] = slot_sector(flash_next);
+    copy[1] = slot_addr(flash_next);
+    copy[4] = SystemCoreClock / 1000;
+    flash_next = (flash_next + 1) % (2 * RETAIN_SLOTS);
+    if (retain_iap(prepare) != IAP_CMD_SUCCESS || retain_iap(copy) != IAP_CMD_SUCCESS) {
+        changed_at = uptime_us(); // Try the next slot after another RETAIN_IDLE_MS
+        return;
+    }
+    retain_stats.flash_writes++;
+    flash_sequence = staging.record.sequence;
+}
@@ -0,0 +1,86 @@
+// ============= RETAIN.H =============
+// State retention across resets. The expression being typed, the number in
+// progress, ANS and the input flags and view are kept in checksummed copies, and
+// restored at boot in place of the start-up message:
+// - two copies in .noinit SRAM, written in turn after every change, which survive
+//   a watchdog reset and a supply dip that the SRAM rides out
+// - a log of copies in two reserved 32 kB flash sectors, one slot per copy, written
+//   through IAP once no key has come for RETAIN_IDLE_MS, which survives a power cut
+// Each copy carries a sequence number and a CRC-32; the newest valid one wins. An
+// evaluation in progress is not restarted: its expression comes back, and '='
+// starts it again (if the evaluation caused the reset, it would do so again).
+//
+// The RTC general-purpose registers hold 20 bytes, too few for the expression.
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "logic.h"
+#include "sim_local.h"
+
+#define RETAIN_MAGIC 0x43414C01UL  // "CAL" and the layout version; bump on changes
+#define RETAIN_SECTOR 28           // Flash sectors RETAIN_SECTOR and RETAIN_SECTOR + 1,
+#define RETAIN_SECTOR_ADDR 0x00070000UL // at the top of flash (keep them out of the image)
+#define RETAIN_SECTOR_SIZE 0x8000UL
+#define RETAIN_SLOT_SIZE 512       // One copy per slot; a write programs one slot
+#define RETAIN_SLOTS (RETAIN_SECTOR_SIZE / RETAIN_SLOT_SIZE)
+#define RETAIN_IDLE_MS 1000        // Unchanged this long before a copy goes to flash
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;                       // Newer copies have higher numbers
+    float expr_data[MAX_TOKENS];             // Only the first expr_len tokens, the rest 0
+    float ans;
+    char expr_type[MAX_TOKENS];
+    char current_num_str[LCD_LINE_LEN + 1];
+    char view_message[LCD_LINE_LEN + 1];
+    char error_message[ERROR_MSG_LEN];
+    uint8_t expr_len;
+    uint8_t current_num_index;
+    uint8_t view;                            // calc_view_t; the diagnostics screen counts as the view below it
+    uint8_t flags;                           // RETAIN_F_*
+    uint32_t crc;                            // CRC-32 of everything above
+} retain_record;
+
+#define RETAIN_F_ENDED 0x01     // calc_ctx.calculation_has_ended
+#define RETAIN_F_DECIMAL 0x02   // calc_ctx.decimal_point_entered
+#define RETAIN_F_OPERATOR 0x04  // calc_ctx.last_key_was_operator
+#define RETAIN_F_ERROR 0x08     // calculator_error
+
+typedef enum {
+    RETAIN_FROM_NONE,   // Nothing valid: first power-up, or both copies lost
+    RETAIN_FROM_RAM,
+    RETAIN_FROM_FLASH
+} retain_source_t;
+
+typedef struct {
+    retain_source_t source;   // Where the last restore found the state
+    uint32_t restore_us;      // Time retain_restore() took
+    uint32_t restore_cycles;  // The same in CPU cycles (DWT, target only)
+    uint32_t ram_saves;       // Copies written to SRAM since boot
+    uint32_t flash_writes;    // Copies written to flash since boot
+    uint32_t flash_erases;    // Sector erases since boot
+} retain_stats_t;
+
+extern SIM_LOCAL retain_stats_t retain_stats; // For a debugger and the tests
+
+// Boot: restores the newest valid copy and, unless it was taken on the start-up
+// message, shows it with calc_ui_resume(). Call after calc_ui_begin(); returns true
+// if the start-up message should be skipped. Run at full clock: it may check up to
+// 2 * RETAIN_SLOTS flash copies.
+bool retain_restore(void);
+
+// After the calculator state may have changed: writes an SRAM copy if it did
+void retain_save(void);
+
+// The newest copy is not in flash yet; retain_flash_wait_us() is the time until
+// it is due, 0 when retain_flash_write() should run
+bool retain_flash_pending(void);
+uint32_t retain_flash_wait_us(void);
+
+// Programs the newest copy into the next free flash slot: 2 ms, plus 100 ms to
+// erase the other sector when one is full. Interrupts are off meanwhile.
+void retain_flash_write(void);
+
+#endif
@@ -0,0 +1,119 @@
+// ============= SCHED.C =============
+// Cooperative scheduler: picks the task with the earliest due wake-up, runs it once,
+// and accounts the time it took. Sleeps on the delay timer when nothing is due.
+// ===================================
+
+#include "sched.h"
+#include "delay.h"
+#include <stddef.h>
+
+SIM_LOCAL sched_task sched_tasks[SCHED_MAX_TASKS];
+SIM_LOCAL uint32_t sched_idle_us = 0;
+
+// Wrap-safe "a is before b" for uptime values less than 35 minutes apart
+#define SCHED_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+void sched_init(void)
+{
+    int i;
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_tasks[i].active = 0;
+    }
+    sched_idle_us = 0;
+}
+
+sched_task *sched_add(const char *name, sched_fn run)
+{
+    int i;
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_task *t = &sched_tasks[i];
+        if (!t->active) {
+            t->name = name;
+            t->run = run;
+            PT_INIT(&t->pt);
+            t->wake_at = uptime_us();
+            t->blocked = 0;
+            t->runtime_us = 0;
+            t->max_run_us = 0;
+            t->runs = 0;
+            t->active = 1;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+void sched_wake(sched_task *task)
+{
+    task->wake_at = uptime_us();
+    task->blocked = 0;
+}
+
+// Non-blocked task with the earliest wake-up; ties go to the task added first
+static sched_task *sched_earliest(void)
+{
+    sched_task *earliest = NULL;
+    int i;
+
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_task *t = &sched_tasks[i];
+        if (t->active && !t->blocked &&
+            (earliest == NULL || SCHED_BEFORE(t->wake_at, earliest->wake_at))) {
+            earliest = t;
+        }
+    }
+    return earliest;
+}
+
+static void sched_sleep_until(uint32_t at_us)
+{
+    uint32_t now = uptime_us();
+    sleep_until_us(at_us);
+    sched_idle_us += uptime_us() - now;
+}
+
+int sched_run_once(void)
+{
+    sched_task *next = sched_earliest();
+    uint32_t start, took;
+
+    if (next == NULL) {
+        return 0; // Everything is blocked; only an interrupt handler could wake a task now
+    }
+    if (SCHED_BEFORE(uptime_us(), next->wake_at)) {
+        sched_sleep_until(next->wake_at); // Nothing due: sleep until the earliest deadline
+        return 0;
+    }
+
+    start = uptime_us();
+    if (next->run(next) == PT_ENDED) {
+        next->active = 0;
+    }
+    took = uptime_us() - start;
+    next->runtime_us += took;
+    if (took > next->max_run_us) {
+        next->max_run_us = took;
+    }
+    next->runs++;
+    return 1;
+}
+
+void sched_run_until(uint32_t until_us)
+{
+    while (SCHED_BEFORE(uptime_us(), until_us)) {
+        sched_task *earliest = sched_earliest();
+
+        if (earliest == NULL || !SCHED_BEFORE(earliest->wake_at, until_us)) {
+            sched_sleep_until(until_us); // Do not sleep past `until_us`
+            return;
+        }
+        sched_run_once();
+    }
+}
+
+void sched_run(void)
+{
+    for (;;) {
+        sched_run_once();
+    }
+}
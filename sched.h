@@ -0,0 +1,73 @@
+// ============= SCHED.H =============
+// Cooperative run-to-completion scheduler with stackless (protothread style) tasks.
+//
+// A task is a function that is called again and again; the PT_ and SCHED_ macros
+// below let it be written as straight-line code that yields and resumes where it
+// left off. Tasks share the one stack, so local variables do not survive a yield:
+// keep such state in statics or in the task's own structure.
+//
+// Tasks wake up in deadline order. When no task is ready the scheduler sleeps until
+// the earliest deadline with sleep_until_us(), which uses the delay timer's match
+// interrupt, so one hardware timer provides both time and wake-ups.
+// All memory is the fixed task table; nothing is allocated at run time.
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include "sim_local.h"
+
+#define SCHED_MAX_TASKS 6
+
+// --- Protothreads ---
+// A local continuation is the source line to resume at (switch-based, so a task
+// must not yield from inside a switch statement of its own).
+typedef struct {
+    unsigned short lc;
+} pt_t;
+
+#define PT_WAITING 0 // Yielded, call again later
+#define PT_ENDED   1 // Ran to the end, the task is finished
+
+#define PT_INIT(pt)  ((pt)->lc = 0)
+#define PT_BEGIN(pt) switch ((pt)->lc) { case 0:
+#define PT_END(pt)   } (pt)->lc = 0; return PT_ENDED
+#define PT_YIELD(pt) do { (pt)->lc = __LINE__; return PT_WAITING; case __LINE__:; } while (0)
+
+// --- Tasks ---
+typedef struct sched_task sched_task;
+typedef char (*sched_fn)(sched_task *task);
+
+struct sched_task {
+    const char *name;
+    sched_fn run;
+    pt_t pt;
+    uint32_t wake_at;      // Uptime (us) at which the task becomes ready
+    unsigned char blocked; // Waiting for sched_wake(), wake_at is ignored
+    unsigned char active;  // Slot in use
+    // Runtime accounting (microseconds of uptime spent inside run())
+    uint32_t runtime_us;   // Total, wraps after about 71 minutes of CPU time
+    uint32_t max_run_us;   // Longest single run
+    uint32_t runs;         // Number of calls
+};
+
+// Yield, ready again immediately (after any other task that is already due)
+#define SCHED_YIELD(t) do { (t)->wake_at = uptime_us(); PT_YIELD(&(t)->pt); } while (0)
+// Sleep for `us` microseconds, or until sched_wake()
+#define SCHED_SLEEP_US(t, us) do { (t)->wake_at = uptime_us() + (us); PT_YIELD(&(t)->pt); } while (0)
+// Sleep until the absolute uptime `at` (drift-free periodic tasks), or until sched_wake()
+#define SCHED_SLEEP_UNTIL(t, at) do { (t)->wake_at = (at); PT_YIELD(&(t)->pt); } while (0)
+// Block until sched_wake()
+#define SCHED_WAIT(t) do { (t)->blocked = 1; PT_YIELD(&(t)->pt); } while (0)
+
+void sched_init(void);
+sched_task *sched_add(const char *name, sched_fn run); // NULL if the task table is full
+void sched_wake(sched_task *task);                      // Make a sleeping or blocked task ready now
+int sched_run_once(void);                               // Run one ready task (1), or sleep until the next deadline (0)
+void sched_run_until(uint32_t until_us);                // Run tasks until the uptime reaches `until_us`
+void sched_run(void);                                   // Run tasks forever
+
+// --- Accounting ---
+extern SIM_LOCAL sched_task sched_tasks[SCHED_MAX_TASKS];
+extern SIM_LOCAL uint32_t sched_idle_us; // Time spent sleeping in the scheduler
+
+#endif
@@ -0,0 +1,19 @@
+// ============= SIM_LOCAL.H =============
+// Storage of the firmware's mutable state. Every variable that belongs to one
+// calculator (the calculator core, the drivers, the scheduler and the board
+// simulator) is marked SIM_LOCAL. Normally that expands to nothing.
+//
+// fleet_sim.c builds with -DSIM_THREAD_LOCAL, which makes the state thread-local,
+// so each worker thread of its pool runs a calculator of its own.
+#ifndef SIM_LOCAL_H
+#define SIM_LOCAL_H
+
+#if defined(SIM_THREAD_LOCAL) && defined(__cplusplus)
+#define SIM_LOCAL __thread // No TLS wrapper calls, so C and C++ objects link together
+#elif defined(SIM_THREAD_LOCAL)
+#define SIM_LOCAL _Thread_local
+#else
+#define SIM_LOCAL
+#endif
+
+#endif
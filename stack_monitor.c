@@ -0,0 +1,131 @@
+// ============= STACK_MONITOR.C =============
+// Stack painting and high-water mark, see stack_monitor.h
+// ===================================
+
+#include "stack_monitor.h"
+#include "fmt.h"
+#include "logic.h"
+#include "lcd.h"
+#include "delay.h"
+
+void stack_paint_range(uint32_t *limit, uint32_t *end)
+{
+    while (limit < end) {
+        *limit++ = STACK_PAINT_WORD;
+    }
+}
+
+// The stack grows down from top, so the first overwritten word above limit marks
+// the deepest point reached
+uint32_t stack_used_bytes(const uint32_t *limit, const uint32_t *top)
+{
+    const uint32_t *p = limit;
+    while (p < top && *p == STACK_PAINT_WORD) {
+        p++;
+    }
+    return (uint32_t)((top - p) * sizeof(uint32_t));
+}
+
+#if defined(__arm__)
+// Defined by the linker script
+extern uint32_t __StackLimit[];
+extern uint32_t __StackTop[];
+
+void stack_paint(void)
+{
+    uint32_t *sp;
+    __asm volatile ("mov %0, sp" : "=r" (sp));
+    stack_paint_range(__StackLimit, sp - STACK_PAINT_MARGIN / sizeof(uint32_t));
+}
+
+uint32_t stack_size(void)
+{
+    return (uint32_t)((__StackTop - __StackLimit) * sizeof(uint32_t));
+}
+
+uint32_t stack_high_water(void)
+{
+    return stack_used_bytes(__StackLimit, __StackTop);
+}
+#else
+void stack_paint(void)
+{
+}
+
+uint32_t stack_size(void)
+{
+    return 0;
+}
+
+uint32_t stack_high_water(void)
+{
+    return 0;
+}
+#endif
+
+// Expressions for stack_stress(): one number repeated, joined by one operator or,
+// for KEY_NONE, by all four in turn. The results are an overflow, a number in
+// scientific notation, an underflow to 0 and a long mixed-precedence chain.
+static const struct {
+    const char *number;
+    unsigned char op;
+} stress_patterns[] = {
+    { "9999999.9", KEY_MULTIPLY },
+    { "30", KEY_MULTIPLY },
+    { "7", KEY_DIVIDE },
+    { "123456789012345", KEY_NONE },
+};
+static const unsigned char stress_ops[] = { KEY_PLUS, KEY_MULTIPLY, KEY_MINUS, KEY_DIVIDE };
+#define STRESS_PATTERNS (int)(sizeof(stress_patterns) / sizeof(stress_patterns[0]))
+
+static void stress_key(unsigned char key)
+{
+    calc_ui_key(key);
+    if (calc_eval_pending()) {
+        calc_eval_run();
+    }
+    calc_render();
+}
+
+static void stress_number(const char *digits)
+{
+    for (; *digits; digits++) {
+        stress_key(*digits == '.' ? KEY_DECIMAL : (unsigned char)(*digits - '0'));
+    }
+}
+
+void stack_stress(void)
+{
+    int pattern, i;
+
+    // MAX_TOKENS - 1 tokens: numbers and operators alternate, ending with a number
+    for (pattern = 0; pattern < STRESS_PATTERNS; pattern++) {
+        unsigned char op = stress_patterns[pattern].op;
+        for (i = 0; i < MAX_TOKENS / 2; i++) {
+            stress_number(stress_patterns[pattern].number);
+            if (i < MAX_TOKENS / 2 - 1) {
+                stress_key(op != KEY_NONE ? op : stress_ops[i % 4]);
+            }
+        }
+        stress_key(KEY_EQUALS);
+    }
+    calc_ui_begin(); // Back to the start-up message
+}
+
+void stack_report_show(void)
+{
+    char line[32]; // Room for any counts; cut to the LCD width below
+    int len;
+
+    stack_stress();
+    len = fmt_str(line, 0, "Stack ");
+    len += fmt_u64(line + len, stack_high_water());
+    len = fmt_str(line, len, "/");
+    fmt_u64(line + len, stack_size());
+    line[LCD_LINE_LEN] = '\0';
+    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C');
+    lcdstring(line);
+    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+    lcdstring("after stress run");
+    delay(2000);
+}
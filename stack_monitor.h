@@ -0,0 +1,28 @@
+// ============= STACK_MONITOR.H =============
+// Stack high-water mark. stack_paint() fills the unused part of the stack with a
+// pattern at boot; stack_high_water() later finds the deepest word that was
+// overwritten. The stack bounds come from the linker script (__StackLimit and
+// __StackTop, as in the CMSIS GCC startup files). Host builds report 0.
+#ifndef STACK_MONITOR_H
+#define STACK_MONITOR_H
+
+#include <stdint.h>
+
+#define STACK_PAINT_WORD 0xC5C5C5C5UL
+#define STACK_PAINT_MARGIN 64 // Bytes below the caller's stack pointer left unpainted
+
+void stack_paint(void);           // Call first thing at boot
+uint32_t stack_size(void);        // Bytes reserved for the stack
+uint32_t stack_high_water(void);  // Deepest use since stack_paint(), in bytes
+
+// The range versions behind the above, usable on any buffer
+void stack_paint_range(uint32_t *limit, uint32_t *end);
+uint32_t stack_used_bytes(const uint32_t *limit, const uint32_t *top);
+
+// Types the longest expressions the calculator accepts, with every operator and
+// results that need scientific notation, through the normal key, evaluation and
+// display path, so that stack_high_water() afterwards covers the worst case
+void stack_stress(void);
+void stack_report_show(void); // Runs stack_stress() and shows the peak on the LCD for 2 s
+
+#endif
@@ -0,0 +1,141 @@
+// stack_report.c - Folds GCC -fstack-usage output into one report
+//
+// Lists every function from the given .su files by frame size, largest first, and
+// optionally adds up the frames along a call chain given with -c. Frames of library
+// code (newlib's snprintf, soft-float) are not in the .su files; the runtime
+// high-water mark (stack_monitor.c) covers those.
+//
+//     gcc -Wall -o stack_report stack_report.c -std=c99
+//     ./stack_report [-n top] [-c func,func,...] file.su...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FRAMES 2048
+#define NAME_LEN 96
+
+typedef struct {
+    char function[NAME_LEN];
+    char where[NAME_LEN]; // file:line
+    unsigned long bytes;
+    char kind[24];        // static, dynamic or "dynamic,bounded"
+} frame_entry;
+
+static frame_entry frames[MAX_FRAMES];
+static int frame_count = 0;
+
+// A line reads "path:line:col:function<TAB>bytes<TAB>kind"
+static int parse_line(char *line, frame_entry *out)
+{
+    char *tab1 = strchr(line, '\t');
+    char *tab2 = tab1 ? strchr(tab1 + 1, '\t') : NULL;
+    char *colon, *col_colon;
+
+    if (!tab2) return 0;
+    *tab1 = '\0';
+    *tab2 = '\0';
+    colon = strrchr(line, ':');    // Before the function name
+    if (!colon) return 0;
+    *colon = '\0';
+    col_colon = strrchr(line, ':'); // Before the column
+    if (col_colon) *col_colon = '\0';
+
+    snprintf(out->function, sizeof(out->function), "%s", colon + 1);
+    snprintf(out->where, sizeof(out->where), "%s", line);
+    out->bytes = strtoul(tab1 + 1, NULL, 10);
+    snprintf(out->kind, sizeof(out->kind), "%.*s", (int)strcspn(tab2 + 1, "\r\n"), tab2 + 1);
+    return 1;
+}
+
+static int load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) && frame_count < MAX_FRAMES) {
+        if (parse_line(line, &frames[frame_count])) {
+            frame_count++;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+static int by_size(const void *a, const void *b)
+{
+    const frame_entry *fa = a, *fb = b;
+    if (fa->bytes != fb->bytes) return (fa->bytes < fb->bytes) ? 1 : -1;
+    return strcmp(fa->function, fb->function);
+}
+
+static const frame_entry *find(const char *function)
+{
+    int i;
+    for (i = 0; i < frame_count; i++) {
+        if (strcmp(frames[i].function, function) == 0) return &frames[i];
+    }
+    return NULL;
+}
+
+static void report_chain(char *chain)
+{
+    unsigned long total = 0;
+    int missing = 0, dynamic = 0;
+    char *name;
+
+    printf("\nCall chain:\n");
+    for (name = strtok(chain, ","); name; name = strtok(NULL, ",")) {
+        const frame_entry *e = find(name);
+        if (e) {
+            printf("  %6lu  %-16s %s\n", e->bytes, e->kind, e->function);
+            total += e->bytes;
+            dynamic |= strncmp(e->kind, "static", 6) != 0;
+        } else {
+            printf("  %6s  %-16s %s\n", "?", "not found", name);
+            missing++;
+        }
+    }
+    printf("  %6lu  total%s%s\n", total, dynamic ? ", lower bound (dynamic frames)" : "",
+           missing ? ", lower bound (missing frames)" : "");
+}
+
+int main(int argc, char **argv)
+{
+    char *chain = NULL;
+    int top = 0, i;
+    unsigned long dynamic = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            chain = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            top = atoi(argv[++i]);
+        } else if (load(argv[i]) < 0) {
+            return 1;
+        }
+    }
+    if (frame_count == 0) {
+        fprintf(stderr, "usage: %s [-n top] [-c func,func,...] file.su...\n", argv[0]);
+        return 1;
+    }
+
+    qsort(frames, frame_count, sizeof(frames[0]), by_size);
+    printf("  bytes  kind             function (file:line)\n");
+    for (i = 0; i < frame_count && (top <= 0 || i < top); i++) {
+        printf("  %5lu  %-16s %s (%s)\n", frames[i].bytes, frames[i].kind, frames[i].function, frames[i].where);
+    }
+    for (i = 0; i < frame_count; i++) {
+        dynamic += strncmp(frames[i].kind, "static", 6) != 0;
+    }
+    printf("%d functions, %lu with dynamic frames\n", frame_count, dynamic);
+
+    if (chain) {
+        report_chain(chain);
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+// ============= TASKS.C =============
+// The calculator as five cooperative tasks on the scheduler in sched.c:
+//   keypad - scans one row per wake-up and queues debounced keys
+//   ui     - restores the state kept through a reset, then feeds queued keys to
+//            calc_ui_key()
+//   eval   - runs a pending KEY_EQUALS evaluation, EVAL_SLICE_OPS per run
+//   lcd    - brings the display up to date with calc_render(), at most RENDER_MAX_FPS
+//            times a second; keys that arrive in between are drained into one frame
+//   retain - keeps the retention copies of the state current (retain.c)
+// The eval and LCD tasks hold a clock boost (clock.c) while they work; the rest of
+// the time the CPU runs at the idle clock or sleeps.
+// Each task checks for work before it blocks, so a wake-up sent before its first
+// run is not lost. None of them waits with delay(), so a row settle time or a slow evaluation no
+// longer holds up the other tasks beyond a single run.
+// ===================================
+
+#include "tasks.h"
+#include "clock.h"
+#include "keypad.h"
+#include "logic.h"
+#include "delay.h"
+#include "lcd.h"
+#include "retain.h"
+#ifdef LCD_DMA_BACKEND
+#include "lcd_dma.h"
+#endif
+#include <stddef.h>
+
+SIM_LOCAL sched_task *task_keypad = NULL;
+SIM_LOCAL sched_task *task_lcd = NULL;
+SIM_LOCAL sched_task *task_eval = NULL;
+SIM_LOCAL sched_task *task_ui = NULL;
+SIM_LOCAL sched_task *task_retain = NULL;
+
+#define LCD_DMA_POLL_US 100 // How often the LCD task checks for the end of a DMA frame
+
+// Same scan as GetKeyPressed(), but sleeping through the row settle time. While a
+// key settles, only its row is read, every KEY_SAMPLE_US, until the debouncer has
+// decided; a key being released is followed on the row where it was last seen.
+static char keypad_task(sched_task *t)
+{
+    static SIM_LOCAL unsigned char row;
+    static SIM_LOCAL unsigned char keyRow;
+    static SIM_LOCAL unsigned char key;
+
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        key = 0xFF;
+        for (row = 0; row < 4; row++) {
+            KeypadSelectRow(row);
+            SCHED_SLEEP_US(t, KEY_SETTLE_US);
+            key = KeypadReadRow(row);
+            if (key != 0xFF) {
+                keyRow = row;
+                break; // Found a key, stop scanning
+            }
+        }
+        for (;;) {
+            key = KeypadDebounce(key);
+            if (key != 0xFF) {
+                KeypadQueueKey(key);
+                sched_wake(task_ui);
+            }
+            if (!KeypadDebouncing()) {
+                break;
+            }
+            if (row != keyRow) {
+                row = keyRow;
+                KeypadSelectRow(row);
+                SCHED_SLEEP_US(t, KEY_SETTLE_US);
+            } else {
+                SCHED_SLEEP_US(t, KEY_SAMPLE_US);
+            }
+            key = KeypadReadRow(row);
+        }
+        SCHED_SLEEP_US(t, KEY_POLL_MS * 1000UL);
+    }
+    PT_END(&t->pt);
+}
+
+static char ui_task(sched_task *t)
+{
+    bool resumed;
+
+    PT_BEGIN(&t->pt);
+    calc_ui_begin();
+    clock_boost(); // The restore checks every flash copy
+    resumed = retain_restore();
+    clock_release();
+    sched_wake(task_lcd);
+
+    // Start-up message, unless a kept state was put back: until the first key (the
+    // keypad task wakes us) or SPLASH_MS
+    if (!resumed) {
+        SCHED_SLEEP_US(t, SPLASH_MS * 1000UL);
+        calc_ui_poll();
+        sched_wake(task_lcd);
+    }
+
+    for (;;) {
+        // Keys stay queued while an evaluation is pending, except KEY_CANCEL, which
+        // aborts it wherever it is and drops the keys typed ahead of it (so "Err:
+        // Cancelled" is shown); the eval task wakes us when the result is shown
+        if (calc_eval_pending() && KeypadFlushThrough(KEY_CANCEL)) {
+            calc_eval_cancel();
+        }
+        while (!calc_eval_pending() && KeypadPeekKey() != KEY_NONE) {
+            calc_ui_key(KeypadNextKey());
+        }
+        if (calc_eval_pending()) {
+            sched_wake(task_eval);
+        }
+        sched_wake(task_lcd);
+        sched_wake(task_retain);
+        SCHED_WAIT(t);
+    }
+    PT_END(&t->pt);
+}
+
+static char eval_task(sched_task *t)
+{
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        // One slice per run; yielding in between lets key scans and a cancel get in
+        if (calc_eval_pending()) {
+            clock_boost();
+            while (calc_eval_slice()) {
+                SCHED_YIELD(t);
+            }
+            clock_release();
+        }
+        sched_wake(task_lcd);
+        sched_wake(task_ui); // Keys queued during the evaluation
+        SCHED_WAIT(t);
+    }
+    PT_END(&t->pt);
+}
+
+static char lcd_task(sched_task *t)
+{
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        // Wait out the frame interval first; the UI task keeps draining keys meanwhile
+        while (calc_render_pending() && calc_render_wait_us() != 0) {
+            SCHED_SLEEP_US(t, calc_render_wait_us());
+        }
+        if (calc_render_pending()) {
+            clock_boost();
+            calc_render();
+#ifdef LCD_DMA_BACKEND
+            while (lcd_dma_busy()) { // Keep the boost (and the DMA tick) until the frame is out
+                SCHED_SLEEP_US(t, LCD_DMA_POLL_US);
+            }
+#endif
+            clock_release();
+        }
+        SCHED_WAIT(t);
+    }
+    PT_END(&t->pt);
+}
+
+// Woken by the UI task after keys and results. The SRAM copy is written at once;
+// the flash copy waits until the state has been left alone for RETAIN_IDLE_MS, so
+// a burst of typing costs one flash write.
+static char retain_task(sched_task *t)
+{
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        SCHED_WAIT(t); // Not before the UI task has restored the state
+        do {
+            clock_boost();
+            retain_save();
+            clock_release();
+            if (retain_flash_pending() && retain_flash_wait_us() == 0) {
+                retain_flash_write(); // Waits in the boot ROM, as long at any clock
+            }
+            if (retain_flash_pending()) {
+                SCHED_SLEEP_US(t, retain_flash_wait_us()); // Or until the next change
+            }
+        } while (retain_flash_pending());
+    }
+    PT_END(&t->pt);
+}
+
+void tasks_start(void)
+{
+    sched_init();
+    // Registration order breaks ties between tasks that are due at the same time
+    task_keypad = sched_add("keypad", keypad_task);
+    task_ui = sched_add("ui", ui_task);
+    task_eval = sched_add("eval", eval_task);
+    task_lcd = sched_add("lcd", lcd_task);
+    task_retain = sched_add("retain", retain_task);
+}
@@ -0,0 +1,16 @@
+// ============= TASKS.H =============
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "sched.h"
+
+// Calculator work split into cooperative tasks (see tasks.c)
+extern SIM_LOCAL sched_task *task_keypad;
+extern SIM_LOCAL sched_task *task_lcd;
+extern SIM_LOCAL sched_task *task_eval;
+extern SIM_LOCAL sched_task *task_ui;
+extern SIM_LOCAL sched_task *task_retain;
+
+void tasks_start(void); // Registers the tasks; call after boot_fast(), then sched_run()
+
+#endif
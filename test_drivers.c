@@ -0,0 +1,832 @@
+// test_drivers.c - Host tests for lcd.c and keypad.c running on the board simulator
+
+#include <stdio.h>
+#include <string.h>
+#include "LPC17xx.h"
+#include "board_sim.h"
+#include "lcd.h"
+#include "lcd_dma.h"
+#include "keypad.h"
+#include "keymap.h"
+#include "logic.h"
+#include "boot.h"
+#include "sched.h"
+#include "tasks.h"
+#include "delay.h"
+#include "clock.h"
+#include "stack_monitor.h"
+#include "delay_profile.h"
+#include "diag.h"
+#include "event_trace.h"
+#include "retain.h"
+
+// --- Assertion Macros ---
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define RUN_TEST(test_function) do { \
+    printf("Running %s...\n", #test_function); \
+    test_function(); \
+} while (0)
+
+#define ASSERT_TRUE(condition, message_format, ...) do { \
+    if (!(condition)) { \
+        printf(ANSI_COLOR_RED "[FAIL] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf(" (%s:%d)\n", __FILE__, __LINE__); \
+        tests_failed++; \
+    } else { \
+        printf(ANSI_COLOR_GREEN "[PASS] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf("\n"); \
+        tests_passed++; \
+    } \
+} while (0)
+
+#define ASSERT_EQUAL_STRING(expected, actual, message_format, ...) do { \
+    if (strcmp(expected, actual) != 0) { \
+        printf(ANSI_COLOR_RED "[FAIL] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf(" - Expected '%s', got '%s' (%s:%d)\n", expected, actual, __FILE__, __LINE__); \
+        tests_failed++; \
+    } else { \
+        printf(ANSI_COLOR_GREEN "[PASS] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf("\n"); \
+        tests_passed++; \
+    } \
+} while (0)
+
+// GPIO stores per operation of the SET/CLR based drivers these replaced:
+// lcdchar() cleared RS or set it, cleared RW, then per nibble cleared the data pins,
+// set the nibble, set EN and cleared EN; SetRowToZero() set all rows then cleared one.
+#define LEGACY_STORES_PER_LCD_BYTE 10
+#define LEGACY_STORES_PER_ROW_SELECT 2
+
+static void board_setup(void) {
+    board_sim_reset();
+    clock_init();
+    delay_init();
+    lcdinit();
+    KeyPadInitialize();
+    clear_all_state();
+}
+
+// Polls the keypad the way the main loop does until a key is accepted
+static unsigned char poll_until_key(int max_polls) {
+    unsigned char key = KEY_NONE;
+    while (max_polls-- > 0 && (key = GetKeyPressed()) == KEY_NONE) {
+    }
+    return key;
+}
+
+// --- Test Cases for lcd.c ---
+
+void test_lcd_char_single_store_per_edge() {
+    board_setup();
+    unsigned long stores_before = sim_gpio_stores;
+    lcdchar('A', 'D');
+    ASSERT_TRUE(sim_gpio_stores - stores_before == 5, "LCD: 5 GPIO stores per byte (got %lu)",
+                sim_gpio_stores - stores_before);
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("A               ", line, "LCD: character latched by controller");
+}
+
+void test_lcd_string_and_second_line() {
+    board_setup();
+    lcdstring("Calculator Ready");
+    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+    lcdstring("Enter Expression");
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("Calculator Ready", line, "LCD: line 1 text");
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("Enter Expression", line, "LCD: line 2 text");
+}
+
+void test_lcd_history_scrolls_with_display_shift() {
+    board_setup();
+    for (int i = 1; i <= 5; ++i) {
+        push_operand_to_expr(i * 1000.0f);
+        push_operator_to_expr('+');
+        update_lcd_display_content();
+    }
+    board_sim_run_dma(); // Let a queued frame finish when built with LCD_DMA_BACKEND
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("+3000+4000+5000+", line, "LCD: history tail visible after shifting");
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("                ", line, "LCD: line 2 blank in shifted window");
+}
+
+void test_lcd_cpu_path_meets_timing() {
+    board_setup();
+    lcdstring("Calculator Ready");
+    update_lcd_display_content();
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "LCD: bit-banged writes meet HD44780 timing (%s)",
+                sim_lcd_last_violation);
+}
+
+// --- Test Cases for lcd_dma.c ---
+
+static void frame_string(lcd_dma_frame *frame, const char *str) {
+    while (*str) {
+        lcd_dma_frame_byte(frame, *str++, 'D');
+    }
+}
+
+void test_lcd_dma_frame_streams_without_cpu() {
+    static lcd_dma_frame frame;
+    board_setup();
+    lcd_dma_init();
+    lcd_dma_frame_reset(&frame);
+    lcd_dma_frame_byte(&frame, LCD_CMD_CLEAR_DISPLAY, 'C');
+    frame_string(&frame, "12+34*5");
+    lcd_dma_frame_byte(&frame, LCD_CMD_CURSOR_LINE_2, 'C');
+    frame_string(&frame, "678");
+    ASSERT_TRUE(frame.count <= LCD_DMA_FRAME_WORDS, "DMA: frame fits (%d words)", frame.count);
+
+    unsigned long cpu_stores_before = sim_gpio_stores - sim_dma_transfers;
+    unsigned long long start_ns = sim_time_ns;
+    lcd_dma_start(&frame);
+    ASSERT_TRUE(lcd_dma_busy(), "DMA: channel busy after start");
+    board_sim_run_dma();
+    ASSERT_TRUE(!lcd_dma_busy(), "DMA: channel idle after the last word");
+    ASSERT_TRUE(sim_dma_transfers == (unsigned long)frame.count, "DMA: one transfer per word");
+    ASSERT_TRUE(sim_gpio_stores - sim_dma_transfers == cpu_stores_before, "DMA: no CPU GPIO stores");
+    printf("DMA frame: %d words, %llu us on the bus\n", frame.count, (sim_time_ns - start_ns) / 1000);
+
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("12+34*5         ", line, "DMA: line 1 text");
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("678             ", line, "DMA: line 2 text");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "DMA: waveform meets HD44780 timing (%s)",
+                sim_lcd_last_violation);
+}
+
+void test_lcd_dma_timing_checker_catches_busy_write() {
+    static lcd_dma_frame frame;
+    board_setup();
+    lcd_dma_init();
+    lcd_dma_frame_reset(&frame);
+    lcd_dma_frame_byte(&frame, 'A', 'D');
+    frame.count = 5; // Drop the idle words that wait out the execution time
+    lcd_dma_frame_byte(&frame, 'B', 'D');
+    lcd_dma_start(&frame);
+    board_sim_run_dma();
+    ASSERT_TRUE(sim_lcd_timing_violations > 0, "DMA: writing while busy is reported (%s)",
+                sim_lcd_last_violation);
+}
+
+// --- Test Cases for keypad.c ---
+
+void test_keypad_row_select_single_store() {
+    board_setup();
+    unsigned long stores_before = sim_gpio_stores;
+    SetRowToZero(2);
+    ASSERT_TRUE(sim_gpio_stores - stores_before == 1, "Keypad: 1 GPIO store per row select (got %lu)",
+                sim_gpio_stores - stores_before);
+}
+
+void test_keypad_scan_reads_pressed_key() {
+    board_setup();
+    board_sim_press_key(2, 1);
+    unsigned char key = poll_until_key(20);
+    ASSERT_TRUE(key == KEY_0, "Keypad: row 2 col 1 reads as KEY_0 (got 0x%X)", key);
+    board_sim_press_key(3, 3);
+    ASSERT_TRUE(poll_until_key(20) == KEY_NONE, "Keypad: '.' waits while held (it has a long press)");
+    board_sim_release_keys();
+    key = poll_until_key(20);
+    ASSERT_TRUE(key == KEY_DECIMAL, "Keypad: row 3 col 3 reads as KEY_DECIMAL on release (got 0x%X)", key);
+    ASSERT_TRUE(poll_until_key(20) == KEY_NONE, "Keypad: no key after release");
+}
+
+void test_keymap_layers() {
+    unsigned char key;
+    board_setup();
+
+    // Long press: '.' held past KEY_LONG_MS deletes, and sends nothing on release
+    board_sim_press_key(3, 3);
+    key = poll_until_key(KEY_LONG_MS / 4 + 20);
+    ASSERT_TRUE(key == KEY_BACKSPACE, "Keymap: long press of '.' is KEY_BACKSPACE (got 0x%X)", key);
+    board_sim_release_keys();
+    ASSERT_TRUE(poll_until_key(20) == KEY_NONE, "Keymap: nothing more on release after a long press");
+
+    // Chord: '+' is not sent when '-' joins it, nor when '-' is let go first
+    board_sim_press_key(2, 2);
+    ASSERT_TRUE(poll_until_key(5) == KEY_NONE, "Keymap: '+' waits for the rest of a chord");
+    board_sim_press_also(2, 3);
+    ASSERT_TRUE(poll_until_key(20) == KEY_NONE, "Keymap: '+' and '-' is KEY_SHIFT, handled in the driver");
+    board_sim_press_key(2, 2);
+    ASSERT_TRUE(poll_until_key(40) == KEY_NONE, "Keymap: a key left over from a chord is ignored");
+    board_sim_release_keys();
+    poll_until_key(20);
+
+    // Shift layer for one key: '=' types the last result, then '=' is '=' again
+    board_sim_press_key(3, 2);
+    key = poll_until_key(40);
+    ASSERT_TRUE(key == KEY_ANS, "Keymap: shift '=' is KEY_ANS (got 0x%X)", key);
+    board_sim_release_keys();
+    poll_until_key(20);
+    board_sim_press_key(3, 2);
+    key = poll_until_key(40);
+    ASSERT_TRUE(key == KEY_EQUALS, "Keymap: shift lasts one key (got 0x%X)", key);
+    board_sim_release_keys();
+    poll_until_key(20);
+
+    // A key without a chord or long press acts on acceptance
+    board_sim_press_key(1, 2);
+    ASSERT_TRUE(poll_until_key(20) == KEY_7, "Keymap: '7' is sent while still held");
+    board_sim_release_keys();
+    poll_until_key(20);
+}
+
+// --- Per-keystroke register write count ---
+
+void test_keystroke_store_count() {
+    board_setup();
+    unsigned long stores_before = sim_gpio_stores;
+    unsigned long bytes_before = sim_lcd_bytes;
+    unsigned long selects_before = sim_keypad_selects;
+
+    // Press '7': debounce until accepted, then show it as the number being typed
+    board_sim_press_key(1, 2);
+    unsigned char key = poll_until_key(20);
+    current_num_str[current_num_index++] = '0' + key;
+    update_lcd_display_content();
+    board_sim_release_keys();
+
+    unsigned long stores = sim_gpio_stores - stores_before;
+    unsigned long legacy = (sim_lcd_bytes - bytes_before) * LEGACY_STORES_PER_LCD_BYTE +
+                           (sim_keypad_selects - selects_before) * LEGACY_STORES_PER_ROW_SELECT;
+    printf("GPIO stores per keystroke: %lu (SET/CLR drivers: %lu)\n", stores, legacy);
+    ASSERT_TRUE(stores * 2 <= legacy, "Keystroke: masked stores at least halve GPIO writes");
+
+    board_sim_run_dma(); // CPU stores counted above; now let a queued frame reach the LCD
+    char line[17];
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("7               ", line, "Keystroke: digit shown on line 2");
+}
+
+// --- Boot ---
+
+void test_boot_buffers_key_pressed_during_lcd_init() {
+    board_sim_reset();
+    board_sim_release_keys();
+    poll_until_key(2); // Let the debouncer see the release left over from earlier tests
+    keypad_first_key_us = 0;
+    sim_lcd_timing_violations = 0;
+    sim_time_ns = 0;
+
+    // Key already held when power comes up
+    board_sim_press_key(1, 2);
+    boot_fast();
+    unsigned long long ready_ns = sim_time_ns;
+    board_sim_release_keys();
+
+    printf("Boot: key accepted at %lu us, LCD ready at %llu us\n",
+           (unsigned long)keypad_first_key_us, ready_ns / 1000ULL);
+    ASSERT_TRUE(KeypadNextKey() == KEY_7, "Boot: key pressed during LCD init is buffered");
+    ASSERT_TRUE(KeypadNextKey() == KEY_NONE, "Boot: key is buffered once");
+    ASSERT_TRUE(keypad_first_key_us > 0 && keypad_first_key_us < 50000, "Boot: key accepted within 50 ms");
+    ASSERT_TRUE(ready_ns < 60000000ULL, "Boot: LCD ready within 60 ms");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Boot: init sequence meets HD44780 timing");
+}
+
+// --- Scheduler tasks ---
+
+// Holds a key long enough to be accepted, then releases it, running the tasks throughout
+static void press_with_tasks(unsigned char row, unsigned char col) {
+    board_sim_press_key(row, col);
+    sched_run_until(uptime_us() + 60000);
+    board_sim_release_keys();
+    sched_run_until(uptime_us() + 30000);
+}
+
+void test_tasks_calculate_on_scheduler() {
+    int i;
+    board_setup();
+    board_sim_release_keys();
+    poll_until_key(2);
+    while (KeypadNextKey() != KEY_NONE) {
+    }
+    tasks_start();
+    sched_run_until(uptime_us() + 10000);
+
+    char line[17];
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("Calculator Ready", line, "Tasks: start-up message shown");
+
+    press_with_tasks(0, 0); // 1
+    press_with_tasks(2, 2); // +
+    press_with_tasks(0, 1); // 2
+    press_with_tasks(3, 2); // =
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("3               ", line, "Tasks: 1+2= shows the result");
+
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_task *t = &sched_tasks[i];
+        if (t->active) {
+            printf("  %-6s runs %5lu  total %6lu us  longest %5lu us\n", t->name,
+                   (unsigned long)t->runs, (unsigned long)t->runtime_us, (unsigned long)t->max_run_us);
+        }
+    }
+    printf("  idle          total %6lu us\n", (unsigned long)sched_idle_us);
+    ASSERT_TRUE(task_keypad->max_run_us < KEY_SETTLE_US, "Tasks: keypad scan never waits inside a run");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Tasks: LCD timing met");
+}
+
+void test_tasks_evaluate_in_slices() {
+    // Continues from the previous test: the result is shown, the next key starts over
+    static const unsigned char keys[][2] = {
+        {0, 0}, {2, 2}, {0, 1}, {3, 0}, {0, 2}, {2, 3}, {0, 3}, {3, 1}, {0, 1}, // 1+2*3-4/2
+        {2, 2}, {1, 0}, {3, 0}, {1, 1}, {3, 2}                                  // +5*6=
+    };
+    uint32_t eval_runs_before = task_eval->runs;
+    unsigned i;
+
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        press_with_tasks(keys[i][0], keys[i][1]);
+    }
+    board_sim_run_dma();
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("35              ", line, "Tasks: 1+2*3-4/2+5*6= shows the result");
+
+    printf("  evaluation: %lu ops, %lu slices, longest slice %lu us, compute %lu us\n",
+           (unsigned long)calc_ctx.eval.ops, (unsigned long)calc_ctx.eval.slices,
+           (unsigned long)calc_ctx.eval.slice_max_us, (unsigned long)calc_ctx.eval.compute_us);
+    ASSERT_TRUE(calc_ctx.eval.slices > 1, "Tasks: evaluation split into slices");
+    ASSERT_TRUE(task_eval->runs - eval_runs_before >= calc_ctx.eval.slices,
+                "Tasks: eval task yields between slices");
+}
+
+void test_tasks_coalesce_key_burst() {
+    // Continues from the previous test. Keys injected faster than the LCD refreshes
+    // (as from a replay or a UART) are all processed before one frame is drawn.
+    static const unsigned char burst[] = { KEY_1, KEY_PLUS, KEY_2, KEY_MULTIPLY, KEY_3 };
+    uint32_t frames = calc_ctx.frames, skipped = calc_ctx.frames_skipped;
+    char line[17];
+    unsigned i;
+
+    for (i = 0; i < sizeof(burst); i++) {
+        KeypadQueueKey(burst[i]);
+    }
+    sched_wake(task_ui);
+    sched_run_until(uptime_us() + RENDER_FRAME_US / 4);
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("1+2*            ", line, "Coalesce: burst shown as a whole on line 1");
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("3               ", line, "Coalesce: number being typed on line 2");
+    ASSERT_TRUE(calc_ctx.frames - frames == 1, "Coalesce: five keys, one frame (got %lu)",
+                (unsigned long)(calc_ctx.frames - frames));
+    ASSERT_TRUE(calc_ctx.frames_skipped - skipped == 4, "Coalesce: four frames skipped (got %lu)",
+                (unsigned long)(calc_ctx.frames_skipped - skipped));
+
+    // A key right after a frame waits for the frame interval
+    frames = calc_ctx.frames;
+    KeypadQueueKey(KEY_4);
+    sched_wake(task_ui);
+    sched_run_until(uptime_us() + 1000);
+    ASSERT_TRUE(calc_ctx.frames == frames && calc_render_pending(), "Coalesce: no frame before the interval");
+    sched_run_until(uptime_us() + RENDER_FRAME_US);
+    board_sim_run_dma();
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("34              ", line, "Coalesce: frame drawn once the interval is over");
+    ASSERT_TRUE(calc_ctx.frames - frames == 1, "Coalesce: one frame for the late key");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Coalesce: no LCD timing violations %s", sim_lcd_last_violation);
+}
+
+void test_tasks_cancel_behind_queued_key() {
+    // Continues from the previous test ("1+2*34" typed). A digit and then '=' pressed
+    // while the result is pending: the '=' cancels although the digit is ahead of it
+    static const unsigned char more[] = { KEY_PLUS, KEY_5, KEY_MULTIPLY, KEY_6, KEY_MINUS, KEY_7 };
+    uint32_t slices;
+    char line[17];
+    unsigned i;
+    int guard;
+
+    for (i = 0; i < sizeof(more); i++) {
+        KeypadQueueKey(more[i]);
+    }
+    KeypadQueueKey(KEY_EQUALS);
+    sched_wake(task_ui);
+    for (guard = 0; guard < 100 && !calc_eval_pending(); guard++) {
+        sched_run_once();
+    }
+    ASSERT_TRUE(calc_eval_pending(), "Cancel: evaluation started");
+
+    slices = calc_ctx.eval.slices;
+    KeypadQueueKey(KEY_1);
+    KeypadQueueKey(KEY_CANCEL);
+    sched_wake(task_ui);
+    for (guard = 0; guard < 100 && calc_eval_pending(); guard++) {
+        sched_run_once();
+    }
+    ASSERT_TRUE(!calc_eval_pending(), "Cancel: evaluation ended");
+    ASSERT_TRUE(calc_ctx.eval.slices - slices <= 1, "Cancel: within one slice (took %lu)",
+                (unsigned long)(calc_ctx.eval.slices - slices));
+    ASSERT_EQUAL_STRING("Err: Cancelled", calc_ctx.view_message, "Cancel: message shown");
+    ASSERT_TRUE(KeypadPeekKey() == KEY_NONE, "Cancel: digit typed while waiting dropped");
+
+    sched_run_until(uptime_us() + 2 * RENDER_FRAME_US);
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("Err: Cancelled  ", line, "Cancel: message on the LCD");
+}
+
+void test_tasks_coalesce_backspace_redraws_history() {
+    // Backspace and another operator in one frame leave as many tokens as before
+    char line[17];
+    board_setup();
+    calc_ui_begin();
+    calc_ui_key(KEY_5);
+    calc_ui_key(KEY_PLUS);
+    calc_render();
+    board_sim_run_dma();
+
+    calc_ui_key(KEY_BACKSPACE);
+    calc_ui_key(KEY_MULTIPLY);
+    calc_render();
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("5*              ", line, "Coalesce: operator replaced by backspace is redrawn");
+
+    calc_ui_key(KEY_2);
+    calc_ui_key(KEY_EQUALS);
+    calc_eval_run();
+    calc_render();
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("10              ", line, "Coalesce: result matches the expression shown");
+}
+
+// --- State retention ---
+
+// Resets the board as if by a watchdog or brown-out (power_lost = 0) or a power cut,
+// boots the firmware and runs it until the LCD shows `line1` and `line2`. Returns
+// the uptime at which it did, or 0 if not within two seconds.
+static uint32_t restart_until_shown(int power_lost, const char *line1, const char *line2) {
+    char shown1[17], shown2[17];
+
+    board_sim_restart(power_lost);
+    boot_fast();
+    tasks_start();
+    while (uptime_us() < 2000000) {
+        sched_run_until(uptime_us() + 1000);
+        board_sim_run_dma();
+        board_sim_lcd_visible(0, shown1);
+        board_sim_lcd_visible(1, shown2);
+        if (strncmp(shown1, line1, strlen(line1)) == 0 && strncmp(shown2, line2, strlen(line2)) == 0) {
+            return uptime_us();
+        }
+    }
+    return 0;
+}
+
+void test_retain_resumes_after_reset() {
+    static const unsigned char keys[][2] = { {0, 0}, {0, 1}, {2, 2}, {0, 2}, {0, 3} }; // 12+34
+    uint32_t shown;
+    unsigned i;
+
+    board_setup();
+    board_sim_release_keys();
+    poll_until_key(2);
+    while (KeypadNextKey() != KEY_NONE) {
+    }
+    tasks_start();
+    sched_run_until(uptime_us() + 10000);
+    for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        press_with_tasks(keys[i][0], keys[i][1]);
+    }
+    ASSERT_TRUE(sim_flash_programs == 0, "Retain: flash left alone while typing");
+
+    // Watchdog reset: the SRAM copy comes back, without the start-up message
+    shown = restart_until_shown(0, "12+ ", "34 ");
+    printf("Retain: expression back on the LCD %lu us after the reset\n", (unsigned long)shown);
+    ASSERT_TRUE(shown > 0 && shown < 100000, "Retain: expression shown within 100 ms of a watchdog reset");
+    ASSERT_TRUE(retain_stats.source == RETAIN_FROM_RAM, "Retain: restored from SRAM");
+
+    // Typing goes on; once idle, the state goes to flash and survives a power cut
+    press_with_tasks(2, 2); // +
+    sched_run_until(uptime_us() + RETAIN_IDLE_MS * 1000UL + 100000);
+    ASSERT_TRUE(sim_flash_programs == 1 && retain_stats.flash_writes == 1, "Retain: one flash write when idle (got %lu)",
+                sim_flash_programs);
+    shown = restart_until_shown(1, "12+34+ ", "  ");
+    ASSERT_TRUE(shown > 0 && shown < 100000, "Retain: expression shown within 100 ms of a power cut");
+    ASSERT_TRUE(retain_stats.source == RETAIN_FROM_FLASH, "Retain: restored from flash");
+
+    // A result, and ANS with it
+    press_with_tasks(1, 0); // 5
+    press_with_tasks(3, 2); // =
+    sched_run_until(uptime_us() + RETAIN_IDLE_MS * 1000UL + 100000);
+    shown = restart_until_shown(1, "51 ", "  ");
+    ASSERT_TRUE(shown > 0 && calc_ctx.ans == 51.0f, "Retain: result and ANS shown after a power cut");
+    press_with_tasks(0, 0); // 1 starts over
+    board_sim_run_dma();
+    char line[17];
+    board_sim_lcd_visible(1, line);
+    ASSERT_EQUAL_STRING("1               ", line, "Retain: a key after the restored result starts over");
+
+    // Damaged copies are not used: the start-up message instead
+    sched_run_until(uptime_us() + RETAIN_IDLE_MS * 1000UL + 100000);
+    for (i = 0; i < SIM_FLASH_TOP_SIZE; i += RETAIN_SLOT_SIZE) {
+        if (sim_flash_top[i] != 0xFF) {
+            sim_flash_top[i + 100] ^= 0x01;
+        }
+    }
+    shown = restart_until_shown(1, "Calculator Ready", "Enter Expression");
+    ASSERT_TRUE(shown > 0 && retain_stats.source == RETAIN_FROM_NONE, "Retain: damaged copies give the start-up message");
+    ASSERT_TRUE(sim_iap_errors == 0, "Retain: IAP commands valid (%lu errors)", sim_iap_errors);
+}
+
+void test_retain_flash_log_wraps() {
+    // Three more copies than the two sectors hold: the log fills both, then erases
+    // the first and goes on there
+    uint32_t writes = 2 * RETAIN_SLOTS + 3;
+    uint32_t i;
+
+    board_setup();
+    while (KeypadNextKey() != KEY_NONE) {
+    }
+    tasks_start();
+    sched_run_until(uptime_us() + 10000);
+    for (i = 0; i < writes; i++) {
+        KeypadQueueKey(i % 2 == 0 ? KEY_7 : KEY_BACKSPACE); // Differs from the copy before
+        sched_wake(task_ui);
+        sched_run_until(uptime_us() + RETAIN_IDLE_MS * 1000UL + 10000);
+    }
+    ASSERT_TRUE(sim_flash_programs == writes, "Retain: one flash write per idle change (got %lu)", sim_flash_programs);
+    ASSERT_TRUE(sim_flash_erases == 1, "Retain: full sector erased when the log comes back to it (got %lu)",
+                sim_flash_erases);
+
+    uint32_t shown = restart_until_shown(1, "", "7 ");
+    ASSERT_TRUE(shown > 0 && retain_stats.source == RETAIN_FROM_FLASH, "Retain: newest copy restored after the wrap");
+    ASSERT_TRUE(sim_iap_errors == 0, "Retain: IAP commands valid (%lu errors)", sim_iap_errors);
+}
+
+#ifndef CALC_NO_DIAG
+// --- Diagnostics screen ---
+
+void test_diag_chord_shows_counters() {
+    static const char *const page_starts[DIAG_PAGES][2] = {
+        { "Keys 5", "Bounce rej 1" }, { "Evals 1", "Worst " }, { "LCD bytes ", "Key>LCD " }, { "Stack ", "Up " }
+    };
+    uint32_t lcd_bytes;
+    char line[17];
+    int page;
+
+    board_setup();
+    board_sim_release_keys();
+    poll_until_key(2);
+    tasks_start();
+    sched_run_until(uptime_us() + 10000);
+    diag_init(); // The simulated clock restarted with board_setup()
+    calc_ctx.keys = 0;
+
+    press_with_tasks(0, 0); // 1
+    // + on a switch that chatters for 20 ms, let go of after 10 ms: it never settles
+    static const sim_bounce chatter = { 20000, 20000, 0, 0, 300, 0, 0 };
+    board_sim_bounce(&chatter, 1);
+    board_sim_press_key(2, 2);
+    sched_run_until(uptime_us() + 10000);
+    board_sim_release_keys();
+    sched_run_until(uptime_us() + 40000);
+    board_sim_bounce(NULL, 0);
+    press_with_tasks(2, 2); // +
+    press_with_tasks(0, 1); // 2
+    press_with_tasks(3, 2); // =
+    lcd_bytes = diag.lcd_bytes;
+
+    // '=' and '.' together
+    board_sim_press_key(3, 2);
+    board_sim_press_also(3, 3);
+    sched_run_until(uptime_us() + 60000);
+    board_sim_release_keys();
+    sched_run_until(uptime_us() + 30000);
+
+    for (page = 0; page < DIAG_PAGES; page++) {
+        board_sim_run_dma();
+        board_sim_lcd_visible(0, line);
+        ASSERT_TRUE(strncmp(line, page_starts[page][0], strlen(page_starts[page][0])) == 0,
+                    "Diag: page %d line 1 '%s'", page + 1, line);
+        board_sim_lcd_visible(1, line);
+        ASSERT_TRUE(strncmp(line, page_starts[page][1], strlen(page_starts[page][1])) == 0,
+                    "Diag: page %d line 2 '%s'", page + 1, line);
+        printf("  page %d: %s\n", page + 1, line);
+        press_with_tasks(0, 0); // Next page
+    }
+    ASSERT_TRUE(diag.lcd_bytes > lcd_bytes, "Diag: LCD bytes counted");
+    ASSERT_TRUE(diag.latency_keys >= 4 && diag.latency_us / diag.latency_keys > 0,
+                "Diag: key-to-display latency measured (%lu us average)",
+                (unsigned long)(diag.latency_us / (diag.latency_keys ? diag.latency_keys : 1)));
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("3               ", line, "Diag: result view back after the last page");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Diag: no LCD timing violations %s", sim_lcd_last_violation);
+}
+#endif
+
+// --- Clock scaling ---
+
+void test_clock_scaling_keeps_timing() {
+    board_setup();
+    board_sim_release_keys();
+    poll_until_key(2);
+    tasks_start();
+    sched_run_until(uptime_us() + 10000);
+
+    press_with_tasks(0, 2); // 3
+    press_with_tasks(3, 0); // *
+    press_with_tasks(0, 3); // 4
+    press_with_tasks(3, 2); // =
+    board_sim_run_dma();
+    char line[17];
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("12              ", line, "Clock: 3*4= correct with clock switches");
+
+    uint32_t idle_us = clock_residency_us(CLOCK_IDLE);
+    uint32_t full_us = clock_residency_us(CLOCK_FULL);
+    printf("  %lu switches, %lu us at %lu MHz, %lu us at %lu MHz\n", (unsigned long)clock_switches,
+           (unsigned long)idle_us, CLOCK_IDLE_HZ / 1000000UL, (unsigned long)full_us, CLOCK_FULL_HZ / 1000000UL);
+    ASSERT_TRUE(clock_switches >= 2 && full_us > 0, "Clock: boosted for evaluation and LCD updates");
+    ASSERT_TRUE(idle_us > 9 * full_us, "Clock: idle clock most of the time");
+    ASSERT_TRUE(clock_level() == CLOCK_IDLE, "Clock: back to idle when nothing is running");
+    ASSERT_TRUE(sim_timer_rate_errors == 0, "Clock: Timer 1 stayed at 1 MHz across switches");
+    ASSERT_TRUE(sim_flash_wait_errors == 0, "Clock: flash wait states suited every clock");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Clock: LCD timing met at both clocks");
+}
+
+void test_clock_checker_catches_stale_timer() {
+    board_setup();
+    LPC_SC->CCLKCFG = 0x0B; // Change CCLK behind delay.c's back
+    delay_us(10);
+    ASSERT_TRUE(sim_timer_rate_errors > 0, "Clock: checker flags a timer not reloaded for the new CCLK");
+}
+
+// --- Stack monitor ---
+
+void test_stack_used_from_paint() {
+    uint32_t stack[64];
+    stack_paint_range(stack, stack + 64);
+    ASSERT_TRUE(stack_used_bytes(stack, stack + 64) == 0, "Stack: nothing used right after painting");
+    stack[40] = 0;
+    ASSERT_TRUE(stack_used_bytes(stack, stack + 64) == 24 * 4, "Stack: deepest overwritten word sets the mark");
+    stack[50] = 0;
+    ASSERT_TRUE(stack_used_bytes(stack, stack + 64) == 24 * 4, "Stack: shallower writes do not lower it");
+    stack[0] = 0;
+    ASSERT_TRUE(stack_used_bytes(stack, stack + 64) == 64 * 4, "Stack: whole stack used");
+}
+
+void test_stack_stress_returns_to_splash() {
+    char line[17];
+    board_setup();
+    stack_stress();
+    ASSERT_TRUE(expr_len == 0 && !calculator_error, "Stack: stress run leaves a clean state");
+    calc_render();
+    board_sim_run_dma();
+    board_sim_lcd_visible(0, line);
+    ASSERT_EQUAL_STRING("Calculator Ready", line, "Stack: start-up message after the stress run");
+    ASSERT_TRUE(sim_lcd_timing_violations == 0, "Stack: no LCD timing violations %s", sim_lcd_last_violation);
+}
+
+static char profile_lines[4][96];
+static int profile_line_count;
+
+static void collect_profile_line(const char *line) {
+    if (profile_line_count < 4) {
+        strcpy(profile_lines[profile_line_count], line);
+    }
+    profile_line_count++;
+}
+
+void test_delay_profile_ranks_call_sites() {
+    static const char site_a[] = "src/lcd.c", site_b[] = "keypad.c";
+    uint32_t total;
+    board_setup();
+    delay_profile_reset();
+    delay_us_profiled(40, site_a, 213);
+    delay_us_profiled(40, site_a, 213);
+    delay_profiled(1, site_b, 38);
+    delay_us_profiled(5, site_a, 32);
+    profile_line_count = 0;
+    total = delay_profile_report(collect_profile_line, 2);
+    ASSERT_TRUE(total == 1085, "Profile: total wait is the sum of the calls (%lu)", (unsigned long)total);
+    ASSERT_TRUE(profile_line_count == 4, "Profile: header plus one line per call site");
+    ASSERT_TRUE(strstr(profile_lines[1], "keypad.c:38") && strstr(profile_lines[1], " 1000 "),
+                "Profile: longest site ranks first '%s'", profile_lines[1]);
+    ASSERT_TRUE(strstr(profile_lines[2], "lcd.c:213") && strstr(profile_lines[2], "   2 "),
+                "Profile: repeated calls add up at one site '%s'", profile_lines[2]);
+    ASSERT_TRUE(strstr(profile_lines[3], "lcd.c:32") && strstr(profile_lines[3], "0.4%"),
+                "Profile: share of the total '%s'", profile_lines[3]);
+}
+
+void test_event_trace_file_records() {
+    const char *path = "test_events.bin";
+    unsigned char buf[32];
+    uint32_t at;
+    size_t n;
+    FILE *f;
+
+    board_setup();
+    sim_time_ns = 0x12345678ULL * 1000ULL; // Uptime with four distinct bytes
+    at = uptime_us();
+    ASSERT_TRUE(event_trace_open(path) == 0, "Trace: file created");
+    event_trace_emit(EVT_KEY, KEY_7);
+    event_trace_emit(EVT_ERROR, event_trace_error_arg("Err: Div Zero"));
+    event_trace_close();
+
+    f = fopen(path, "rb");
+    n = f ? fread(buf, 1, sizeof(buf), f) : 0;
+    if (f) fclose(f);
+    remove(path);
+    ASSERT_TRUE(n == 24, "Trace: three 8-byte records (got %lu bytes)", (unsigned long)n);
+    ASSERT_TRUE(buf[4] == EVT_START && buf[5] == EVENT_TRACE_VERSION, "Trace: starts with EVT_START");
+    ASSERT_TRUE(at == 0x12345678 && buf[8] == 0x78 && buf[9] == 0x56 && buf[10] == 0x34 && buf[11] == 0x12,
+                "Trace: little-endian uptime");
+    ASSERT_TRUE(buf[12] == EVT_KEY && buf[13] == KEY_7 && buf[14] == 0, "Trace: key record");
+    ASSERT_TRUE(buf[20] == EVT_ERROR && memcmp(buf + 21, "Div", 3) == 0, "Trace: error record carries 'Div'");
+}
+
+// --- Main Test Runner ---
+int main() {
+    printf("Starting driver tests on the board simulator...\n\n");
+
+    printf("--- Testing lcd.c ---\n");
+    RUN_TEST(test_lcd_char_single_store_per_edge);
+    RUN_TEST(test_lcd_string_and_second_line);
+    RUN_TEST(test_lcd_history_scrolls_with_display_shift);
+    RUN_TEST(test_lcd_cpu_path_meets_timing);
+    printf("\n");
+
+    printf("--- Testing lcd_dma.c ---\n");
+    RUN_TEST(test_lcd_dma_frame_streams_without_cpu);
+    RUN_TEST(test_lcd_dma_timing_checker_catches_busy_write);
+    printf("\n");
+
+    printf("--- Testing keypad.c ---\n");
+    RUN_TEST(test_keypad_row_select_single_store);
+    RUN_TEST(test_keypad_scan_reads_pressed_key);
+    RUN_TEST(test_keymap_layers);
+    printf("\n");
+
+    printf("--- Testing GPIO writes per keystroke ---\n");
+    RUN_TEST(test_keystroke_store_count);
+    printf("\n");
+
+    printf("--- Testing boot.c ---\n");
+    RUN_TEST(test_boot_buffers_key_pressed_during_lcd_init);
+    printf("\n");
+
+    printf("--- Testing tasks.c ---\n");
+    RUN_TEST(test_tasks_calculate_on_scheduler);
+    RUN_TEST(test_tasks_evaluate_in_slices);
+    RUN_TEST(test_tasks_coalesce_key_burst);
+    RUN_TEST(test_tasks_cancel_behind_queued_key);
+    RUN_TEST(test_tasks_coalesce_backspace_redraws_history);
+    printf("\n");
+
+    printf("--- Testing retain.c ---\n");
+    RUN_TEST(test_retain_resumes_after_reset);
+    RUN_TEST(test_retain_flash_log_wraps);
+    printf("\n");
+
+    printf("--- Testing clock.c ---\n");
+    RUN_TEST(test_clock_scaling_keeps_timing);
+    RUN_TEST(test_clock_checker_catches_stale_timer);
+    printf("\n");
+
+#ifndef CALC_NO_DIAG
+    printf("--- Testing diag.c ---\n");
+    RUN_TEST(test_diag_chord_shows_counters);
+    printf("\n");
+
+#endif
+    printf("--- Testing stack_monitor.c ---\n");
+    RUN_TEST(test_stack_used_from_paint);
+    RUN_TEST(test_stack_stress_returns_to_splash);
+    printf("\n");
+
+    printf("--- Testing delay_profile.c ---\n");
+    RUN_TEST(test_delay_profile_ranks_call_sites);
+    printf("\n");
+
+    printf("--- Testing event_trace.c ---\n");
+    RUN_TEST(test_event_trace_file_records);
+
+    printf("\n--- Test Summary ---\n");
+    printf(ANSI_COLOR_GREEN "Passed: %d\n" ANSI_COLOR_RESET, tests_passed);
+    printf(ANSI_COLOR_RED "Failed: %d\n" ANSI_COLOR_RESET, tests_failed);
+    printf("\n");
+
+    return (tests_failed == 0) ? 0 : 1;
+}
@@ -2,18 +2,8 @@
 #include <string.h> // For strcmp, strcpy, strlen
 #include <math.h>   // For fabsf
 #include "logic.h"  // The header for the code we are testing
-
-// --- Global variables from logic.c needed by tests ---
-// These are 'extern' in logic.h, so we need to define them here for the test executable.
-bool calculator_error;
-char error_message[ERROR_MSG_LEN];
-char expr_type[MAX_TOKENS];
-float expr_data[MAX_TOKENS];
-int expr_len;
-char expression_str[MAX_DISPLAY_STR];
-int expression_index;
-char current_num_str[LCD_LINE_LEN + 1];
-int current_num_index;
+#include "diag.h"   // For DIAG_PAGES
+#include "calc_goldens.h" // Results computed at compile time by calc_eval.hpp
 
 // --- Assertion Macros ---
 #define ANSI_COLOR_RED     "\x1b[31m"
@@ -326,6 +316,316 @@ void test_eval_empty_expression() {
 }
 
 
+// --- Test Cases for the time-sliced evaluator ---
+
+// Builds 1+2*3-4/2+5*6-... with `terms` operands
+static void build_mixed_expression(int terms) {
+    const char ops[] = {'+', '*', '-', '/'};
+    clear_all_state();
+    for (int i = 0; i < terms; ++i) {
+        if (i > 0) {
+            push_operator_to_expr(ops[i % 4]);
+        }
+        push_operand_to_expr((float)(i % 9 + 1));
+    }
+}
+
+// Feeds key codes to calc_ui_key(), as the UI task does
+static void type_keys(const char* keys) {
+    for (; *keys; ++keys) {
+        char c = *keys;
+        unsigned char key = (c >= '0' && c <= '9') ? (unsigned char)(c - '0') :
+                            c == '+' ? KEY_PLUS : c == '-' ? KEY_MINUS :
+                            c == '*' ? KEY_MULTIPLY : c == '/' ? KEY_DIVIDE :
+                            c == '.' ? KEY_DECIMAL : c == 'C' ? KEY_CLEAR :
+                            c == '<' ? KEY_BACKSPACE : c == 'A' ? KEY_ANS : KEY_EQUALS;
+        calc_ui_key(key);
+    }
+}
+
+void test_eval_sliced_matches_full() {
+    build_mixed_expression(25);
+    float full = evaluate_full_expression();
+    uint32_t full_ops = calc_ctx.eval.ops;
+
+    build_mixed_expression(25);
+    evaluate_begin();
+    int steps = 1;
+    while (!evaluate_step(1)) {
+        steps++;
+    }
+    ASSERT_EQUAL_FLOAT(full, calc_ctx.eval.result, 1e-6f, "Sliced: one op per step gives the same result");
+    ASSERT_TRUE(!calculator_error, "Sliced: no error");
+    ASSERT_TRUE(calc_ctx.eval.ops == full_ops, "Sliced: same number of operations (%lu)", (unsigned long)full_ops);
+    ASSERT_TRUE(full_ops < 2 * 49, "Sliced: fewer than 2 ops per token");
+    ASSERT_TRUE(steps == (int)full_ops + 1, "Sliced: each step did at most one op (%d steps)", steps);
+}
+
+void test_eval_slices_bounded() {
+    calc_ui_begin();
+    type_keys("1+2*3-4/2+5*6-7+8*9=");
+    ASSERT_TRUE(calc_eval_pending(), "Sliced: '=' leaves the evaluation pending");
+    int slices = 0;
+    uint32_t ops_before = 0;
+    bool within_budget = true;
+    while (calc_eval_slice()) {
+        slices++;
+        within_budget = within_budget && (calc_ctx.eval.ops - ops_before <= EVAL_SLICE_OPS);
+        ops_before = calc_ctx.eval.ops;
+    }
+    slices++;
+    printf("  %lu ops in %d slices of at most %d\n", (unsigned long)calc_ctx.eval.ops, slices, EVAL_SLICE_OPS);
+    ASSERT_TRUE(within_budget, "Sliced: no slice exceeds EVAL_SLICE_OPS");
+    ASSERT_TRUE(slices > 1, "Sliced: long expression takes several slices");
+    ASSERT_TRUE(calc_ctx.eval.slices == (uint32_t)slices, "Sliced: slices counted");
+    ASSERT_EQUAL_STRING("100", calc_ctx.view_message, "Sliced: result shown after the last slice");
+}
+
+void test_eval_cancel_between_slices() {
+    calc_ui_begin();
+    type_keys("1+2*3-4/2+5*6-7+8*9=");
+    calc_eval_slice();
+    ASSERT_TRUE(calc_eval_pending(), "Cancel: still pending after one slice");
+    calc_eval_cancel();
+    ASSERT_TRUE(!calc_eval_pending(), "Cancel: evaluation aborted");
+    ASSERT_EQUAL_STRING("Err: Cancelled", calc_ctx.view_message, "Cancel: message shown");
+    ASSERT_TRUE(!calc_eval_slice(), "Cancel: no further slices run");
+    calc_ui_key(KEY_5);
+    ASSERT_TRUE(!calculator_error && current_num_index == 1, "Cancel: next key starts a new calculation");
+}
+
+// Every golden of calc_goldens.cpp typed on the calculator: the C evaluator must
+// give the compile-time result bit for bit, or the same error
+void test_eval_matches_constexpr_goldens() {
+    int mismatches = 0;
+    for (int g = 0; g < calc_golden_count; ++g) {
+        const calc_golden* golden = &calc_goldens[g];
+        char key[2] = {0};
+        calc_ui_begin();
+        for (const char* k = golden->keys; *k && !calc_ctx.calculation_has_ended && !calc_eval_pending(); ++k) {
+            key[0] = *k;
+            type_keys(key);
+        }
+        if (!calc_ctx.calculation_has_ended && !calc_eval_pending()) {
+            calc_ui_key(KEY_EQUALS); // '=' implied at the end
+        }
+        if (calc_eval_pending()) {
+            calc_eval_run();
+        }
+        float value = calculator_error ? 0.0f : calc_ctx.eval.result;
+        bool same = golden->error ? (calculator_error && strcmp(golden->error, error_message) == 0)
+                                  : (!calculator_error && memcmp(&value, &golden->value, sizeof(value)) == 0);
+        if (!same) {
+            printf("  %s: C gives %s %.9g, constexpr %s %.9g\n", golden->keys,
+                   calculator_error ? error_message : "", value, golden->error ? golden->error : "", golden->value);
+            mismatches++;
+        }
+    }
+    ASSERT_TRUE(calc_golden_count > 30, "Goldens: %d expressions computed at compile time", calc_golden_count);
+    ASSERT_TRUE(mismatches == 0, "Goldens: logic.c matches calc_eval.hpp (%d mismatches)", mismatches);
+}
+
+// Every key sequence golden (clear, backspace, ANS, several calculations) typed on
+// the calculator from power-up: the last result or error shown must be the same
+void test_keys_match_constexpr_goldens() {
+    int mismatches = 0;
+    for (int g = 0; g < calc_key_golden_count; ++g) {
+        const calc_golden* golden = &calc_key_goldens[g];
+        char key[2] = {0};
+        char shown_error[ERROR_MSG_LEN] = "";
+        float shown = -1.0f;
+        calc_ui_begin();
+        calc_ctx.ans = 0.0f;
+        for (const char* k = golden->keys; *k; ++k) {
+            key[0] = *k;
+            type_keys(key);
+            if (calc_eval_pending()) {
+                calc_eval_run();
+            }
+            if (calc_ctx.calculation_has_ended) { // This key brought up a result or an error
+                strcpy(shown_error, calculator_error ? error_message : "");
+                shown = calculator_error ? 0.0f : calc_ctx.eval.result;
+            }
+        }
+        bool same = golden->error ? strcmp(golden->error, shown_error) == 0
+                                  : (shown_error[0] == '\0' && memcmp(&shown, &golden->value, sizeof(shown)) == 0);
+        if (!same) {
+            printf("  %s: C gives %s %.9g, constexpr %s %.9g\n", golden->keys,
+                   shown_error, shown, golden->error ? golden->error : "", golden->value);
+            mismatches++;
+        }
+    }
+    ASSERT_TRUE(calc_key_golden_count > 20, "Goldens: %d key sequences computed at compile time", calc_key_golden_count);
+    ASSERT_TRUE(mismatches == 0, "Goldens: clear, backspace and ANS match calc_eval.hpp (%d mismatches)", mismatches);
+}
+
+void test_keymap_edit_keys() {
+    calc_ui_begin();
+    type_keys("12+3.");
+    calc_ui_key(KEY_BACKSPACE);
+    ASSERT_TRUE(strcmp(current_num_str, "3") == 0 && !calc_ctx.decimal_point_entered,
+                "Edit: backspace deletes the decimal point");
+    calc_ui_key(KEY_BACKSPACE);
+    calc_ui_key(KEY_BACKSPACE);
+    ASSERT_TRUE(expr_len == 0 && strcmp(current_num_str, "12") == 0 && !calc_ctx.last_key_was_operator,
+                "Edit: then the number, then the trailing operator, which reopens 12");
+    type_keys("*4=");
+    calc_eval_run();
+    ASSERT_TRUE(strcmp(calc_ctx.view_message, "48") == 0, "Edit: 12*4 after the edits (got %s)", calc_ctx.view_message);
+
+    calc_ui_key(KEY_ANS);
+    ASSERT_TRUE(calc_ctx.view == VIEW_INPUT && strcmp(current_num_str, "48") == 0, "Edit: ANS starts over with the result");
+    type_keys("/5=");
+    calc_eval_run();
+    calc_ui_key(KEY_ANS);
+    ASSERT_TRUE(strcmp(current_num_str, "9.6") == 0 && calc_ctx.decimal_point_entered, "Edit: ANS of a fraction");
+    type_keys("+1");
+    calc_ui_key(KEY_CLEAR);
+    ASSERT_TRUE(expr_len == 0 && current_num_index == 0 && !calculator_error, "Edit: clear empties the input");
+    type_keys("2=");
+    calc_eval_run();
+    ASSERT_TRUE(strcmp(calc_ctx.view_message, "2") == 0, "Edit: input after clear is a new expression");
+}
+
+void test_keymap_backspace_operator_then_digit() {
+    calc_ui_begin();
+    type_keys("12+");
+    calc_ui_key(KEY_BACKSPACE);
+    type_keys("3=");
+    calc_eval_run();
+    ASSERT_TRUE(!calculator_error && strcmp(calc_ctx.view_message, "123") == 0,
+                "Edit: a digit after backspacing '+' extends 12 (got %s)", calc_ctx.view_message);
+
+    calc_ui_begin();
+    type_keys("12+");
+    calc_ui_key(KEY_BACKSPACE);
+    type_keys("3+4=");
+    calc_eval_run();
+    ASSERT_TRUE(strcmp(calc_ctx.view_message, "127") == 0, "Edit: 123+4 after the edit (got %s)", calc_ctx.view_message);
+
+    calc_ui_begin();
+    type_keys("1.5*");
+    calc_ui_key(KEY_BACKSPACE);
+    ASSERT_TRUE(calc_ctx.decimal_point_entered, "Edit: reopened 1.5 keeps its decimal point");
+    calc_ui_key(KEY_DECIMAL);
+    ASSERT_TRUE(calculator_error && strcmp(error_message, "Err: Syntax") == 0, "Edit: so a second one is refused");
+
+    calc_ui_begin();
+    type_keys("7*+");
+    calc_ui_key(KEY_BACKSPACE);
+    ASSERT_TRUE(expr_len == 2 && current_num_index == 0 && calc_ctx.last_key_was_operator,
+                "Edit: the second of two operators goes alone");
+    type_keys("2=");
+    calc_eval_run();
+    ASSERT_TRUE(strcmp(calc_ctx.view_message, "14") == 0, "Edit: 7*2 after the edit (got %s)", calc_ctx.view_message);
+}
+
+#ifndef CALC_NO_DIAG
+void test_diag_screen_pages_and_returns() {
+    int page;
+    calc_ui_begin();
+    type_keys("12+3");
+    calc_ui_key(KEY_DIAG);
+    ASSERT_TRUE(calc_ctx.view == VIEW_DIAG && calc_ctx.diag_page == 0, "Diag: chord opens the first page");
+    for (page = 1; page < DIAG_PAGES; page++) {
+        calc_ui_key(KEY_7);
+        ASSERT_TRUE(calc_ctx.view == VIEW_DIAG && calc_ctx.diag_page == page, "Diag: a key shows page %d", page);
+    }
+    calc_ui_key(KEY_7);
+    ASSERT_TRUE(calc_ctx.view == VIEW_INPUT, "Diag: key after the last page returns to the input view");
+    ASSERT_TRUE(expr_len == 2 && current_num_index == 1 && current_num_str[0] == '3',
+                "Diag: keys on the screen do not reach the calculator");
+    calc_ui_key(KEY_DIAG);
+    calc_ui_key(KEY_DIAG);
+    ASSERT_TRUE(calc_ctx.view == VIEW_INPUT, "Diag: the chord again closes it at once");
+}
+#endif
+
+// --- Test Cases for display rendering ---
+
+void test_format_integer_and_float() {
+    char buf[LCD_LINE_LEN + 1];
+    int len = format_number(42.0f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("42", buf, "Format: 42");
+    ASSERT_TRUE(len == 2, "Format: 42 length");
+    format_number(-2.5f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("-2.5", buf, "Format: -2.5 trims trailing zeros");
+}
+
+void test_format_large_uses_scientific() {
+    char buf[LCD_LINE_LEN + 1];
+    int len = format_number(1e20f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("1.000e+20", buf, "Format: 1e20 falls back to scientific notation");
+    ASSERT_TRUE(len == 9, "Format: 1e20 length");
+}
+
+void test_format_matches_printf_rounding() {
+    char buf[LCD_LINE_LEN + 1];
+    format_number(0.0078125f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("0.007812", buf, "Format: exact tie rounds to even like %%f");
+    format_number(-8388607.5f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("-8388607.5", buf, "Format: largest non-integer floats");
+    format_number(123456789012345.0f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("123456788103168", buf, "Format: exact digits of a large float");
+    format_number(9.9996e20f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("1.000e+21", buf, "Format: rounding carries into the exponent");
+    int len = format_number(3.4028235e38f, buf, sizeof(buf));
+    ASSERT_EQUAL_STRING("3.403e+38", buf, "Format: FLT_MAX");
+    ASSERT_TRUE(len == 9, "Format: FLT_MAX length");
+}
+
+void test_render_tail_short() {
+    // 12+3.5*
+    char types[] = {'N', 'O', 'N', 'O'};
+    float data[] = {12.0f, (float)'+', 3.5f, (float)'*'};
+    char line[LCD_LINE_LEN + 1];
+    setup_expression(types, data, 4);
+    int len = render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING("12+3.5*", line, "Render: 12+3.5*");
+    ASSERT_TRUE(len == 7, "Render: 12+3.5* length");
+}
+
+void test_render_tail_long() {
+    // 1000+2000+3000+4000+5000+ is longer than the LCD line; only the tail is shown
+    TEST_SETUP();
+    for (int i = 1; i <= 5; ++i) {
+        push_operand_to_expr(i * 1000.0f);
+        push_operator_to_expr('+');
+    }
+    char line[LCD_LINE_LEN + 1];
+    int len = render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING("+3000+4000+5000+", line, "Render: tail of long expression");
+    ASSERT_TRUE(len == LCD_LINE_LEN, "Render: long expression length");
+}
+
+void test_render_tail_typed_fractions() {
+    // Numbers show as typed, not with the float's binary error (9999.990234)
+    char line[LCD_LINE_LEN + 1];
+    calc_ui_begin();
+    type_keys("3.14159*9999.99+");
+    render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING("3.14159*9999.99+", line, "Render: typed fractions shown as typed");
+    calc_ui_begin();
+    type_keys("12345.67-123456.7/");
+    render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING("345.67-123456.7/", line, "Render: tail of typed fractions");
+    calc_ui_key(KEY_BACKSPACE);
+    ASSERT_EQUAL_STRING("123456.7", current_num_str, "Render: backspace reopens the number as shown");
+    calc_ui_begin();
+    type_keys("0.00000000000001+");
+    render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING(".00000000000001+", line, "Render: 1e-14 shown as typed");
+}
+
+void test_render_tail_empty() {
+    TEST_SETUP();
+    char line[LCD_LINE_LEN + 1];
+    int len = render_expression_tail(line, LCD_LINE_LEN);
+    ASSERT_EQUAL_STRING("", line, "Render: empty expression");
+    ASSERT_TRUE(len == 0, "Render: empty expression length");
+}
+
+
 // --- Main Test Runner ---
 int main() {
     printf("Starting unit tests for logic.c...\n\n");
@@ -358,6 +658,32 @@ int main() {
     RUN_TEST(test_eval_single_number);
     RUN_TEST(test_eval_error_expr_long_push); // Tests push functions setting error
     RUN_TEST(test_eval_empty_expression);
+    printf("\n");
+
+    printf("--- Testing the time-sliced evaluator ---\n");
+    RUN_TEST(test_eval_sliced_matches_full);
+    RUN_TEST(test_eval_slices_bounded);
+    RUN_TEST(test_eval_cancel_between_slices);
+    RUN_TEST(test_eval_matches_constexpr_goldens);
+    RUN_TEST(test_keys_match_constexpr_goldens);
+    RUN_TEST(test_keymap_edit_keys);
+    RUN_TEST(test_keymap_backspace_operator_then_digit);
+    printf("\n");
+
+#ifndef CALC_NO_DIAG
+    printf("--- Testing the diagnostics screen ---\n");
+    RUN_TEST(test_diag_screen_pages_and_returns);
+    printf("\n");
+#endif
+
+    printf("--- Testing display rendering ---\n");
+    RUN_TEST(test_format_integer_and_float);
+    RUN_TEST(test_format_large_uses_scientific);
+    RUN_TEST(test_format_matches_printf_rounding);
+    RUN_TEST(test_render_tail_short);
+    RUN_TEST(test_render_tail_long);
+    RUN_TEST(test_render_tail_typed_fractions);
+    RUN_TEST(test_render_tail_empty);
 
 
     printf("\n--- Test Summary ---\n");
@@ -0,0 +1,258 @@
+// test_sched.c - Host tests for the cooperative scheduler on a virtual clock
+
+#include <stdio.h>
+#include <string.h>
+#include "sched.h"
+#include "delay.h"
+
+// --- Assertion Macros ---
+#define ANSI_COLOR_RED     "\x1b[31m"
+#define ANSI_COLOR_GREEN   "\x1b[32m"
+#define ANSI_COLOR_RESET   "\x1b[0m"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+#define RUN_TEST(test_function) do { \
+    printf("Running %s...\n", #test_function); \
+    test_function(); \
+} while (0)
+
+#define ASSERT_TRUE(condition, message_format, ...) do { \
+    if (!(condition)) { \
+        printf(ANSI_COLOR_RED "[FAIL] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf(" (%s:%d)\n", __FILE__, __LINE__); \
+        tests_failed++; \
+    } else { \
+        printf(ANSI_COLOR_GREEN "[PASS] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf("\n"); \
+        tests_passed++; \
+    } \
+} while (0)
+
+#define ASSERT_EQUAL_INT(expected, actual, message_format, ...) do { \
+    long e_ = (long)(expected), a_ = (long)(actual); \
+    if (e_ != a_) { \
+        printf(ANSI_COLOR_RED "[FAIL] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf(" - Expected %ld, got %ld (%s:%d)\n", e_, a_, __FILE__, __LINE__); \
+        tests_failed++; \
+    } else { \
+        printf(ANSI_COLOR_GREEN "[PASS] " ANSI_COLOR_RESET); \
+        printf(message_format, ##__VA_ARGS__); \
+        printf("\n"); \
+        tests_passed++; \
+    } \
+} while (0)
+
+// --- Virtual Clock ---
+// Replaces delay.c: time only moves when a task "works" or the scheduler sleeps.
+static uint32_t virtual_us = 0;
+static int sleeps = 0;
+
+uint32_t uptime_us(void) {
+    return virtual_us;
+}
+
+void delay_us(unsigned int us) {
+    virtual_us += us;
+}
+
+void sleep_until_us(uint32_t at_us) {
+    sleeps++;
+    if ((int32_t)(at_us - virtual_us) > 0) {
+        virtual_us = at_us;
+    }
+}
+
+static void clock_reset(uint32_t start_us) {
+    virtual_us = start_us;
+    sleeps = 0;
+    sched_init();
+}
+
+// --- Trace of task runs ---
+#define TRACE_MAX 64
+static char trace[TRACE_MAX];
+static uint32_t trace_at[TRACE_MAX];
+static int trace_len = 0;
+
+static void trace_add(char id) {
+    if (trace_len < TRACE_MAX) {
+        trace_at[trace_len] = virtual_us;
+        trace[trace_len++] = id;
+    }
+    trace[trace_len < TRACE_MAX ? trace_len : TRACE_MAX - 1] = '\0';
+}
+
+static void trace_reset(void) {
+    trace_len = 0;
+    trace[0] = '\0';
+}
+
+// --- Test Tasks ---
+static char periodic_a(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        trace_add('a');
+        SCHED_SLEEP_US(t, 3000);
+    }
+    PT_END(&t->pt);
+}
+
+static char periodic_b(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        trace_add('b');
+        SCHED_SLEEP_US(t, 5000);
+    }
+    PT_END(&t->pt);
+}
+
+static sched_task *waiter = NULL;
+
+static char blocked_waiter(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        SCHED_WAIT(t);
+        trace_add('w');
+    }
+    PT_END(&t->pt);
+}
+
+static char waker(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    SCHED_SLEEP_US(t, 4000);
+    sched_wake(waiter);
+    SCHED_SLEEP_US(t, 4000);
+    sched_wake(waiter);
+    PT_END(&t->pt);
+}
+
+static char worker(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    for (;;) {
+        delay_us(200); // 200 us of work per millisecond
+        SCHED_SLEEP_UNTIL(t, t->wake_at + 1000);
+    }
+    PT_END(&t->pt);
+}
+
+static char steps(sched_task *t) {
+    PT_BEGIN(&t->pt);
+    trace_add('1');
+    SCHED_YIELD(t);
+    trace_add('2');
+    SCHED_YIELD(t);
+    trace_add('3');
+    PT_END(&t->pt);
+}
+
+static char nothing(sched_task *t) {
+    (void)t;
+    return PT_WAITING;
+}
+
+// --- Test Cases ---
+
+void test_tasks_wake_in_deadline_order() {
+    clock_reset(0);
+    trace_reset();
+    sched_add("a", periodic_a);
+    sched_add("b", periodic_b);
+    sched_run_until(15500);
+    // a at 0,3,6,9,12,15; b at 0,5,10,15 (a first on ties: it was added first)
+    ASSERT_TRUE(strcmp(trace, "ababaabaab") == 0, "Sched: runs in deadline order (got %s)", trace);
+    ASSERT_EQUAL_INT(10000, trace_at[6], "Sched: b's third run at its deadline");
+    ASSERT_EQUAL_INT(15500, uptime_us(), "Sched: run_until stops at its deadline");
+    ASSERT_EQUAL_INT(15500, sched_idle_us, "Sched: all time without work is idle");
+}
+
+void test_sleep_goes_to_earliest_deadline() {
+    clock_reset(0);
+    trace_reset();
+    sched_add("a", periodic_a);
+    sched_add("b", periodic_b);
+    sched_run_once(); // a at 0
+    sched_run_once(); // b at 0
+    ASSERT_EQUAL_INT(0, sched_run_once(), "Sched: nothing due, run_once sleeps");
+    ASSERT_EQUAL_INT(3000, uptime_us(), "Sched: slept exactly until a's deadline");
+    ASSERT_EQUAL_INT(1, sched_run_once(), "Sched: a runs after the sleep");
+}
+
+void test_blocked_task_runs_only_when_woken() {
+    clock_reset(0);
+    trace_reset();
+    waiter = sched_add("waiter", blocked_waiter);
+    sched_add("waker", waker);
+    sched_run_until(20000);
+    ASSERT_TRUE(strcmp(trace, "ww") == 0, "Sched: blocked task ran once per wake (got %s)", trace);
+    ASSERT_EQUAL_INT(4000, trace_at[0], "Sched: first wake at 4 ms");
+    ASSERT_EQUAL_INT(8000, trace_at[1], "Sched: second wake at 8 ms");
+    ASSERT_TRUE(!sched_tasks[1].active, "Sched: task that reached PT_END is removed");
+}
+
+void test_runtime_accounting() {
+    clock_reset(0);
+    sched_task *t = sched_add("worker", worker);
+    sched_run_until(10000);
+    ASSERT_EQUAL_INT(10, t->runs, "Sched: periodic task ran every millisecond");
+    ASSERT_EQUAL_INT(2000, t->runtime_us, "Sched: runtime is the sum of the work");
+    ASSERT_EQUAL_INT(200, t->max_run_us, "Sched: longest run recorded");
+    ASSERT_EQUAL_INT(8000, sched_idle_us, "Sched: idle time is the rest");
+}
+
+void test_protothread_resumes_after_yield() {
+    clock_reset(0);
+    trace_reset();
+    sched_task *t = sched_add("steps", steps);
+    sched_run_once();
+    ASSERT_TRUE(strcmp(trace, "1") == 0, "PT: first run stops at the first yield");
+    sched_run_once();
+    sched_run_once();
+    ASSERT_TRUE(strcmp(trace, "123") == 0, "PT: later runs resume after each yield");
+    ASSERT_TRUE(!t->active, "PT: finished task leaves the table");
+    ASSERT_TRUE(sched_add("again", steps) == t, "PT: its slot is reused");
+}
+
+void test_deadlines_across_clock_wrap() {
+    clock_reset(0xFFFFF000u); // 4096 us before the 32-bit uptime wraps
+    trace_reset();
+    sched_add("a", periodic_a);
+    sched_run_until(0x00001000u);
+    ASSERT_EQUAL_INT(3, trace_len, "Sched: periodic task keeps running across the wrap");
+}
+
+void test_task_table_is_fixed() {
+    int i;
+    clock_reset(0);
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_add("n", nothing);
+    }
+    ASSERT_TRUE(sched_add("extra", nothing) == NULL, "Sched: adding past SCHED_MAX_TASKS fails");
+    printf("Scheduler RAM: %u bytes for %d tasks\n", (unsigned)sizeof(sched_tasks), SCHED_MAX_TASKS);
+}
+
+
+// --- Main Test Runner ---
+int main() {
+    printf("Starting scheduler tests on a virtual clock...\n\n");
+
+    printf("--- Testing sched.c ---\n");
+    RUN_TEST(test_tasks_wake_in_deadline_order);
+    RUN_TEST(test_sleep_goes_to_earliest_deadline);
+    RUN_TEST(test_blocked_task_runs_only_when_woken);
+    RUN_TEST(test_runtime_accounting);
+    RUN_TEST(test_protothread_resumes_after_yield);
+    RUN_TEST(test_deadlines_across_clock_wrap);
+    RUN_TEST(test_task_table_is_fixed);
+
+    printf("\n--- Test Summary ---\n");
+    printf(ANSI_COLOR_GREEN "Passed: %d\n" ANSI_COLOR_RESET, tests_passed);
+    printf(ANSI_COLOR_RED "Failed: %d\n" ANSI_COLOR_RESET, tests_failed);
+    printf("\n");
+
+    return (tests_failed == 0) ? 0 : 1;
+}
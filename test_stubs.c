@@ -2,7 +2,9 @@
 
 #include "lcd.h"
 #include "keypad.h"
+#define DELAY_IMPLEMENTATION // Defines delay() and delay_us()
 #include "delay.h"
+#include "logic.h" // For KEY_NONE
 #include <stdio.h> // For printf in stubs if needed for debugging
 
 // --- LCD Stubs ---
@@ -20,6 +22,26 @@ void lcdinit(void) {
     // Stub: Does nothing
 }
 
+void lcd_goto(unsigned char line, unsigned char col) {
+    // Stub: Does nothing
+}
+
+void lcd_write_at(unsigned char line, unsigned char col, const char *str, int len) {
+    // Stub: Does nothing
+}
+
+void lcd_shift_display_left(unsigned char steps) {
+    // Stub: Does nothing
+}
+
+void lcd_frame_begin(void) {
+    // Stub: Does nothing
+}
+
+void lcd_frame_end(void) {
+    // Stub: Does nothing
+}
+
 // --- Keypad Stubs ---
 // Global variable to control GetKeyPressed return value for specific tests if needed
 static unsigned char mock_key_pressed = KEY_NONE; 
@@ -38,7 +60,31 @@ unsigned char GetKeyPressed(void) {
     return key_to_return;
 }
 
+void KeypadPoll(void) {
+    // Stub: Does nothing, keys come straight from GetKeyPressed()
+}
+
+unsigned char KeypadNextKey(void) {
+    return GetKeyPressed();
+}
+
+unsigned char KeypadPeekKey(void) {
+    return GetKeyPressed();
+}
+
+int KeypadFlushThrough(unsigned char key) {
+    return GetKeyPressed() == key;
+}
+
 // --- Delay Stubs ---
 void delay(unsigned int ms) {
     // Stub: Does nothing, or could simulate time passing if tests become time-sensitive
 }
+
+void delay_us(unsigned int us) {
+    // Stub: Does nothing
+}
+
+uint32_t uptime_us(void) {
+    return 0; // Stub: Time does not pass in the logic tests
+}
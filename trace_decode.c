@@ -0,0 +1,190 @@
+// trace_decode.c - Converts an event trace (event_trace.h) to Chrome trace-event JSON
+//
+// Input is either the record stream itself (the host backend's file, or ITM port
+// EVENT_TRACE_ITM_PORT already separated by the SWO tool), or with -i a raw SWO
+// capture with ITM packet framing, from which the port's bytes are picked out.
+// Evaluations and LCD frames become duration slices, keys and errors instant
+// events, each kind on its own track. Open the output in chrome://tracing or
+// ui.perfetto.dev.
+//
+//     gcc -Wall -I. -o trace_decode trace_decode.c -std=c99
+//     ./trace_decode [-i] events.bin [events.json]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "event_trace.h"
+
+#define MAX_BYTES (4u << 20) // Largest capture read
+
+enum { TRACK_KEYS = 1, TRACK_EVAL, TRACK_LCD, TRACK_ERRORS };
+
+static unsigned char *data;
+static size_t length;
+
+static const char key_names[] = "0123456789+-*/=.";
+static const char *const view_names[] = { "splash", "input", "message", "diag" };
+
+static uint32_t get_word(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return -1;
+    }
+    data = malloc(MAX_BYTES);
+    length = data ? fread(data, 1, MAX_BYTES, f) : 0;
+    fclose(f);
+    return data ? 0 : -1;
+}
+
+// Keeps the payload of the software packets for our stimulus port and drops sync,
+// overflow, timestamp, extension and hardware-source packets (ARMv7-M ARM, D4.2)
+static void itm_demux(void)
+{
+    size_t in = 0, out = 0;
+
+    while (in < length) {
+        unsigned char h = data[in++];
+        if (h == 0x00 || h == 0x80 || h == 0x70) {
+            continue; // Synchronization or overflow
+        }
+        if ((h & 0x03) != 0) {
+            size_t size = ((h & 0x03) == 3) ? 4 : (h & 0x03);
+            if ((h & 0x04) == 0 && (h >> 3) == EVENT_TRACE_ITM_PORT) {
+                size_t i;
+                for (i = 0; i < size && in + i < length; i++) {
+                    data[out++] = data[in + i];
+                }
+            }
+            in += size;
+            continue;
+        }
+        // Protocol packet: timestamps and extensions carry continuation bytes
+        if (h & 0x80) {
+            while (in < length && (data[in++] & 0x80)) {
+            }
+        }
+    }
+    length = out;
+}
+
+// Offset of the first EVT_START record, so that a capture that begins in the
+// middle of a record still lines up; 0 if there is none
+static size_t find_start(void)
+{
+    size_t at;
+    for (at = 0; at + 8 <= length; at++) {
+        if (get_word(data + at + 4) == EVENT_TRACE_WORD1(EVT_START, EVENT_TRACE_VERSION)) {
+            return at;
+        }
+    }
+    return 0;
+}
+
+static void emit(FILE *out, int *first, const char *name, char phase, uint64_t ts, int track, const char *args)
+{
+    fprintf(out, "%s\n  {\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":1,\"tid\":%d%s%s%s}",
+            *first ? "" : ",", name, phase, (unsigned long long)ts, track,
+            phase == 'i' ? ",\"s\":\"t\"" : "", args ? ",\"args\":" : "", args ? args : "");
+    *first = 0;
+}
+
+static void track_name(FILE *out, int *first, int track, const char *name)
+{
+    fprintf(out, "%s\n  {\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            *first ? "" : ",", track, name);
+    *first = 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *in_path = NULL, *out_path = NULL;
+    FILE *out = stdout;
+    int itm = 0, first = 1, i;
+    unsigned long records = 0, unknown = 0;
+    uint64_t ts = 0;
+    uint32_t last = 0;
+    size_t at;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-i") == 0) {
+            itm = 1;
+        } else if (!in_path) {
+            in_path = argv[i];
+        } else {
+            out_path = argv[i];
+        }
+    }
+    if (!in_path) {
+        fprintf(stderr, "usage: %s [-i] events.bin [events.json]\n", argv[0]);
+        return 1;
+    }
+    if (load(in_path) < 0) return 1;
+    if (itm) itm_demux();
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        fprintf(stderr, "%s: cannot create\n", out_path);
+        return 1;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    track_name(out, &first, TRACK_KEYS, "keys");
+    track_name(out, &first, TRACK_EVAL, "evaluation");
+    track_name(out, &first, TRACK_LCD, "LCD");
+    track_name(out, &first, TRACK_ERRORS, "errors");
+
+    for (at = find_start(); at + 8 <= length; at += 8) {
+        uint32_t time = get_word(data + at);
+        uint32_t word1 = get_word(data + at + 4);
+        uint32_t arg = word1 >> 8;
+        char name[32], args[48];
+
+        // uptime_us() wraps every 71.6 minutes; the trace keeps counting
+        ts = (records == 0) ? time : ts + (uint32_t)(time - last);
+        last = time;
+        records++;
+
+        switch ((event_trace_type)(word1 & 0xFF)) {
+        case EVT_START:
+            break;
+        case EVT_KEY:
+            snprintf(name, sizeof(name), "key %c", arg < 16 ? key_names[arg] : '?');
+            emit(out, &first, arg < 16 ? name : "key diag", 'i', ts, TRACK_KEYS, NULL);
+            break;
+        case EVT_EVAL_BEGIN:
+            snprintf(args, sizeof(args), "{\"tokens\":%lu}", (unsigned long)arg);
+            emit(out, &first, "evaluate", 'B', ts, TRACK_EVAL, args);
+            break;
+        case EVT_EVAL_END:
+            snprintf(args, sizeof(args), "{\"ops\":%lu}", (unsigned long)arg);
+            emit(out, &first, "evaluate", 'E', ts, TRACK_EVAL, args);
+            break;
+        case EVT_LCD_BEGIN:
+            snprintf(name, sizeof(name), "frame %s", arg < 4 ? view_names[arg] : "?");
+            emit(out, &first, name, 'B', ts, TRACK_LCD, NULL);
+            break;
+        case EVT_LCD_END:
+            emit(out, &first, "", 'E', ts, TRACK_LCD, NULL);
+            break;
+        case EVT_ERROR:
+            snprintf(name, sizeof(name), "Err: %c%c%c", (char)arg, (char)(arg >> 8), (char)(arg >> 16));
+            emit(out, &first, name, 'i', ts, TRACK_ERRORS, NULL);
+            break;
+        default:
+            unknown++;
+            break;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    if (out != stdout) fclose(out);
+
+    fprintf(stderr, "%lu records, %lu unknown, %.3f s\n", records, unknown,
+            records ? (ts - (uint64_t)get_word(data + find_start())) / 1e6 : 0.0);
+    return 0;
+}
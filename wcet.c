@@ -0,0 +1,391 @@
+// ============= WCET.C =============
+// Worst-case execution time harness (see wcet.h). The input sets are built
+// directly in the calculator's state (expr_type/expr_data, current_num_str) from
+// values that can be typed on the keypad. Nothing here allocates or uses the printf
+// family, so the same code runs on the board, on QEMU and on the host.
+// ===================================
+
+#include "wcet.h"
+#include <float.h>
+#include <string.h>
+#include "fmt.h"
+#include "logic.h"
+
+// --- Inputs of the evaluator: MAX_TOKENS - 1 tokens, the longest accepted ---
+
+typedef struct {
+    const char *name;
+    const float *values; // Operands, cycled
+    int count;
+} operand_family;
+
+static const float small_ints[] = { 7.0f, 3.0f };
+static const float fractions[] = { 0.12345678901234f, 9876543.21098765f }; // 16 characters typed
+static const float tiny[] = { 0.00000000000001f, 0.00000000000003f };     // Products go subnormal
+static const float huge[] = { 9999999999999999.0f, 8888888888888888.0f }; // Products overflow
+static const float negatives[] = { -0.1234567890123f, -987654.32109876f };
+
+#define FAMILY(values) { #values, values, (int)(sizeof(values) / sizeof(values[0])) }
+static const operand_family families[] = {
+    FAMILY(small_ints), FAMILY(fractions), FAMILY(tiny), FAMILY(huge), FAMILY(negatives),
+};
+#define FAMILIES (int)(sizeof(families) / sizeof(families[0]))
+
+// Operators, cycled: alternating precedence pushes and pops the operator stack at
+// every token; a single operator applies at every token
+static const char *const op_patterns[] = { "+*", "*+", "-", "/", "*", "+-*/" };
+#define OP_PATTERNS (int)(sizeof(op_patterns) / sizeof(op_patterns[0]))
+
+// Operands of the random search: every family
+static const float *const pool[] = { small_ints, fractions, tiny, huge, negatives };
+#define POOL_SIZE (FAMILIES * 2)
+
+// --- Inputs of the number parser and the formatter ---
+
+static const char *const parse_inputs[] = {
+    "9999999999999999", "-999999999999999", "0.12345678901234", "-0.1234567890123",
+    "0.99999999999999", "9.99999999999999", "0.00000000000001", "1234567.89012345",
+    "999999999999999.", "-0.0000000000001",
+};
+#define PARSE_INPUTS (int)(sizeof(parse_inputs) / sizeof(parse_inputs[0]))
+
+static const float format_inputs[] = {
+    0.0f, -0.0f, FLT_MIN, 1.40129846e-45f, FLT_MAX, -FLT_MAX, FLT_EPSILON, 16777215.0f, 8388607.5f,
+    8388608.0f, 0.1f, 0.0000005f, 0.333333343f, -1234567.875f, 9999999999999999.0f, 1e16f, 1e-5f,
+    123456.789f, -0.000999999f,
+};
+#define FORMAT_INPUTS (int)(sizeof(format_inputs) / sizeof(format_inputs[0]))
+
+// --- Measurement ---
+
+static uint32_t overhead; // Cost of measuring an empty call
+static int reps_per_input;
+static volatile float sink_f;
+static volatile int sink_i;
+
+// The input being measured
+static const char *eval_ops;
+static const operand_family *eval_family;
+static uint32_t eval_seed; // Nonzero: random operators and operands
+static const char *parse_text;
+static float format_value;
+
+static uint32_t xorshift32(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static void eval_build(void)
+{
+    uint32_t s = eval_seed;
+    int i;
+
+    clear_all_state();
+    for (i = 0; i < MAX_TOKENS - 1; i++) {
+        if (i & 1) {
+            push_operator_to_expr(s ? "+-*/"[xorshift32(&s) & 3] : eval_ops[(i >> 1) % (int)strlen(eval_ops)]);
+        } else if (s) {
+            uint32_t v = xorshift32(&s) % POOL_SIZE;
+            push_operand_to_expr(pool[v / 2][v % 2]);
+        } else {
+            push_operand_to_expr(eval_family->values[(i >> 1) % eval_family->count]);
+        }
+    }
+}
+
+static void eval_call(void)
+{
+    sink_f = evaluate_full_expression();
+}
+
+static void parse_setup(void)
+{
+    clear_all_state();
+    current_num_index = (int)strlen(parse_text);
+    memcpy(current_num_str, parse_text, (size_t)current_num_index);
+}
+
+static void parse_call(void)
+{
+    sink_f = parse_current_input_number();
+}
+
+static void format_setup(void)
+{
+}
+
+static void format_call(void)
+{
+    char buf[LCD_LINE_LEN + 1];
+    sink_i = format_number(format_value, buf, sizeof(buf));
+}
+
+// Whether `cost` replaces `kept` as the figure of an input over its repetitions:
+// the greatest, or on the host the least (see wcet.h)
+static bool keep_cost(uint32_t cost, uint32_t kept)
+{
+#ifdef WCET_HOST
+    return cost < kept;
+#else
+    return cost > kept;
+#endif
+}
+
+// Cost of `call` over the repetitions, the first included, `setup` not counted
+static uint32_t measure(void (*setup)(void), void (*call)(void))
+{
+    uint32_t kept = 0;
+    int r;
+
+    for (r = 0; r < reps_per_input; r++) {
+        uint32_t start, cost;
+
+        setup();
+        start = wcet_now();
+        call();
+        cost = wcet_since(start);
+        if (r == 0 || keep_cost(cost, kept)) kept = cost;
+    }
+    return kept > overhead ? kept - overhead : 0;
+}
+
+// Least cost of an empty call, subtracted from every figure
+static uint32_t measure_overhead(void (*call)(void))
+{
+    uint32_t least = UINT32_MAX;
+    int r;
+
+    for (r = 0; r < reps_per_input; r++) {
+        uint32_t start = wcet_now(), cost;
+
+        call();
+        cost = wcet_since(start);
+        if (cost < least) least = cost;
+    }
+    return least;
+}
+
+// Costliest evaluate_step(EVAL_SLICE_OPS) of the expression eval_build() makes;
+// each slice's cost is kept over the repetitions as in measure()
+static uint32_t measure_slices(void)
+{
+    uint32_t kept[2 * MAX_TOKENS + 2], worst = 0;
+    int slices = 0, r, s;
+
+    for (r = 0; r < reps_per_input; r++) {
+        eval_build();
+        evaluate_begin();
+        for (s = 0; s < 2 * MAX_TOKENS + 2; s++) {
+            uint32_t start = wcet_now();
+            bool done = evaluate_step(EVAL_SLICE_OPS);
+            uint32_t cost = wcet_since(start);
+
+            if (r == 0 || keep_cost(cost, kept[s])) kept[s] = cost;
+            if (done) break;
+        }
+        slices = s + 1;
+    }
+    for (s = 0; s < slices && s < 2 * MAX_TOKENS + 2; s++) {
+        if (kept[s] > worst) worst = kept[s];
+    }
+    return worst > overhead ? worst - overhead : 0;
+}
+
+static void record(wcet_result *res, uint32_t cost, const char *label)
+{
+    res->inputs++;
+    if (res->inputs == 1 || cost > res->worst) {
+        int n = (int)strlen(label);
+        if (n > (int)sizeof(res->input) - 1) n = (int)sizeof(res->input) - 1;
+        memcpy(res->input, label, (size_t)n);
+        res->input[n] = '\0';
+        res->worst = cost;
+    }
+}
+
+static int fmt_hex32(char *buf, int len, uint32_t v)
+{
+    int d;
+
+    len = fmt_str(buf, len, "0x");
+    for (d = 28; d >= 0; d -= 4) {
+        buf[len++] = "0123456789abcdef"[(v >> d) & 15];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static void try_format(wcet_result *res, float value, const char *from)
+{
+    char label[64], text[LCD_LINE_LEN + 1];
+    uint32_t bits;
+    int len;
+
+    format_value = value;
+    memcpy(&bits, &value, sizeof(bits));
+    format_number(value, text, sizeof(text));
+    len = fmt_hex32(label, 0, bits);
+    len = fmt_str(label, len, " ");
+    len = fmt_str(label, len, from ? from : text);
+    record(res, measure(format_setup, format_call), label);
+}
+
+// The evaluator input now set up, for both evaluator figures and the formatter
+static void try_eval(wcet_result *results, const char *label)
+{
+    float result;
+
+    record(&results[WCET_EVAL_FULL], measure(eval_build, eval_call), label);
+    record(&results[WCET_EVAL_SLICE], measure_slices(), label);
+    eval_build();
+    result = evaluate_full_expression();
+    if (!calculator_error) {
+        try_format(&results[WCET_FORMAT], result, NULL);
+    }
+}
+
+static void noop(void)
+{
+}
+
+bool wcet_run(wcet_result *results, int reps)
+{
+    static const char *const names[WCET_FUNCTIONS] = {
+        "evaluate_full_expression", "evaluate_step (slice)", "parse_current_input_number", "format_number",
+    };
+    static const uint32_t budgets[WCET_FUNCTIONS] = {
+        WCET_BUDGET_EVAL_FULL, WCET_BUDGET_EVAL_SLICE, WCET_BUDGET_PARSE, WCET_BUDGET_FORMAT,
+    };
+    char label[64], number[LCD_LINE_LEN + 1];
+    uint32_t s = WCET_SEED;
+    bool ok = true;
+    int f, p, i, len;
+
+    memset(results, 0, WCET_FUNCTIONS * sizeof(*results));
+    for (f = 0; f < WCET_FUNCTIONS; f++) {
+        results[f].function = names[f];
+        results[f].budget = budgets[f];
+    }
+    reps_per_input = reps > 0 ? reps : 1;
+    overhead = measure_overhead(noop);
+
+    // Evaluator: every operator pattern over every operand family, then random
+    eval_seed = 0;
+    for (p = 0; p < OP_PATTERNS; p++) {
+        for (f = 0; f < FAMILIES; f++) {
+            eval_ops = op_patterns[p];
+            eval_family = &families[f];
+            len = fmt_str(label, 0, op_patterns[p]);
+            len = fmt_str(label, len, " ");
+            fmt_str(label, len, families[f].name);
+            try_eval(results, label);
+        }
+    }
+    for (i = 0; i < WCET_RANDOM; i++) {
+        eval_seed = xorshift32(&s);
+        len = fmt_str(label, 0, "random ");
+        fmt_u64(label + len, (uint64_t)i);
+        try_eval(results, label);
+    }
+
+    // Parser: the longest numbers, then random ones of 16 characters
+    for (i = 0; i < PARSE_INPUTS + WCET_RANDOM; i++) {
+        if (i < PARSE_INPUTS) {
+            parse_text = parse_inputs[i];
+        } else {
+            int neg = (int)(xorshift32(&s) & 1);
+            int dot = (int)(xorshift32(&s) % LCD_LINE_LEN); // At 0 or right after '-': no point
+            int c;
+
+            for (c = 0; c < LCD_LINE_LEN; c++) {
+                number[c] = (char)('0' + xorshift32(&s) % 10);
+            }
+            if (neg) number[0] = '-';
+            if (dot > neg) number[dot] = '.';
+            number[LCD_LINE_LEN] = '\0';
+            parse_text = number;
+        }
+        record(&results[WCET_PARSE], measure(parse_setup, parse_call), parse_text);
+    }
+
+    // Formatter: the extremes of float and random bit patterns (the evaluator's
+    // results were tried above)
+    for (i = 0; i < FORMAT_INPUTS; i++) {
+        try_format(&results[WCET_FORMAT], format_inputs[i], NULL);
+    }
+    for (i = 0; i < WCET_RANDOM; i++) {
+        uint32_t bits = xorshift32(&s);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        try_format(&results[WCET_FORMAT], value, NULL);
+    }
+
+    clear_all_state();
+    for (f = 0; f < WCET_FUNCTIONS; f++) {
+        ok = ok && results[f].worst <= results[f].budget;
+    }
+    return ok;
+}
+
+#ifdef WCET_REPORT
+// --- On the board: DWT cycles, outcome on the LCD ---
+#include <LPC17xx.h>
+#include "clock.h"
+#include "delay.h"
+#include "lcd.h"
+
+wcet_result wcet_results[WCET_FUNCTIONS];
+
+uint32_t wcet_now(void)
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t wcet_since(uint32_t start)
+{
+    return DWT->CYCCNT - start;
+}
+
+void wcet_report(void)
+{
+    static const char *const short_names[WCET_FUNCTIONS] = { "Eval", "Slice", "Parse", "Format" };
+    char line[32]; // Room for any count; cut to the LCD width below
+    bool ok;
+    int f, over = -1, len;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    clock_boost();
+#ifndef LPC17XX_HOST_SIM
+    __disable_irq(); // Only the measured code is counted
+#endif
+    ok = wcet_run(wcet_results, 3);
+#ifndef LPC17XX_HOST_SIM
+    __enable_irq();
+#endif
+    clock_release();
+    for (f = WCET_FUNCTIONS - 1; f >= 0; f--) {
+        if (wcet_results[f].worst > wcet_results[f].budget) over = f;
+    }
+
+    // "WCET ok" with the worst slice, or the first function over its budget. Against
+    // the estimated budgets that is only "est ok" (see wcet.h).
+    f = ok ? WCET_EVAL_SLICE : over;
+    len = fmt_str(line, 0, ok ? (WCET_BUDGETS_MEASURED ? "WCET ok" : "WCET est ok") : "WCET over: ");
+    if (!ok) fmt_str(line, len, short_names[f]);
+    line[LCD_LINE_LEN] = '\0';
+    lcdchar(LCD_CMD_CLEAR_DISPLAY, 'C');
+    lcdstring(line);
+    len = fmt_str(line, 0, short_names[f]);
+    len = fmt_str(line, len, " ");
+    len += fmt_u64(line + len, wcet_results[f].worst);
+    fmt_str(line, len, " cyc");
+    line[LCD_LINE_LEN] = '\0';
+    lcdchar(LCD_CMD_CURSOR_LINE_2, 'C');
+    lcdstring(line);
+    delay(2000); // The start-up message replaces it
+}
+#endif
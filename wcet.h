@@ -0,0 +1,74 @@
+// ============= WCET.H =============
+// Worst-case execution time of the calculator's hot functions. wcet_run() feeds
+// each function adversarial inputs, then a seeded random search, and keeps the
+// costliest input and its cost. The inputs are:
+// - evaluate_full_expression() and one evaluate_step() slice: the longest
+//   expression, with alternating precedence and single-operator chains, over
+//   16-digit fractions and tiny and huge operands that produce subnormal and
+//   infinite results
+// - parse_current_input_number(): 16-character numbers
+// - format_number(): the extremes of float and every result above
+// Each cost is the greatest of `reps` runs of the input. The first run follows the
+// setup code, so it starts with the flash accelerator holding other lines, and is
+// counted. The board runs the harness with interrupts masked, so nothing else is
+// counted. The host cannot mask the OS and keeps the least of the runs instead:
+// its figures rank inputs and catch regressions, but are not worst cases.
+//
+// The target supplies the counter:
+// - wcet.c itself: CPU cycles (DWT) on the board, built with -DWCET_REPORT
+// - qemu/wcet_qemu.c: instructions on QEMU (not run yet, see run_qemu.sh)
+// - wcet_host.c: nanoseconds on the host
+#ifndef WCET_H
+#define WCET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Budgets per call. On the board they are CPU cycles, hundredths of a
+// microsecond at 100 MHz. QEMU counts instructions, which take at least one cycle
+// each on a Cortex-M3, so it checks against the same figures. The host measures
+// nanoseconds on a much faster CPU and has budgets of its own, to catch
+// regressions in the input paths.
+#ifdef WCET_HOST
+#define WCET_BUDGET_EVAL_FULL 1200 // About 3x the worst case on an x86-64 host
+#define WCET_BUDGET_EVAL_SLICE 400
+#define WCET_BUDGET_PARSE 150
+#define WCET_BUDGET_FORMAT 1200
+#else
+// Estimates: no board or QEMU figure has been taken yet. Until one has been
+// recorded here and WCET_BUDGETS_MEASURED set to 1, being within them proves
+// nothing, and wcet_report() says so.
+#define WCET_BUDGETS_MEASURED 0
+#define WCET_BUDGET_EVAL_FULL 50000 // 500 us: the whole longest expression
+#define WCET_BUDGET_EVAL_SLICE 5000 // 50 us: keys are scanned between slices
+#define WCET_BUDGET_PARSE 5000
+#define WCET_BUDGET_FORMAT 20000
+#endif
+
+#define WCET_RANDOM 200 // Random inputs per function after the adversarial sets
+#define WCET_SEED 1
+
+enum { WCET_EVAL_FULL, WCET_EVAL_SLICE, WCET_PARSE, WCET_FORMAT, WCET_FUNCTIONS };
+
+typedef struct {
+    const char *function;
+    char input[40];  // The worst input found
+    uint32_t worst;  // Its cost, in the target's unit
+    uint32_t budget;
+    uint32_t inputs; // Inputs tried
+} wcet_result;
+
+// Supplied by the target: a timestamp, and the count since it
+uint32_t wcet_now(void);
+uint32_t wcet_since(uint32_t start);
+
+// Fills results[WCET_FUNCTIONS]; returns true if every worst case is within budget
+bool wcet_run(wcet_result *results, int reps);
+
+#ifdef WCET_REPORT
+extern wcet_result wcet_results[WCET_FUNCTIONS]; // The last run, for a debugger
+
+void wcet_report(void); // Runs it at full clock and shows the outcome on the LCD for 2 s
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+// wcet_host.c - Runs the WCET harness (wcet.c) on the host in nanoseconds
+//
+// Prints each function's worst input and cost against the host budgets of
+// wcet.h, and exits with 1 if one is over. The host is much faster than the
+// board, so it mainly finds the costliest inputs and catches regressions; the
+// board's cycle counts come from the -DWCET_REPORT firmware build and QEMU
+// (qemu/wcet_qemu.c).
+//
+// Build and run commands are in README.md ("Worst-Case Execution Time").
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime() under -std=c99
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "wcet.h"
+
+uint32_t wcet_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32_t)((uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec);
+}
+
+uint32_t wcet_since(uint32_t start)
+{
+    return wcet_now() - start;
+}
+
+int main(int argc, char **argv)
+{
+    wcet_result results[WCET_FUNCTIONS];
+    int reps = argc > 1 ? atoi(argv[1]) : 50;
+    bool ok = wcet_run(results, reps);
+    int f;
+
+    printf("%-28s %9s %9s %7s  %s\n", "function", "worst ns", "budget", "inputs", "worst input");
+    for (f = 0; f < WCET_FUNCTIONS; f++) {
+        const wcet_result *r = &results[f];
+        printf("%-28s %9lu %9lu %7lu  %s%s\n", r->function, (unsigned long)r->worst, (unsigned long)r->budget,
+               (unsigned long)r->inputs, r->input, r->worst > r->budget ? "  OVER BUDGET" : "");
+    }
+    return ok ? 0 : 1;
+}